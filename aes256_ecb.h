@@ -1,8 +1,11 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 
+#include "aes_tables.h"
+
 // Check for AES-NI support
 #if defined(__AES__) || defined(_MSC_VER)
 #include <emmintrin.h> // SSE2
@@ -13,200 +16,58 @@
 #define USE_AES_NI 0
 #endif
 
-// AES-256 with AES-NI Hardware Acceleration
-// This provides 10-50x speedup over software implementation
-
-namespace mcbe_aes {
+// VAES: two AES blocks per 256-bit register
+#if USE_AES_NI && defined(__VAES__) && defined(__AVX2__)
+#include <immintrin.h>
 
-struct AES256Ctx {
-#if USE_AES_NI
-  __m128i roundKeys[15]; // 15 round keys for AES-256
+#define USE_VAES 1
 #else
-  uint8_t roundKey[240];
+#define USE_VAES 0
 #endif
-};
-
-#if USE_AES_NI
 
-// ============================================
-// AES-NI HARDWARE ACCELERATED IMPLEMENTATION
-// ============================================
-
-// Key expansion helper
-static inline __m128i aes256_key_exp_128(__m128i key, __m128i keygened) {
-  keygened = _mm_shuffle_epi32(keygened, _MM_SHUFFLE(3, 3, 3, 3));
-  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
-  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
-  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
-  return _mm_xor_si128(key, keygened);
-}
-
-static inline __m128i aes256_key_exp_256(__m128i key, __m128i keygened) {
-  keygened = _mm_shuffle_epi32(keygened, _MM_SHUFFLE(2, 2, 2, 2));
-  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
-  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
-  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
-  return _mm_xor_si128(key, keygened);
-}
+// ARMv8 Crypto Extensions
+#if defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO)
+#include <arm_neon.h>
 
-static inline void aes256_init(AES256Ctx &ctx, const uint8_t key[32]) {
-  __m128i key1 = _mm_loadu_si128((__m128i *)key);
-  __m128i key2 = _mm_loadu_si128((__m128i *)(key + 16));
-
-  ctx.roundKeys[0] = key1;
-  ctx.roundKeys[1] = key2;
-
-  // Generate round keys using AESKEYGENASSIST
-  ctx.roundKeys[2] =
-      aes256_key_exp_128(key1, _mm_aeskeygenassist_si128(key2, 0x01));
-  ctx.roundKeys[3] = aes256_key_exp_256(
-      key2, _mm_aeskeygenassist_si128(ctx.roundKeys[2], 0x00));
-  ctx.roundKeys[4] = aes256_key_exp_128(
-      ctx.roundKeys[2], _mm_aeskeygenassist_si128(ctx.roundKeys[3], 0x02));
-  ctx.roundKeys[5] = aes256_key_exp_256(
-      ctx.roundKeys[3], _mm_aeskeygenassist_si128(ctx.roundKeys[4], 0x00));
-  ctx.roundKeys[6] = aes256_key_exp_128(
-      ctx.roundKeys[4], _mm_aeskeygenassist_si128(ctx.roundKeys[5], 0x04));
-  ctx.roundKeys[7] = aes256_key_exp_256(
-      ctx.roundKeys[5], _mm_aeskeygenassist_si128(ctx.roundKeys[6], 0x00));
-  ctx.roundKeys[8] = aes256_key_exp_128(
-      ctx.roundKeys[6], _mm_aeskeygenassist_si128(ctx.roundKeys[7], 0x08));
-  ctx.roundKeys[9] = aes256_key_exp_256(
-      ctx.roundKeys[7], _mm_aeskeygenassist_si128(ctx.roundKeys[8], 0x00));
-  ctx.roundKeys[10] = aes256_key_exp_128(
-      ctx.roundKeys[8], _mm_aeskeygenassist_si128(ctx.roundKeys[9], 0x10));
-  ctx.roundKeys[11] = aes256_key_exp_256(
-      ctx.roundKeys[9], _mm_aeskeygenassist_si128(ctx.roundKeys[10], 0x00));
-  ctx.roundKeys[12] = aes256_key_exp_128(
-      ctx.roundKeys[10], _mm_aeskeygenassist_si128(ctx.roundKeys[11], 0x20));
-  ctx.roundKeys[13] = aes256_key_exp_256(
-      ctx.roundKeys[11], _mm_aeskeygenassist_si128(ctx.roundKeys[12], 0x00));
-  ctx.roundKeys[14] = aes256_key_exp_128(
-      ctx.roundKeys[12], _mm_aeskeygenassist_si128(ctx.roundKeys[13], 0x40));
-}
+#define USE_AES_ARM 1
+#else
+#define USE_AES_ARM 0
+#endif
 
-static inline void aes256_encrypt_block(const AES256Ctx &ctx,
-                                        const uint8_t in[16], uint8_t out[16]) {
-  __m128i state = _mm_loadu_si128((__m128i *)in);
-
-  // Initial AddRoundKey
-  state = _mm_xor_si128(state, ctx.roundKeys[0]);
-
-  // 13 rounds of AES encryption (AESENC instruction = SubBytes + ShiftRows +
-  // MixColumns + AddRoundKey)
-  state = _mm_aesenc_si128(state, ctx.roundKeys[1]);
-  state = _mm_aesenc_si128(state, ctx.roundKeys[2]);
-  state = _mm_aesenc_si128(state, ctx.roundKeys[3]);
-  state = _mm_aesenc_si128(state, ctx.roundKeys[4]);
-  state = _mm_aesenc_si128(state, ctx.roundKeys[5]);
-  state = _mm_aesenc_si128(state, ctx.roundKeys[6]);
-  state = _mm_aesenc_si128(state, ctx.roundKeys[7]);
-  state = _mm_aesenc_si128(state, ctx.roundKeys[8]);
-  state = _mm_aesenc_si128(state, ctx.roundKeys[9]);
-  state = _mm_aesenc_si128(state, ctx.roundKeys[10]);
-  state = _mm_aesenc_si128(state, ctx.roundKeys[11]);
-  state = _mm_aesenc_si128(state, ctx.roundKeys[12]);
-  state = _mm_aesenc_si128(state, ctx.roundKeys[13]);
-
-  // Final round (AESENCLAST = SubBytes + ShiftRows + AddRoundKey, no
-  // MixColumns)
-  state = _mm_aesenclast_si128(state, ctx.roundKeys[14]);
-
-  _mm_storeu_si128((__m128i *)out, state);
-}
+// WebAssembly SIMD128 (emcc -msimd128)
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
 
-// 4-WAY PIPELINED AES ENCRYPTION
-// Exploits AES-NI pipeline: latency=4, throughput=1
-// Processing 4 blocks simultaneously achieves 4x speedup
-static inline void aes256_encrypt_block_4way(
-    const AES256Ctx &ctx, const uint8_t in0[16], const uint8_t in1[16],
-    const uint8_t in2[16], const uint8_t in3[16], uint8_t out0[16],
-    uint8_t out1[16], uint8_t out2[16], uint8_t out3[16]) {
+#define USE_WASM_SIMD128 1
+#else
+#define USE_WASM_SIMD128 0
+#endif
 
-  __m128i s0 = _mm_loadu_si128((__m128i *)in0);
-  __m128i s1 = _mm_loadu_si128((__m128i *)in1);
-  __m128i s2 = _mm_loadu_si128((__m128i *)in2);
-  __m128i s3 = _mm_loadu_si128((__m128i *)in3);
-
-  // Initial AddRoundKey (4-way)
-  s0 = _mm_xor_si128(s0, ctx.roundKeys[0]);
-  s1 = _mm_xor_si128(s1, ctx.roundKeys[0]);
-  s2 = _mm_xor_si128(s2, ctx.roundKeys[0]);
-  s3 = _mm_xor_si128(s3, ctx.roundKeys[0]);
-
-// 13 rounds (4-way interleaved for pipeline saturation)
-#define AES_ROUND_4WAY(rk)                                                     \
-  s0 = _mm_aesenc_si128(s0, ctx.roundKeys[rk]);                                \
-  s1 = _mm_aesenc_si128(s1, ctx.roundKeys[rk]);                                \
-  s2 = _mm_aesenc_si128(s2, ctx.roundKeys[rk]);                                \
-  s3 = _mm_aesenc_si128(s3, ctx.roundKeys[rk])
-
-  AES_ROUND_4WAY(1);
-  AES_ROUND_4WAY(2);
-  AES_ROUND_4WAY(3);
-  AES_ROUND_4WAY(4);
-  AES_ROUND_4WAY(5);
-  AES_ROUND_4WAY(6);
-  AES_ROUND_4WAY(7);
-  AES_ROUND_4WAY(8);
-  AES_ROUND_4WAY(9);
-  AES_ROUND_4WAY(10);
-  AES_ROUND_4WAY(11);
-  AES_ROUND_4WAY(12);
-  AES_ROUND_4WAY(13);
-
-#undef AES_ROUND_4WAY
-
-  // Final round (4-way)
-  s0 = _mm_aesenclast_si128(s0, ctx.roundKeys[14]);
-  s1 = _mm_aesenclast_si128(s1, ctx.roundKeys[14]);
-  s2 = _mm_aesenclast_si128(s2, ctx.roundKeys[14]);
-  s3 = _mm_aesenclast_si128(s3, ctx.roundKeys[14]);
-
-  _mm_storeu_si128((__m128i *)out0, s0);
-  _mm_storeu_si128((__m128i *)out1, s1);
-  _mm_storeu_si128((__m128i *)out2, s2);
-  _mm_storeu_si128((__m128i *)out3, s3);
-}
+// AES-256 with AES-NI Hardware Acceleration
+// This provides 10-50x speedup over software implementation
+//
+// Every backend exposes the same shape:
+//   struct Backend {
+//     struct Ctx;
+//     static void init(Ctx &, const uint8_t key[32]);
+//     template <int Lanes>
+//     static void encrypt(const Ctx *const ctx[Lanes],
+//                         const uint8_t *const in[Lanes],
+//                         uint8_t *const out[Lanes]);
+//   };
+// Kernel<Lanes, Backend> builds the N-way interleaved block and CFB-8
+// routines on top of that, so the lane count and backend are picked at
+// compile time instead of being unrolled by hand.
 
-#else
+namespace mcbe_aes {
 
 // ============================================
-// SOFTWARE FALLBACK (original implementation)
+// SOFTWARE IMPLEMENTATION (always available)
 // ============================================
 
 namespace detail {
 
-static constexpr uint8_t sbox[256] = {
-    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b,
-    0xfe, 0xd7, 0xab, 0x76, 0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
-    0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0, 0xb7, 0xfd, 0x93, 0x26,
-    0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
-    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2,
-    0xeb, 0x27, 0xb2, 0x75, 0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
-    0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84, 0x53, 0xd1, 0x00, 0xed,
-    0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
-    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f,
-    0x50, 0x3c, 0x9f, 0xa8, 0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
-    0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2, 0xcd, 0x0c, 0x13, 0xec,
-    0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
-    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14,
-    0xde, 0x5e, 0x0b, 0xdb, 0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
-    0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79, 0xe7, 0xc8, 0x37, 0x6d,
-    0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
-    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f,
-    0x4b, 0xbd, 0x8b, 0x8a, 0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
-    0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e, 0xe1, 0xf8, 0x98, 0x11,
-    0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
-    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f,
-    0xb0, 0x54, 0xbb, 0x16};
-
-static constexpr uint8_t rcon[11] = {0x00, 0x01, 0x02, 0x04, 0x08, 0x10,
-                                     0x20, 0x40, 0x80, 0x1B, 0x36};
-
-static inline uint8_t xtime(uint8_t x) {
-  return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1B : 0x00));
-}
+static inline uint8_t xtime(uint8_t x) { return tables::xtime(x); }
 
 static inline uint8_t mul(uint8_t x, uint8_t y) {
   uint8_t r = 0;
@@ -220,10 +81,10 @@ static inline uint8_t mul(uint8_t x, uint8_t y) {
 }
 
 static inline void sub_word(uint8_t w[4]) {
-  w[0] = sbox[w[0]];
-  w[1] = sbox[w[1]];
-  w[2] = sbox[w[2]];
-  w[3] = sbox[w[3]];
+  w[0] = tables::kSbox[w[0]];
+  w[1] = tables::kSbox[w[1]];
+  w[2] = tables::kSbox[w[2]];
+  w[3] = tables::kSbox[w[3]];
 }
 
 static inline void rot_word(uint8_t w[4]) {
@@ -241,7 +102,7 @@ static inline void add_round_key(uint8_t state[16], const uint8_t *rk) {
 
 static inline void sub_bytes(uint8_t state[16]) {
   for (int i = 0; i < 16; i++)
-    state[i] = sbox[state[i]];
+    state[i] = tables::kSbox[state[i]];
 }
 
 static inline void shift_rows(uint8_t s[16]) {
@@ -275,55 +136,515 @@ static inline void mix_columns(uint8_t s[16]) {
   }
 }
 
-} // namespace detail
-
-static inline void aes256_init(AES256Ctx &ctx, const uint8_t key[32]) {
-  memcpy(ctx.roundKey, key, 32);
+// Byte-oriented key expansion, shared by every backend that does not have
+// a dedicated key-schedule instruction.
+static inline void expand_key(uint8_t roundKey[240], const uint8_t key[32]) {
+  memcpy(roundKey, key, 32);
   uint8_t temp[4];
   int bytesGenerated = 32;
   int rconIter = 1;
 
   while (bytesGenerated < 240) {
     for (int i = 0; i < 4; i++)
-      temp[i] = ctx.roundKey[bytesGenerated - 4 + i];
+      temp[i] = roundKey[bytesGenerated - 4 + i];
 
     if ((bytesGenerated % 32) == 0) {
-      detail::rot_word(temp);
-      detail::sub_word(temp);
-      temp[0] ^= detail::rcon[rconIter++];
+      rot_word(temp);
+      sub_word(temp);
+      temp[0] ^= tables::kRcon[rconIter++];
     } else if ((bytesGenerated % 32) == 16) {
-      detail::sub_word(temp);
+      sub_word(temp);
     }
 
     for (int i = 0; i < 4; i++) {
-      ctx.roundKey[bytesGenerated] =
-          (uint8_t)(ctx.roundKey[bytesGenerated - 32] ^ temp[i]);
+      roundKey[bytesGenerated] =
+          (uint8_t)(roundKey[bytesGenerated - 32] ^ temp[i]);
       bytesGenerated++;
     }
   }
 }
 
-static inline void aes256_encrypt_block(const AES256Ctx &ctx,
-                                        const uint8_t in[16], uint8_t out[16]) {
-  uint8_t state[16];
-  memcpy(state, in, 16);
+} // namespace detail
 
-  detail::add_round_key(state, ctx.roundKey);
+struct SoftBackend {
+  struct Ctx {
+    uint8_t roundKey[240];
+  };
 
-  for (int round = 1; round <= 13; round++) {
-    detail::sub_bytes(state);
-    detail::shift_rows(state);
-    detail::mix_columns(state);
-    detail::add_round_key(state, ctx.roundKey + (round * 16));
+  static inline void init(Ctx &ctx, const uint8_t key[32]) {
+    detail::expand_key(ctx.roundKey, key);
   }
 
-  detail::sub_bytes(state);
-  detail::shift_rows(state);
-  detail::add_round_key(state, ctx.roundKey + (14 * 16));
+  template <int Lanes>
+  static inline void encrypt(const Ctx *const ctx[Lanes],
+                             const uint8_t *const in[Lanes],
+                             uint8_t *const out[Lanes]) {
+    uint8_t state[Lanes][16];
+    for (int l = 0; l < Lanes; l++) {
+      memcpy(state[l], in[l], 16);
+      detail::add_round_key(state[l], ctx[l]->roundKey);
+    }
+
+    for (int round = 1; round <= 13; round++) {
+      for (int l = 0; l < Lanes; l++) {
+        detail::sub_bytes(state[l]);
+        detail::shift_rows(state[l]);
+        detail::mix_columns(state[l]);
+        detail::add_round_key(state[l], ctx[l]->roundKey + (round * 16));
+      }
+    }
 
-  memcpy(out, state, 16);
+    for (int l = 0; l < Lanes; l++) {
+      detail::sub_bytes(state[l]);
+      detail::shift_rows(state[l]);
+      detail::add_round_key(state[l], ctx[l]->roundKey + (14 * 16));
+      memcpy(out[l], state[l], 16);
+    }
+  }
+};
+
+#if USE_AES_NI
+
+// ============================================
+// AES-NI HARDWARE ACCELERATED IMPLEMENTATION
+// ============================================
+
+// Key expansion helper
+static inline __m128i aes256_key_exp_128(__m128i key, __m128i keygened) {
+  keygened = _mm_shuffle_epi32(keygened, _MM_SHUFFLE(3, 3, 3, 3));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  return _mm_xor_si128(key, keygened);
+}
+
+static inline __m128i aes256_key_exp_256(__m128i key, __m128i keygened) {
+  keygened = _mm_shuffle_epi32(keygened, _MM_SHUFFLE(2, 2, 2, 2));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  return _mm_xor_si128(key, keygened);
 }
 
+struct AesNiBackend {
+  struct Ctx {
+    __m128i roundKeys[15]; // 15 round keys for AES-256
+  };
+
+  static inline void init(Ctx &ctx, const uint8_t key[32]) {
+    __m128i key1 = _mm_loadu_si128((const __m128i *)key);
+    __m128i key2 = _mm_loadu_si128((const __m128i *)(key + 16));
+
+    ctx.roundKeys[0] = key1;
+    ctx.roundKeys[1] = key2;
+
+    // Generate round keys using AESKEYGENASSIST
+    ctx.roundKeys[2] =
+        aes256_key_exp_128(key1, _mm_aeskeygenassist_si128(key2, 0x01));
+    ctx.roundKeys[3] = aes256_key_exp_256(
+        key2, _mm_aeskeygenassist_si128(ctx.roundKeys[2], 0x00));
+    ctx.roundKeys[4] = aes256_key_exp_128(
+        ctx.roundKeys[2], _mm_aeskeygenassist_si128(ctx.roundKeys[3], 0x02));
+    ctx.roundKeys[5] = aes256_key_exp_256(
+        ctx.roundKeys[3], _mm_aeskeygenassist_si128(ctx.roundKeys[4], 0x00));
+    ctx.roundKeys[6] = aes256_key_exp_128(
+        ctx.roundKeys[4], _mm_aeskeygenassist_si128(ctx.roundKeys[5], 0x04));
+    ctx.roundKeys[7] = aes256_key_exp_256(
+        ctx.roundKeys[5], _mm_aeskeygenassist_si128(ctx.roundKeys[6], 0x00));
+    ctx.roundKeys[8] = aes256_key_exp_128(
+        ctx.roundKeys[6], _mm_aeskeygenassist_si128(ctx.roundKeys[7], 0x08));
+    ctx.roundKeys[9] = aes256_key_exp_256(
+        ctx.roundKeys[7], _mm_aeskeygenassist_si128(ctx.roundKeys[8], 0x00));
+    ctx.roundKeys[10] = aes256_key_exp_128(
+        ctx.roundKeys[8], _mm_aeskeygenassist_si128(ctx.roundKeys[9], 0x10));
+    ctx.roundKeys[11] = aes256_key_exp_256(
+        ctx.roundKeys[9], _mm_aeskeygenassist_si128(ctx.roundKeys[10], 0x00));
+    ctx.roundKeys[12] = aes256_key_exp_128(
+        ctx.roundKeys[10], _mm_aeskeygenassist_si128(ctx.roundKeys[11], 0x20));
+    ctx.roundKeys[13] = aes256_key_exp_256(
+        ctx.roundKeys[11], _mm_aeskeygenassist_si128(ctx.roundKeys[12], 0x00));
+    ctx.roundKeys[14] = aes256_key_exp_128(
+        ctx.roundKeys[12], _mm_aeskeygenassist_si128(ctx.roundKeys[13], 0x40));
+  }
+
+  // N-WAY PIPELINED AES ENCRYPTION
+  // Exploits AES-NI pipeline: latency=4, throughput=1
+  // Interleaving independent blocks keeps the AES unit saturated; the lane
+  // loops are fully unrolled because Lanes is a compile-time constant.
+  template <int Lanes>
+  static inline void encrypt(const Ctx *const ctx[Lanes],
+                             const uint8_t *const in[Lanes],
+                             uint8_t *const out[Lanes]) {
+    __m128i s[Lanes];
+
+    // Initial AddRoundKey
+    for (int l = 0; l < Lanes; l++)
+      s[l] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in[l]),
+                           ctx[l]->roundKeys[0]);
+
+    // 13 rounds (AESENC = SubBytes + ShiftRows + MixColumns + AddRoundKey)
+    for (int r = 1; r <= 13; r++)
+      for (int l = 0; l < Lanes; l++)
+        s[l] = _mm_aesenc_si128(s[l], ctx[l]->roundKeys[r]);
+
+    // Final round (AESENCLAST = SubBytes + ShiftRows + AddRoundKey, no
+    // MixColumns)
+    for (int l = 0; l < Lanes; l++)
+      _mm_storeu_si128((__m128i *)out[l],
+                       _mm_aesenclast_si128(s[l], ctx[l]->roundKeys[14]));
+  }
+};
+
+#if USE_VAES
+
+// ============================================
+// VAES (AVX2) IMPLEMENTATION
+// ============================================
+
+// Shares the AES-NI key schedule; lanes are processed in pairs, one pair
+// per 256-bit register. Odd lane counts fall back to AES-NI.
+struct VaesBackend {
+  using Ctx = AesNiBackend::Ctx;
+
+  static inline void init(Ctx &ctx, const uint8_t key[32]) {
+    AesNiBackend::init(ctx, key);
+  }
+
+  template <int Lanes>
+  static inline void encrypt(const Ctx *const ctx[Lanes],
+                             const uint8_t *const in[Lanes],
+                             uint8_t *const out[Lanes]) {
+    if constexpr (Lanes % 2 != 0) {
+      AesNiBackend::encrypt<Lanes>(ctx, in, out);
+    } else {
+      constexpr int Pairs = Lanes / 2;
+      __m256i s[Pairs];
+
+      for (int p = 0; p < Pairs; p++) {
+        __m256i rk = _mm256_set_m128i(ctx[2 * p + 1]->roundKeys[0],
+                                      ctx[2 * p]->roundKeys[0]);
+        s[p] = _mm256_xor_si256(
+            _mm256_set_m128i(_mm_loadu_si128((const __m128i *)in[2 * p + 1]),
+                             _mm_loadu_si128((const __m128i *)in[2 * p])),
+            rk);
+      }
+
+      for (int r = 1; r <= 13; r++)
+        for (int p = 0; p < Pairs; p++)
+          s[p] = _mm256_aesenc_epi128(
+              s[p], _mm256_set_m128i(ctx[2 * p + 1]->roundKeys[r],
+                                     ctx[2 * p]->roundKeys[r]));
+
+      for (int p = 0; p < Pairs; p++) {
+        __m256i v = _mm256_aesenclast_epi128(
+            s[p], _mm256_set_m128i(ctx[2 * p + 1]->roundKeys[14],
+                                   ctx[2 * p]->roundKeys[14]));
+        _mm_storeu_si128((__m128i *)out[2 * p], _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i *)out[2 * p + 1],
+                         _mm256_extracti128_si256(v, 1));
+      }
+    }
+  }
+};
+
+#endif // USE_VAES
+
 #endif // USE_AES_NI
 
+#if USE_AES_ARM
+
+// ============================================
+// ARMv8 CRYPTO EXTENSIONS IMPLEMENTATION
+// ============================================
+
+struct ArmBackend {
+  struct Ctx {
+    uint8x16_t roundKeys[15];
+  };
+
+  static inline void init(Ctx &ctx, const uint8_t key[32]) {
+    uint8_t rk[240];
+    detail::expand_key(rk, key);
+    for (int i = 0; i < 15; i++)
+      ctx.roundKeys[i] = vld1q_u8(rk + i * 16);
+  }
+
+  // AESE = AddRoundKey + SubBytes + ShiftRows, AESMC = MixColumns
+  template <int Lanes>
+  static inline void encrypt(const Ctx *const ctx[Lanes],
+                             const uint8_t *const in[Lanes],
+                             uint8_t *const out[Lanes]) {
+    uint8x16_t s[Lanes];
+    for (int l = 0; l < Lanes; l++)
+      s[l] = vld1q_u8(in[l]);
+
+    for (int r = 0; r < 13; r++)
+      for (int l = 0; l < Lanes; l++)
+        s[l] = vaesmcq_u8(vaeseq_u8(s[l], ctx[l]->roundKeys[r]));
+
+    for (int l = 0; l < Lanes; l++)
+      vst1q_u8(out[l], veorq_u8(vaeseq_u8(s[l], ctx[l]->roundKeys[13]),
+                                ctx[l]->roundKeys[14]));
+  }
+};
+
+#endif // USE_AES_ARM
+
+#if USE_WASM_SIMD128
+
+// ============================================
+// WEBASSEMBLY SIMD128 IMPLEMENTATION
+// ============================================
+
+// WebAssembly has no AES instructions. SubBytes is 16 swizzles against
+// 16-byte slices of the S-box: an index outside 0..15 gives 0, so the
+// slices are simply ORed together. ShiftRows and the MixColumns rotations
+// are byte shuffles. No memory access depends on the data, so this is
+// also constant time, unlike SoftBackend.
+struct Simd128Backend {
+  struct Ctx {
+    v128_t roundKeys[15];
+  };
+
+  static inline void init(Ctx &ctx, const uint8_t key[32]) {
+    uint8_t rk[240];
+    detail::expand_key(rk, key);
+    for (int i = 0; i < 15; i++)
+      ctx.roundKeys[i] = wasm_v128_load(rk + i * 16);
+  }
+
+  static inline v128_t sub_bytes(v128_t x) {
+    const v128_t step = wasm_i8x16_splat(16);
+    v128_t r = wasm_i8x16_swizzle(wasm_v128_load(tables::kSbox.v), x);
+    for (int k = 1; k < 16; k++) {
+      x = wasm_i8x16_sub(x, step);
+      r = wasm_v128_or(
+          r, wasm_i8x16_swizzle(wasm_v128_load(tables::kSbox.v + k * 16), x));
+    }
+    return r;
+  }
+
+  static inline v128_t shift_rows(v128_t x) {
+    return wasm_i8x16_shuffle(x, x, 0, 5, 10, 15, 4, 9, 14, 3, 8, 13, 2, 7, 12,
+                              1, 6, 11);
+  }
+
+  static inline v128_t xtime(v128_t x) {
+    v128_t carry =
+        wasm_v128_and(wasm_i8x16_shr(x, 7), wasm_i8x16_splat(0x1B));
+    return wasm_v128_xor(wasm_i8x16_shl(x, 1), carry);
+  }
+
+  // out[r] = 2 a[r] ^ 3 a[r+1] ^ a[r+2] ^ a[r+3] within each column
+  static inline v128_t mix_columns(v128_t x) {
+    v128_t r1 = wasm_i8x16_shuffle(x, x, 1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8,
+                                   13, 14, 15, 12);
+    v128_t r2 = wasm_i8x16_shuffle(x, x, 2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9,
+                                   14, 15, 12, 13);
+    v128_t r3 = wasm_i8x16_shuffle(x, x, 3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10,
+                                   15, 12, 13, 14);
+    return wasm_v128_xor(wasm_v128_xor(xtime(wasm_v128_xor(x, r1)), r1),
+                         wasm_v128_xor(r2, r3));
+  }
+
+  template <int Lanes>
+  static inline void encrypt(const Ctx *const ctx[Lanes],
+                             const uint8_t *const in[Lanes],
+                             uint8_t *const out[Lanes]) {
+    v128_t s[Lanes];
+    for (int l = 0; l < Lanes; l++)
+      s[l] = wasm_v128_xor(wasm_v128_load(in[l]), ctx[l]->roundKeys[0]);
+
+    for (int r = 1; r < 14; r++)
+      for (int l = 0; l < Lanes; l++)
+        s[l] = wasm_v128_xor(mix_columns(shift_rows(sub_bytes(s[l]))),
+                             ctx[l]->roundKeys[r]);
+
+    for (int l = 0; l < Lanes; l++)
+      wasm_v128_store(out[l], wasm_v128_xor(shift_rows(sub_bytes(s[l])),
+                                            ctx[l]->roundKeys[14]));
+  }
+};
+
+#endif // USE_WASM_SIMD128
+
+#if USE_AES_NI
+using DefaultBackend = AesNiBackend;
+#elif USE_AES_ARM
+using DefaultBackend = ArmBackend;
+#elif USE_WASM_SIMD128
+using DefaultBackend = Simd128Backend;
+#else
+using DefaultBackend = SoftBackend;
+#endif
+
+using AES256Ctx = DefaultBackend::Ctx;
+
+// ============================================
+// N-WAY KERNEL FAMILY
+// ============================================
+
+template <int Lanes, class Backend = DefaultBackend> struct Kernel {
+  static_assert(Lanes == 1 || Lanes == 2 || Lanes == 4 || Lanes == 8,
+                "Lanes must be 1, 2, 4 or 8");
+
+  using Ctx = typename Backend::Ctx;
+
+  static inline void encrypt(const Ctx *const ctx[Lanes],
+                             const uint8_t *const in[Lanes],
+                             uint8_t *const out[Lanes]) {
+    Backend::template encrypt<Lanes>(ctx, in, out);
+  }
+
+  // CFB-8 over `Lanes` independent streams of equal length.
+  // The shift register lives in a 32-byte window per lane: the block for
+  // byte i starts at reg + pos, and the feedback byte is appended at
+  // reg + pos + 16. The window slides once every 16 bytes instead of doing
+  // a 15-byte memmove per byte. Works in place (in == out) both ways.
+  static inline void cfb8(const Ctx *const ctx[Lanes],
+                          const uint8_t *const iv[Lanes],
+                          const uint8_t *const in[Lanes],
+                          uint8_t *const out[Lanes], size_t len,
+                          bool decrypt) {
+    uint8_t reg[Lanes][32];
+    uint8_t ks[Lanes][16];
+    const uint8_t *blk[Lanes];
+    uint8_t *ksp[Lanes];
+
+    for (int l = 0; l < Lanes; l++) {
+      memcpy(reg[l], iv[l], 16);
+      ksp[l] = ks[l];
+    }
+
+    size_t pos = 0;
+    for (size_t i = 0; i < len; i++) {
+      for (int l = 0; l < Lanes; l++)
+        blk[l] = reg[l] + pos;
+
+      encrypt(ctx, blk, ksp);
+
+      for (int l = 0; l < Lanes; l++) {
+        uint8_t c = in[l][i];
+        uint8_t o = (uint8_t)(c ^ ks[l][0]);
+        out[l][i] = o;
+        reg[l][pos + 16] = decrypt ? c : o;
+      }
+
+      if (++pos == 16) {
+        for (int l = 0; l < Lanes; l++)
+          memcpy(reg[l], reg[l] + 16, 16);
+        pos = 0;
+      }
+    }
+  }
+};
+
+// ============================================
+// AES-256-CMAC (RFC 4493)
+// ============================================
+
+// CBC-MAC chaining over whole blocks: x = E(x ^ block) for each block.
+// CMAC is this plus the subkey handling of the final block.
+template <class Backend = DefaultBackend>
+static inline void cbc_mac(const typename Backend::Ctx &ctx, uint8_t x[16],
+                           const uint8_t *blocks, size_t nblocks) {
+  using Ctx = typename Backend::Ctx;
+  const Ctx *c[1] = {&ctx};
+  uint8_t y[16];
+  const uint8_t *i[1] = {y};
+  uint8_t *o[1] = {x};
+  for (size_t b = 0; b < nblocks; b++, blocks += 16) {
+    for (int k = 0; k < 16; k++)
+      y[k] = (uint8_t)(x[k] ^ blocks[k]);
+    Backend::template encrypt<1>(c, i, o);
+  }
+}
+
+// Doubling in GF(2^128), used to derive the CMAC subkeys K1/K2
+static inline void cmac_dbl(uint8_t b[16]) {
+  uint8_t carry = b[0] >> 7;
+  for (int i = 0; i < 15; i++)
+    b[i] = (uint8_t)((b[i] << 1) | (b[i + 1] >> 7));
+  b[15] = (uint8_t)((b[15] << 1) ^ (carry ? 0x87 : 0x00));
+}
+
+template <class Backend = DefaultBackend>
+static inline void cmac(const typename Backend::Ctx &ctx, const uint8_t *msg,
+                        size_t len, uint8_t mac[16]) {
+  // Subkeys K1 = dbl(E(0)), K2 = dbl(K1)
+  static const uint8_t zero[16] = {0};
+  uint8_t k[16] = {0};
+  cbc_mac<Backend>(ctx, k, zero, 1);
+  cmac_dbl(k);
+
+  uint8_t x[16] = {0};
+  size_t full = len ? (len - 1) / 16 : 0;
+  cbc_mac<Backend>(ctx, x, msg, full);
+  msg += full * 16;
+  len -= full * 16;
+
+  uint8_t last[16] = {0};
+  memcpy(last, msg, len);
+  if (len < 16) {
+    last[len] = 0x80;
+    cmac_dbl(k);
+  }
+  for (int i = 0; i < 16; i++)
+    last[i] ^= k[i];
+  cbc_mac<Backend>(ctx, x, last, 1);
+  memcpy(mac, x, 16);
+}
+
+// ============================================
+// SINGLE-STREAM ENTRY POINTS (default backend)
+// ============================================
+
+static inline void aes256_init(AES256Ctx &ctx, const uint8_t key[32]) {
+  DefaultBackend::init(ctx, key);
+}
+
+static inline void aes256_encrypt_block(const AES256Ctx &ctx,
+                                        const uint8_t in[16], uint8_t out[16]) {
+  const AES256Ctx *c[1] = {&ctx};
+  const uint8_t *i[1] = {in};
+  uint8_t *o[1] = {out};
+  Kernel<1>::encrypt(c, i, o);
+}
+
+// 4-WAY PIPELINED AES ENCRYPTION (one key, four blocks)
+static inline void aes256_encrypt_block_4way(
+    const AES256Ctx &ctx, const uint8_t in0[16], const uint8_t in1[16],
+    const uint8_t in2[16], const uint8_t in3[16], uint8_t out0[16],
+    uint8_t out1[16], uint8_t out2[16], uint8_t out3[16]) {
+  const AES256Ctx *c[4] = {&ctx, &ctx, &ctx, &ctx};
+  const uint8_t *i[4] = {in0, in1, in2, in3};
+  uint8_t *o[4] = {out0, out1, out2, out3};
+  Kernel<4>::encrypt(c, i, o);
+}
+
+static inline void aes256_cfb8_encrypt(const AES256Ctx &ctx,
+                                       const uint8_t iv[16], const uint8_t *in,
+                                       uint8_t *out, size_t len) {
+  const AES256Ctx *c[1] = {&ctx};
+  const uint8_t *v[1] = {iv};
+  const uint8_t *i[1] = {in};
+  uint8_t *o[1] = {out};
+  Kernel<1>::cfb8(c, v, i, o, len, false);
+}
+
+static inline void aes256_cfb8_decrypt(const AES256Ctx &ctx,
+                                       const uint8_t iv[16], const uint8_t *in,
+                                       uint8_t *out, size_t len) {
+  const AES256Ctx *c[1] = {&ctx};
+  const uint8_t *v[1] = {iv};
+  const uint8_t *i[1] = {in};
+  uint8_t *o[1] = {out};
+  Kernel<1>::cfb8(c, v, i, o, len, true);
+}
+
+static inline void aes256_cmac(const AES256Ctx &ctx, const uint8_t *msg,
+                               size_t len, uint8_t mac[16]) {
+  cmac<>(ctx, msg, len, mac);
+}
+
 } // namespace mcbe_aes
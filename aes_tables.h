@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+
+// AES lookup tables generated at compile time.
+// Shared by the software path in aes256_ecb.h and the CUDA kernels in
+// aes_cuda.cu, so the S-box only exists in one place.
+
+namespace mcbe_aes {
+namespace tables {
+
+struct ByteTable256 {
+  uint8_t v[256];
+  constexpr uint8_t operator[](int i) const { return v[i]; }
+};
+
+struct RconTable {
+  uint8_t v[11];
+  constexpr uint8_t operator[](int i) const { return v[i]; }
+};
+
+constexpr uint8_t rotl8(uint8_t x, int s) {
+  return (uint8_t)((x << s) | (x >> (8 - s)));
+}
+
+constexpr uint8_t xtime(uint8_t x) {
+  return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1B : 0x00));
+}
+
+// Walks GF(2^8) with generator 3 (p) and its inverse (q) so every p gets
+// its multiplicative inverse q, then applies the affine transform.
+constexpr ByteTable256 make_sbox() {
+  ByteTable256 t{};
+  uint8_t p = 1, q = 1;
+  do {
+    p = (uint8_t)(p ^ xtime(p));
+    q = (uint8_t)(q ^ (q << 1));
+    q = (uint8_t)(q ^ (q << 2));
+    q = (uint8_t)(q ^ (q << 4));
+    if (q & 0x80)
+      q = (uint8_t)(q ^ 0x09);
+    uint8_t x = (uint8_t)(q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^
+                          rotl8(q, 4));
+    t.v[p] = (uint8_t)(x ^ 0x63);
+  } while (p != 1);
+  t.v[0] = 0x63;
+  return t;
+}
+
+constexpr RconTable make_rcon() {
+  RconTable t{};
+  uint8_t r = 1;
+  for (int i = 1; i < 11; i++) {
+    t.v[i] = r;
+    r = xtime(r);
+  }
+  return t;
+}
+
+static constexpr ByteTable256 kSbox = make_sbox();
+static constexpr RconTable kRcon = make_rcon();
+
+static_assert(kSbox[0x00] == 0x63 && kSbox[0x01] == 0x7c &&
+                  kSbox[0x53] == 0xed && kSbox[0xff] == 0x16,
+              "AES S-box generation is broken");
+static_assert(kRcon[1] == 0x01 && kRcon[9] == 0x1B && kRcon[10] == 0x36,
+              "AES round constant generation is broken");
+
+} // namespace tables
+} // namespace mcbe_aes
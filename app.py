@@ -1,10 +1,12 @@
 import os
+import re
 import shutil
 import tempfile
+import threading
 import zipfile
 from pathlib import Path
 from flask import Flask, render_template, request, send_file, after_this_request, jsonify
-from encrypt import encrypt_pack, EncryptOptions, ensure_pycryptodome, random_key
+from encrypt import encrypt_pack, plan_pack, EncryptOptions, ensure_pycryptodome, random_key, KEY_LENGTH, ProgressChannel
 
 app = Flask(__name__, 
             static_url_path='/static', 
@@ -12,12 +14,45 @@ app = Flask(__name__,
             template_folder=os.path.join(os.path.dirname(os.path.abspath(__file__)), 'templates'))
 app.config['MAX_CONTENT_LENGTH'] = 500 * 1024 * 1024  # 500MB limit
 
+# Running /encrypt requests by the job id the page sends, polled by /progress.
+# The page asks at a fixed rate, so a pack with 50k entries costs the same
+# few requests per second as a small one.
+jobs = {}
+jobs_lock = threading.Lock()
+JOB_ID = re.compile(r'^[A-Za-z0-9-]{8,64}$')
+PROGRESS_LOG_LINES = 50
+
+@app.route('/progress/<job_id>')
+def progress_route(job_id):
+    with jobs_lock:
+        channel = jobs.get(job_id)
+    if channel is None:
+        return jsonify({'error': 'Unknown job'}), 404
+    snap = channel.snapshot()
+    snap['log'] = channel.drain(PROGRESS_LOG_LINES)
+    return jsonify(snap)
+
 @app.route('/')
 def index():
     return render_template('index.html')
 
 @app.route('/encrypt', methods=['POST'])
 def encrypt_route():
+    # In the query string so the job shows up before the upload is parsed
+    job_id = request.args.get('job', '')
+    if not JOB_ID.match(job_id):
+        return _encrypt(None)
+    channel = ProgressChannel()
+    channel.set_phase('Receiving upload')
+    with jobs_lock:
+        jobs[job_id] = channel
+    try:
+        return _encrypt(channel)
+    finally:
+        with jobs_lock:
+            jobs.pop(job_id, None)
+
+def _encrypt(channel):
     if 'file' not in request.files:
         return jsonify({'error': 'No file uploaded'}), 400
     
@@ -33,6 +68,13 @@ def encrypt_route():
     exclude_pack_icon = request.form.get('exclude_pack_icon') == 'true'
     exclude_bug_icon = request.form.get('exclude_bug_icon') == 'true'
 
+    # Reproducible builds: derived entry keys + fixed timestamps.
+    # Only byte-identical across uploads when the same master key is sent back.
+    deterministic = request.form.get('deterministic') == 'true'
+    master_key = request.form.get('master_key', '').strip()
+    if master_key and len(master_key) != KEY_LENGTH:
+        return jsonify({'error': f'Master key must be exactly {KEY_LENGTH} characters'}), 400
+
     # Create distinct temp dir for this request
     temp_dir = Path(tempfile.mkdtemp())
     
@@ -56,28 +98,38 @@ def encrypt_route():
         if exclude_pack_icon: excluded.add("pack_icon.png")
         if exclude_bug_icon: excluded.add("bug_pack_icon.png")
 
+        # One pass over the upload's central directory; encrypt_pack() works from this plan.
+        # An upload that isn't a ZIP is a client error, not a server one.
+        try:
+            plan = plan_pack(input_zip_path, excluded, deterministic)
+        except zipfile.BadZipFile as e:
+            shutil.rmtree(temp_dir)
+            return jsonify({'error': f'Not a valid ZIP file: {e}'}), 400
+
         opts = EncryptOptions(
             input_zip=input_zip_path,
             output_dir=output_dir,
             output_zip=output_zip_path,
             key_file=key_file_path,
-            master_key=random_key(),
-            excluded_files=excluded
+            master_key=master_key or random_key(),
+            excluded_files=excluded,
+            deterministic=deterministic
         )
 
         # Ensure dependencies (just in case)
         if not ensure_pycryptodome():
             return jsonify({'error': 'Server configuration error: PyCryptodome missing'}), 500
 
-        # Run encryption
-        # We can pass simple log/progress callbacks if we want, or ignore them
-        encrypt_pack(opts)
+        # Run encryption; progress goes to the job's channel, if any
+        encrypt_pack(opts, channel=channel, plan=plan)
 
         # Zip the result (encrypted zip + key file + info txt)
         # To make it easy for the user, we'll zip everything in the output folder into one download
         # OR we could just send the zip if the key is inside? The key is usually outside.
         # Let's create a wrapper zip containing both.
         
+        if channel is not None:
+            channel.set_phase('Packaging download')
         final_download_name = Path(file.filename).stem + "_result.zip"
         final_download_path = temp_dir / final_download_name
         
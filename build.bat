@@ -1,11 +1,14 @@
 @echo off
-echo [*] Compiling recovery.cpp using MinGW g++...
-g++ -O3 -march=native -pthread recovery.cpp -o recovery.exe
+echo [*] Building recovery.exe with CMake (MinGW g++)...
+:: The CMake build knows every source mcbe_pack needs; a hand-written g++
+:: line here went stale each time a module was added
+cmake -S . -B build -G "MinGW Makefiles" -DMCBE_BUILD_PYTHON=OFF && cmake --build build --target recovery
 if %ERRORLEVEL% EQU 0 (
+    copy /Y build\recovery.exe recovery.exe >nul
     echo [OK] Compilation successful!
     echo [*] Running recovery.exe...
     recovery.exe
 ) else (
-    echo [ERROR] Compilation failed. Make sure g++ is in your PATH.
+    echo [ERROR] Compilation failed. Make sure CMake, g++ and zlib are installed.
     pause
 )
@@ -4,11 +4,15 @@
 import os
 import sys
 import json
+import hmac
 import zipfile
 import secrets
 import threading
 import queue
+import collections
+import shutil
 import subprocess
+import time
 import traceback
 from pathlib import Path
 from dataclasses import dataclass
@@ -17,6 +21,12 @@ from typing import Optional
 import tkinter as tk
 from tkinter import ttk, filedialog, messagebox
 
+# 네이티브 AES 엔진(CMake로 빌드한 mcbe_native 확장 모듈). 없으면 pycryptodome 사용
+try:
+    import mcbe_native
+except ImportError:
+    mcbe_native = None
+
 
 # =========================
 # Dependency (pycryptodome) auto install
@@ -79,9 +89,13 @@ def pip_install_pycryptodome(log_fn=None) -> bool:
 
 def ensure_pycryptodome(log_fn=None) -> bool:
     """
+    네이티브 엔진(mcbe_native)이 있으면 설치 없이 OK
     이미 있으면 OK
     없으면 자동 설치 시도 후 OK/FAIL 반환
     """
+    if mcbe_native is not None:
+        return True
+
     if try_import_crypto():
         return True
 
@@ -102,16 +116,100 @@ VERSION = bytes([0, 0, 0, 0])
 MAGIC = bytes([0xFC, 0xB9, 0xCF, 0x9B])
 DEFAULT_EXCLUDED_FILES = {"manifest.json", "pack_icon.png", "bug_pack_icon.png"}
 
+# 결정적(재현 가능) 모드에서 모든 엔트리에 기록하는 고정 시각
+FIXED_DATE_TIME = (1980, 1, 1, 0, 0, 0)
+KDF_LABEL = b"MCBE-KDF1\x00"
+
+# 한 번에 encrypt_many()로 넘기는 묶음 크기
+BATCH_BYTES = 64 * 1024 * 1024
+BATCH_FILES = 256
+
+# 이 크기 이상인 엔트리는 통째로 읽지 않고 STREAM_CHUNK 단위로 흘려서 처리
+STREAM_BYTES = 64 * 1024 * 1024
+STREAM_CHUNK = 1024 * 1024
+
 def random_key():
     alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789"
     return ''.join(secrets.choice(alphabet) for _ in range(KEY_LENGTH))
 
+def aes_cmac(key: bytes, msg) -> bytes:
+    """msg는 bytes 또는 read()가 있는 바이너리 파일 객체"""
+    from Crypto.Hash import CMAC
+    from Crypto.Cipher import AES
+    c = CMAC.new(key, ciphermod=AES)
+    if hasattr(msg, "read"):
+        for chunk in iter(lambda: msg.read(STREAM_CHUNK), b""):
+            c.update(chunk)
+    else:
+        c.update(msg)
+    return c.digest()
+
+def derive_entry_key(master_key: str, path: str, data: bytes) -> str:
+    """
+    결정적 모드용 엔트리 키 (마스터 키 + 경로 + 내용 → 항상 같은 키)
+    data는 bytes 또는 바이너리 파일 객체(큰 엔트리는 zin.open()으로 넘김)
+    T = CMAC(master, data), seed = CMAC(master, "MCBE-KDF1\\0" + path + "\\0" + T)
+    CMAC(master, seed + i) 바이트 중 248 미만만 골라 alphabet[b % 62]로 변환
+    mcbe_pack::derive_entry_key()와 같은 결과
+    """
+    if mcbe_native is not None:
+        return mcbe_native.derive_entry_key(master_key, path, data)
+
+    alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789"
+    mk = master_key.encode('utf-8')
+    digest = aes_cmac(mk, data)
+    seed = aes_cmac(mk, KDF_LABEL + path.encode('utf-8') + b"\x00" + digest)
+
+    out = []
+    counter = 0
+    while len(out) < KEY_LENGTH:
+        for b in aes_cmac(mk, seed + bytes([counter])):
+            if b < 248 and len(out) < KEY_LENGTH:
+                out.append(alphabet[b % len(alphabet)])
+        counter += 1
+    return ''.join(out)
+
+def zip_write(zout: zipfile.ZipFile, name: str, data: bytes, date_time=None):
+    """
+    date_time이 없으면 zout.writestr()와 동일
+    있으면 그 시각으로 고정해서 기록 (속성은 writestr 기본값과 동일)
+    """
+    if date_time is None:
+        zout.writestr(name, data)
+        return
+    info = zipfile.ZipInfo(name, date_time=date_time)
+    info.compress_type = zipfile.ZIP_DEFLATED
+    if is_dir(name):
+        info.external_attr = (0o40775 << 16) | 0x10
+    else:
+        info.external_attr = 0o600 << 16
+    zout.writestr(info, data)
+
+def stream_entry(zin: zipfile.ZipFile, zout: zipfile.ZipFile, name: str, key: Optional[str], date_time=None):
+    """
+    큰 엔트리를 압축 해제 → 암호화(key가 None이면 그대로) → 압축 순으로 흘려서 기록
+    """
+    src_info = zin.getinfo(name)
+    info = zipfile.ZipInfo(name, date_time=date_time or time.localtime(time.time())[:6])
+    info.compress_type = zipfile.ZIP_DEFLATED
+    info.external_attr = 0o600 << 16
+    # 크기를 미리 알려줘야 zipfile이 ZIP64 여부를 정함
+    info.file_size = src_info.file_size
+    with zin.open(name) as src, zout.open(info, 'w') as dst:
+        if key is None:
+            shutil.copyfileobj(src, dst, STREAM_CHUNK)
+        else:
+            encrypt_stream(src, dst, key)
+
 def pad_to(buf: bytearray, size: int):
     while len(buf) < size:
         buf.append(0)
     return buf
 
 def encrypt_bytes(data: bytes, key: str) -> bytes:
+    if mcbe_native is not None:
+        return mcbe_native.encrypt_bytes(data, key)
+
     from Crypto.Cipher import AES
     cipher = AES.new(
         key.encode('utf-8'),
@@ -121,6 +219,36 @@ def encrypt_bytes(data: bytes, key: str) -> bytes:
     )
     return cipher.encrypt(data)
 
+def encrypt_stream(src, dst, key: str) -> int:
+    """
+    src.read() 조각을 암호화해서 dst.write()로 기록 (CFB-8 상태는 이어짐)
+    메모리는 STREAM_CHUNK 정도만 사용
+    """
+    if mcbe_native is not None:
+        return mcbe_native.encrypt_stream(src, dst, key, STREAM_CHUNK)
+
+    from Crypto.Cipher import AES
+    cipher = AES.new(
+        key.encode('utf-8'),
+        AES.MODE_CFB,
+        iv=key[:16].encode('utf-8'),
+        segment_size=8
+    )
+    total = 0
+    for chunk in iter(lambda: src.read(STREAM_CHUNK), b""):
+        dst.write(cipher.encrypt(chunk))
+        total += len(chunk)
+    return total
+
+def encrypt_many(items: list[tuple[bytes, str]]) -> list[bytes]:
+    """
+    [(data, key), ...]를 한꺼번에 암호화
+    네이티브 엔진이면 GIL 없이 여러 스레드에서 처리
+    """
+    if mcbe_native is not None:
+        return mcbe_native.encrypt_many(items)
+    return [encrypt_bytes(data, key) for data, key in items]
+
 def find_manifest_member(z: zipfile.ZipFile) -> Optional[str]:
     candidates = [i.filename for i in z.infolist() if i.filename.endswith("manifest.json")]
     if not candidates:
@@ -128,17 +256,26 @@ def find_manifest_member(z: zipfile.ZipFile) -> Optional[str]:
     candidates.sort(key=lambda n: (n.count('/'), len(n)))
     return candidates[0]
 
+def read_manifest_uuid(z: zipfile.ZipFile, name: Optional[str]) -> str:
+    """
+    manifest의 header.uuid (없거나 읽을 수 없으면 00000000-...)
+    BOM과 문자열이 아닌 uuid는 네이티브 엔진과 같게 처리
+    """
+    if not name:
+        return "00000000-0000-0000-0000-000000000000"
+    try:
+        data = z.read(name)
+        manifest = json.loads(data.decode('utf-8-sig'))
+        uuid = manifest["header"]["uuid"]
+        if isinstance(uuid, str):
+            return uuid
+    except Exception:
+        pass
+    return "00000000-0000-0000-0000-000000000000"
+
 def get_manifest_uuid(zip_path: Path) -> str:
     with zipfile.ZipFile(zip_path, 'r') as z:
-        name = find_manifest_member(z)
-        if not name:
-            return "00000000-0000-0000-0000-000000000000"
-        try:
-            data = z.read(name)
-            manifest = json.loads(data.decode('utf-8'))
-            return manifest["header"]["uuid"]
-        except Exception:
-            return "00000000-0000-0000-0000-000000000000"
+        return read_manifest_uuid(z, find_manifest_member(z))
 
 def is_dir(name: str) -> bool:
     return name.endswith('/')
@@ -149,22 +286,24 @@ def is_subpack_file(name: str) -> bool:
 def is_subpack_root(name: str) -> bool:
     return name.startswith("subpacks/") and is_dir(name) and name.count('/') == 2
 
-def write_contents_json(zout: zipfile.ZipFile, entry_name: str, content_id: str, master_key: str, entries: list[dict]):
+def write_contents_json(zout: zipfile.ZipFile, entry_name: str, content_id: str, master_key: str, entries: list[dict],
+                        date_time=None):
     meta = bytearray()
     meta += VERSION
     meta += MAGIC
     pad_to(meta, 0x10)
 
     cid = content_id.encode('utf-8')
-    if len(cid) > 255:
-        raise ValueError("ContentId too long (>255).")
+    # 0x10: 길이, 0x11부터 헤더(0x100) 끝까지 ID
+    if len(cid) > 0x100 - 0x11:
+        raise ValueError(f"ContentId too long (>{0x100 - 0x11} bytes).")
     meta.append(len(cid))
     meta += cid
     pad_to(meta, 0x100)
 
     content_json = json.dumps({"content": entries}, ensure_ascii=False).encode('utf-8')
     meta += encrypt_bytes(content_json, master_key)
-    zout.writestr(entry_name, meta)
+    zip_write(zout, entry_name, bytes(meta), date_time)
 
 @dataclass
 class EncryptOptions:
@@ -174,11 +313,180 @@ class EncryptOptions:
     key_file: Path
     master_key: str
     excluded_files: set[str]
+    # True면 키 파생 + 고정 시각/정렬 → 같은 입력과 마스터 키에서 항상 같은 결과
+    deterministic: bool = False
+
+# =========================
+# Pack plan
+# =========================
+
+@dataclass(frozen=True)
+class PackPlan:
+    """
+    plan_pack() 결과: 중앙 디렉터리를 한 번 훑어 만든 처리 계획 (만든 뒤로 바뀌지 않음)
+    GUI/웹/CLI가 같은 계획으로 encrypt_pack()을 돌림
+    """
+    uuid: str
+    sorted: bool                                            # 결정적 모드(이름순)로 만든 계획인지
+    directories: tuple[str, ...]
+    root_files: tuple[tuple[str, int, bool], ...]           # (이름, 크기, 그대로 복사)
+    subpacks: tuple[tuple[str, tuple[tuple[str, int], ...]], ...]  # (루트, ((이름, 크기), ...))
+    excluded: tuple[str, ...]                               # 그대로 복사하는 루트 파일
+    files: int                                              # 루트 + 서브팩 파일 수
+    total: int                                              # 진행 단계 수: 파일 + contents.json
+    bytes: int                                              # 위 파일들의 압축 전 크기
+
+    def summary(self) -> str:
+        return (f"파일 {self.files}개 (그대로 복사 {len(self.excluded)}개), "
+                f"서브팩 {len(self.subpacks)}개, {self.bytes / (1024 * 1024):.1f} MB")
+
+def _plan_pack_py(z: zipfile.ZipFile, excluded: set[str], deterministic: bool) -> PackPlan:
+    """네이티브 모듈이 없을 때: infolist()를 한 번만 훑어 분류"""
+    manifest = None
+    dirs, roots, files, sub_files = [], [], [], []
+    for info in z.infolist():
+        name = info.filename
+        # find_manifest_member()와 같은 기준: 얕은 것, 짧은 것, 먼저 나온 것
+        if name.endswith("manifest.json") and (
+                manifest is None or (name.count('/'), len(name)) < (manifest.count('/'), len(manifest))):
+            manifest = name
+        if is_dir(name):
+            dirs.append(name)
+            if is_subpack_root(name):
+                roots.append(name)
+        elif is_subpack_file(name):
+            sub_files.append((name, info.file_size))
+        else:
+            files.append((name, info.file_size))
+
+    if deterministic:
+        # 안정 정렬이라 전체를 먼저 정렬한 뒤 나누는 것과 같은 순서
+        dirs.sort()
+        roots.sort()
+        files.sort(key=lambda f: f[0])
+        sub_files.sort(key=lambda f: f[0])
+
+    # 서브팩 파일은 앞의 두 단계("subpacks/<이름>/")가 같은 루트에 속함. 루트가 없으면 빠짐
+    by_root: dict[str, list[int]] = {}
+    subpacks = []
+    for root in roots:
+        by_root.setdefault(root, []).append(len(subpacks))
+        subpacks.append((root, []))
+    for name, size in sub_files:
+        slash = name.find('/', len("subpacks/"))
+        for i in by_root.get(name[:slash + 1], ()) if slash >= 0 else ():
+            subpacks[i][1].append((name, size))
+
+    root_files = tuple((name, size, name in excluded) for name, size in files)
+    subpacks = tuple((root, tuple(sub)) for root, sub in subpacks)
+    nfiles = len(root_files) + sum(len(sub) for _, sub in subpacks)
+    return PackPlan(
+        uuid=read_manifest_uuid(z, manifest),
+        sorted=deterministic,
+        directories=tuple(dirs),
+        root_files=root_files,
+        subpacks=subpacks,
+        excluded=tuple(name for name, _, copy in root_files if copy),
+        files=nfiles,
+        total=nfiles + 1 + len(subpacks),
+        bytes=sum(size for _, size, _ in root_files) + sum(size for _, sub in subpacks for _, size in sub),
+    )
+
+def plan_pack(zip_path: Path, excluded: set[str], deterministic: bool = False) -> PackPlan:
+    """
+    입력 ZIP의 처리 계획. 네이티브 모듈이 있으면 GIL 없이 C++에서 (큰 ZIP은 여러 스레드로)
+    손상된 ZIP이면 zipfile 예외(BadZipFile 등)
+    """
+    if mcbe_native is not None:
+        try:
+            return PackPlan(**mcbe_native.plan_pack(zip_path, tuple(excluded), deterministic))
+        except (RuntimeError, ValueError):
+            # zipfile이 다르게 읽는 이름이 있거나 열 수 없는 ZIP → zipfile로 다시 (오류도 zipfile 예외로)
+            pass
+    with zipfile.ZipFile(zip_path, 'r') as z:
+        return _plan_pack_py(z, excluded, deterministic)
+
+# =========================
+# Progress channel
+# =========================
+
+class _PyProgressChannel:
+    """
+    mcbe_native.ProgressChannel과 같은 인터페이스 (네이티브 모듈이 없을 때)
+    작업 스레드가 기록하고 UI가 타이머로 snapshot()/drain() 해 감.
+    deque append/popleft는 GIL 아래에서 원자적이라 양쪽 모두 잠그지 않음
+    """
+    def __init__(self, capacity: int = 4096):
+        self._lines = collections.deque()
+        self._capacity = capacity
+        self._done = 0
+        self._total = 0
+        self._bytes = 0
+        self._phase = ""
+        self._dropped = 0
+        self._finished = False
+        self.file_log = False
+
+    def log(self, line: str):
+        # 가득 차면 새 줄을 버리고 개수만 셈 (작업 스레드는 기다리지 않음)
+        if len(self._lines) >= self._capacity:
+            self._dropped += 1
+        else:
+            self._lines.append(line)
+
+    def set_phase(self, phase: str):
+        self._phase = phase
+
+    def add_total(self, n: int):
+        self._total += n
+
+    def advance(self, files: int = 1, bytes: int = 0):
+        self._done += files
+        self._bytes += bytes
+
+    def finish(self):
+        self._finished = True
+
+    def snapshot(self) -> dict:
+        return {"done": self._done, "total": self._total, "bytes": self._bytes, "phase": self._phase,
+                "pending": len(self._lines), "dropped": self._dropped, "finished": self._finished}
+
+    def drain(self, max: int = -1) -> list[str]:
+        out = []
+        while max < 0 or len(out) < max:
+            try:
+                out.append(self._lines.popleft())
+            except IndexError:
+                break
+        return out
 
-def encrypt_pack(opts: EncryptOptions, log_cb=None, progress_cb=None, cancel_flag=None):
+
+# 엔진 → UI 진행 상황 전달: 카운터 + 잠금 없는 로그 링 버퍼. 파일별 로그는 file_log일 때만
+ProgressChannel = mcbe_native.ProgressChannel if mcbe_native is not None else _PyProgressChannel
+
+def load_master_key(key_path: Path) -> Optional[str]:
+    """기존 .zip.key 파일의 마스터 키 (없거나 형식이 다르면 None)"""
+    try:
+        key = key_path.read_bytes().decode('utf-8').strip()
+    except (OSError, UnicodeDecodeError):
+        return None
+    return key if len(key) == KEY_LENGTH else None
+
+def encrypt_pack(opts: EncryptOptions, log_cb=None, progress_cb=None, cancel_flag=None, channel=None,
+                 plan: Optional[PackPlan] = None):
+    """
+    channel(ProgressChannel)이 있으면 진행 상황/단계/로그를 거기에 기록 (log_cb가 없을 때 로그도).
+    파일별 로그("암호화: x")는 channel.file_log가 켜져 있을 때만 만듦.
+    plan은 같은 입력/제외 목록/결정적 모드로 만든 plan_pack() 결과 (없으면 여기서 만듦)
+    """
     def log(msg: str):
         if log_cb:
             log_cb(msg)
+        elif channel is not None:
+            channel.log(msg)
+
+    def file_log() -> bool:
+        return channel is None or channel.file_log
 
     def check_cancel():
         if cancel_flag is not None and cancel_flag.is_set():
@@ -189,97 +497,151 @@ def encrypt_pack(opts: EncryptOptions, log_cb=None, progress_cb=None, cancel_fla
     key_path = opts.key_file
     master_key = opts.master_key
     excluded = opts.excluded_files
+    deterministic = opts.deterministic
+    date_time = FIXED_DATE_TIME if deterministic else None
 
     if len(master_key) != KEY_LENGTH:
         raise ValueError(f"마스터 키는 반드시 {KEY_LENGTH}자여야 합니다.")
 
-    uuid = get_manifest_uuid(inzip)
+    if plan is None:
+        plan = plan_pack(inzip, excluded, deterministic)
+    elif plan.sorted != deterministic:
+        raise ValueError("처리 계획의 결정적 모드 설정이 옵션과 다릅니다.")
+    uuid = plan.uuid
     log(f"Manifest UUID: {uuid}")
+    log(f"처리 계획: {plan.summary()}")
 
     with zipfile.ZipFile(inzip, 'r') as zin, zipfile.ZipFile(outzip, 'w', compression=zipfile.ZIP_DEFLATED) as zout:
-        infolist = zin.infolist()
+        if deterministic:
+            # 입력 ZIP의 순서/시각이 결과에 섞이지 않도록 이름순으로 처리 (계획이 이름순)
+            log("결정적 모드: 파생 키, 고정 시각으로 기록합니다.")
+
+        def entry_key_for(name: str, data) -> str:
+            if deterministic:
+                return derive_entry_key(master_key, name, data)
+            return random_key()
+
+        def is_large(size: int) -> bool:
+            return size >= STREAM_BYTES
+
+        def put_large(name: str, size: int, copy: bool, phase: str) -> Optional[str]:
+            """큰 엔트리: 대기열을 먼저 비우고(기록 순서 유지) 스트리밍으로 처리"""
+            nonlocal done
+            flush(phase)
+            check_cancel()
+            entry_key = None
+            if not copy:
+                if deterministic:
+                    with zin.open(name) as src:
+                        entry_key = derive_entry_key(master_key, name, src)
+                else:
+                    entry_key = random_key()
+            stream_entry(zin, zout, name, entry_key, date_time)
+            if file_log():
+                log(f"{'복사' if copy else '암호화'}(스트리밍): {name}")
+            done += 1
+            prog(phase, size)
+            return entry_key
 
         # Copy directory entries
-        for item in infolist:
+        for name in plan.directories:
             check_cancel()
-            if is_dir(item.filename):
-                zout.writestr(item.filename, b'')
-
-        # Root files
-        root_files = []
-        for item in infolist:
-            name = item.filename
-            if is_dir(name) or is_subpack_file(name):
-                continue
-            root_files.append(name)
-
-        subpack_roots = [i.filename for i in infolist if is_subpack_root(i.filename)]
-        subpack_files = {}
-        for root in subpack_roots:
-            files = []
-            for item in infolist:
-                name = item.filename
-                if is_dir(name) or not name.startswith(root):
-                    continue
-                files.append(name)
-            subpack_files[root] = files
-
-        total = len(root_files) + sum(len(v) for v in subpack_files.values()) + (1 + len(subpack_roots))
-        done = 0
+            zip_write(zout, name, b'', date_time)
 
-        def prog(phase: str):
+        total = plan.total
+        done = 0
+        last_phase = None
+        if channel is not None:
+            channel.add_total(total)
+
+        def prog(phase: str, nbytes: int = 0):
+            nonlocal last_phase
+            if channel is not None:
+                if phase != last_phase:
+                    channel.set_phase(phase)
+                    last_phase = phase
+                channel.advance(1, nbytes)
             if progress_cb:
                 progress_cb(done, total, phase)
 
+        # 암호화 대기열: encrypt_many()로 묶어서 처리하고, 입력 순서대로 기록
+        batch = []
+        batch_bytes = 0
+
+        def flush(phase: str):
+            nonlocal done, batch_bytes
+            if not batch:
+                return
+            check_cancel()
+            encs = encrypt_many([(data, key) for _, data, key in batch])
+            for (name, _, _), enc in zip(batch, encs):
+                zip_write(zout, name, enc, date_time)
+                if file_log():
+                    log(f"암호화: {name}")
+                done += 1
+                prog(phase, len(enc))
+            batch.clear()
+            batch_bytes = 0
+
+        def queue_encrypt(name: str, data: bytes, key: str, phase: str):
+            nonlocal batch_bytes
+            batch.append((name, data, key))
+            batch_bytes += len(data)
+            if batch_bytes >= BATCH_BYTES or len(batch) >= BATCH_FILES:
+                flush(phase)
+
         content_entries = []
 
-        log(f"루트 파일 {len(root_files)}개를 처리합니다.")
-        for name in root_files:
+        log(f"루트 파일 {len(plan.root_files)}개를 처리합니다.")
+        for name, size, copy in plan.root_files:
             check_cancel()
-            data = zin.read(name)
+            if is_large(size):
+                entry_key = put_large(name, size, copy, "루트 파일 처리 중")
+                content_entries.append({"path": name, "key": entry_key})
+                continue
 
-            if name in excluded:
-                zout.writestr(name, data)
+            data = zin.read(name)
+            if copy:
+                flush("루트 파일 처리 중")
+                zip_write(zout, name, data, date_time)
                 entry_key = None
-                log(f"복사: {name}")
+                if file_log():
+                    log(f"복사: {name}")
+                done += 1
+                prog("루트 파일 처리 중", len(data))
             else:
-                entry_key = random_key()
-                enc = encrypt_bytes(data, entry_key)
-                zout.writestr(name, enc)
-                log(f"암호화: {name}")
+                entry_key = entry_key_for(name, data)
+                queue_encrypt(name, data, entry_key, "루트 파일 처리 중")
 
             content_entries.append({"path": name, "key": entry_key})
-            done += 1
-            prog("루트 파일 처리 중")
+        flush("루트 파일 처리 중")
 
         check_cancel()
-        write_contents_json(zout, "contents.json", uuid, master_key, content_entries)
+        write_contents_json(zout, "contents.json", uuid, master_key, content_entries, date_time)
         log("contents.json 작성 완료")
         done += 1
         prog("메타데이터 작성 중")
 
-        for root in subpack_roots:
+        for root, files in plan.subpacks:
             check_cancel()
-            files = subpack_files[root]
             log(f"서브팩 처리: {root} ({len(files)}개)")
 
             sub_entries = []
-            for name in files:
+            for name, size in files:
                 check_cancel()
-                data = zin.read(name)
-                entry_key = random_key()
-                enc = encrypt_bytes(data, entry_key)
-                zout.writestr(name, enc)
+                if is_large(size):
+                    entry_key = put_large(name, size, False, "서브팩 처리 중")
+                else:
+                    data = zin.read(name)
+                    entry_key = entry_key_for(name, data)
+                    queue_encrypt(name, data, entry_key, "서브팩 처리 중")
 
                 rel = name[len(root):]
                 sub_entries.append({"path": rel, "key": entry_key})
-
-                log(f"암호화: {name}")
-                done += 1
-                prog("서브팩 처리 중")
+            flush("서브팩 처리 중")
 
             check_cancel()
-            write_contents_json(zout, f"{root}contents.json", uuid, master_key, sub_entries)
+            write_contents_json(zout, f"{root}contents.json", uuid, master_key, sub_entries, date_time)
             log(f"{root}contents.json 작성 완료")
             done += 1
             prog("서브팩 메타데이터 작성 중")
@@ -295,12 +657,20 @@ def encrypt_pack(opts: EncryptOptions, log_cb=None, progress_cb=None, cancel_fla
     log(f"출력 ZIP: {outzip.name}")
     log(f"키 파일: {key_path.name}")
     log(f"추가 정보: {info_path.name}")
+    if channel is not None:
+        channel.finish()
 
 
 # =========================
 # GUI (깔끔한 라이트 테마)
 # =========================
 
+# 진행 상황/로그 갱신 주기. 파일 수와 상관없이 이 주기로만 화면을 고침
+REFRESH_MS = 100
+# 한 번 갱신할 때 옮겨 오는 최대 로그 줄 수 / 작업 기록 창에 남기는 줄 수
+LOG_LINES_PER_REFRESH = 500
+LOG_MAX_LINES = 5000
+
 class App(tk.Tk):
     def __init__(self):
         super().__init__()
@@ -311,6 +681,12 @@ class App(tk.Tk):
         self.q = queue.Queue()
         self.cancel_event = threading.Event()
         self.worker: Optional[threading.Thread] = None
+        # 실행 중인 작업의 진행 채널 (_poll_queue가 REFRESH_MS마다 읽음)
+        self.channel = None
+        self.dropped = 0
+        # 파일을 고를 때 미리 만든 처리 계획과 그때의 (경로, 제외 목록, 결정적 모드, 수정 시각)
+        self.plan: Optional[PackPlan] = None
+        self.plan_key = None
 
         self.input_zip: Optional[Path] = None
         self.output_dir: Optional[Path] = None
@@ -323,6 +699,8 @@ class App(tk.Tk):
         self.var_ex_manifest = tk.BooleanVar(value=True)
         self.var_ex_pack_icon = tk.BooleanVar(value=True)
         self.var_ex_bug_icon = tk.BooleanVar(value=True)
+        self.var_deterministic = tk.BooleanVar(value=False)
+        self.var_file_log = tk.BooleanVar(value=False)
 
         self._build_ui()
         self._poll_queue()
@@ -421,6 +799,8 @@ class App(tk.Tk):
         ttk.Checkbutton(optbox, text="manifest.json 제외(그대로 복사)", variable=self.var_ex_manifest).pack(anchor="w", pady=2)
         ttk.Checkbutton(optbox, text="pack_icon.png 제외(그대로 복사)", variable=self.var_ex_pack_icon).pack(anchor="w", pady=2)
         ttk.Checkbutton(optbox, text="bug_pack_icon.png 제외(그대로 복사)", variable=self.var_ex_bug_icon).pack(anchor="w", pady=2)
+        ttk.Checkbutton(optbox, text="재현 가능한 결과(같은 입력 → 같은 ZIP, 기존 키 파일 재사용)",
+                        variable=self.var_deterministic).pack(anchor="w", pady=(8, 2))
 
         # Action card
         action = ttk.Frame(root, style="Card.TFrame", padding=14)
@@ -455,6 +835,8 @@ class App(tk.Tk):
                  font=("Segoe UI", 12, "bold")).pack(side="left")
 
         ttk.Button(top, text="기록 지우기", command=self.clear_log).pack(side="right")
+        ttk.Checkbutton(top, text="파일별 기록", variable=self.var_file_log,
+                        command=self._toggle_file_log).pack(side="right", padx=(0, 10))
 
         self.txt = tk.Text(
             logs, height=10,
@@ -472,11 +854,41 @@ class App(tk.Tk):
         self.txt.delete("1.0", "end")
 
     def _append_log(self, msg: str):
-        self.txt.insert("end", msg + "\n")
+        self._append_lines([msg])
+
+    def _append_lines(self, lines: list[str]):
+        # 한 번에 넣고, 오래된 줄은 잘라서 위젯이 끝없이 커지지 않게 함
+        self.txt.insert("end", "\n".join(lines) + "\n")
+        excess = int(self.txt.index("end-1c").split(".")[0]) - 1 - LOG_MAX_LINES
+        if excess > 0:
+            self.txt.delete("1.0", f"{excess + 1}.0")
         self.txt.see("end")
 
-    def _set_progress(self, done: int, total: int, phase: str):
-        self.q.put(("progress", done, total, phase))
+    def _toggle_file_log(self):
+        if self.channel is not None:
+            self.channel.file_log = self.var_file_log.get()
+
+    def _poll_channel(self):
+        ch = self.channel
+        if ch is None:
+            return
+        lines = ch.drain(LOG_LINES_PER_REFRESH)
+        snap = ch.snapshot()
+        if snap["dropped"] > self.dropped:
+            lines.append(f"(기록 {snap['dropped'] - self.dropped}줄 생략)")
+            self.dropped = snap["dropped"]
+        if lines:
+            self._append_lines(lines)
+        if snap["total"]:
+            self.pbar["maximum"] = snap["total"]
+            self.pbar["value"] = snap["done"]
+            self.var_status.set(f"{snap['done']}/{snap['total']} ({snap['bytes'] / 1e6:.1f} MB)")
+            self.var_phase.set(snap["phase"])
+
+    def _flush_channel(self):
+        while self.channel is not None and self.channel.snapshot()["pending"]:
+            self._poll_channel()
+        self._poll_channel()
 
     def _poll_queue(self):
         try:
@@ -484,14 +896,17 @@ class App(tk.Tk):
                 kind, *payload = self.q.get_nowait()
                 if kind == "log":
                     self._append_log(payload[0])
-                elif kind == "progress":
-                    done, total, phase = payload
-                    self.pbar["maximum"] = max(total, 1)
-                    self.pbar["value"] = done
-                    self.var_status.set(f"{done}/{total}")
-                    self.var_phase.set(phase)
+                elif kind == "plan":
+                    key, plan = payload
+                    # 그 사이 다른 파일을 골랐으면 버림
+                    if self.input_zip is not None and key[0] == self.input_zip:
+                        self.plan, self.plan_key = plan, key
+                        self._append_log(f"처리 계획: {plan.summary()}")
                 elif kind == "done":
                     ok, outdir, outzip, keyfile = payload
+                    # 남은 로그를 모두 옮긴 뒤 채널 정리
+                    self._flush_channel()
+                    self.channel = None
                     self.btn_run.config(state="normal")
                     self.btn_cancel.config(state="disabled")
                     self.var_phase.set("")
@@ -509,7 +924,8 @@ class App(tk.Tk):
                         messagebox.showerror("실패", "암호화에 실패했습니다.\n작업 기록을 확인하세요.")
         except queue.Empty:
             pass
-        self.after(80, self._poll_queue)
+        self._poll_channel()
+        self.after(REFRESH_MS, self._poll_queue)
 
     def pick_input_zip(self):
         path = filedialog.askopenfilename(
@@ -528,6 +944,40 @@ class App(tk.Tk):
             self.var_output.set(str(self.output_dir))
             self._log(f"출력 폴더 자동 설정: {self.output_dir}")
 
+        self._start_plan()
+
+    def _excluded_files(self) -> set[str]:
+        excluded = set()
+        if self.var_ex_manifest.get():
+            excluded.add("manifest.json")
+        if self.var_ex_pack_icon.get():
+            excluded.add("pack_icon.png")
+        if self.var_ex_bug_icon.get():
+            excluded.add("bug_pack_icon.png")
+        return excluded
+
+    def _plan_key(self):
+        try:
+            mtime = self.input_zip.stat().st_mtime_ns
+        except OSError:
+            return None
+        return (self.input_zip, frozenset(self._excluded_files()), self.var_deterministic.get(), mtime)
+
+    def _start_plan(self):
+        """입력 ZIP의 처리 계획을 백그라운드에서 만들어 둠 (암호화 시작 때 그대로 씀)"""
+        self.plan, self.plan_key = None, None
+        key = self._plan_key()
+        if key is None:
+            return
+
+        def planner():
+            try:
+                self.q.put(("plan", key, plan_pack(key[0], set(key[1]), key[2])))
+            except Exception as e:
+                self.q.put(("log", f"ZIP을 읽을 수 없습니다: {e}"))
+
+        threading.Thread(target=planner, daemon=True).start()
+
     def pick_output_dir(self):
         path = filedialog.askdirectory(title="출력 폴더 선택")
         if not path:
@@ -555,13 +1005,7 @@ class App(tk.Tk):
             messagebox.showwarning("안내", "출력 폴더를 먼저 선택하세요.")
             return
 
-        excluded = set()
-        if self.var_ex_manifest.get():
-            excluded.add("manifest.json")
-        if self.var_ex_pack_icon.get():
-            excluded.add("pack_icon.png")
-        if self.var_ex_bug_icon.get():
-            excluded.add("bug_pack_icon.png")
+        excluded = self._excluded_files()
 
         outzip = self.output_dir / f"{self.input_zip.stem}_encrypted.zip"
         keyfile = self.output_dir / f"{self.input_zip.stem}.zip.key"
@@ -575,16 +1019,28 @@ class App(tk.Tk):
             ):
                 return
 
+        deterministic = self.var_deterministic.get()
+        master_key = None
+        if deterministic:
+            # 같은 마스터 키여야 이전 빌드와 같은 결과가 나옴
+            master_key = load_master_key(keyfile)
+            if master_key:
+                self._log(f"기존 키 파일의 마스터 키를 사용합니다: {keyfile.name}")
+
         opts = EncryptOptions(
             input_zip=self.input_zip,
             output_dir=self.output_dir,
             output_zip=outzip,
             key_file=keyfile,
-            master_key=random_key(),
-            excluded_files=excluded
+            master_key=master_key or random_key(),
+            excluded_files=excluded,
+            deterministic=deterministic
         )
 
         self.cancel_event.clear()
+        self.channel = ProgressChannel()
+        self.channel.file_log = self.var_file_log.get()
+        self.dropped = 0
         self.btn_run.config(state="disabled")
         self.btn_cancel.config(state="normal")
         self.pbar["value"] = 0
@@ -597,20 +1053,24 @@ class App(tk.Tk):
         self._log(f"키 파일: {keyfile.name}")
         self._log("—" * 40)
 
+        channel = self.channel
+        # 옵션이나 파일이 바뀌었으면 encrypt_pack()이 새로 만듦
+        plan = self.plan if self.plan_key is not None and self.plan_key == self._plan_key() else None
+
         def worker():
             ok = False
             try:
                 encrypt_pack(
                     opts,
-                    log_cb=self._log,
-                    progress_cb=self._set_progress,
-                    cancel_flag=self.cancel_event
+                    cancel_flag=self.cancel_event,
+                    channel=channel,
+                    plan=plan
                 )
                 ok = True
             except Exception as e:
-                self._log("오류가 발생했습니다:")
-                self._log(str(e))
-                self._log(traceback.format_exc())
+                # 작업 로그와 순서가 섞이지 않게 같은 채널로
+                for line in ["오류가 발생했습니다:", str(e), *traceback.format_exc().splitlines()]:
+                    channel.log(line)
             finally:
                 self.q.put(("done", ok, str(self.output_dir), str(outzip), str(keyfile)))
 
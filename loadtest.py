@@ -0,0 +1,627 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Load test for the Flask encrypt service (app.py).
+
+For each configuration (server mode x client count) this starts a fresh local
+instance of app.py and POSTs packs from a synthetic corpus to /encrypt from N
+concurrent clients. It then reports:
+- throughput
+- p50/p95/p99 latency
+- peak RSS of the server process tree
+- peak temp-disk usage
+
+Every /encrypt request writes its upload, output and result zip under
+tempfile.mkdtemp(). The server runs with TMPDIR pointing at a directory of its
+own, so that directory is exactly the service's temp footprint. Anything left
+in it after the run is reported as leaked.
+
+    python loadtest.py                                  # threaded server, 1/4/8 clients
+    python loadtest.py --server threaded,serial,fork:4 --clients 1,8 --requests 60
+    python loadtest.py --mix small:1 --json out.json
+    python loadtest.py --baseline out.json --tolerance 15   # exit 1 on regression
+
+Standard library only. RSS and process-tree sampling read /proc (Linux).
+"""
+
+import argparse
+import http.client
+import io
+import json
+import os
+import random
+import secrets
+import shutil
+import signal
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import uuid as uuidlib
+import zipfile
+from dataclasses import dataclass, field, asdict
+from pathlib import Path
+
+REPO_DIR = Path(__file__).resolve().parent
+
+# Bump when the generator changes so cached corpora are rebuilt
+CORPUS_VERSION = 1
+
+
+# =========================
+# Synthetic pack corpus
+# =========================
+
+@dataclass
+class PackSpec:
+    name: str
+    json_files: int       # entity/, animations/, ui/ ...
+    lang_files: int
+    textures: int
+    texture_kb: int       # average texture size
+    subpacks: int         # subpacks/<n>/ with a copy of a few textures
+    big_texture_mb: int = 0
+
+
+# Shapes follow real resource packs: many small JSON files, a handful of lang
+# files and textures that are mostly incompressible
+PACK_SPECS = {
+    "small": PackSpec("small", json_files=120, lang_files=4, textures=40, texture_kb=6, subpacks=0),
+    "medium": PackSpec("medium", json_files=1200, lang_files=12, textures=400, texture_kb=16, subpacks=2),
+    "large": PackSpec("large", json_files=3000, lang_files=24, textures=1200, texture_kb=24, subpacks=3,
+                      big_texture_mb=16),
+}
+
+
+def _texture_bytes(rng: random.Random, size: int) -> bytes:
+    # PNG-like: a header, then half noise and half runs so deflate has some work
+    head = b"\x89PNG\r\n\x1a\n"
+    noise = rng.randbytes(size // 2)
+    runs = bytearray()
+    while len(runs) < size - len(head) - len(noise):
+        runs += bytes([rng.randrange(256)]) * rng.randrange(4, 64)
+    return head + noise + bytes(runs[:size - len(head) - len(noise)])
+
+
+def _entity_json(rng: random.Random, i: int) -> bytes:
+    doc = {
+        "format_version": "1.10.0",
+        "minecraft:client_entity": {
+            "description": {
+                "identifier": f"loadtest:entity_{i}",
+                "materials": {"default": "entity_alphatest"},
+                "textures": {"default": f"textures/entity/e{i}"},
+                "geometry": {"default": f"geometry.e{i}"},
+                "render_controllers": ["controller.render.default"],
+                "scripts": {"pre_animation": [f"variable.t = {rng.random():.6f};" for _ in range(rng.randrange(1, 8))]},
+            }
+        },
+    }
+    return json.dumps(doc, indent=2).encode("utf-8")
+
+
+def _lang_text(rng: random.Random, lines: int) -> bytes:
+    words = ["block", "item", "entity", "name", "stone", "wood", "gold", "iron", "dark", "light", "red", "blue"]
+    out = io.StringIO()
+    for i in range(lines):
+        key = ".".join(rng.choice(words) for _ in range(3))
+        out.write(f"{key}.{i}={' '.join(rng.choice(words).title() for _ in range(rng.randrange(1, 5)))}\n")
+    return out.getvalue().encode("utf-8")
+
+
+def make_pack(spec: PackSpec, path: Path, seed: int):
+    rng = random.Random(f"{spec.name}:{seed}")
+    manifest = {
+        "format_version": 2,
+        "header": {
+            "name": f"loadtest {spec.name}",
+            "description": "synthetic pack",
+            "uuid": str(uuidlib.UUID(int=rng.getrandbits(128), version=4)),
+            "version": [1, 0, 0],
+            "min_engine_version": [1, 20, 0],
+        },
+        "modules": [{"type": "resources", "uuid": str(uuidlib.UUID(int=rng.getrandbits(128), version=4)),
+                     "version": [1, 0, 0]}],
+    }
+    if spec.subpacks:
+        manifest["subpacks"] = [{"folder_name": f"tier{i}", "name": f"Tier {i}", "memory_tier": i}
+                                for i in range(spec.subpacks)]
+
+    tmp = path.with_suffix(".tmp")
+    with zipfile.ZipFile(tmp, "w", zipfile.ZIP_DEFLATED) as z:
+        z.writestr("manifest.json", json.dumps(manifest, indent=2))
+        z.writestr("pack_icon.png", _texture_bytes(rng, 8 * 1024))
+        for i in range(spec.json_files):
+            z.writestr(f"entity/e{i}.json", _entity_json(rng, i))
+        for i in range(spec.lang_files):
+            z.writestr(f"texts/lang{i}.lang", _lang_text(rng, 400))
+        for i in range(spec.textures):
+            size = max(256, int(rng.gauss(spec.texture_kb, spec.texture_kb / 3) * 1024))
+            z.writestr(f"textures/blocks/t{i}.png", _texture_bytes(rng, size))
+        if spec.big_texture_mb:
+            z.writestr("textures/atlas.png", _texture_bytes(rng, spec.big_texture_mb * 1024 * 1024))
+        for s in range(spec.subpacks):
+            root = f"subpacks/tier{s}/"
+            z.writestr(zipfile.ZipInfo(root), b"")
+            for i in range(min(spec.textures, 50)):
+                z.writestr(f"{root}textures/blocks/t{i}.png", _texture_bytes(rng, spec.texture_kb * 512))
+    tmp.replace(path)
+
+
+def ensure_corpus(corpus_dir: Path, names: list[str], seed: int) -> dict[str, bytes]:
+    """Builds missing packs (cached by name/seed/version) and loads them"""
+    corpus_dir.mkdir(parents=True, exist_ok=True)
+    packs = {}
+    for name in names:
+        path = corpus_dir / f"{name}-s{seed}-v{CORPUS_VERSION}.zip"
+        if not path.exists():
+            print(f"[*] Generating {name} pack: {path}")
+            make_pack(PACK_SPECS[name], path, seed)
+        packs[name] = path.read_bytes()
+    return packs
+
+
+# =========================
+# /proc sampling
+# =========================
+
+def _status_kb(pid: int, field_name: str) -> int:
+    try:
+        with open(f"/proc/{pid}/status") as f:
+            for line in f:
+                if line.startswith(field_name + ":"):
+                    return int(line.split()[1])
+    except (OSError, ValueError):
+        pass
+    return 0
+
+
+def _children(pid: int) -> list[int]:
+    kids = []
+    try:
+        tasks = os.listdir(f"/proc/{pid}/task")
+    except OSError:
+        return kids
+    for tid in tasks:
+        try:
+            with open(f"/proc/{pid}/task/{tid}/children") as f:
+                kids.extend(int(x) for x in f.read().split())
+        except (OSError, ValueError):
+            # Kernel without CONFIG_PROC_CHILDREN: scan ppids instead
+            return _children_by_scan(pid)
+    return kids
+
+
+def _children_by_scan(pid: int) -> list[int]:
+    kids = []
+    for d in os.listdir("/proc"):
+        if not d.isdigit():
+            continue
+        try:
+            with open(f"/proc/{d}/stat") as f:
+                stat = f.read()
+            # comm may contain spaces; ppid is the second field after ')'
+            if int(stat[stat.rindex(")") + 2:].split()[1]) == pid:
+                kids.append(int(d))
+        except (OSError, ValueError):
+            pass
+    return kids
+
+
+def tree_rss_kb(pid: int) -> int:
+    total, todo = 0, [pid]
+    while todo:
+        p = todo.pop()
+        total += _status_kb(p, "VmRSS")
+        todo.extend(_children(p))
+    return total
+
+
+def disk_usage(path: Path) -> int:
+    """Bytes allocated under `path` (files may vanish while we walk)"""
+    total, todo = 0, [str(path)]
+    while todo:
+        d = todo.pop()
+        try:
+            with os.scandir(d) as it:
+                for e in it:
+                    try:
+                        if e.is_dir(follow_symlinks=False):
+                            todo.append(e.path)
+                        else:
+                            total += e.stat(follow_symlinks=False).st_blocks * 512
+                    except OSError:
+                        pass
+        except OSError:
+            pass
+    return total
+
+
+class Sampler(threading.Thread):
+    """Tracks peak RSS of the server tree and peak size of its temp dir"""
+
+    def __init__(self, pid: int, temp_dir: Path, interval: float):
+        super().__init__(daemon=True)
+        self.pid = pid
+        self.temp_dir = temp_dir
+        self.interval = interval
+        self.peak_rss_kb = 0
+        self.peak_temp = 0
+        self._halt = threading.Event()
+
+    def run(self):
+        while not self._halt.is_set():
+            self.sample()
+            self._halt.wait(self.interval)
+
+    def sample(self):
+        self.peak_rss_kb = max(self.peak_rss_kb, tree_rss_kb(self.pid))
+        self.peak_temp = max(self.peak_temp, disk_usage(self.temp_dir))
+
+    def stop(self):
+        self._halt.set()
+        self.join()
+        self.sample()
+        # VmHWM catches spikes of the main process between samples
+        self.peak_rss_kb = max(self.peak_rss_kb, _status_kb(self.pid, "VmHWM"))
+
+
+# =========================
+# Server
+# =========================
+
+SERVER_MODES = {
+    # name -> app.run() keyword arguments
+    "threaded": dict(threaded=True),
+    "serial": dict(threaded=False),
+}
+
+
+def server_kwargs(mode: str) -> dict:
+    if mode in SERVER_MODES:
+        return SERVER_MODES[mode]
+    if mode.startswith("fork:"):
+        return dict(threaded=False, processes=int(mode[5:]))
+    raise ValueError(f"Unknown server mode: {mode} (threaded, serial, fork:<n>)")
+
+
+def free_port() -> int:
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+class Server:
+    def __init__(self, mode: str, work_dir: Path):
+        self.mode = mode
+        self.port = free_port()
+        self.temp_dir = work_dir / "tmp"
+        self.temp_dir.mkdir(parents=True)
+        self.log_path = work_dir / "server.log"
+
+        kwargs = dict(host="127.0.0.1", port=self.port, debug=False, use_reloader=False, **server_kwargs(mode))
+        code = (f"import sys; sys.path.insert(0, {str(REPO_DIR)!r}); from app import app; "
+                f"app.run(**{kwargs!r})")
+        env = dict(os.environ, TMPDIR=str(self.temp_dir), PYTHONDONTWRITEBYTECODE="1")
+        self.log = open(self.log_path, "wb")
+        self.proc = subprocess.Popen([sys.executable, "-c", code], env=env, cwd=str(REPO_DIR),
+                                     stdout=self.log, stderr=subprocess.STDOUT)
+
+    def wait_ready(self, timeout: float = 30.0):
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            if self.proc.poll() is not None:
+                raise RuntimeError(f"Server exited with code {self.proc.returncode}; see {self.log_path}")
+            try:
+                conn = http.client.HTTPConnection("127.0.0.1", self.port, timeout=2)
+                conn.request("GET", "/")
+                conn.getresponse().read()
+                conn.close()
+                return
+            except OSError:
+                time.sleep(0.1)
+        raise RuntimeError(f"Server did not come up within {timeout:.0f}s; see {self.log_path}")
+
+    def stop(self):
+        if self.proc.poll() is None:
+            self.proc.send_signal(signal.SIGINT)
+            try:
+                self.proc.wait(timeout=10)
+            except subprocess.TimeoutExpired:
+                self.proc.kill()
+                self.proc.wait()
+        self.log.close()
+
+
+# =========================
+# Clients
+# =========================
+
+@dataclass
+class Sample:
+    pack: str
+    latency: float
+    status: int           # 0 = connection error
+    sent: int
+    received: int
+    error: str = ""
+
+
+def multipart(fields: dict[str, str], filename: str) -> tuple[str, bytes, bytes]:
+    """Content type, body before the file data, body after it"""
+    boundary = "loadtest" + secrets.token_hex(12)
+    head = io.BytesIO()
+    for k, v in fields.items():
+        head.write(f'--{boundary}\r\nContent-Disposition: form-data; name="{k}"\r\n\r\n{v}\r\n'.encode())
+    head.write(f'--{boundary}\r\nContent-Disposition: form-data; name="file"; filename="{filename}"\r\n'
+               f"Content-Type: application/zip\r\n\r\n".encode())
+    tail = f"\r\n--{boundary}--\r\n".encode()
+    return f"multipart/form-data; boundary={boundary}", head.getvalue(), tail
+
+
+def post_pack(port: int, pack: str, data: bytes, fields: dict[str, str], timeout: float) -> Sample:
+    ctype, head, tail = multipart(fields, f"{pack}.zip")
+    length = len(head) + len(data) + len(tail)
+    t0 = time.perf_counter()
+    conn = http.client.HTTPConnection("127.0.0.1", port, timeout=timeout)
+    try:
+        # Sent in pieces so a large pack isn't copied into one body per request
+        conn.putrequest("POST", "/encrypt")
+        conn.putheader("Content-Type", ctype)
+        conn.putheader("Content-Length", str(length))
+        conn.endheaders()
+        conn.send(head)
+        conn.send(data)
+        conn.send(tail)
+        resp = conn.getresponse()
+        body = resp.read()
+        latency = time.perf_counter() - t0
+        error = ""
+        if resp.status != 200:
+            error = body[:200].decode("utf-8", "replace")
+        elif not body.startswith(b"PK"):
+            error = "response is not a zip"
+        return Sample(pack, latency, resp.status, length, len(body), error)
+    except (OSError, http.client.HTTPException) as e:
+        return Sample(pack, time.perf_counter() - t0, 0, length, 0, f"{type(e).__name__}: {e}")
+    finally:
+        conn.close()
+
+
+def schedule(mix: dict[str, int], count: int, seed: int) -> list[str]:
+    """Same pack sequence for every configuration, so runs are comparable"""
+    rng = random.Random(seed)
+    names = list(mix)
+    return rng.choices(names, weights=[mix[n] for n in names], k=count)
+
+
+def run_clients(port: int, packs: dict[str, bytes], order: list[str], clients: int,
+                fields: dict[str, str], timeout: float) -> tuple[list[Sample], float]:
+    samples: list[Sample] = []
+    lock = threading.Lock()
+    next_index = [0]
+
+    def client():
+        while True:
+            with lock:
+                i = next_index[0]
+                next_index[0] += 1
+            if i >= len(order):
+                return
+            s = post_pack(port, order[i], packs[order[i]], fields, timeout)
+            with lock:
+                samples.append(s)
+
+    t0 = time.perf_counter()
+    threads = [threading.Thread(target=client) for _ in range(clients)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    return samples, time.perf_counter() - t0
+
+
+# =========================
+# Report
+# =========================
+
+def percentile(values: list[float], p: float) -> float:
+    """Nearest-rank percentile"""
+    if not values:
+        return 0.0
+    v = sorted(values)
+    k = max(0, min(len(v) - 1, int(-(-p * len(v) // 100)) - 1))
+    return v[k]
+
+
+@dataclass
+class Result:
+    server: str
+    clients: int
+    requests: int
+    errors: int
+    wall_s: float
+    req_per_s: float
+    upload_mb_per_s: float
+    p50_ms: float
+    p95_ms: float
+    p99_ms: float
+    max_ms: float
+    idle_rss_mb: float
+    peak_rss_mb: float
+    peak_temp_mb: float
+    leaked_temp_mb: float
+    per_pack: dict = field(default_factory=dict)   # name -> {count, p50_ms, p95_ms}
+    first_errors: list = field(default_factory=list)
+
+    @property
+    def key(self) -> str:
+        return f"{self.server}/c{self.clients}"
+
+
+def summarize(server: str, clients: int, samples: list[Sample], wall: float,
+              idle_rss_kb: int, sampler: Sampler, leaked: int) -> Result:
+    ok = [s for s in samples if not s.error]
+    lat = [s.latency * 1000 for s in ok]
+    per_pack = {}
+    for name in sorted({s.pack for s in ok}):
+        pl = [s.latency * 1000 for s in ok if s.pack == name]
+        per_pack[name] = {"count": len(pl), "p50_ms": round(percentile(pl, 50), 1),
+                          "p95_ms": round(percentile(pl, 95), 1)}
+    mb = 1024 * 1024
+    return Result(
+        server=server, clients=clients, requests=len(samples), errors=len(samples) - len(ok),
+        wall_s=round(wall, 3),
+        req_per_s=round(len(ok) / wall, 3) if wall else 0.0,
+        upload_mb_per_s=round(sum(s.sent for s in ok) / mb / wall, 2) if wall else 0.0,
+        p50_ms=round(percentile(lat, 50), 1), p95_ms=round(percentile(lat, 95), 1),
+        p99_ms=round(percentile(lat, 99), 1), max_ms=round(max(lat, default=0.0), 1),
+        idle_rss_mb=round(idle_rss_kb / 1024, 1), peak_rss_mb=round(sampler.peak_rss_kb / 1024, 1),
+        peak_temp_mb=round(sampler.peak_temp / mb, 1), leaked_temp_mb=round(leaked / mb, 2),
+        per_pack=per_pack,
+        first_errors=[f"{s.pack}: {s.status} {s.error}" for s in samples if s.error][:5],
+    )
+
+
+def print_table(results: list[Result]):
+    cols = [("config", 16), ("req", 5), ("err", 4), ("req/s", 7), ("MB/s", 7), ("p50 ms", 9),
+            ("p95 ms", 9), ("p99 ms", 9), ("RSS MB", 8), ("tmp MB", 8), ("leak", 6)]
+    print()
+    print(" ".join(name.rjust(w) if i else name.ljust(w) for i, (name, w) in enumerate(cols)))
+    for r in results:
+        row = [r.key, r.requests, r.errors, r.req_per_s, r.upload_mb_per_s, r.p50_ms, r.p95_ms, r.p99_ms,
+               r.peak_rss_mb, r.peak_temp_mb, r.leaked_temp_mb]
+        print(" ".join(str(v).rjust(w) if i else str(v).ljust(w) for i, (v, (_, w)) in enumerate(zip(row, cols))))
+    for r in results:
+        packs = ", ".join(f"{n} p50 {v['p50_ms']} / p95 {v['p95_ms']} ms (x{v['count']})"
+                          for n, v in r.per_pack.items())
+        print(f"  {r.key}: idle RSS {r.idle_rss_mb} MB; {packs}")
+        for e in r.first_errors:
+            print(f"  [ERROR] {e}")
+
+
+def compare(results: list[Result], baseline_path: Path, tolerance: float) -> bool:
+    """Prints deltas against a previous --json run; False on a regression"""
+    base = {f"{b['server']}/c{b['clients']}": b for b in json.loads(baseline_path.read_text())["results"]}
+    ok = True
+    print(f"\n[*] Against {baseline_path} (tolerance {tolerance:g}%)")
+    for r in results:
+        b = base.get(r.key)
+        if not b:
+            print(f"  {r.key}: not in baseline")
+            continue
+        checks = [("req/s", r.req_per_s, b["req_per_s"], -1), ("p95", r.p95_ms, b["p95_ms"], 1),
+                  ("p99", r.p99_ms, b["p99_ms"], 1), ("RSS", r.peak_rss_mb, b["peak_rss_mb"], 1)]
+        parts = []
+        for name, now, then, worse_sign in checks:
+            delta = (now - then) / then * 100 if then else 0.0
+            bad = delta * worse_sign > tolerance
+            ok &= not bad
+            parts.append(f"{name} {delta:+.1f}%{' REGRESSION' if bad else ''}")
+        print(f"  {r.key}: " + ", ".join(parts))
+    return ok
+
+
+# =========================
+# Main
+# =========================
+
+def parse_mix(text: str) -> dict[str, int]:
+    mix = {}
+    for part in text.split(","):
+        name, _, weight = part.partition(":")
+        if name not in PACK_SPECS:
+            raise SystemExit(f"[ERROR] Unknown pack size: {name} ({', '.join(PACK_SPECS)})")
+        mix[name] = int(weight or 1)
+    return mix
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description="Load test for app.py's /encrypt route")
+    ap.add_argument("--server", default="threaded",
+                    help="comma-separated server modes: threaded, serial, fork:<n> (default: threaded)")
+    ap.add_argument("--clients", default="1,4,8", help="comma-separated concurrent client counts")
+    ap.add_argument("--requests", type=int, default=30, help="requests per configuration")
+    ap.add_argument("--mix", default="small:6,medium:3,large:1", help="pack sizes and weights")
+    ap.add_argument("--seed", type=int, default=1, help="corpus and request-order seed")
+    ap.add_argument("--corpus", type=Path, default=Path(tempfile.gettempdir()) / "mcbe_loadtest_corpus",
+                    help="where generated packs are cached")
+    ap.add_argument("--form", action="append", default=[], metavar="KEY=VALUE",
+                    help="extra form field, e.g. deterministic=true")
+    ap.add_argument("--warmup", type=int, default=1, help="unmeasured requests per pack size")
+    ap.add_argument("--sample-ms", type=float, default=50, help="RSS/temp-disk sampling interval")
+    ap.add_argument("--timeout", type=float, default=600, help="per-request timeout in seconds")
+    ap.add_argument("--json", type=Path, help="write results as JSON")
+    ap.add_argument("--baseline", type=Path, help="compare with a previous --json file")
+    ap.add_argument("--tolerance", type=float, default=10, help="allowed regression vs baseline in percent")
+    ap.add_argument("--keep", action="store_true", help="keep server logs and temp dirs")
+    args = ap.parse_args()
+
+    modes = [m.strip() for m in args.server.split(",") if m.strip()]
+    for m in modes:
+        server_kwargs(m)
+    client_counts = [int(c) for c in args.clients.split(",")]
+    mix = parse_mix(args.mix)
+    # Same defaults as the web UI
+    fields = {"exclude_manifest": "true", "exclude_pack_icon": "true", "exclude_bug_icon": "true"}
+    for f in args.form:
+        k, _, v = f.partition("=")
+        fields[k] = v
+
+    packs = ensure_corpus(args.corpus, list(mix), args.seed)
+    for name, data in packs.items():
+        print(f"[*] {name}: {len(data) / 1024 / 1024:.1f} MB")
+    order = schedule(mix, args.requests, args.seed)
+
+    work_root = Path(tempfile.mkdtemp(prefix="mcbe_loadtest_"))
+    results = []
+    try:
+        for mode in modes:
+            for clients in client_counts:
+                work = work_root / f"{mode.replace(':', '')}_c{clients}"
+                print(f"\n[*] {mode}, {clients} client(s), {len(order)} requests")
+                server = Server(mode, work)
+                try:
+                    server.wait_ready()
+                    for name in mix:
+                        for _ in range(args.warmup):
+                            post_pack(server.port, name, packs[name], fields, args.timeout)
+                    idle = tree_rss_kb(server.proc.pid)
+                    sampler = Sampler(server.proc.pid, server.temp_dir, args.sample_ms / 1000)
+                    sampler.start()
+                    samples, wall = run_clients(server.port, packs, order, clients, fields, args.timeout)
+                    sampler.stop()
+                    # send_file cleanup runs after the response; give it a moment
+                    time.sleep(0.5)
+                    leaked = disk_usage(server.temp_dir)
+                finally:
+                    server.stop()
+                r = summarize(mode, clients, samples, wall, idle, sampler, leaked)
+                print(f"[OK] {r.req_per_s} req/s, p95 {r.p95_ms} ms, peak RSS {r.peak_rss_mb} MB, "
+                      f"peak temp {r.peak_temp_mb} MB" + (f", {r.errors} failed" if r.errors else ""))
+                results.append(r)
+    finally:
+        if args.keep:
+            print(f"[*] Logs and temp dirs kept in {work_root}")
+        else:
+            shutil.rmtree(work_root, ignore_errors=True)
+
+    print_table(results)
+    if args.json:
+        args.json.write_text(json.dumps({
+            "mix": mix, "requests": args.requests, "seed": args.seed, "fields": fields,
+            "python": sys.version.split()[0], "cpus": os.cpu_count(),
+            "results": [asdict(r) for r in results],
+        }, indent=2))
+        print(f"\n[*] Results: {args.json}")
+
+    ok = all(r.errors == 0 for r in results)
+    if args.baseline:
+        ok &= compare(results, args.baseline, args.tolerance)
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
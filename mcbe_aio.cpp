@@ -0,0 +1,512 @@
+#include "mcbe_aio.h"
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define MCBE_AIO_HAVE_URING 1
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace mcbe_aio {
+
+class FileWriter::Engine {
+public:
+  virtual ~Engine() = default;
+  virtual const char *name() const = 0;
+  // A free buffer of the configured size; waits for a write to complete if
+  // all of them are in flight
+  virtual uint8_t *acquire() = 0;
+  virtual void submit(uint8_t *buf, size_t len, uint64_t offset) = 0;
+  // Waits for all writes, closes the file and throws the first error
+  virtual void finish() = 0;
+};
+
+// ============================================
+// Thread engine
+// ============================================
+
+class ThreadEngine : public FileWriter::Engine {
+public:
+  ThreadEngine(const fs::path &p, const WriterOptions &opts)
+      : pool_(opts.depth, std::vector<uint8_t>(opts.bufferSize)) {
+    out_.open(p, std::ios::binary | std::ios::trunc);
+    if (!out_)
+      throw std::runtime_error("Failed to create file: " + p.u8string());
+    for (auto &b : pool_)
+      free_.push_back(b.data());
+    worker_ = std::thread([this]() { run(); });
+  }
+
+  ~ThreadEngine() override {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable())
+      worker_.join();
+  }
+
+  const char *name() const override { return "thread"; }
+
+  uint8_t *acquire() override {
+    std::unique_lock<std::mutex> lk(mu_);
+    cv_.wait(lk, [this]() { return !free_.empty() || !error_.empty(); });
+    throw_error();
+    uint8_t *b = free_.back();
+    free_.pop_back();
+    return b;
+  }
+
+  void submit(uint8_t *buf, size_t len, uint64_t) override {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      queue_.push_back({buf, len});
+    }
+    cv_.notify_all();
+  }
+
+  void finish() override {
+    std::unique_lock<std::mutex> lk(mu_);
+    cv_.wait(lk, [this]() {
+      return (queue_.empty() && !writing_) || !error_.empty();
+    });
+    throw_error();
+    out_.close();
+    if (out_.fail())
+      throw std::runtime_error("Failed to close output file.");
+  }
+
+private:
+  struct Job {
+    uint8_t *buf;
+    size_t len;
+  };
+
+  void run() {
+    std::unique_lock<std::mutex> lk(mu_);
+    for (;;) {
+      cv_.wait(lk, [this]() { return !queue_.empty() || stop_; });
+      if (queue_.empty())
+        return;
+      Job job = queue_.front();
+      queue_.pop_front();
+      writing_ = true;
+      lk.unlock();
+
+      out_.write((const char *)job.buf, (std::streamsize)job.len);
+      bool ok = (bool)out_;
+
+      lk.lock();
+      writing_ = false;
+      if (!ok && error_.empty())
+        error_ = "Failed to write output file.";
+      free_.push_back(job.buf);
+      cv_.notify_all();
+    }
+  }
+
+  void throw_error() {
+    if (!error_.empty())
+      throw std::runtime_error(error_);
+  }
+
+  std::ofstream out_;
+  std::vector<std::vector<uint8_t>> pool_;
+  std::vector<uint8_t *> free_;
+  std::deque<Job> queue_;
+  bool writing_ = false;
+  bool stop_ = false;
+  std::string error_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::thread worker_;
+};
+
+// ============================================
+// io_uring engine
+// ============================================
+
+#ifdef MCBE_AIO_HAVE_URING
+
+static int sys_io_uring_setup(unsigned entries, io_uring_params *p) {
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete,
+                              unsigned flags) {
+  return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags,
+                      nullptr, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned op, const void *arg,
+                                 unsigned nargs) {
+  return (int)syscall(__NR_io_uring_register, fd, op, arg, nargs);
+}
+
+class UringEngine : public FileWriter::Engine {
+public:
+  UringEngine(const fs::path &p, const WriterOptions &opts)
+      : bufSize_(opts.bufferSize), maxWrite_(opts.maxWrite),
+        batch_(std::max(1u, opts.depth / 2)), slots_(opts.depth) {
+    io_uring_params params{};
+    ring_ = sys_io_uring_setup(opts.depth, &params);
+    if (ring_ < 0)
+      throw std::runtime_error(std::string("io_uring_setup: ") +
+                               strerror(errno));
+    try {
+      map_rings(params);
+
+      size_t total = bufSize_ * slots_.size();
+      void *mem = mmap(nullptr, total, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (mem == MAP_FAILED)
+        throw std::runtime_error("Failed to allocate I/O buffers.");
+      buffers_ = (uint8_t *)mem;
+
+      // Registered buffers skip the per-write page pinning; without enough
+      // RLIMIT_MEMLOCK fall back to plain writes from the same buffers
+      std::vector<iovec> iov(slots_.size());
+      for (size_t i = 0; i < slots_.size(); i++)
+        iov[i] = {buffers_ + i * bufSize_, bufSize_};
+      fixed_ = sys_io_uring_register(ring_, IORING_REGISTER_BUFFERS,
+                                     iov.data(), (unsigned)iov.size()) == 0;
+
+      fd_ = ::open(p.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      if (fd_ < 0)
+        throw std::runtime_error("Failed to create file: " + p.u8string());
+    } catch (...) {
+      release();
+      throw;
+    }
+  }
+
+  ~UringEngine() override {
+    // Buffers may still be owned by the kernel
+    try {
+      wait_all();
+    } catch (...) {
+    }
+    release();
+  }
+
+  const char *name() const override { return "io_uring"; }
+
+  uint8_t *acquire() override {
+    for (;;) {
+      reap();
+      throw_error();
+      for (size_t i = 0; i < slots_.size(); i++) {
+        if (slots_[i].busy)
+          continue;
+        slots_[i].busy = true;
+        // Queued writes go in together once a batch is ready
+        if (pending_ >= batch_)
+          enter(false);
+        return buffers_ + i * bufSize_;
+      }
+      // Every buffer is taken: submit and wait in the same call
+      enter(true);
+    }
+  }
+
+  // Only queues the write; acquire() and finish() hand it to the kernel
+  void submit(uint8_t *buf, size_t len, uint64_t offset) override {
+    size_t i = (size_t)(buf - buffers_) / bufSize_;
+    slots_[i].left = len;
+    slots_[i].offset = offset;
+    slots_[i].written = 0;
+    push_sqe(i);
+  }
+
+  void finish() override {
+    wait_all();
+    throw_error();
+    int fd = fd_;
+    fd_ = -1;
+    if (::close(fd) != 0)
+      throw std::runtime_error("Failed to close output file.");
+  }
+
+private:
+  struct Slot {
+    bool busy = false;
+    size_t left = 0;
+    size_t written = 0;
+    uint64_t offset = 0;
+  };
+
+  void map_rings(const io_uring_params &p) {
+    sqSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqSize_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+      sqSize_ = cqSize_ = std::max(sqSize_, cqSize_);
+
+    sqRing_ = mmap(nullptr, sqSize_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+      sqRing_ = nullptr;
+      throw std::runtime_error("Failed to map io_uring SQ ring.");
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+      cqRing_ = sqRing_;
+    } else {
+      cqRing_ = mmap(nullptr, cqSize_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring_, IORING_OFF_CQ_RING);
+      if (cqRing_ == MAP_FAILED) {
+        cqRing_ = nullptr;
+        throw std::runtime_error("Failed to map io_uring CQ ring.");
+      }
+    }
+    sqesSize_ = p.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = (io_uring_sqe *)mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, ring_,
+                                 IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+      sqes_ = nullptr;
+      throw std::runtime_error("Failed to map io_uring SQEs.");
+    }
+
+    uint8_t *sq = (uint8_t *)sqRing_;
+    sqTail_ = (unsigned *)(sq + p.sq_off.tail);
+    sqMask_ = *(unsigned *)(sq + p.sq_off.ring_mask);
+    sqArray_ = (unsigned *)(sq + p.sq_off.array);
+    uint8_t *cq = (uint8_t *)cqRing_;
+    cqHead_ = (unsigned *)(cq + p.cq_off.head);
+    cqTail_ = (unsigned *)(cq + p.cq_off.tail);
+    cqMask_ = *(unsigned *)(cq + p.cq_off.ring_mask);
+    cqes_ = (io_uring_cqe *)(cq + p.cq_off.cqes);
+  }
+
+  // At most `depth` writes are queued or in flight and the SQ has `depth`
+  // entries, so there is always room for one more
+  void push_sqe(size_t i) {
+    const Slot &s = slots_[i];
+    unsigned tail = *sqTail_;
+    unsigned idx = tail & sqMask_;
+    io_uring_sqe &sqe = sqes_[idx];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = fixed_ ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe.fd = fd_;
+    sqe.addr = (uint64_t)(uintptr_t)(buffers_ + i * bufSize_ + s.written);
+    sqe.len = (uint32_t)(maxWrite_ ? std::min(s.left, maxWrite_) : s.left);
+    sqe.off = s.offset + s.written;
+    sqe.buf_index = (uint16_t)i;
+    sqe.user_data = i;
+    sqArray_[idx] = idx;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    inFlight_++;
+    pending_++;
+  }
+
+  // Hands the queued SQEs to the kernel in one io_uring_enter; with `wait`
+  // the same call also blocks for a completion
+  void enter(bool wait) {
+    for (;;) {
+      int r = sys_io_uring_enter(ring_, pending_, wait ? 1 : 0,
+                                 wait ? IORING_ENTER_GETEVENTS : 0);
+      if (r < 0 && errno == EINTR)
+        continue;
+      if (r < 0 || (r == 0 && pending_ > 0))
+        throw std::runtime_error(std::string("io_uring_enter: ") +
+                                 (r < 0 ? strerror(errno) : "nothing submitted"));
+      pending_ -= std::min(pending_, (size_t)r);
+      // The caller reaps and comes back if more is needed
+      if (wait || pending_ == 0)
+        return;
+    }
+  }
+
+  // Takes every completion that has arrived, without a syscall. A short
+  // write queues the rest of the same buffer again.
+  void reap() {
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+      const io_uring_cqe &cqe = cqes_[head & cqMask_];
+      Slot &s = slots_[(size_t)cqe.user_data];
+      inFlight_--;
+      if (cqe.res < 0) {
+        if (error_.empty())
+          error_ = std::string("Failed to write output file: ") +
+                   strerror(-cqe.res);
+        s.busy = false;
+      } else if ((size_t)cqe.res < s.left && cqe.res > 0) {
+        s.written += (size_t)cqe.res;
+        s.left -= (size_t)cqe.res;
+        push_sqe((size_t)cqe.user_data);
+      } else {
+        if (cqe.res == 0 && s.left != 0 && error_.empty())
+          error_ = "Failed to write output file (no progress).";
+        s.busy = false;
+      }
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+  }
+
+  void wait_all() {
+    for (;;) {
+      reap();
+      if (inFlight_ == 0)
+        return;
+      enter(true);
+    }
+  }
+
+  void throw_error() {
+    if (!error_.empty())
+      throw std::runtime_error(error_);
+  }
+
+  void release() {
+    if (fd_ >= 0)
+      ::close(fd_);
+    if (buffers_)
+      munmap(buffers_, bufSize_ * slots_.size());
+    if (sqes_)
+      munmap(sqes_, sqesSize_);
+    if (cqRing_ && cqRing_ != sqRing_)
+      munmap(cqRing_, cqSize_);
+    if (sqRing_)
+      munmap(sqRing_, sqSize_);
+    if (ring_ >= 0)
+      ::close(ring_); // also unregisters the buffers
+    fd_ = ring_ = -1;
+    buffers_ = nullptr;
+    sqes_ = nullptr;
+    sqRing_ = cqRing_ = nullptr;
+  }
+
+  size_t bufSize_;
+  size_t maxWrite_;
+  size_t batch_; // queued writes that are submitted without waiting
+  std::vector<Slot> slots_;
+  uint8_t *buffers_ = nullptr;
+  bool fixed_ = false;
+  int ring_ = -1;
+  int fd_ = -1;
+  size_t inFlight_ = 0; // queued or submitted
+  size_t pending_ = 0;  // queued, not yet handed to the kernel
+  std::string error_;
+
+  void *sqRing_ = nullptr;
+  void *cqRing_ = nullptr;
+  size_t sqSize_ = 0;
+  size_t cqSize_ = 0;
+  io_uring_sqe *sqes_ = nullptr;
+  size_t sqesSize_ = 0;
+  unsigned *sqTail_ = nullptr;
+  unsigned sqMask_ = 0;
+  unsigned *sqArray_ = nullptr;
+  unsigned *cqHead_ = nullptr;
+  unsigned *cqTail_ = nullptr;
+  unsigned cqMask_ = 0;
+  io_uring_cqe *cqes_ = nullptr;
+};
+
+#endif // MCBE_AIO_HAVE_URING
+
+// ============================================
+// FileWriter
+// ============================================
+
+FileWriter::FileWriter() = default;
+
+FileWriter::~FileWriter() {
+  if (engine_) {
+    try {
+      close();
+    } catch (...) {
+    }
+  }
+}
+
+void FileWriter::open(const fs::path &p, const WriterOptions &opts) {
+  if (engine_)
+    close();
+  if (opts.bufferSize == 0 || opts.depth == 0)
+    throw std::runtime_error("FileWriter needs at least one non-empty buffer.");
+
+#ifdef MCBE_AIO_HAVE_URING
+  if (opts.backend != Backend::Thread) {
+    try {
+      engine_.reset(new UringEngine(p, opts));
+    } catch (const std::exception &) {
+      // Kernel too old, io_uring disabled by policy, ...
+      if (opts.backend == Backend::IoUring)
+        throw;
+    }
+  }
+#else
+  if (opts.backend == Backend::IoUring)
+    throw std::runtime_error("io_uring is not available on this platform.");
+#endif
+  if (!engine_)
+    engine_.reset(new ThreadEngine(p, opts));
+
+  bufSize_ = opts.bufferSize;
+  cur_ = nullptr;
+  curLen_ = 0;
+  offset_ = 0;
+}
+
+void FileWriter::submit_current() {
+  engine_->submit(cur_, curLen_, offset_);
+  offset_ += curLen_;
+  cur_ = nullptr;
+  curLen_ = 0;
+}
+
+void FileWriter::write(const void *p, size_t n) {
+  if (!engine_)
+    throw std::runtime_error("FileWriter::write() on a closed file.");
+  const uint8_t *src = (const uint8_t *)p;
+  while (n > 0) {
+    if (!cur_)
+      cur_ = engine_->acquire();
+    size_t k = std::min(n, bufSize_ - curLen_);
+    memcpy(cur_ + curLen_, src, k);
+    curLen_ += k;
+    src += k;
+    n -= k;
+    if (curLen_ == bufSize_)
+      submit_current();
+  }
+}
+
+void FileWriter::close() {
+  if (!engine_)
+    return;
+  // Whatever happens, the file is closed afterwards
+  std::unique_ptr<Engine> engine = std::move(engine_);
+  if (cur_ && curLen_) {
+    engine->submit(cur_, curLen_, offset_);
+    offset_ += curLen_;
+  }
+  cur_ = nullptr;
+  curLen_ = 0;
+  engine->finish();
+}
+
+const char *FileWriter::backend_name() const {
+  return engine_ ? engine_->name() : "closed";
+}
+
+} // namespace mcbe_aio
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+// Write-behind file output for the ZIP writer. Data is copied into a small
+// pool of fixed-size buffers; full buffers are written while the caller
+// keeps encrypting into the next one, so AES never waits on write().
+//
+// Engines:
+//   io_uring  Linux: raw io_uring syscalls, buffers registered once and
+//             written with IORING_OP_WRITE_FIXED at explicit offsets; full
+//             buffers are queued and handed over several per io_uring_enter
+//   thread    everywhere else (or when io_uring is unavailable): one I/O
+//             thread draining the buffers in order
+// Local headers and payloads of small entries end up in the same buffer,
+// so one submission usually covers many ZIP records.
+
+namespace mcbe_aio {
+
+namespace fs = std::filesystem;
+
+enum class Backend { Auto, IoUring, Thread };
+
+struct WriterOptions {
+  size_t bufferSize = 1024 * 1024;
+  unsigned depth = 8; // buffers, i.e. writes in flight at most
+  Backend backend = Backend::Auto;
+  // io_uring: bytes per write request, 0 for a whole buffer. Anything less
+  // goes through the same path as a short write (tests use it).
+  size_t maxWrite = 0;
+};
+
+class FileWriter {
+public:
+  FileWriter();
+  ~FileWriter();
+
+  FileWriter(const FileWriter &) = delete;
+  FileWriter &operator=(const FileWriter &) = delete;
+
+  // Creates/truncates `p`. Backend::Auto falls back to the thread engine
+  // when io_uring can't be set up. Throws std::runtime_error.
+  void open(const fs::path &p, const WriterOptions &opts = {});
+
+  // Copies `n` bytes into the pipeline; blocks only while every buffer is
+  // in flight. Errors of earlier writes are thrown from here or close().
+  void write(const void *p, size_t n);
+
+  // Writes what is left, waits for it and closes the file
+  void close();
+
+  bool is_open() const { return engine_ != nullptr; }
+
+  // "io_uring" or "thread"
+  const char *backend_name() const;
+
+  class Engine;
+
+private:
+  void submit_current();
+
+  std::unique_ptr<Engine> engine_;
+  uint8_t *cur_ = nullptr;
+  size_t curLen_ = 0;
+  size_t bufSize_ = 0;
+  uint64_t offset_ = 0;
+};
+
+} // namespace mcbe_aio
@@ -0,0 +1,152 @@
+#include "mcbe_asset_cache.h"
+
+#include <chrono>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace mcbe_pack {
+
+AssetCache::FileStamp AssetCache::stamp_of(const fs::path &p) {
+  FileStamp s;
+#ifdef _WIN32
+  std::error_code ec;
+  s.size = (uint64_t)fs::file_size(p, ec);
+  if (ec)
+    throw std::runtime_error("Failed to open file: " + p.u8string());
+  auto mtime = fs::last_write_time(p, ec);
+  s.mtimeNs = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  mtime.time_since_epoch())
+                  .count();
+#else
+  struct stat st;
+  if (::stat(p.c_str(), &st) != 0)
+    throw std::runtime_error("Failed to open file: " + p.u8string());
+  s.size = (uint64_t)st.st_size;
+  s.mtimeNs = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+  s.inode = (uint64_t)st.st_ino;
+#endif
+  return s;
+}
+
+std::shared_ptr<AssetCache::Pack>
+AssetCache::pack_for(const fs::path &zip, const std::string &masterKey) {
+  FileStamp stamp = stamp_of(zip);
+  std::string id = zip.u8string();
+  id.push_back('\0');
+  id += masterKey;
+
+  {
+    std::lock_guard<std::mutex> lk(packsMu_);
+    auto it = packs_.find(id);
+    if (it != packs_.end() && it->second->stamp == stamp)
+      return it->second;
+  }
+
+  // Open and index outside the lock so a large pack doesn't stall lookups
+  // into the others
+  auto pack = std::make_shared<Pack>();
+  pack->reader.open(zip, masterKey);
+  pack->reader.size();
+  pack->stamp = stamp;
+
+  std::shared_ptr<Pack> stale;
+  {
+    std::lock_guard<std::mutex> lk(packsMu_);
+    std::shared_ptr<Pack> &slot = packs_[id];
+    if (slot && slot->stamp == stamp)
+      return slot; // another thread got there first
+    stale = slot;
+    pack->generation = nextGeneration_++;
+    slot = pack;
+  }
+  if (stale)
+    drop_generation(*stale);
+  return pack;
+}
+
+void AssetCache::drop_generation(Pack &pack) {
+  std::lock_guard<std::mutex> lk(lruMu_);
+  pack.dropped = true;
+  for (auto it = lru_.begin(); it != lru_.end();) {
+    if (it->generation != pack.generation) {
+      ++it;
+      continue;
+    }
+    bytes_ -= it->blob->size();
+    map_.erase(it->key);
+    it = lru_.erase(it);
+  }
+  counters_.invalidations++;
+}
+
+void AssetCache::insert(std::string key, Pack &pack, Blob blob) {
+  if (blob->size() > budget_)
+    return;
+
+  std::lock_guard<std::mutex> lk(lruMu_);
+  // A lookup that missed just before the pack was replaced on disk finishes
+  // after drop_generation() swept its generation; caching it then would pin
+  // bytes no key can reach until they are evicted
+  if (pack.dropped || map_.count(key))
+    return;
+  bytes_ += blob->size();
+  lru_.push_front(Node{key, pack.generation, std::move(blob)});
+  map_.emplace(std::move(key), lru_.begin());
+
+  while (bytes_ > budget_) {
+    Node &victim = lru_.back();
+    bytes_ -= victim.blob->size();
+    map_.erase(victim.key);
+    lru_.pop_back();
+    counters_.evictions++;
+  }
+}
+
+AssetCache::Blob AssetCache::get(const fs::path &zip,
+                                 const std::string &masterKey,
+                                 const std::string &asset, bool *hit) {
+  std::shared_ptr<Pack> pack = pack_for(zip, masterKey);
+  std::string key = std::to_string(pack->generation);
+  key.push_back('\0');
+  key += asset;
+
+  {
+    std::lock_guard<std::mutex> lk(lruMu_);
+    auto it = map_.find(key);
+    if (it != map_.end()) {
+      lru_.splice(lru_.begin(), lru_, it->second);
+      counters_.hits++;
+      if (hit)
+        *hit = true;
+      return it->second->blob;
+    }
+    counters_.misses++;
+  }
+  if (hit)
+    *hit = false;
+
+  // Decrypt without holding any lock; PackReader::read is thread-safe
+  Blob blob =
+      std::make_shared<const std::vector<uint8_t>>(pack->reader.read(asset));
+  insert(std::move(key), *pack, blob);
+  return blob;
+}
+
+AssetCache::Stats AssetCache::stats() const {
+  Stats s;
+  {
+    std::lock_guard<std::mutex> lk(lruMu_);
+    s = counters_;
+    s.bytes = bytes_;
+    s.entries = lru_.size();
+  }
+  s.budget = budget_;
+  std::lock_guard<std::mutex> lk(packsMu_);
+  s.packs = packs_.size();
+  return s;
+}
+
+} // namespace mcbe_pack
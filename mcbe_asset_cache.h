@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mcbe_pack_reader.h"
+
+// Process-wide cache in front of PackReader, shared by the threads of the
+// mcbe_cached daemon:
+//   - opened packs (mapping + contents.json index), keyed by path and key
+//   - an LRU of decrypted assets bounded by a byte budget
+// A pack whose size, mtime or inode changed on disk is re-opened on the
+// next lookup and its cached assets are dropped.
+
+namespace mcbe_pack {
+
+class AssetCache {
+public:
+  using Blob = std::shared_ptr<const std::vector<uint8_t>>;
+
+  explicit AssetCache(size_t budgetBytes) : budget_(budgetBytes) {}
+
+  AssetCache(const AssetCache &) = delete;
+  AssetCache &operator=(const AssetCache &) = delete;
+
+  // Plaintext of `asset` inside the pack at `zip`. Safe to call from any
+  // number of threads. Throws std::runtime_error.
+  Blob get(const fs::path &zip, const std::string &masterKey,
+           const std::string &asset, bool *hit = nullptr);
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t invalidations = 0;
+    size_t bytes = 0;
+    size_t budget = 0;
+    size_t entries = 0;
+    size_t packs = 0;
+  };
+  Stats stats() const;
+
+private:
+  // What identifies one version of a file on disk
+  struct FileStamp {
+    uint64_t size = 0;
+    int64_t mtimeNs = 0;
+    uint64_t inode = 0;
+    bool operator==(const FileStamp &o) const {
+      return size == o.size && mtimeNs == o.mtimeNs && inode == o.inode;
+    }
+  };
+
+  struct Pack {
+    PackReader reader;
+    FileStamp stamp;
+    uint64_t generation = 0;
+    bool dropped = false; // replaced by a newer version; guarded by lruMu_
+  };
+
+  struct Node {
+    std::string key;
+    uint64_t generation;
+    Blob blob;
+  };
+
+  static FileStamp stamp_of(const fs::path &p);
+  std::shared_ptr<Pack> pack_for(const fs::path &zip,
+                                 const std::string &masterKey);
+  void drop_generation(Pack &pack);
+  void insert(std::string key, Pack &pack, Blob blob);
+
+  mutable std::mutex packsMu_;
+  std::unordered_map<std::string, std::shared_ptr<Pack>> packs_;
+  uint64_t nextGeneration_ = 1;
+
+  mutable std::mutex lruMu_;
+  std::list<Node> lru_; // most recently used first
+  std::unordered_map<std::string, std::list<Node>::iterator> map_;
+  size_t budget_;
+  size_t bytes_ = 0;
+  Stats counters_;
+};
+
+} // namespace mcbe_pack
@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mcbe_pack_audit.h"
+
+namespace fs = std::filesystem;
+
+static void print_usage() {
+    std::cout
+        << "Usage:\n"
+        << "  mcbe_audit <store_dir>... [options]\n\n"
+        << "Options:\n"
+        << "  --index <file>   Scan index (default: <first store_dir>/.mcbe_audit.idx)\n"
+        << "  --full           Ignore the index and audit every pack again\n"
+        << "  --threads <n>    Worker threads (default: one per core)\n"
+        << "  --verbose        List packs that passed too\n\n"
+        << "Audits every *.zip below the given directories: ZIP structure, contents.json\n"
+        << "headers against manifest.json, .zip.key / .info.txt sidecars and, with the\n"
+        << "key, that contents.json and the archive list the same files. Packs whose\n"
+        << "size and mtime (and sidecars) are unchanged since the last scan are taken\n"
+        << "from the index. Exit code 1 if any pack fails.\n";
+}
+
+static bool is_zip_name(const fs::path& p) {
+    std::string ext = p.extension().u8string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)tolower(c); });
+    return ext == ".zip";
+}
+
+struct Finding {
+    std::string path;
+    mcbe_pack::AuditStamp stamp;
+    mcbe_pack::AuditResult result;
+    bool cached = false;
+};
+
+// Shared queue of directories to list and packs to audit. Workers take
+// whatever is next, so a deep tree and a flat store of thousands of packs
+// both keep every thread busy.
+class Scan {
+public:
+    Scan(const mcbe_pack::AuditIndex* index) : index_(index) {}
+
+    void push(fs::path p, bool dir) {
+        std::lock_guard<std::mutex> lk(mu_);
+        queue_.push_back(Task{std::move(p), dir});
+        cv_.notify_one();
+    }
+
+    void run(unsigned threadCount) {
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < threadCount; i++) threads.emplace_back([this]() { worker(); });
+        for (auto& t : threads) t.join();
+    }
+
+    std::vector<Finding> findings;
+    std::vector<std::string> walkErrors;
+
+private:
+    struct Task {
+        fs::path path;
+        bool dir;
+    };
+
+    void worker() {
+        for (;;) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lk(mu_);
+                cv_.wait(lk, [this]() { return !queue_.empty() || busy_ == 0; });
+                if (queue_.empty()) return; // nothing queued and nobody left to queue more
+                task = std::move(queue_.front());
+                queue_.pop_front();
+                busy_++;
+            }
+
+            if (task.dir) list_dir(task.path);
+            else audit(task.path);
+
+            std::lock_guard<std::mutex> lk(mu_);
+            if (--busy_ == 0 && queue_.empty()) cv_.notify_all();
+        }
+    }
+
+    void list_dir(const fs::path& dir) {
+        std::error_code ec;
+        fs::directory_iterator it(dir, fs::directory_options::skip_permission_denied, ec);
+        for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            const fs::directory_entry& e = *it;
+            std::error_code sec;
+            if (e.is_symlink(sec)) continue;
+            if (e.is_directory(sec)) push(e.path(), true);
+            else if (e.is_regular_file(sec) && is_zip_name(e.path())) push(e.path(), false);
+        }
+        if (ec) {
+            std::lock_guard<std::mutex> lk(resultsMu_);
+            walkErrors.push_back(dir.u8string() + ": " + ec.message());
+        }
+    }
+
+    void audit(const fs::path& zip) {
+        Finding f;
+        f.path = fs::absolute(zip).lexically_normal().u8string();
+        fs::path keyFile = mcbe_pack::find_key_file(zip);
+        try {
+            f.stamp = mcbe_pack::audit_stamp(zip, keyFile);
+            const mcbe_pack::AuditResult* cached = index_ ? index_->find(f.path, f.stamp) : nullptr;
+            if (cached) {
+                f.result = *cached;
+                f.cached = true;
+            } else {
+                f.result = mcbe_pack::audit_pack(zip, keyFile);
+            }
+        } catch (const std::exception& e) {
+            f.result.ok = false;
+            f.result.issues.push_back(e.what());
+        }
+        std::lock_guard<std::mutex> lk(resultsMu_);
+        findings.push_back(std::move(f));
+    }
+
+    const mcbe_pack::AuditIndex* index_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<Task> queue_;
+    size_t busy_ = 0;
+    std::mutex resultsMu_;
+};
+
+int main(int argc, char** argv) {
+    try {
+        std::vector<fs::path> roots;
+        fs::path indexPath;
+        bool full = false;
+        bool verbose = false;
+        unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+        for (int i = 1; i < argc; i++) {
+            std::string a = argv[i];
+            if (a == "--index" && i + 1 < argc) {
+                indexPath = fs::u8path(argv[++i]);
+            } else if (a == "--full") {
+                full = true;
+            } else if (a == "--threads" && i + 1 < argc) {
+                threadCount = (unsigned)std::max(1, std::stoi(argv[++i]));
+            } else if (a == "--verbose") {
+                verbose = true;
+            } else if (a == "-h" || a == "--help") {
+                print_usage();
+                return 0;
+            } else if (!a.empty() && a[0] == '-') {
+                std::cerr << "[ERROR] Unknown option: " << a << std::endl;
+                print_usage();
+                return 2;
+            } else {
+                roots.push_back(fs::u8path(a));
+            }
+        }
+        if (roots.empty()) {
+            print_usage();
+            return 2;
+        }
+        if (indexPath.empty()) indexPath = roots.front() / ".mcbe_audit.idx";
+
+        auto start = std::chrono::steady_clock::now();
+        mcbe_pack::AuditIndex index;
+        if (!full) index.load(indexPath);
+        std::cout << "[*] Index: " << indexPath.u8string() << " (" << index.size() << " records)" << std::endl;
+
+        Scan scan(full ? nullptr : &index);
+        for (auto const& r : roots) {
+            if (!fs::is_directory(r)) throw std::runtime_error("Not a directory: " + r.u8string());
+            scan.push(r, true);
+        }
+        scan.run(threadCount);
+
+        std::sort(scan.findings.begin(), scan.findings.end(),
+                  [](const Finding& a, const Finding& b) { return a.path < b.path; });
+
+        size_t failed = 0;
+        size_t cached = 0;
+        size_t noKey = 0;
+        std::unordered_set<std::string> seen;
+        for (auto const& f : scan.findings) {
+            seen.insert(f.path);
+            if (f.cached) cached++;
+            else index.put(f.path, f.stamp, f.result);
+            if (!f.result.keyChecked) noKey++;
+
+            if (f.result.ok) {
+                if (verbose) std::cout << "[OK] " << f.path << " (" << f.result.contentId << ", "
+                                       << f.result.listed << " listed)" << std::endl;
+                continue;
+            }
+            failed++;
+            std::cout << "[FAIL] " << f.path << (f.cached ? " (unchanged)" : "") << std::endl;
+            for (auto const& issue : f.result.issues) std::cout << "    " << issue << std::endl;
+        }
+        for (auto const& e : scan.walkErrors) std::cout << "[ERROR] " << e << std::endl;
+
+        index.prune(seen);
+        index.save(indexPath);
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "[*] " << scan.findings.size() << " packs: " << scan.findings.size() - failed << " ok, "
+                  << failed << " failed, " << noKey << " without key check" << std::endl;
+        std::cout << "[*] Audited " << scan.findings.size() - cached << ", unchanged " << cached << ", in "
+                  << std::fixed << std::setprecision(3) << elapsed << "s with " << threadCount << " threads"
+                  << std::endl;
+        return failed || !scan.walkErrors.empty() ? 1 : 0;
+    } catch (const std::exception& e) {
+        std::cerr << "\n[ERROR] " << e.what() << std::endl;
+        return 3;
+    }
+}
@@ -0,0 +1,519 @@
+// Local decrypted-asset cache daemon (POSIX, Unix domain socket).
+//
+// Protocol, one request per line, any number per connection:
+//   GET\t<pack.zip>\t<key|keyfile>\t<asset path>\n
+//       -> "OK <size> HIT|MISS\n" followed by <size> bytes
+//   STATS\n
+//       -> "OK <size>\n" followed by <size> bytes of text
+// Errors come back as "ERR <message>\n" and keep the connection open.
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "mcbe_asset_cache.h"
+#include "mcbe_pack.h"
+
+namespace fs = std::filesystem;
+
+static std::atomic<bool> g_stop(false);
+// Write end of the poll loop's wake-up pipe
+static int g_wakeFd = -1;
+
+// A request line longer than this is refused and the connection closed
+static constexpr size_t MAX_LINE = 64 * 1024;
+// A client that stops reading its replies gives up a reader thread after this
+static constexpr int SEND_TIMEOUT_SEC = 10;
+
+static void print_usage() {
+    std::cout
+        << "Usage:\n"
+        << "  mcbe_cached serve <socket> [--budget-mb <n>] [--threads <n>]\n"
+        << "  mcbe_cached get <socket> <pack.zip> <key|keyfile> <asset> [output] [--repeat <n>]\n"
+        << "  mcbe_cached stats <socket>\n\n"
+        << "serve   Run the daemon (default budget 256 MB, one reader thread per core).\n"
+        << "get     Fetch one decrypted asset through a running daemon; --repeat\n"
+        << "        reports the average lookup latency on stderr.\n";
+}
+
+static void on_signal(int) {
+    g_stop = true;
+    // Wakes up the poll loop, which then shuts down every open connection
+    if (g_wakeFd >= 0) {
+        char b = 0;
+        ssize_t r = write(g_wakeFd, &b, 1);
+        (void)r;
+    }
+}
+
+static sockaddr_un socket_address(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) throw std::runtime_error("Socket path too long: " + path);
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return addr;
+}
+
+static bool write_all(int fd, const void* p, size_t n) {
+    const char* c = (const char*)p;
+    while (n > 0) {
+        ssize_t w = send(fd, c, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        c += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+// Buffered line/byte reader over a socket
+class Conn {
+public:
+    explicit Conn(int fd) : fd_(fd) {}
+
+    bool read_line(std::string& line) {
+        for (;;) {
+            size_t nl = buf_.find('\n', pos_);
+            if (nl != std::string::npos) {
+                line.assign(buf_, pos_, nl - pos_);
+                pos_ = nl + 1;
+                return true;
+            }
+            if (!fill()) return false;
+        }
+    }
+
+    // Server side: a complete line that is already buffered, without reading
+    bool buffered_line(std::string& line) {
+        size_t nl = buf_.find('\n', pos_);
+        if (nl == std::string::npos) return false;
+        line.assign(buf_, pos_, nl - pos_);
+        pos_ = nl + 1;
+        return true;
+    }
+
+    size_t buffered() const { return buf_.size() - pos_; }
+
+    // Server side: one read of whatever the socket has, never blocking;
+    // false once the peer has hung up or the socket failed
+    bool receive() { return fill(MSG_DONTWAIT); }
+
+    bool read_bytes(std::vector<uint8_t>& out, size_t n) {
+        out.clear();
+        out.reserve(n);
+        while (out.size() < n) {
+            if (pos_ == buf_.size() && !fill()) return false;
+            size_t take = std::min(n - out.size(), buf_.size() - pos_);
+            out.insert(out.end(), buf_.begin() + pos_, buf_.begin() + pos_ + take);
+            pos_ += take;
+        }
+        return true;
+    }
+
+private:
+    bool fill(int flags = 0) {
+        if (pos_ > 0) {
+            buf_.erase(0, pos_);
+            pos_ = 0;
+        }
+        char tmp[64 * 1024];
+        ssize_t r;
+        do {
+            r = recv(fd_, tmp, sizeof(tmp), flags);
+        } while (r < 0 && errno == EINTR);
+        if (r < 0 && (flags & MSG_DONTWAIT) && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        if (r <= 0) return false;
+        buf_.append(tmp, (size_t)r);
+        return true;
+    }
+
+    int fd_;
+    std::string buf_;
+    size_t pos_ = 0;
+};
+
+static std::vector<std::string> split_tabs(const std::string& s) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    for (;;) {
+        size_t t = s.find('\t', start);
+        parts.push_back(s.substr(start, t == std::string::npos ? std::string::npos : t - start));
+        if (t == std::string::npos) break;
+        start = t + 1;
+    }
+    return parts;
+}
+
+// 32-character master key, or the path of a .zip.key file holding one
+static std::string load_master_key(const std::string& arg) {
+    if (arg.size() == mcbe_pack::KEY_LEN && !fs::exists(fs::u8path(arg))) return arg;
+    return mcbe_pack::read_key_file(fs::u8path(arg));
+}
+
+static std::string stats_text(const mcbe_pack::AssetCache& cache) {
+    mcbe_pack::AssetCache::Stats s = cache.stats();
+    std::ostringstream o;
+    o << "hits " << s.hits << "\n"
+      << "misses " << s.misses << "\n"
+      << "evictions " << s.evictions << "\n"
+      << "invalidations " << s.invalidations << "\n"
+      << "entries " << s.entries << "\n"
+      << "bytes " << s.bytes << "\n"
+      << "budget " << s.budget << "\n"
+      << "packs " << s.packs << "\n";
+    return o.str();
+}
+
+// Answers one request line; false when the reply could not be sent
+static bool answer(int fd, const std::string& line, mcbe_pack::AssetCache& cache) {
+    std::string header;
+    const void* body = nullptr;
+    size_t bodyLen = 0;
+    std::string text;
+    mcbe_pack::AssetCache::Blob blob;
+
+    try {
+        std::vector<std::string> f = split_tabs(line);
+        if (f[0] == "GET" && f.size() == 4) {
+            bool hit = false;
+            blob = cache.get(fs::u8path(f[1]), load_master_key(f[2]), f[3], &hit);
+            body = blob->data();
+            bodyLen = blob->size();
+            header = "OK " + std::to_string(bodyLen) + (hit ? " HIT\n" : " MISS\n");
+        } else if (f[0] == "STATS") {
+            text = stats_text(cache);
+            body = text.data();
+            bodyLen = text.size();
+            header = "OK " + std::to_string(bodyLen) + "\n";
+        } else {
+            throw std::runtime_error("Bad request");
+        }
+    } catch (const std::exception& e) {
+        std::string msg = e.what();
+        for (auto& c : msg) {
+            if (c == '\n') c = ' ';
+        }
+        header = "ERR " + msg + "\n";
+        bodyLen = 0;
+    }
+
+    if (!write_all(fd, header.data(), header.size())) return false;
+    return !bodyLen || write_all(fd, body, bodyLen);
+}
+
+struct Client {
+    explicit Client(int fd) : fd(fd), conn(fd) {}
+    int fd;
+    Conn conn;
+};
+
+// One poll loop watches the listening socket and every idle connection;
+// a connection with input is handed to a reader thread, which answers the
+// complete requests that arrived and hands it back. Idle clients cost no
+// thread, and a slow one holds a reader for one request at most.
+class Server {
+public:
+    // wakeRead: read end of the pipe g_wakeFd writes to
+    Server(int listenFd, int wakeRead, mcbe_pack::AssetCache& cache, unsigned threadCount)
+        : listenFd_(listenFd), wakeRead_(wakeRead), cache_(cache) {
+        for (unsigned i = 0; i < threadCount; i++) readers_.emplace_back([this]() { reader(); });
+    }
+
+    ~Server() { stop(); }
+
+    // Runs until g_stop is set
+    void run() {
+        std::vector<Client*> polled;
+        std::vector<pollfd> fds;
+        while (!g_stop) {
+            fds.assign({{wakeRead_, POLLIN, 0}, {listenFd_, POLLIN, 0}});
+            for (Client* c : polled) fds.push_back({c->fd, POLLIN, 0});
+            if (poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::string("poll() failed: ") + strerror(errno));
+            }
+
+            std::vector<Client*> idle;
+            std::vector<Client*> ready;
+            for (size_t i = 0; i < polled.size(); i++)
+                (fds[i + 2].revents ? ready : idle).push_back(polled[i]);
+            polled.swap(idle);
+            if (!ready.empty()) {
+                std::lock_guard<std::mutex> lk(mu_);
+                ready_.insert(ready_.end(), ready.begin(), ready.end());
+                cv_.notify_all();
+            }
+
+            if (fds[1].revents) accept_all(polled);
+            if (fds[0].revents) {
+                char buf[64];
+                while (read(wakeRead_, buf, sizeof(buf)) > 0) {
+                }
+                std::lock_guard<std::mutex> lk(mu_);
+                polled.insert(polled.end(), returned_.begin(), returned_.end());
+                returned_.clear();
+            }
+        }
+        stop();
+    }
+
+private:
+    void accept_all(std::vector<Client*>& polled) {
+        for (;;) {
+            int fd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                return;
+            }
+            timeval tv{SEND_TIMEOUT_SEC, 0};
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+            std::lock_guard<std::mutex> lk(mu_);
+            auto& c = clients_[fd];
+            c.reset(new Client(fd));
+            polled.push_back(c.get());
+        }
+    }
+
+    void reader() {
+        for (;;) {
+            Client* c;
+            {
+                std::unique_lock<std::mutex> lk(mu_);
+                cv_.wait(lk, [&] { return stopping_ || !ready_.empty(); });
+                if (stopping_) return;
+                c = ready_.front();
+                ready_.pop_front();
+            }
+            if (serve(*c)) {
+                hand_back(c);
+            } else {
+                std::lock_guard<std::mutex> lk(mu_);
+                close(c->fd);
+                clients_.erase(c->fd);
+            }
+        }
+    }
+
+    // Reads what arrived and answers every complete line; false closes
+    bool serve(Client& c) {
+        if (!c.conn.receive()) return false;
+        std::string line;
+        while (!g_stop && c.conn.buffered_line(line)) {
+            if (!answer(c.fd, line, cache_)) return false;
+        }
+        if (c.conn.buffered() > MAX_LINE) {
+            static const char msg[] = "ERR Request line too long\n";
+            write_all(c.fd, msg, sizeof(msg) - 1);
+            return false;
+        }
+        return !g_stop;
+    }
+
+    void hand_back(Client* c) {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            returned_.push_back(c);
+        }
+        char b = 0;
+        ssize_t r = write(g_wakeFd, &b, 1);
+        (void)r;
+    }
+
+    // Shuts down every open connection, which also fails a reader's pending
+    // send, then joins the readers and closes what is left
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            if (stopping_) return;
+            stopping_ = true;
+            for (auto& kv : clients_) shutdown(kv.first, SHUT_RDWR);
+        }
+        cv_.notify_all();
+        for (auto& t : readers_) t.join();
+        for (auto& kv : clients_) close(kv.first);
+        clients_.clear();
+    }
+
+    int listenFd_;
+    int wakeRead_;
+    mcbe_pack::AssetCache& cache_;
+    std::vector<std::thread> readers_;
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::map<int, std::unique_ptr<Client>> clients_; // every open connection
+    std::deque<Client*> ready_;                      // waiting for a reader
+    std::vector<Client*> returned_;                  // back to the poll loop
+    bool stopping_ = false;
+};
+
+static int run_server(const std::string& socketPath, size_t budget, unsigned threadCount) {
+    sockaddr_un addr = socket_address(socketPath);
+    int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listenFd < 0) throw std::runtime_error("socket() failed.");
+    unlink(socketPath.c_str());
+    if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0)
+        throw std::runtime_error("Failed to bind " + socketPath + ": " + strerror(errno));
+    if (listen(listenFd, 128) != 0) throw std::runtime_error("listen() failed.");
+
+    int wake[2];
+    if (pipe2(wake, O_CLOEXEC | O_NONBLOCK) != 0) throw std::runtime_error("pipe2() failed.");
+    g_wakeFd = wake[1];
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    mcbe_pack::AssetCache cache(budget);
+    std::cout << "[*] Listening on " << socketPath << std::endl;
+    std::cout << "[*] Cache budget: " << budget / (1024 * 1024) << " MB, reader threads: " << threadCount
+              << std::endl;
+
+    {
+        Server server(listenFd, wake[0], cache, threadCount);
+        server.run();
+    }
+
+    g_wakeFd = -1;
+    close(wake[0]);
+    close(wake[1]);
+    close(listenFd);
+    unlink(socketPath.c_str());
+    std::cout << "\n[STOP] " << stats_text(cache);
+    return 0;
+}
+
+static int connect_to(const std::string& socketPath) {
+    sockaddr_un addr = socket_address(socketPath);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+        throw std::runtime_error("Failed to connect to " + socketPath + ": " + strerror(errno));
+    return fd;
+}
+
+// Sends one request and returns the body; throws on ERR
+static std::vector<uint8_t> request(int fd, Conn& conn, const std::string& line, std::string* status) {
+    if (!write_all(fd, line.data(), line.size())) throw std::runtime_error("Connection lost.");
+    std::string header;
+    if (!conn.read_line(header)) throw std::runtime_error("Connection lost.");
+    if (header.rfind("ERR ", 0) == 0) throw std::runtime_error(header.substr(4));
+    if (header.rfind("OK ", 0) != 0) throw std::runtime_error("Bad reply: " + header);
+
+    size_t sp = header.find(' ', 3);
+    size_t size = std::stoull(header.substr(3, sp == std::string::npos ? std::string::npos : sp - 3));
+    if (status) *status = sp == std::string::npos ? "" : header.substr(sp + 1);
+    std::vector<uint8_t> body;
+    if (!conn.read_bytes(body, size)) throw std::runtime_error("Connection lost.");
+    return body;
+}
+
+int main(int argc, char** argv) {
+    try {
+        if (argc < 3) {
+            print_usage();
+            return 2;
+        }
+        std::string cmd = argv[1];
+        std::string socketPath = argv[2];
+
+        if (cmd == "serve") {
+            size_t budget = 256ull * 1024 * 1024;
+            unsigned threadCount = std::max(4u, std::thread::hardware_concurrency());
+            for (int i = 3; i < argc; i++) {
+                std::string a = argv[i];
+                if (a == "--budget-mb" && i + 1 < argc) {
+                    budget = (size_t)std::stoull(argv[++i]) * 1024 * 1024;
+                } else if (a == "--threads" && i + 1 < argc) {
+                    threadCount = (unsigned)std::max(1, std::stoi(argv[++i]));
+                } else {
+                    print_usage();
+                    return 2;
+                }
+            }
+            return run_server(socketPath, budget, threadCount);
+        }
+
+        int fd = connect_to(socketPath);
+        Conn conn(fd);
+
+        if (cmd == "stats") {
+            std::vector<uint8_t> body = request(fd, conn, "STATS\n", nullptr);
+            std::cout.write((const char*)body.data(), (std::streamsize)body.size());
+            close(fd);
+            return 0;
+        }
+
+        if (cmd != "get" || argc < 6) {
+            print_usage();
+            return 2;
+        }
+
+        std::string output;
+        int repeat = 1;
+        for (int i = 6; i < argc; i++) {
+            std::string a = argv[i];
+            if (a == "--repeat" && i + 1 < argc) {
+                repeat = std::max(1, std::stoi(argv[++i]));
+            } else if (output.empty()) {
+                output = a;
+            } else {
+                print_usage();
+                return 2;
+            }
+        }
+
+        std::string line = std::string("GET\t") + argv[3] + "\t" + argv[4] + "\t" + argv[5] + "\n";
+        std::vector<uint8_t> body;
+        std::string status;
+        std::string firstStatus;
+        double firstMs = 0.0;
+        double restMs = 0.0;
+        for (int i = 0; i < repeat; i++) {
+            auto start = std::chrono::steady_clock::now();
+            body = request(fd, conn, line, &status);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (i == 0) {
+                firstMs = ms;
+                firstStatus = status;
+            } else {
+                restMs += ms;
+            }
+        }
+        close(fd);
+
+        if (repeat > 1) {
+            std::cerr << "[*] First lookup: " << std::fixed << std::setprecision(3) << firstMs << " ms (" << firstStatus
+                      << "), warm average: " << restMs / (repeat - 1) << " ms over " << repeat - 1 << std::endl;
+        }
+        if (!output.empty()) {
+            std::ofstream out(fs::u8path(output), std::ios::binary | std::ios::trunc);
+            if (!out) throw std::runtime_error("Failed to create file: " + output);
+            out.write((const char*)body.data(), (std::streamsize)body.size());
+        } else {
+            std::cout.write((const char*)body.data(), (std::streamsize)body.size());
+            std::cout.flush();
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "\n[ERROR] " << e.what() << std::endl;
+        return 3;
+    }
+}
@@ -0,0 +1,79 @@
+#include "mcbe_cfb8.h"
+
+#include "aes256_ecb.h"
+
+namespace mcbe_cfb8 {
+
+extern const Impl impl_native;
+#ifdef MCBE_CFB8_HAVE_AESNI
+extern const Impl impl_aesni;
+#endif
+#ifdef MCBE_CFB8_HAVE_VAES
+extern const Impl impl_vaes;
+#endif
+
+static const Impl &detect() {
+#if (defined(__GNUC__) || defined(__clang__)) &&                              \
+    (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+#ifdef MCBE_CFB8_HAVE_VAES
+  if (__builtin_cpu_supports("vaes") && __builtin_cpu_supports("avx2"))
+    return impl_vaes;
+#endif
+#ifdef MCBE_CFB8_HAVE_AESNI
+  if (__builtin_cpu_supports("aes"))
+    return impl_aesni;
+#endif
+#endif
+  return impl_native;
+}
+
+const Impl &select() {
+  static const Impl &impl = detect();
+  return impl;
+}
+
+// ============================================
+// Cmac
+// ============================================
+
+void Cmac::update(const uint8_t *data, size_t len) {
+  if (bufLen_ < 16) {
+    size_t n = len < 16 - bufLen_ ? len : 16 - bufLen_;
+    memcpy(buf_ + bufLen_, data, n);
+    bufLen_ += n;
+    data += n;
+    len -= n;
+  }
+  if (len == 0)
+    return;
+
+  // More data follows, so the held block and all but the last one are final
+  impl_->cbc_mac(key_, x_, buf_, 1);
+  size_t full = (len - 1) / 16;
+  impl_->cbc_mac(key_, x_, data, full);
+  data += full * 16;
+  len -= full * 16;
+  memcpy(buf_, data, len);
+  bufLen_ = len;
+}
+
+void Cmac::final(uint8_t mac[16]) {
+  static const uint8_t zero[16] = {0};
+  uint8_t k[16] = {0};
+  impl_->cbc_mac(key_, k, zero, 1); // E(0)
+  mcbe_aes::cmac_dbl(k);
+
+  uint8_t last[16] = {0};
+  memcpy(last, buf_, bufLen_);
+  if (bufLen_ < 16) {
+    last[bufLen_] = 0x80;
+    mcbe_aes::cmac_dbl(k);
+  }
+  for (int i = 0; i < 16; i++)
+    last[i] ^= k[i];
+  impl_->cbc_mac(key_, x_, last, 1);
+  memcpy(mac, x_, 16);
+}
+
+} // namespace mcbe_cfb8
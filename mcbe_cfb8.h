@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Bulk AES-256-CFB-8 with the MCBE key convention: the 32-byte key string
+// is the AES key and its first 16 bytes are the IV.
+//
+// The implementation is compiled once per instruction-set variant
+// (mcbe_cfb8_impl.cpp) and picked at runtime from the CPU features, so a
+// portable -march build still uses AES-NI/VAES where the host has them.
+// The same variants also provide AES-256-CMAC for the deterministic key
+// derivation in mcbe_pack.
+
+namespace mcbe_cfb8 {
+
+// One message of a crypt_many() batch; IV = key[:16] as usual
+struct Job {
+  const uint8_t *key;
+  const uint8_t *in;
+  uint8_t *out;
+  size_t len;
+};
+
+struct Impl {
+  const char *name;
+  // CFB-8 starting from shift register `iv`; on return `iv` holds the
+  // register after the last byte, so calls can be chained
+  void (*crypt)(const uint8_t key[32], uint8_t iv[16], const uint8_t *in,
+                uint8_t *out, size_t len, bool decrypt);
+  // Independent messages, up to 8 interleaved in the multi-lane kernel.
+  // A single CFB-8 stream is bound by AES latency; several streams side by
+  // side keep the AES unit busy.
+  void (*crypt_many)(const Job *jobs, size_t n, bool decrypt);
+  // x = E(x ^ block) over `nblocks` 16-byte blocks
+  void (*cbc_mac)(const uint8_t key[32], uint8_t x[16], const uint8_t *blocks,
+                  size_t nblocks);
+};
+
+// Best variant for this CPU (resolved once)
+const Impl &select();
+
+inline const char *backend_name() { return select().name; }
+
+inline void encrypt(const uint8_t key[32], const uint8_t *in, uint8_t *out,
+                    size_t len) {
+  uint8_t iv[16];
+  memcpy(iv, key, 16);
+  select().crypt(key, iv, in, out, len, false);
+}
+
+inline void decrypt(const uint8_t key[32], const uint8_t *in, uint8_t *out,
+                    size_t len) {
+  uint8_t iv[16];
+  memcpy(iv, key, 16);
+  select().crypt(key, iv, in, out, len, true);
+}
+
+// Batch of small messages (e.g. the JSON files of a pack) in one call
+inline void encrypt_many(const Job *jobs, size_t n) {
+  select().crypt_many(jobs, n, false);
+}
+
+// Incremental CFB-8: feeding a message in any number of pieces gives the
+// same bytes as one encrypt()/decrypt() call over the whole message.
+class Stream {
+public:
+  Stream(const uint8_t key[32], bool decrypt)
+      : impl_(&select()), decrypt_(decrypt) {
+    memcpy(key_, key, 32);
+    memcpy(iv_, key, 16);
+  }
+
+  // in == out is allowed
+  void update(const uint8_t *in, uint8_t *out, size_t len) {
+    impl_->crypt(key_, iv_, in, out, len, decrypt_);
+  }
+
+private:
+  const Impl *impl_;
+  bool decrypt_;
+  uint8_t key_[32];
+  uint8_t iv_[16];
+};
+
+// Incremental AES-256-CMAC (RFC 4493)
+class Cmac {
+public:
+  explicit Cmac(const uint8_t key[32]) : impl_(&select()) {
+    memcpy(key_, key, 32);
+  }
+
+  void update(const uint8_t *data, size_t len);
+  void final(uint8_t mac[16]);
+
+private:
+  const Impl *impl_;
+  uint8_t key_[32];
+  uint8_t x_[16] = {0};
+  // Last block is held back until final() knows whether it is complete
+  uint8_t buf_[16];
+  size_t bufLen_ = 0;
+};
+
+// One-shot AES-256-CMAC of msg under key
+inline void cmac(const uint8_t key[32], const uint8_t *msg, size_t len,
+                 uint8_t mac[16]) {
+  Cmac c(key);
+  c.update(msg, len);
+  c.final(mac);
+}
+
+} // namespace mcbe_cfb8
@@ -0,0 +1,164 @@
+// One instruction-set variant of the CFB-8 engine.
+// Built several times with different -m flags; MCBE_CFB8_VARIANT names the
+// exported Impl (impl_native when built with the target's own flags).
+
+#include <algorithm>
+#include <cstring>
+
+#include "aes256_ecb.h"
+#include "mcbe_cfb8.h"
+
+#ifndef MCBE_CFB8_VARIANT
+#define MCBE_CFB8_VARIANT native
+#endif
+
+#define MCBE_CFB8_CAT2(a, b) a##b
+#define MCBE_CFB8_CAT(a, b) MCBE_CFB8_CAT2(a, b)
+
+namespace mcbe_cfb8 {
+
+#if USE_VAES
+using Backend = mcbe_aes::VaesBackend;
+static constexpr const char *kName = "vaes";
+#elif USE_AES_NI
+using Backend = mcbe_aes::AesNiBackend;
+static constexpr const char *kName = "aes-ni";
+#elif USE_AES_ARM
+using Backend = mcbe_aes::ArmBackend;
+static constexpr const char *kName = "armv8-ce";
+#elif USE_WASM_SIMD128
+using Backend = mcbe_aes::Simd128Backend;
+static constexpr const char *kName = "wasm-simd128";
+#else
+using Backend = mcbe_aes::SoftBackend;
+static constexpr const char *kName = "soft";
+#endif
+
+static void crypt(const uint8_t key[32], uint8_t iv[16], const uint8_t *in,
+                  uint8_t *out, size_t len, bool decrypt) {
+  // Register after this call: the last 16 bytes of iv || ciphertext.
+  // Taken before the kernel runs since it may work in place.
+  uint8_t next[16];
+  const uint8_t *cipher = decrypt ? in : out;
+  size_t keep = len < 16 ? 16 - len : 0;
+  memcpy(next, iv + 16 - keep, keep);
+  if (decrypt && len)
+    memcpy(next + keep, in + len - (16 - keep), 16 - keep);
+
+  Backend::Ctx ctx;
+  Backend::init(ctx, key);
+  const Backend::Ctx *c[1] = {&ctx};
+  const uint8_t *v[1] = {iv};
+  const uint8_t *i[1] = {in};
+  uint8_t *o[1] = {out};
+  mcbe_aes::Kernel<1, Backend>::cfb8(c, v, i, o, len, decrypt);
+
+  if (!decrypt && len)
+    memcpy(next + keep, cipher + len - (16 - keep), 16 - keep);
+  memcpy(iv, next, 16);
+}
+
+// Lanes of crypt_many(): a message in progress and its shift register
+struct Lane {
+  const Job *job;
+  size_t off;
+  Backend::Ctx ctx;
+  uint8_t iv[16];
+};
+
+// Advances lanes[0..N) by `step` bytes each
+template <int N>
+static void crypt_lanes(Lane *lanes, size_t step, bool decrypt) {
+  const Backend::Ctx *c[N];
+  const uint8_t *v[N];
+  const uint8_t *i[N];
+  uint8_t *o[N];
+  uint8_t next[N][16];
+  for (int l = 0; l < N; l++) {
+    Lane &ln = lanes[l];
+    c[l] = &ln.ctx;
+    v[l] = ln.iv;
+    i[l] = ln.job->in + ln.off;
+    o[l] = ln.job->out + ln.off;
+    // Register after this step, as in crypt(): ciphertext is the input
+    // when decrypting, so take it before the kernel overwrites it
+    size_t keep = step < 16 ? 16 - step : 0;
+    memcpy(next[l], ln.iv + 16 - keep, keep);
+    if (decrypt)
+      memcpy(next[l] + keep, i[l] + step - (16 - keep), 16 - keep);
+  }
+  mcbe_aes::Kernel<N, Backend>::cfb8(c, v, i, o, step, decrypt);
+  for (int l = 0; l < N; l++) {
+    Lane &ln = lanes[l];
+    size_t keep = step < 16 ? 16 - step : 0;
+    if (!decrypt)
+      memcpy(next[l] + keep, o[l] + step - (16 - keep), 16 - keep);
+    memcpy(ln.iv, next[l], 16);
+    ln.off += step;
+  }
+}
+
+static void crypt_many(const Job *jobs, size_t n, bool decrypt) {
+  constexpr int kLanes = 8;
+  Lane lanes[kLanes];
+  int active = 0;
+  size_t next = 0;
+
+  for (;;) {
+    // Refill free lanes with the next messages
+    while (active < kLanes && next < n) {
+      const Job &job = jobs[next++];
+      if (job.len == 0)
+        continue;
+      Lane &ln = lanes[active++];
+      ln.job = &job;
+      ln.off = 0;
+      Backend::init(ln.ctx, job.key);
+      memcpy(ln.iv, job.key, 16);
+    }
+    if (active == 0)
+      return;
+
+    // Every lane runs until the shortest one is done
+    size_t step = lanes[0].job->len - lanes[0].off;
+    for (int l = 1; l < active; l++)
+      step = std::min(step, lanes[l].job->len - lanes[l].off);
+    for (int l = 0; l < active;) {
+      int left = active - l;
+      if (left >= 8) {
+        crypt_lanes<8>(lanes + l, step, decrypt);
+        l += 8;
+      } else if (left >= 4) {
+        crypt_lanes<4>(lanes + l, step, decrypt);
+        l += 4;
+      } else if (left >= 2) {
+        crypt_lanes<2>(lanes + l, step, decrypt);
+        l += 2;
+      } else {
+        crypt_lanes<1>(lanes + l, step, decrypt);
+        l += 1;
+      }
+    }
+
+    // Drop finished lanes
+    for (int l = 0; l < active;) {
+      if (lanes[l].off == lanes[l].job->len)
+        lanes[l] = lanes[--active];
+      else
+        l++;
+    }
+  }
+}
+
+static void cbc_mac(const uint8_t key[32], uint8_t x[16],
+                    const uint8_t *blocks, size_t nblocks) {
+  Backend::Ctx ctx;
+  Backend::init(ctx, key);
+  mcbe_aes::cbc_mac<Backend>(ctx, x, blocks, nblocks);
+}
+
+extern const Impl MCBE_CFB8_CAT(impl_, MCBE_CFB8_VARIANT);
+const Impl MCBE_CFB8_CAT(impl_, MCBE_CFB8_VARIANT) = {kName, crypt,
+                                                      crypt_many, cbc_mac};
+
+} // namespace mcbe_cfb8
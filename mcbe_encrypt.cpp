@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
+
+#include "mcbe_cfb8.h"
+#include "mcbe_hash.h"
+#include "mcbe_pack.h"
+#include "mcbe_pack_bundle.h"
+#include "mcbe_pack_hashes.h"
+#include "mcbe_perf.h"
+#include "mcbe_progress.h"
+
+namespace fs = std::filesystem;
+
+static std::atomic<bool> g_stop(false);
+
+// Console refresh interval for log lines and the status line
+static constexpr auto REFRESH = std::chrono::milliseconds(100);
+
+static void print_usage() {
+    std::cout
+        << "Usage:\n"
+        << "  mcbe_encrypt <pack.zip> [output_dir] [options]\n"
+        << "  mcbe_encrypt <addon.mcaddon|world.mcworld> [output_dir] [options]\n\n"
+        << "Options:\n"
+        << "  --key <32 chars>       Master key (default: random)\n"
+        << "  --exclude <name>       Copy a root file unencrypted (repeatable)\n"
+        << "  --no-default-excludes  Encrypt manifest.json / pack icons too\n"
+        << "  --deterministic        Reproducible output: derived entry keys, fixed\n"
+        << "                         timestamps and order. Without --key the master\n"
+        << "                         key of an existing <name>.zip.key is reused.\n"
+        << "  --stream-mb <n>        Stream entries of at least n MB in fixed windows\n"
+        << "                         instead of loading them (default: 64)\n"
+        << "  --threads <n>          Worker threads for inflate/AES/deflate\n"
+        << "                         (default: one per core)\n"
+        << "  --no-hashes            Don't write the <name>.zip.hashes plaintext digests\n"
+        << "  --perf-counters        Print cycles, instructions, IPC, LLC misses and\n"
+        << "                         context switches per stage and thread (Linux)\n"
+        << "  --verbose              Also log every file (default: progress line only)\n"
+        << "  --quiet                Only print the summary\n\n"
+        << "Writes <name>_encrypted.zip, <name>.zip.key, <name>.zip.key.info.txt and\n"
+        << "<name>.zip.hashes (BLAKE3 of every entry, for mcbe_verify)\n"
+        << "to output_dir (default: next to the input).\n"
+        << "An .mcaddon/.mcworld is written as <name>_encrypted.<ext> with every inner\n"
+        << "pack encrypted in place, a <pack>.zip.key per pack and <name>.<ext>.key.\n";
+}
+
+static void on_signal(int) {
+    g_stop = true;
+}
+
+// Runs `work` on another thread and prints what it reports through `ch`
+// every REFRESH: queued log lines, then a one-line status on a terminal.
+// Returns (or rethrows) once `work` is done.
+template <typename Fn>
+static auto run_with_progress(mcbe_progress::Channel& ch, bool quiet, Fn work) -> decltype(work()) {
+    auto job = std::async(std::launch::async, work);
+    bool tty = !quiet && isatty(fileno(stdout));
+    size_t statusLen = 0;
+    std::vector<std::string> lines;
+    uint64_t dropped = 0;
+    auto flush = [&]() {
+        lines.clear();
+        ch.drain(lines);
+        mcbe_progress::Snapshot s = ch.snapshot();
+        if (quiet) return;
+        if (statusLen) std::cout << "\r" << std::string(statusLen, ' ') << "\r";
+        statusLen = 0;
+        for (auto const& l : lines) std::cout << "  " << l << "\n";
+        if (s.dropped > dropped) {
+            std::cout << "  (" << s.dropped - dropped << " log lines dropped)\n";
+            dropped = s.dropped;
+        }
+        if (tty && !s.finished && s.total) {
+            std::ostringstream st;
+            st << "  [" << s.phase << "] " << s.done << "/" << s.total << " ("
+               << s.done * 100 / s.total << "%, " << std::fixed << std::setprecision(1) << s.bytes / 1e6
+               << " MB)";
+            statusLen = st.str().size();
+            std::cout << st.str();
+        }
+        std::cout << std::flush;
+    };
+    while (job.wait_for(REFRESH) != std::future_status::ready) flush();
+    ch.finish();
+    flush();
+    return job.get();
+}
+
+int main(int argc, char** argv) {
+    try {
+        std::cout << "[*] MCBE Resource Pack Encryptor (C++)" << std::endl;
+
+        fs::path inputPath;
+        fs::path outputDir;
+        std::string masterKey;
+        std::set<std::string> excluded;
+        bool defaultExcludes = true;
+        bool quiet = false;
+        bool verbose = false;
+        bool deterministic = false;
+        bool perfCounters = false;
+        bool plainHashes = true;
+        uint64_t streamThreshold = mcbe_pack::STREAM_THRESHOLD;
+        unsigned threads = 0;
+
+        for (int i = 1; i < argc; i++) {
+            std::string a = argv[i];
+            if (a == "--key" && i + 1 < argc) {
+                masterKey = argv[++i];
+            } else if (a == "--exclude" && i + 1 < argc) {
+                excluded.insert(argv[++i]);
+            } else if (a == "--no-default-excludes") {
+                defaultExcludes = false;
+            } else if (a == "--deterministic") {
+                deterministic = true;
+            } else if (a == "--stream-mb" && i + 1 < argc) {
+                streamThreshold = std::stoull(argv[++i]) * 1024 * 1024;
+            } else if (a == "--threads" && i + 1 < argc) {
+                threads = (unsigned)std::max(1, std::stoi(argv[++i]));
+            } else if (a == "--no-hashes") {
+                plainHashes = false;
+            } else if (a == "--perf-counters") {
+                perfCounters = true;
+            } else if (a == "--quiet") {
+                quiet = true;
+            } else if (a == "--verbose") {
+                verbose = true;
+            } else if (a == "-h" || a == "--help") {
+                print_usage();
+                return 0;
+            } else if (!a.empty() && a[0] == '-') {
+                std::cerr << "[ERROR] Unknown option: " << a << std::endl;
+                print_usage();
+                return 2;
+            } else if (inputPath.empty()) {
+                inputPath = fs::u8path(a);
+            } else if (outputDir.empty()) {
+                outputDir = fs::u8path(a);
+            } else {
+                print_usage();
+                return 2;
+            }
+        }
+
+        if (inputPath.empty()) {
+            print_usage();
+            return 2;
+        }
+        if (outputDir.empty()) outputDir = inputPath.parent_path();
+        if (outputDir.empty()) outputDir = ".";
+        if (defaultExcludes) {
+            for (auto const& f : mcbe_pack::default_excluded_files()) excluded.insert(f);
+        }
+
+        fs::create_directories(outputDir);
+
+        std::string stem = inputPath.stem().u8string();
+        bool bundle = mcbe_pack::is_bundle_path(inputPath);
+        std::string ext = bundle ? inputPath.extension().u8string() : ".zip";
+        fs::path keyFile = outputDir / fs::u8path(stem + ext + ".key");
+        if (masterKey.empty() && deterministic && fs::exists(keyFile)) {
+            // Same master key as the previous build, otherwise nothing is reproducible
+            masterKey = mcbe_pack::read_key_file(keyFile);
+            std::cout << "[*] Reusing master key from " << keyFile.u8string() << std::endl;
+        }
+        if (masterKey.empty()) masterKey = mcbe_pack::random_key();
+
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
+
+        mcbe_pack::EncryptOptions opts;
+        opts.inputZip = inputPath;
+        opts.outputZip = outputDir / fs::u8path(stem + "_encrypted" + ext);
+        opts.keyFile = keyFile;
+        opts.masterKey = masterKey;
+        opts.excludedFiles = excluded;
+        opts.deterministic = deterministic;
+        opts.streamThreshold = streamThreshold;
+        opts.threads = threads;
+        opts.plainHashes = plainHashes;
+        mcbe_progress::Channel channel;
+        channel.set_file_log(verbose && !quiet);
+        opts.channel = &channel;
+
+        std::cout << "[*] Input: " << inputPath.u8string() << std::endl;
+        std::cout << "[*] Output: " << opts.outputZip.u8string() << std::endl;
+        std::cout << "[*] AES backend: " << mcbe_cfb8::backend_name() << std::endl;
+        if (plainHashes) std::cout << "[*] Hash backend: BLAKE3 " << mcbe_hash::backend_name() << std::endl;
+        if (perfCounters) {
+            std::string why;
+            if (!mcbe_perf::enable(&why)) std::cout << "[*] Perf counters unavailable: " << why << std::endl;
+            else if (!why.empty()) std::cout << "[*] Perf counters: " << why << std::endl;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if (bundle) {
+            auto packs = run_with_progress(channel, quiet,
+                                           [&]() { return mcbe_pack::encrypt_bundle(opts, {}, {}, &g_stop); });
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "[OK] Encrypted " << packs.size() << " pack(s) in " << std::fixed
+                      << std::setprecision(3) << elapsed << "s" << std::endl;
+            for (auto const& p : packs)
+                std::cout << "[*] " << p.source << " -> " << p.keyFile.filename().u8string() << " (UUID "
+                          << p.uuid << ")" << std::endl;
+            if (mcbe_perf::enabled()) {
+                std::cout << "[*] Perf counters (MB/s per thread):" << std::endl;
+                mcbe_perf::print_report(std::cout);
+            }
+            std::cout << "[*] Key file: " << opts.keyFile.u8string() << std::endl;
+            return 0;
+        }
+
+        mcbe_pack::EncryptStats stats;
+        run_with_progress(channel, quiet, [&]() { mcbe_pack::encrypt_pack(opts, {}, {}, &g_stop, &stats); });
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::uintmax_t inBytes = fs::file_size(inputPath);
+        std::cout << "[OK] Encrypted in " << std::fixed << std::setprecision(3) << elapsed << "s"
+                  << " (" << std::setprecision(1) << (elapsed > 0 ? inBytes / elapsed / 1e6 : 0.0)
+                  << " MB/s input)" << std::endl;
+        auto rate = [](uint64_t bytes, double seconds) { return seconds > 0 ? bytes / seconds / 1e6 : 0.0; };
+        std::cout << "[*] Inflate: " << std::setprecision(1) << stats.inflatedBytes / 1e6 << " MB, "
+                  << rate(stats.inflatedBytes, stats.inflateSeconds) << " MB/s per thread ("
+                  << stats.threads << " threads)" << std::endl;
+        std::cout << "[*] AES: " << stats.encryptedBytes / 1e6 << " MB, "
+                  << rate(stats.encryptedBytes, stats.encryptSeconds) << " MB/s per thread" << std::endl;
+        std::cout << "[*] Latency: " << stats.entries << " entries, p50 " << std::setprecision(2)
+                  << stats.p50 * 1e3 << " ms, p99 " << stats.p99 * 1e3 << " ms, max "
+                  << stats.maxLatency * 1e3 << " ms, tail ratio " << stats.tailRatio
+                  << ", idle tail " << std::setprecision(3) << stats.tailSeconds << "s" << std::endl;
+        if (mcbe_perf::enabled()) {
+            std::cout << "[*] Perf counters (MB/s per thread):" << std::endl;
+            mcbe_perf::print_report(std::cout);
+        }
+        std::cout << "[*] Key file: " << opts.keyFile.u8string() << std::endl;
+        if (plainHashes)
+            std::cout << "[*] Hash file: " << mcbe_pack::hash_sidecar_path(opts.keyFile).u8string() << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "\n[ERROR] " << e.what() << std::endl;
+        return 3;
+    }
+}
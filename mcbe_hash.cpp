@@ -0,0 +1,232 @@
+#include "mcbe_hash.h"
+
+#include <cstring>
+#include <thread>
+#include <utility>
+
+namespace mcbe_hash {
+
+extern const Impl impl_native;
+#ifdef MCBE_HASH_HAVE_SSE41
+extern const Impl impl_sse41;
+#endif
+#ifdef MCBE_HASH_HAVE_AVX2
+extern const Impl impl_avx2;
+#endif
+
+static const Impl &detect() {
+#if (defined(__GNUC__) || defined(__clang__)) &&                              \
+    (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+#ifdef MCBE_HASH_HAVE_AVX2
+  if (__builtin_cpu_supports("avx2"))
+    return impl_avx2;
+#endif
+#ifdef MCBE_HASH_HAVE_SSE41
+  if (__builtin_cpu_supports("sse4.1"))
+    return impl_sse41;
+#endif
+#endif
+  return impl_native;
+}
+
+const Impl &select() {
+  static const Impl &impl = detect();
+  return impl;
+}
+
+// Chunks hashed per hash_many() call on the sequential path (64 KiB)
+static constexpr uint64_t GROUP_CHUNKS = 64;
+
+static void parent_cv(const Impl &impl, const uint8_t children[2 * OUT_LEN],
+                      uint8_t out[OUT_LEN]) {
+  const uint8_t *in[1] = {children};
+  impl.hash_many(in, 1, 1, 0, false, PARENT, 0, 0, out);
+}
+
+// Chaining value of the subtree of `chunks` full chunks (a power of two)
+// starting at chunk index `counter` (a multiple of `chunks`)
+static void subtree_cv(const Impl &impl, const uint8_t *data, uint64_t chunks,
+                       uint64_t counter, uint8_t out[OUT_LEN],
+                       unsigned threads) {
+  if (chunks > GROUP_CHUNKS || (threads > 1 && chunks >= 2 &&
+                                chunks * CHUNK_LEN >= PARALLEL_MIN)) {
+    uint64_t half = chunks / 2;
+    uint8_t children[2 * OUT_LEN];
+    const uint8_t *right = data + half * CHUNK_LEN;
+    if (threads > 1 && chunks * CHUNK_LEN >= PARALLEL_MIN) {
+      unsigned left = threads / 2;
+      std::thread t([&]() {
+        subtree_cv(impl, right, half, counter + half, children + OUT_LEN,
+                   threads - left);
+      });
+      subtree_cv(impl, data, half, counter, children, left);
+      t.join();
+    } else {
+      subtree_cv(impl, data, half, counter, children, 1);
+      subtree_cv(impl, right, half, counter + half, children + OUT_LEN, 1);
+    }
+    parent_cv(impl, children, out);
+    return;
+  }
+
+  // Chunks side by side in the SIMD lanes, then each level of parents
+  const uint8_t *in[GROUP_CHUNKS] = {};
+  uint8_t a[GROUP_CHUNKS * OUT_LEN], b[GROUP_CHUNKS / 2 * OUT_LEN];
+  for (uint64_t i = 0; i < chunks; i++)
+    in[i] = data + i * CHUNK_LEN;
+  impl.hash_many(in, (size_t)chunks, CHUNK_LEN / BLOCK_LEN, counter, true, 0,
+                 CHUNK_START, CHUNK_END, a);
+  uint8_t *src = a, *dst = b;
+  for (uint64_t n = chunks; n > 1; n /= 2) {
+    for (uint64_t i = 0; i < n / 2; i++)
+      in[i] = src + i * 2 * OUT_LEN;
+    impl.hash_many(in, (size_t)(n / 2), 1, 0, false, PARENT, 0, 0, dst);
+    std::swap(src, dst);
+  }
+  memcpy(out, src, OUT_LEN);
+}
+
+static void words_to_bytes(const uint32_t w[8], uint8_t out[OUT_LEN]) {
+  for (int i = 0; i < 8; i++) {
+    for (int j = 0; j < 4; j++)
+      out[4 * i + j] = (uint8_t)(w[i] >> (8 * j));
+  }
+}
+
+// ============================================
+// Hasher
+// ============================================
+
+Hasher::Hasher() : impl_(&select()) { memcpy(cv_, IV, sizeof(cv_)); }
+
+// Merges complete sibling subtrees until the stack holds one entry per set
+// bit of `chunks`, the number of chunks it covers
+static void merge_stack(const Impl &impl, uint8_t (*stack)[OUT_LEN],
+                        uint8_t &len, uint64_t chunks) {
+  size_t keep = 0;
+  for (uint64_t c = chunks; c; c &= c - 1)
+    keep++;
+  while (len > keep) {
+    uint8_t children[2 * OUT_LEN];
+    memcpy(children, stack[len - 2], OUT_LEN);
+    memcpy(children + OUT_LEN, stack[len - 1], OUT_LEN);
+    parent_cv(impl, children, stack[len - 2]);
+    len--;
+  }
+}
+
+// `cv` starts at chunk `chunks`. Merging only once more input has arrived
+// keeps the root for final().
+void Hasher::push_cv(const uint8_t cv[OUT_LEN], uint64_t chunks) {
+  merge_stack(*impl_, stack_, stackLen_, chunks);
+  memcpy(stack_[stackLen_++], cv, OUT_LEN);
+}
+
+void Hasher::chunk_update(const uint8_t *data, size_t len) {
+  while (len > 0) {
+    if (bufLen_ == BLOCK_LEN) {
+      // More input follows, so this is not the chunk's last block
+      impl_->compress(cv_, buf_, (uint8_t)BLOCK_LEN, chunk_,
+                      blocksDone_ == 0 ? CHUNK_START : 0);
+      blocksDone_++;
+      bufLen_ = 0;
+    }
+    size_t n = BLOCK_LEN - bufLen_;
+    if (n > len)
+      n = len;
+    memcpy(buf_ + bufLen_, data, n);
+    bufLen_ += (uint8_t)n;
+    data += n;
+    len -= n;
+  }
+}
+
+void Hasher::update(const uint8_t *data, size_t len, unsigned threads) {
+  while (len > 0) {
+    size_t inChunk = blocksDone_ * BLOCK_LEN + bufLen_;
+    if (inChunk == CHUNK_LEN) {
+      impl_->compress(cv_, buf_, (uint8_t)BLOCK_LEN, chunk_,
+                      (blocksDone_ == 0 ? CHUNK_START : 0) | CHUNK_END);
+      uint8_t cv[OUT_LEN];
+      words_to_bytes(cv_, cv);
+      push_cv(cv, chunk_);
+      chunk_++;
+      memcpy(cv_, IV, sizeof(cv_));
+      blocksDone_ = 0;
+      bufLen_ = 0;
+      inChunk = 0;
+    }
+
+    // Whole subtrees straight from the input, as long as something is left
+    // over for the last chunk
+    if (inChunk == 0 && len > CHUNK_LEN) {
+      uint64_t chunks = (len - 1) / CHUNK_LEN;
+      uint64_t n = 1;
+      while (n * 2 <= chunks)
+        n *= 2;
+      while (chunk_ & (n - 1))
+        n /= 2;
+      uint8_t cv[OUT_LEN];
+      subtree_cv(*impl_, data, n, chunk_, cv, threads);
+      push_cv(cv, chunk_);
+      chunk_ += n;
+      data += n * CHUNK_LEN;
+      len -= n * CHUNK_LEN;
+      continue;
+    }
+
+    size_t n = CHUNK_LEN - inChunk;
+    if (n > len)
+      n = len;
+    chunk_update(data, n);
+    data += n;
+    len -= n;
+  }
+}
+
+void Hasher::final(uint8_t out[OUT_LEN]) const {
+  uint8_t stack[MAX_DEPTH][OUT_LEN];
+  uint8_t stackLen = stackLen_;
+  memcpy(stack, stack_, stackLen_ * OUT_LEN);
+  merge_stack(*impl_, stack, stackLen, chunk_);
+
+  uint8_t block[BLOCK_LEN] = {0};
+  memcpy(block, buf_, bufLen_);
+  uint32_t cv[8];
+  memcpy(cv, cv_, sizeof(cv));
+  uint8_t flags = (blocksDone_ == 0 ? CHUNK_START : 0) | CHUNK_END;
+  impl_->compress(cv, block, bufLen_, chunk_, stackLen ? flags : flags | ROOT);
+
+  uint8_t right[OUT_LEN];
+  words_to_bytes(cv, right);
+  for (size_t i = stackLen; i-- > 0;) {
+    memcpy(block, stack[i], OUT_LEN);
+    memcpy(block + OUT_LEN, right, OUT_LEN);
+    memcpy(cv, IV, sizeof(cv));
+    impl_->compress(cv, block, (uint8_t)BLOCK_LEN, 0,
+                    i == 0 ? PARENT | ROOT : PARENT);
+    words_to_bytes(cv, right);
+  }
+  memcpy(out, right, OUT_LEN);
+}
+
+void hash(const uint8_t *data, size_t len, uint8_t out[OUT_LEN],
+          unsigned threads) {
+  Hasher h;
+  h.update(data, len, threads);
+  h.final(out);
+}
+
+std::string to_hex(const uint8_t *digest, size_t len) {
+  static const char *const kHex = "0123456789abcdef";
+  std::string s;
+  s.reserve(len * 2);
+  for (size_t i = 0; i < len; i++) {
+    s.push_back(kHex[digest[i] >> 4]);
+    s.push_back(kHex[digest[i] & 15]);
+  }
+  return s;
+}
+
+} // namespace mcbe_hash
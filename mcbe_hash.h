@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// BLAKE3-256 of plaintext entries, for the .zip.hashes sidecar.
+//
+// BLAKE3 splits its input into 1 KiB chunks, hashes them independently and
+// combines the results in a binary tree, so a run of chunks can be spread
+// over SIMD lanes (4 with SSE4.1, 8 with AVX2) and a large buffer over
+// several threads, and the result is still the standard digest. Like the
+// CFB-8 engine, the compression kernel is compiled once per instruction-set
+// variant (mcbe_hash_impl.cpp) and picked at runtime.
+
+namespace mcbe_hash {
+
+static constexpr size_t OUT_LEN = 32;
+static constexpr size_t BLOCK_LEN = 64;
+static constexpr size_t CHUNK_LEN = 1024;
+
+// Subtree stack of Hasher: enough for 2^54 chunks
+static constexpr size_t MAX_DEPTH = 54;
+
+// Buffers from this size up are split across threads by hash()
+static constexpr size_t PARALLEL_MIN = 4 * 1024 * 1024;
+
+static constexpr uint32_t IV[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372,
+                                   0xA54FF53A, 0x510E527F, 0x9B05688C,
+                                   0x1F83D9AB, 0x5BE0CD19};
+
+enum Flags : uint8_t {
+  CHUNK_START = 1,
+  CHUNK_END = 2,
+  PARENT = 4,
+  ROOT = 8,
+};
+
+struct Impl {
+  const char *name;
+  // Inputs hash_many() processes side by side
+  size_t degree;
+  // One compression; `cv` is replaced by the new chaining value
+  void (*compress)(uint32_t cv[8], const uint8_t block[BLOCK_LEN],
+                   uint8_t blockLen, uint64_t counter, uint8_t flags);
+  // Chaining values of n inputs of `blocks` full blocks each, written to
+  // out + 32 * i. Input i uses counter + i if incrementCounter, else
+  // counter; its first block also gets flagsStart and its last flagsEnd.
+  void (*hash_many)(const uint8_t *const *inputs, size_t n, size_t blocks,
+                    uint64_t counter, bool incrementCounter, uint8_t flags,
+                    uint8_t flagsStart, uint8_t flagsEnd, uint8_t *out);
+};
+
+// Best variant for this CPU (resolved once)
+const Impl &select();
+
+inline const char *backend_name() { return select().name; }
+
+// Incremental hashing: any split of the input gives the same digest
+class Hasher {
+public:
+  Hasher();
+
+  // Up to `threads` threads for the full subtrees of large updates
+  void update(const uint8_t *data, size_t len, unsigned threads = 1);
+  void final(uint8_t out[OUT_LEN]) const;
+
+private:
+  void push_cv(const uint8_t cv[OUT_LEN], uint64_t chunks);
+  void chunk_update(const uint8_t *data, size_t len);
+
+  const Impl *impl_;
+  // Current chunk
+  uint32_t cv_[8];
+  uint8_t buf_[BLOCK_LEN];
+  uint8_t bufLen_ = 0;
+  uint8_t blocksDone_ = 0;
+  uint64_t chunk_ = 0; // index of the current chunk
+  // Chaining values of complete subtrees, largest first
+  uint8_t stack_[MAX_DEPTH][OUT_LEN];
+  uint8_t stackLen_ = 0;
+};
+
+// One-shot digest; buffers from PARALLEL_MIN up use up to `threads` threads
+void hash(const uint8_t *data, size_t len, uint8_t out[OUT_LEN],
+          unsigned threads = 1);
+
+std::string to_hex(const uint8_t *digest, size_t len = OUT_LEN);
+
+} // namespace mcbe_hash
@@ -0,0 +1,356 @@
+// One instruction-set variant of the BLAKE3 compression kernel.
+// Built several times with different -m flags; MCBE_HASH_VARIANT names the
+// exported Impl (impl_native when built with the target's own flags).
+
+#include <cstring>
+
+#include "mcbe_hash.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MCBE_HASH_LANES 8
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define MCBE_HASH_LANES 4
+#else
+#define MCBE_HASH_LANES 1
+#endif
+
+#ifndef MCBE_HASH_VARIANT
+#define MCBE_HASH_VARIANT native
+#endif
+
+// The schedule lookups only fold into constants when the rounds are unrolled
+#if defined(__GNUC__)
+#define MCBE_HASH_UNROLL _Pragma("GCC unroll 7")
+#else
+#define MCBE_HASH_UNROLL
+#endif
+
+#define MCBE_HASH_CAT2(a, b) a##b
+#define MCBE_HASH_CAT(a, b) MCBE_HASH_CAT2(a, b)
+
+namespace mcbe_hash {
+
+// Message word order of each of the 7 rounds
+static const uint8_t SCHEDULE[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+static inline uint32_t load32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+static inline void store32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+// ============================================
+// Portable kernel
+// ============================================
+
+static inline uint32_t rotr(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+static inline void g(uint32_t *s, int a, int b, int c, int d, uint32_t x,
+                     uint32_t y) {
+  s[a] = s[a] + s[b] + x;
+  s[d] = rotr(s[d] ^ s[a], 16);
+  s[c] = s[c] + s[d];
+  s[b] = rotr(s[b] ^ s[c], 12);
+  s[a] = s[a] + s[b] + y;
+  s[d] = rotr(s[d] ^ s[a], 8);
+  s[c] = s[c] + s[d];
+  s[b] = rotr(s[b] ^ s[c], 7);
+}
+
+static void compress(uint32_t cv[8], const uint8_t block[BLOCK_LEN],
+                     uint8_t blockLen, uint64_t counter, uint8_t flags) {
+  uint32_t m[16];
+  for (int i = 0; i < 16; i++)
+    m[i] = load32(block + 4 * i);
+  uint32_t s[16] = {cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+                    IV[0], IV[1], IV[2], IV[3], (uint32_t)counter,
+                    (uint32_t)(counter >> 32), blockLen, flags};
+  MCBE_HASH_UNROLL
+  for (int r = 0; r < 7; r++) {
+    const uint8_t *w = SCHEDULE[r];
+    g(s, 0, 4, 8, 12, m[w[0]], m[w[1]]);
+    g(s, 1, 5, 9, 13, m[w[2]], m[w[3]]);
+    g(s, 2, 6, 10, 14, m[w[4]], m[w[5]]);
+    g(s, 3, 7, 11, 15, m[w[6]], m[w[7]]);
+    g(s, 0, 5, 10, 15, m[w[8]], m[w[9]]);
+    g(s, 1, 6, 11, 12, m[w[10]], m[w[11]]);
+    g(s, 2, 7, 8, 13, m[w[12]], m[w[13]]);
+    g(s, 3, 4, 9, 14, m[w[14]], m[w[15]]);
+  }
+  for (int i = 0; i < 8; i++)
+    cv[i] = s[i] ^ s[i + 8];
+}
+
+static void hash_one(const uint8_t *input, size_t blocks, uint64_t counter,
+                     uint8_t flags, uint8_t flagsStart, uint8_t flagsEnd,
+                     uint8_t out[OUT_LEN]) {
+  uint32_t cv[8];
+  memcpy(cv, IV, sizeof(cv));
+  for (size_t b = 0; b < blocks; b++) {
+    uint8_t f = flags;
+    if (b == 0)
+      f |= flagsStart;
+    if (b + 1 == blocks)
+      f |= flagsEnd;
+    compress(cv, input + b * BLOCK_LEN, (uint8_t)BLOCK_LEN, counter, f);
+  }
+  for (int i = 0; i < 8; i++)
+    store32(out + 4 * i, cv[i]);
+}
+
+// ============================================
+// SIMD kernel: one input per 32-bit lane
+// ============================================
+
+#if MCBE_HASH_LANES == 8
+
+static constexpr const char *kName = "avx2";
+
+struct Vec {
+  using T = __m256i;
+  static constexpr size_t N = 8;
+
+  static T add(T a, T b) { return _mm256_add_epi32(a, b); }
+  static T xor_(T a, T b) { return _mm256_xor_si256(a, b); }
+  static T set1(uint32_t x) { return _mm256_set1_epi32((int)x); }
+  static T loadu(const uint32_t *p) {
+    return _mm256_loadu_si256((const __m256i *)p);
+  }
+  static T rot16(T x) {
+    return _mm256_shuffle_epi8(
+        x, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3,
+                           2, 13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0,
+                           3, 2));
+  }
+  static T rot12(T x) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, 12), _mm256_slli_epi32(x, 20));
+  }
+  static T rot8(T x) {
+    return _mm256_shuffle_epi8(
+        x, _mm256_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2,
+                           1, 12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3,
+                           2, 1));
+  }
+  static T rot7(T x) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, 7), _mm256_slli_epi32(x, 25));
+  }
+
+  // 8x8 transpose of 32-bit words: v[l] word w <-> v[w] word l
+  static void transpose(T v[8]) {
+    T ab0145 = _mm256_unpacklo_epi32(v[0], v[1]);
+    T ab2367 = _mm256_unpackhi_epi32(v[0], v[1]);
+    T cd0145 = _mm256_unpacklo_epi32(v[2], v[3]);
+    T cd2367 = _mm256_unpackhi_epi32(v[2], v[3]);
+    T ef0145 = _mm256_unpacklo_epi32(v[4], v[5]);
+    T ef2367 = _mm256_unpackhi_epi32(v[4], v[5]);
+    T gh0145 = _mm256_unpacklo_epi32(v[6], v[7]);
+    T gh2367 = _mm256_unpackhi_epi32(v[6], v[7]);
+    T abcd04 = _mm256_unpacklo_epi64(ab0145, cd0145);
+    T abcd15 = _mm256_unpackhi_epi64(ab0145, cd0145);
+    T abcd26 = _mm256_unpacklo_epi64(ab2367, cd2367);
+    T abcd37 = _mm256_unpackhi_epi64(ab2367, cd2367);
+    T efgh04 = _mm256_unpacklo_epi64(ef0145, gh0145);
+    T efgh15 = _mm256_unpackhi_epi64(ef0145, gh0145);
+    T efgh26 = _mm256_unpacklo_epi64(ef2367, gh2367);
+    T efgh37 = _mm256_unpackhi_epi64(ef2367, gh2367);
+    v[0] = _mm256_permute2x128_si256(abcd04, efgh04, 0x20);
+    v[1] = _mm256_permute2x128_si256(abcd15, efgh15, 0x20);
+    v[2] = _mm256_permute2x128_si256(abcd26, efgh26, 0x20);
+    v[3] = _mm256_permute2x128_si256(abcd37, efgh37, 0x20);
+    v[4] = _mm256_permute2x128_si256(abcd04, efgh04, 0x31);
+    v[5] = _mm256_permute2x128_si256(abcd15, efgh15, 0x31);
+    v[6] = _mm256_permute2x128_si256(abcd26, efgh26, 0x31);
+    v[7] = _mm256_permute2x128_si256(abcd37, efgh37, 0x31);
+  }
+
+  // m[w] = word w of the block at `off` in every input
+  static void load_msg(const uint8_t *const *in, size_t off, T m[16]) {
+    for (int half = 0; half < 2; half++) {
+      for (int l = 0; l < 8; l++)
+        m[8 * half + l] =
+            _mm256_loadu_si256((const __m256i *)(in[l] + off + 32 * half));
+      transpose(m + 8 * half);
+    }
+  }
+
+  static void store_cv(T h[8], uint8_t *out) {
+    transpose(h);
+    for (int l = 0; l < 8; l++)
+      _mm256_storeu_si256((__m256i *)(out + 32 * l), h[l]);
+  }
+};
+
+#elif MCBE_HASH_LANES == 4
+
+static constexpr const char *kName = "sse4.1";
+
+struct Vec {
+  using T = __m128i;
+  static constexpr size_t N = 4;
+
+  static T add(T a, T b) { return _mm_add_epi32(a, b); }
+  static T xor_(T a, T b) { return _mm_xor_si128(a, b); }
+  static T set1(uint32_t x) { return _mm_set1_epi32((int)x); }
+  static T loadu(const uint32_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+  static T rot16(T x) {
+    return _mm_shuffle_epi8(
+        x, _mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+  }
+  static T rot12(T x) {
+    return _mm_or_si128(_mm_srli_epi32(x, 12), _mm_slli_epi32(x, 20));
+  }
+  static T rot8(T x) {
+    return _mm_shuffle_epi8(
+        x, _mm_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1));
+  }
+  static T rot7(T x) {
+    return _mm_or_si128(_mm_srli_epi32(x, 7), _mm_slli_epi32(x, 25));
+  }
+
+  // 4x4 transpose of 32-bit words
+  static void transpose(T v[4]) {
+    T ab01 = _mm_unpacklo_epi32(v[0], v[1]);
+    T ab23 = _mm_unpackhi_epi32(v[0], v[1]);
+    T cd01 = _mm_unpacklo_epi32(v[2], v[3]);
+    T cd23 = _mm_unpackhi_epi32(v[2], v[3]);
+    v[0] = _mm_unpacklo_epi64(ab01, cd01);
+    v[1] = _mm_unpackhi_epi64(ab01, cd01);
+    v[2] = _mm_unpacklo_epi64(ab23, cd23);
+    v[3] = _mm_unpackhi_epi64(ab23, cd23);
+  }
+
+  static void load_msg(const uint8_t *const *in, size_t off, T m[16]) {
+    for (int q = 0; q < 4; q++) {
+      for (int l = 0; l < 4; l++)
+        m[4 * q + l] = _mm_loadu_si128((const __m128i *)(in[l] + off + 16 * q));
+      transpose(m + 4 * q);
+    }
+  }
+
+  static void store_cv(T h[8], uint8_t *out) {
+    transpose(h);
+    transpose(h + 4);
+    for (int l = 0; l < 4; l++) {
+      _mm_storeu_si128((__m128i *)(out + 32 * l), h[l]);
+      _mm_storeu_si128((__m128i *)(out + 32 * l + 16), h[4 + l]);
+    }
+  }
+};
+
+#else
+
+static constexpr const char *kName = "portable";
+
+#endif
+
+#if MCBE_HASH_LANES > 1
+
+template <typename V>
+static inline void vg(typename V::T *s, int a, int b, int c, int d,
+                      typename V::T x, typename V::T y) {
+  s[a] = V::add(V::add(s[a], s[b]), x);
+  s[d] = V::rot16(V::xor_(s[d], s[a]));
+  s[c] = V::add(s[c], s[d]);
+  s[b] = V::rot12(V::xor_(s[b], s[c]));
+  s[a] = V::add(V::add(s[a], s[b]), y);
+  s[d] = V::rot8(V::xor_(s[d], s[a]));
+  s[c] = V::add(s[c], s[d]);
+  s[b] = V::rot7(V::xor_(s[b], s[c]));
+}
+
+// V::N inputs at once, same block count and flags
+template <typename V>
+static void hash_lanes(const uint8_t *const *in, size_t blocks,
+                       uint64_t counter, bool incrementCounter, uint8_t flags,
+                       uint8_t flagsStart, uint8_t flagsEnd, uint8_t *out) {
+  using T = typename V::T;
+  uint32_t lo[V::N], hi[V::N];
+  for (size_t l = 0; l < V::N; l++) {
+    uint64_t c = counter + (incrementCounter ? l : 0);
+    lo[l] = (uint32_t)c;
+    hi[l] = (uint32_t)(c >> 32);
+  }
+  T ctrLo = V::loadu(lo), ctrHi = V::loadu(hi);
+
+  T h[8];
+  for (int i = 0; i < 8; i++)
+    h[i] = V::set1(IV[i]);
+  for (size_t b = 0; b < blocks; b++) {
+    uint8_t f = flags;
+    if (b == 0)
+      f |= flagsStart;
+    if (b + 1 == blocks)
+      f |= flagsEnd;
+    T m[16];
+    V::load_msg(in, b * BLOCK_LEN, m);
+    T s[16] = {h[0],           h[1],           h[2],
+               h[3],           h[4],           h[5],
+               h[6],           h[7],           V::set1(IV[0]),
+               V::set1(IV[1]), V::set1(IV[2]), V::set1(IV[3]),
+               ctrLo,          ctrHi,          V::set1((uint32_t)BLOCK_LEN),
+               V::set1(f)};
+    MCBE_HASH_UNROLL
+    for (int r = 0; r < 7; r++) {
+      const uint8_t *w = SCHEDULE[r];
+      vg<V>(s, 0, 4, 8, 12, m[w[0]], m[w[1]]);
+      vg<V>(s, 1, 5, 9, 13, m[w[2]], m[w[3]]);
+      vg<V>(s, 2, 6, 10, 14, m[w[4]], m[w[5]]);
+      vg<V>(s, 3, 7, 11, 15, m[w[6]], m[w[7]]);
+      vg<V>(s, 0, 5, 10, 15, m[w[8]], m[w[9]]);
+      vg<V>(s, 1, 6, 11, 12, m[w[10]], m[w[11]]);
+      vg<V>(s, 2, 7, 8, 13, m[w[12]], m[w[13]]);
+      vg<V>(s, 3, 4, 9, 14, m[w[14]], m[w[15]]);
+    }
+    for (int i = 0; i < 8; i++)
+      h[i] = V::xor_(s[i], s[i + 8]);
+  }
+  V::store_cv(h, out);
+}
+
+#endif
+
+static void hash_many(const uint8_t *const *inputs, size_t n, size_t blocks,
+                      uint64_t counter, bool incrementCounter, uint8_t flags,
+                      uint8_t flagsStart, uint8_t flagsEnd, uint8_t *out) {
+#if MCBE_HASH_LANES > 1
+  while (n >= Vec::N) {
+    hash_lanes<Vec>(inputs, blocks, counter, incrementCounter, flags,
+                    flagsStart, flagsEnd, out);
+    inputs += Vec::N;
+    n -= Vec::N;
+    if (incrementCounter)
+      counter += Vec::N;
+    out += Vec::N * OUT_LEN;
+  }
+#endif
+  for (; n > 0; n--) {
+    hash_one(*inputs++, blocks, counter, flags, flagsStart, flagsEnd, out);
+    if (incrementCounter)
+      counter++;
+    out += OUT_LEN;
+  }
+}
+
+extern const Impl MCBE_HASH_CAT(impl_, MCBE_HASH_VARIANT);
+const Impl MCBE_HASH_CAT(impl_, MCBE_HASH_VARIANT) = {
+    kName, MCBE_HASH_LANES, compress, hash_many};
+
+} // namespace mcbe_hash
@@ -0,0 +1,543 @@
+#include "mcbe_inflate.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+namespace mcbe_inflate {
+
+namespace {
+
+// ============================================
+// Decode tables
+// ============================================
+
+// A table entry packs everything the decode loop needs for one codeword:
+//   bits 0-4   bits to consume: codeword + extra bits (SUBTABLE: main bits)
+//   bits 8-11  codeword length (SUBTABLE: subtable index bits)
+//   bits 16-30 length or distance base, literal byte (SUBTABLE: offset)
+//   bit 31     LITERAL, bit 15 EXCEPTIONAL (subtable, end of block, invalid)
+// so a length or distance is value + (bits >> codeword length), taken from
+// the bits consumed in one go.
+constexpr uint32_t LITERAL = 0x80000000u;
+constexpr uint32_t EXCEPTIONAL = 0x8000;
+constexpr uint32_t SUBTABLE = 0x4000;
+constexpr uint32_t END_OF_BLOCK = 0x2000;
+constexpr uint32_t INVALID = EXCEPTIONAL;
+
+// Symbol part of an entry; `extra` sits in the consume field until
+// build_table() adds the codeword length
+constexpr uint32_t make_symbol(uint32_t flags, uint32_t extra, uint32_t value) {
+  return flags | (value << 16) | extra;
+}
+inline uint32_t entry_bits(uint32_t e) { return e & 31; }
+inline uint32_t entry_code_bits(uint32_t e) { return (e >> 8) & 15; }
+inline uint32_t entry_value(uint32_t e) { return (e >> 16) & 0x7FFF; }
+
+constexpr unsigned MAX_CODE_BITS = 15;
+constexpr unsigned NUM_LITLEN = 288;
+constexpr unsigned NUM_DIST = 32;
+constexpr unsigned NUM_PRECODE = 19;
+
+// Main table index widths. Longer codewords continue in a subtable.
+constexpr unsigned LITLEN_BITS = 11;
+constexpr unsigned DIST_BITS = 8;
+constexpr unsigned PRECODE_BITS = 7; // precode lengths are at most 7
+
+// Main table plus at most one subtable (<= 2^(15 - bits) entries) per
+// symbol, which is more than any valid code needs
+constexpr size_t table_size(unsigned bits, unsigned syms) {
+  return ((size_t)1 << bits) + (size_t)syms * ((size_t)1 << (MAX_CODE_BITS - bits));
+}
+
+const uint16_t LENGTH_BASE[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11, 13,
+                                  15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+                                  67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                  2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t DIST_BASE[30] = {1,    2,    3,    4,    5,    7,     9,     13,
+                                17,   25,   33,   49,   65,   97,    129,   193,
+                                257,  385,  513,  769,  1025, 1537,  2049,  3073,
+                                4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+const uint8_t PRECODE_ORDER[NUM_PRECODE] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                            11, 4,  12, 3, 13, 2, 14, 1, 15};
+
+// What each symbol decodes to, without the codeword length
+struct SymbolInfo {
+  uint32_t litlen[NUM_LITLEN];
+  uint32_t dist[NUM_DIST];
+  uint32_t precode[NUM_PRECODE];
+
+  SymbolInfo() {
+    for (unsigned s = 0; s < NUM_LITLEN; s++) {
+      if (s < 256)
+        litlen[s] = make_symbol(LITERAL, 0, s);
+      else if (s == 256)
+        litlen[s] = make_symbol(EXCEPTIONAL | END_OF_BLOCK, 0, 0);
+      else if (s < 286)
+        litlen[s] = make_symbol(0, LENGTH_EXTRA[s - 257], LENGTH_BASE[s - 257]);
+      else
+        litlen[s] = INVALID;
+    }
+    for (unsigned s = 0; s < NUM_DIST; s++)
+      dist[s] = s < 30 ? make_symbol(0, DIST_EXTRA[s], DIST_BASE[s]) : INVALID;
+    for (unsigned s = 0; s < NUM_PRECODE; s++)
+      precode[s] = make_symbol(LITERAL, 0, s);
+  }
+};
+
+const SymbolInfo &symbol_info() {
+  static const SymbolInfo info;
+  return info;
+}
+
+[[noreturn]] void corrupt() {
+  throw std::runtime_error("Corrupt DEFLATE stream.");
+}
+
+inline uint32_t reverse_bits(uint32_t code, unsigned len) {
+  uint32_t r = 0;
+  for (unsigned i = 0; i < len; i++) {
+    r = (r << 1) | (code & 1);
+    code >>= 1;
+  }
+  return r;
+}
+
+// Canonical Huffman code from `lens` -> lookup table indexed by the next
+// `bits` input bits (LSB first). Like zlib, over-subscribed codes are
+// rejected and incomplete ones too, except (unless `strict`) an empty code
+// or a single 1-bit codeword; their unused slots stay INVALID.
+bool build_table(uint32_t *table, unsigned bits, const uint8_t *lens,
+                 unsigned numSyms, const uint32_t *info, bool strict = false) {
+  unsigned count[MAX_CODE_BITS + 1] = {0};
+  for (unsigned s = 0; s < numSyms; s++)
+    count[lens[s]]++;
+  count[0] = 0;
+
+  int left = 1;
+  for (unsigned len = 1; len <= MAX_CODE_BITS; len++) {
+    left = (left << 1) - (int)count[len];
+    if (left < 0)
+      return false;
+  }
+  if (left > 0) {
+    unsigned codes = 0;
+    for (unsigned len = 1; len <= MAX_CODE_BITS; len++)
+      codes += count[len];
+    if (strict || !(codes == 0 || (codes == 1 && count[1] == 1)))
+      return false;
+  }
+
+  uint32_t next[MAX_CODE_BITS + 1];
+  uint32_t code = 0;
+  for (unsigned len = 1; len <= MAX_CODE_BITS; len++) {
+    code = (code + count[len - 1]) << 1;
+    next[len] = code;
+  }
+
+  const uint32_t mainSize = 1u << bits;
+  std::fill(table, table + mainSize, INVALID);
+
+  // Subtable width per main slot: enough for its longest codeword
+  uint16_t rev[NUM_LITLEN];
+  uint8_t subBits[1u << LITLEN_BITS] = {0};
+  for (unsigned s = 0; s < numSyms; s++) {
+    unsigned len = lens[s];
+    if (!len)
+      continue;
+    rev[s] = (uint16_t)reverse_bits(next[len]++, len);
+    if (len > bits) {
+      uint8_t &sb = subBits[rev[s] & (mainSize - 1)];
+      sb = std::max<uint8_t>(sb, (uint8_t)(len - bits));
+    }
+  }
+
+  uint32_t used = mainSize;
+  for (uint32_t p = 0; p < mainSize; p++) {
+    if (!subBits[p])
+      continue;
+    table[p] = EXCEPTIONAL | SUBTABLE | (used << 16) |
+               ((uint32_t)subBits[p] << 8) | bits;
+    std::fill(table + used, table + used + (1u << subBits[p]), INVALID);
+    used += 1u << subBits[p];
+  }
+
+  for (unsigned s = 0; s < numSyms; s++) {
+    unsigned len = lens[s];
+    if (!len)
+      continue;
+    if (len <= bits) {
+      uint32_t e = info[s] == INVALID ? INVALID : info[s] + len + (len << 8);
+      for (uint32_t i = rev[s]; i < mainSize; i += 1u << len)
+        table[i] = e;
+    } else {
+      uint32_t sub = table[rev[s] & (mainSize - 1)];
+      uint32_t *t = table + entry_value(sub);
+      uint32_t subSize = 1u << entry_code_bits(sub);
+      unsigned subLen = len - bits;
+      uint32_t e =
+          info[s] == INVALID ? INVALID : info[s] + subLen + (subLen << 8);
+      for (uint32_t i = (uint32_t)rev[s] >> bits; i < subSize; i += 1u << subLen)
+        t[i] = e;
+    }
+  }
+  return true;
+}
+
+struct Tables {
+  uint32_t litlen[table_size(LITLEN_BITS, NUM_LITLEN)];
+  uint32_t dist[table_size(DIST_BITS, NUM_DIST)];
+  uint32_t precode[1u << PRECODE_BITS];
+};
+
+// Tables of the fixed Huffman code (block type 1), built once
+const Tables &fixed_tables() {
+  static const std::unique_ptr<Tables> tables = []() {
+    std::unique_ptr<Tables> t(new Tables);
+    uint8_t lens[NUM_LITLEN];
+    std::fill(lens, lens + 144, 8);
+    std::fill(lens + 144, lens + 256, 9);
+    std::fill(lens + 256, lens + 280, 7);
+    std::fill(lens + 280, lens + NUM_LITLEN, 8);
+    build_table(t->litlen, LITLEN_BITS, lens, NUM_LITLEN, symbol_info().litlen);
+    std::fill(lens, lens + NUM_DIST, 5);
+    build_table(t->dist, DIST_BITS, lens, NUM_DIST, symbol_info().dist);
+    return t;
+  }();
+  return *tables;
+}
+
+// ============================================
+// Bit reader
+// ============================================
+
+// LSB-first bit buffer refilled a 64-bit word at a time. After refill()
+// at least 56 bits are available. Near the end of the input, missing
+// bytes read as zero; check_end() rejects streams that actually used them.
+class BitReader {
+public:
+  BitReader(const uint8_t *in, size_t len) : p_(in), end_(in + len) {}
+
+  inline void refill() {
+    if (end_ - p_ >= 8) {
+      uint64_t w;
+      memcpy(&w, p_, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      w = __builtin_bswap64(w);
+#endif
+      // Bits above left_ already hold the start of *p_, so OR-ing the same
+      // byte in again at the same position is harmless
+      buf_ |= w << left_;
+      p_ += (63 - left_) >> 3;
+      left_ |= 56;
+    } else {
+      refill_slow();
+    }
+  }
+
+  inline uint32_t peek(unsigned n) const {
+    return (uint32_t)(buf_ & (((uint64_t)1 << n) - 1));
+  }
+  inline void consume(unsigned n) {
+    buf_ >>= n;
+    left_ -= n;
+  }
+  inline uint32_t take(unsigned n) {
+    uint32_t v = peek(n);
+    consume(n);
+    return v;
+  }
+
+  // Stored block: drops the bits up to the next byte boundary and returns
+  // the next `n` input bytes
+  const uint8_t *take_aligned(size_t n) {
+    consume(left_ & 7);
+    size_t buffered = left_ >> 3;
+    if (overread_ > buffered)
+      corrupt();
+    p_ -= buffered - overread_;
+    overread_ = 0;
+    buf_ = 0;
+    left_ = 0;
+    if ((size_t)(end_ - p_) < n)
+      corrupt();
+    const uint8_t *r = p_;
+    p_ += n;
+    return r;
+  }
+
+  inline uint64_t bits() const { return buf_; }
+
+  // refill() can load a whole word
+  inline bool has_word() const { return end_ - p_ >= 8; }
+
+  void check_end() const {
+    if (overread_ > (left_ >> 3))
+      corrupt();
+  }
+
+private:
+  void refill_slow() {
+    while (left_ <= 56) {
+      if (p_ < end_)
+        buf_ |= (uint64_t)*p_++ << left_;
+      else
+        overread_++;
+      left_ += 8;
+    }
+    // A valid stream never needs more than a few bytes of look-ahead
+    if (overread_ > 16)
+      corrupt();
+  }
+
+  const uint8_t *p_;
+  const uint8_t *end_;
+  uint64_t buf_ = 0;
+  unsigned left_ = 0;
+  size_t overread_ = 0;
+};
+
+// ============================================
+// Blocks
+// ============================================
+
+void read_dynamic_header(BitReader &br, Tables &t) {
+  br.refill();
+  unsigned hlit = br.take(5) + 257;
+  unsigned hdist = br.take(5) + 1;
+  unsigned hclen = br.take(4) + 4;
+  if (hlit > 286 || hdist > 30)
+    corrupt();
+
+  uint8_t preLens[NUM_PRECODE] = {0};
+  for (unsigned i = 0; i < hclen; i++) {
+    br.refill();
+    preLens[PRECODE_ORDER[i]] = (uint8_t)br.take(3);
+  }
+  if (!build_table(t.precode, PRECODE_BITS, preLens, NUM_PRECODE,
+                   symbol_info().precode, true))
+    corrupt();
+
+  uint8_t lens[NUM_LITLEN + NUM_DIST] = {0};
+  const unsigned total = hlit + hdist;
+  for (unsigned i = 0; i < total;) {
+    br.refill();
+    uint32_t e = t.precode[br.peek(PRECODE_BITS)];
+    if (!(e & LITERAL))
+      corrupt();
+    br.consume(entry_bits(e));
+    unsigned sym = entry_value(e) & 0xFF;
+    if (sym < 16) {
+      lens[i++] = (uint8_t)sym;
+      continue;
+    }
+    uint8_t val = 0;
+    unsigned rep;
+    if (sym == 16) {
+      if (i == 0)
+        corrupt();
+      val = lens[i - 1];
+      rep = 3 + br.take(2);
+    } else if (sym == 17) {
+      rep = 3 + br.take(3);
+    } else {
+      rep = 11 + br.take(7);
+    }
+    if (i + rep > total)
+      corrupt();
+    memset(lens + i, val, rep);
+    i += rep;
+  }
+  if (lens[256] == 0) // no end-of-block code
+    corrupt();
+
+  uint8_t litLens[NUM_LITLEN] = {0};
+  uint8_t distLens[NUM_DIST] = {0};
+  memcpy(litLens, lens, hlit);
+  memcpy(distLens, lens + hlit, hdist);
+  if (!build_table(t.litlen, LITLEN_BITS, litLens, NUM_LITLEN,
+                   symbol_info().litlen) ||
+      !build_table(t.dist, DIST_BITS, distLens, NUM_DIST, symbol_info().dist))
+    corrupt();
+}
+
+// Copies a match that has at least 8 bytes of output room behind it
+inline void copy_match(uint8_t *out, size_t dist, size_t len) {
+  const uint8_t *src = out - dist;
+  uint8_t *stop = out + len;
+  if (dist < 8) {
+    if (dist == 1) {
+      memset(out, out[-1], len);
+      return;
+    }
+    // Repeat the pattern byte by byte until a whole multiple of it that is
+    // at least 8 bytes long is behind us; from there on the word copies
+    // below read from that far back
+    size_t period = dist * ((8 + dist - 1) / dist);
+    size_t head = std::min(period, len);
+    for (size_t i = 0; i < head; i++)
+      out[i] = src[i];
+    out += head;
+    src = out - period;
+    if (out >= stop)
+      return;
+  }
+  // Eight bytes at a time; may write up to 7 bytes past the match, which
+  // the next literal or match overwrites
+  do {
+    memcpy(out, src, 8);
+    out += 8;
+    src += 8;
+  } while (out < stop);
+}
+
+// Entry for the next codeword, following a subtable pointer (which
+// consumes the main table bits); the codeword itself is not consumed
+inline uint32_t lookup(const uint32_t *table, unsigned bits, BitReader &br) {
+  uint32_t e = table[br.peek(bits)];
+  if (e & SUBTABLE) {
+    br.consume(bits);
+    e = table[entry_value(e) + br.peek(entry_code_bits(e))];
+  }
+  return e;
+}
+
+// Consumes the codeword and extra bits of a length or distance entry
+inline size_t take_value(uint32_t e, BitReader &br) {
+  uint64_t bits = br.bits();
+  br.consume(entry_bits(e));
+  return entry_value(e) +
+         (size_t)((bits & (((uint64_t)1 << entry_bits(e)) - 1)) >>
+                  entry_code_bits(e));
+}
+
+// Worst case output of one fast-loop iteration: two literals, then a
+// 258-byte match plus 7 bytes of word-copy overshoot
+constexpr size_t FAST_OUT_MARGIN = 2 + 258 + 8;
+
+// Decodes one Huffman-coded block. A refill leaves at least 56 bits: up to
+// three literal codewords (45), or a whole length/distance pair (48) when
+// the length comes first.
+void decode_block(BitReader &br, const Tables &t, uint8_t *outBegin,
+                  uint8_t *&out, uint8_t *outEnd) {
+  // Fast loop: input and output are far enough from their ends that no
+  // per-symbol bounds checks are needed
+  while (br.has_word() && (size_t)(outEnd - out) >= FAST_OUT_MARGIN) {
+    br.refill();
+    uint32_t e = lookup(t.litlen, LITLEN_BITS, br);
+    if (e & LITERAL) {
+      br.consume(entry_bits(e));
+      *out++ = (uint8_t)(e >> 16);
+      e = lookup(t.litlen, LITLEN_BITS, br);
+      if (e & LITERAL) {
+        br.consume(entry_bits(e));
+        *out++ = (uint8_t)(e >> 16);
+        e = lookup(t.litlen, LITLEN_BITS, br);
+        if (e & LITERAL) {
+          br.consume(entry_bits(e));
+          *out++ = (uint8_t)(e >> 16);
+          continue;
+        }
+      }
+    }
+    if (e & EXCEPTIONAL) {
+      if (!(e & END_OF_BLOCK))
+        corrupt();
+      br.consume(entry_bits(e));
+      return;
+    }
+    // At least 26 bits were left for the length (<= 20)
+    size_t len = take_value(e, br);
+    br.refill();
+    uint32_t d = lookup(t.dist, DIST_BITS, br);
+    if (d & EXCEPTIONAL)
+      corrupt();
+    size_t dist = take_value(d, br);
+    if (dist > (size_t)(out - outBegin))
+      corrupt();
+    copy_match(out, dist, len);
+    out += len;
+  }
+
+  // Near the end of either buffer: one symbol per refill, everything checked
+  for (;;) {
+    br.refill();
+    uint32_t e = lookup(t.litlen, LITLEN_BITS, br);
+    if (e & LITERAL) {
+      br.consume(entry_bits(e));
+      if (out == outEnd)
+        corrupt();
+      *out++ = (uint8_t)(e >> 16);
+      continue;
+    }
+    if (e & EXCEPTIONAL) {
+      if (!(e & END_OF_BLOCK))
+        corrupt();
+      br.consume(entry_bits(e));
+      return;
+    }
+    size_t len = take_value(e, br);
+    uint32_t d = lookup(t.dist, DIST_BITS, br);
+    if (d & EXCEPTIONAL)
+      corrupt();
+    size_t dist = take_value(d, br);
+
+    size_t room = (size_t)(outEnd - out);
+    if (dist > (size_t)(out - outBegin) || len > room)
+      corrupt();
+    if (room - len >= 8) {
+      copy_match(out, dist, len);
+    } else {
+      const uint8_t *src = out - dist;
+      for (size_t i = 0; i < len; i++)
+        out[i] = src[i];
+    }
+    out += len;
+  }
+}
+
+} // namespace
+
+void inflate(const uint8_t *in, size_t inLen, uint8_t *out, size_t outLen) {
+  BitReader br(in, inLen);
+  uint8_t *const outBegin = out;
+  uint8_t *const outEnd = out + outLen;
+  std::unique_ptr<Tables> dynamic;
+
+  bool final;
+  do {
+    br.refill();
+    final = br.take(1) != 0;
+    unsigned type = br.take(2);
+    if (type == 0) {
+      const uint8_t *hdr = br.take_aligned(4);
+      size_t len = hdr[0] | (size_t)hdr[1] << 8;
+      size_t nlen = hdr[2] | (size_t)hdr[3] << 8;
+      if (len != (~nlen & 0xFFFF) || len > (size_t)(outEnd - out))
+        corrupt();
+      const uint8_t *src = br.take_aligned(len);
+      if (len)
+        memcpy(out, src, len);
+      out += len;
+    } else if (type == 1) {
+      decode_block(br, fixed_tables(), outBegin, out, outEnd);
+    } else if (type == 2) {
+      if (!dynamic)
+        dynamic.reset(new Tables);
+      read_dynamic_header(br, *dynamic);
+      decode_block(br, *dynamic, outBegin, out, outEnd);
+    } else {
+      corrupt();
+    }
+  } while (!final);
+
+  br.check_end();
+  if (out != outEnd)
+    corrupt();
+}
+
+} // namespace mcbe_inflate
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Whole-buffer raw DEFLATE decoder (RFC 1951) in the style of libdeflate.
+//
+// ZIP entries state their uncompressed size up front, so the decoder can
+// write straight into the final buffer: there is no sliding window, no
+// resumable state and no per-call allocation beyond the Huffman tables.
+// Bits are pulled 64 at a time, which leaves enough for a whole
+// length/distance pair (48 bits worst case) per refill, and matches are
+// copied eight bytes at a time where they don't overlap.
+//
+// zlib's streaming inflater is still used for entries that are too large to
+// hold in memory (mcbe_zip::EntryReader).
+
+namespace mcbe_inflate {
+
+// Decodes the raw DEFLATE stream [in, in + inLen) into exactly outLen bytes
+// at `out`. Throws std::runtime_error("Corrupt DEFLATE stream.") if the
+// stream is malformed, reads past inLen or doesn't produce exactly outLen
+// bytes.
+void inflate(const uint8_t *in, size_t inLen, uint8_t *out, size_t outLen);
+
+} // namespace mcbe_inflate
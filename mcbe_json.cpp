@@ -0,0 +1,276 @@
+#include "mcbe_json.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace mcbe_json {
+
+const Value *Value::get(const std::string &key) const {
+  if (type != Type::Object)
+    return nullptr;
+  for (auto const &m : members) {
+    if (m.first == key)
+      return &m.second;
+  }
+  return nullptr;
+}
+
+namespace {
+
+struct Parser {
+  const char *p;
+  const char *end;
+  int depth = 0;
+
+  [[noreturn]] void fail(const char *what) {
+    throw std::runtime_error(std::string("JSON parse error: ") + what);
+  }
+
+  void skip_ws() {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+      p++;
+  }
+
+  bool consume(const char *lit) {
+    const char *q = p;
+    for (; *lit; lit++, q++) {
+      if (q >= end || *q != *lit)
+        return false;
+    }
+    p = q;
+    return true;
+  }
+
+  static void append_utf8(std::string &out, uint32_t cp) {
+    if (cp < 0x80) {
+      out.push_back((char)cp);
+    } else if (cp < 0x800) {
+      out.push_back((char)(0xC0 | (cp >> 6)));
+      out.push_back((char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+      out.push_back((char)(0xE0 | (cp >> 12)));
+      out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+      out.push_back((char)(0x80 | (cp & 0x3F)));
+    } else {
+      out.push_back((char)(0xF0 | (cp >> 18)));
+      out.push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+      out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+      out.push_back((char)(0x80 | (cp & 0x3F)));
+    }
+  }
+
+  uint32_t hex4() {
+    if (end - p < 4)
+      fail("truncated \\u escape");
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++, p++) {
+      char c = *p;
+      v <<= 4;
+      if (c >= '0' && c <= '9')
+        v |= (uint32_t)(c - '0');
+      else if (c >= 'a' && c <= 'f')
+        v |= (uint32_t)(c - 'a' + 10);
+      else if (c >= 'A' && c <= 'F')
+        v |= (uint32_t)(c - 'A' + 10);
+      else
+        fail("bad \\u escape");
+    }
+    return v;
+  }
+
+  std::string parse_string() {
+    // Caller checked the opening quote
+    p++;
+    std::string out;
+    while (true) {
+      if (p >= end)
+        fail("unterminated string");
+      char c = *p++;
+      if (c == '"')
+        break;
+      if (c != '\\') {
+        out.push_back(c);
+        continue;
+      }
+      if (p >= end)
+        fail("unterminated escape");
+      char e = *p++;
+      switch (e) {
+      case '"':
+      case '\\':
+      case '/':
+        out.push_back(e);
+        break;
+      case 'b':
+        out.push_back('\b');
+        break;
+      case 'f':
+        out.push_back('\f');
+        break;
+      case 'n':
+        out.push_back('\n');
+        break;
+      case 'r':
+        out.push_back('\r');
+        break;
+      case 't':
+        out.push_back('\t');
+        break;
+      case 'u': {
+        uint32_t cp = hex4();
+        if (cp >= 0xD800 && cp < 0xDC00 && end - p >= 6 && p[0] == '\\' &&
+            p[1] == 'u') {
+          p += 2;
+          uint32_t lo = hex4();
+          if (lo >= 0xDC00 && lo < 0xE000)
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+        }
+        append_utf8(out, cp);
+        break;
+      }
+      default:
+        fail("bad escape");
+      }
+    }
+    return out;
+  }
+
+  Value parse_value() {
+    if (++depth > 256)
+      fail("nesting too deep");
+    skip_ws();
+    if (p >= end)
+      fail("unexpected end of input");
+
+    Value v;
+    char c = *p;
+    if (c == '{') {
+      p++;
+      v.type = Value::Type::Object;
+      skip_ws();
+      if (p < end && *p == '}') {
+        p++;
+      } else {
+        while (true) {
+          skip_ws();
+          if (p >= end || *p != '"')
+            fail("expected member name");
+          std::string key = parse_string();
+          skip_ws();
+          if (p >= end || *p != ':')
+            fail("expected ':'");
+          p++;
+          v.members.emplace_back(std::move(key), parse_value());
+          skip_ws();
+          if (p < end && *p == ',') {
+            p++;
+            continue;
+          }
+          if (p < end && *p == '}') {
+            p++;
+            break;
+          }
+          fail("expected ',' or '}'");
+        }
+      }
+    } else if (c == '[') {
+      p++;
+      v.type = Value::Type::Array;
+      skip_ws();
+      if (p < end && *p == ']') {
+        p++;
+      } else {
+        while (true) {
+          v.items.push_back(parse_value());
+          skip_ws();
+          if (p < end && *p == ',') {
+            p++;
+            continue;
+          }
+          if (p < end && *p == ']') {
+            p++;
+            break;
+          }
+          fail("expected ',' or ']'");
+        }
+      }
+    } else if (c == '"') {
+      v.type = Value::Type::String;
+      v.str = parse_string();
+    } else if (consume("true")) {
+      v.type = Value::Type::Bool;
+      v.boolean = true;
+    } else if (consume("false")) {
+      v.type = Value::Type::Bool;
+    } else if (consume("null")) {
+      v.type = Value::Type::Null;
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+      const char *start = p;
+      while (p < end && (*p == '-' || *p == '+' || *p == '.' || *p == 'e' ||
+                         *p == 'E' || (*p >= '0' && *p <= '9')))
+        p++;
+      v.type = Value::Type::Number;
+      v.number = std::strtod(std::string(start, p).c_str(), nullptr);
+    } else {
+      fail("unexpected character");
+    }
+    depth--;
+    return v;
+  }
+};
+
+} // namespace
+
+Value parse(const char *begin, const char *end) {
+  Parser ps{begin, end};
+  if (end - begin >= 3 && (uint8_t)begin[0] == 0xEF &&
+      (uint8_t)begin[1] == 0xBB && (uint8_t)begin[2] == 0xBF)
+    ps.p += 3;
+  Value v = ps.parse_value();
+  ps.skip_ws();
+  if (ps.p != ps.end)
+    ps.fail("trailing data");
+  return v;
+}
+
+void append_quoted(std::string &out, const std::string &s) {
+  static const char hex[] = "0123456789abcdef";
+  out.push_back('"');
+  for (unsigned char c : s) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    case '\b':
+      out += "\\b";
+      break;
+    case '\f':
+      out += "\\f";
+      break;
+    default:
+      if (c < 0x20) {
+        out += "\\u00";
+        out.push_back(hex[c >> 4]);
+        out.push_back(hex[c & 0xF]);
+      } else {
+        out.push_back((char)c);
+      }
+    }
+  }
+  out.push_back('"');
+}
+
+} // namespace mcbe_json
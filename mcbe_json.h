@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal JSON reader/writer for manifest.json and contents.json.
+// Only what the pack tools need: a DOM with ordered members, and string
+// escaping that matches Python's json.dumps(..., ensure_ascii=False).
+
+namespace mcbe_json {
+
+struct Value {
+  enum class Type { Null, Bool, Number, String, Array, Object };
+
+  Type type = Type::Null;
+  bool boolean = false;
+  double number = 0.0;
+  std::string str;
+  std::vector<Value> items;
+  std::vector<std::pair<std::string, Value>> members;
+
+  bool is_null() const { return type == Type::Null; }
+  bool is_string() const { return type == Type::String; }
+  bool is_array() const { return type == Type::Array; }
+  bool is_object() const { return type == Type::Object; }
+
+  // Object member lookup, nullptr if missing or not an object
+  const Value *get(const std::string &key) const;
+};
+
+// Throws std::runtime_error on malformed input. A leading UTF-8 BOM is
+// skipped, since Bedrock tooling often writes one into manifest.json.
+Value parse(const char *begin, const char *end);
+
+inline Value parse(const std::string &s) {
+  return parse(s.data(), s.data() + s.size());
+}
+
+// Appends `s` as a quoted JSON string
+void append_quoted(std::string &out, const std::string &s);
+
+} // namespace mcbe_json
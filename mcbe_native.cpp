@@ -0,0 +1,741 @@
+// CPython extension exposing the native AES-256-CFB-8 engine to encrypt.py
+// (and through it to the Tk GUI and the Flask app).
+//
+//   encrypt_bytes(data, key) -> bytes
+//   decrypt_bytes(data, key) -> bytes
+//   encrypt_many([(data, key), ...], threads=0) -> list[bytes]
+//   encrypt_stream(src, dst, key, chunk_size=1 MiB) -> int
+//   derive_entry_key(master_key, path, data) -> str
+//   backend() -> str
+//   plan_pack(path, excluded=(), sorted=False, threads=0) -> dict
+//   ProgressChannel(capacity=4096): log(), set_phase(), add_total(),
+//     advance(), finish(), file_log; snapshot() -> dict, drain() -> list
+//
+// `data` is any buffer-protocol object and is read in place. `key` is a
+// 32-character str or a 32-byte bytes-like object. encrypt_many releases
+// the GIL and spreads the items over native threads. encrypt_stream and
+// derive_entry_key also take binary file objects (anything with read()),
+// which are consumed chunk by chunk so large entries never sit in memory.
+// ProgressChannel is mcbe_progress::Channel: encrypt.py reports into it
+// from the worker thread and the GUI/web UI poll it on a timer. plan_pack
+// is mcbe_pack::plan_pack() on a file, run without the GIL; names come
+// back decoded the way zipfile decodes them.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mcbe_cfb8.h"
+#include "mcbe_pack.h"
+#include "mcbe_pack_plan.h"
+#include "mcbe_progress.h"
+#include "mcbe_zip.h"
+
+namespace {
+
+// Below this much work a batch runs on the calling thread
+constexpr size_t kParallelThreshold = 256 * 1024;
+
+// Read size for file objects
+constexpr Py_ssize_t kStreamChunk = (Py_ssize_t)mcbe_pack::STREAM_WINDOW;
+
+bool get_key(PyObject *obj, uint8_t key[32]) {
+  if (PyUnicode_Check(obj)) {
+    Py_ssize_t n = 0;
+    const char *s = PyUnicode_AsUTF8AndSize(obj, &n);
+    if (!s)
+      return false;
+    if (n != (Py_ssize_t)mcbe_pack::KEY_LEN) {
+      PyErr_SetString(PyExc_ValueError, "key must be exactly 32 bytes");
+      return false;
+    }
+    memcpy(key, s, 32);
+    return true;
+  }
+
+  Py_buffer view;
+  if (PyObject_GetBuffer(obj, &view, PyBUF_SIMPLE) != 0)
+    return false;
+  bool ok = view.len == (Py_ssize_t)mcbe_pack::KEY_LEN;
+  if (ok)
+    memcpy(key, view.buf, 32);
+  else
+    PyErr_SetString(PyExc_ValueError, "key must be exactly 32 bytes");
+  PyBuffer_Release(&view);
+  return ok;
+}
+
+void crypt(const uint8_t key[32], const uint8_t *in, uint8_t *out, size_t len,
+           bool decrypt) {
+  if (decrypt)
+    mcbe_cfb8::decrypt(key, in, out, len);
+  else
+    mcbe_cfb8::encrypt(key, in, out, len);
+}
+
+PyObject *crypt_one(PyObject *args, bool decrypt) {
+  PyObject *dataObj, *keyObj;
+  if (!PyArg_ParseTuple(args, "OO", &dataObj, &keyObj))
+    return nullptr;
+
+  uint8_t key[32];
+  if (!get_key(keyObj, key))
+    return nullptr;
+
+  Py_buffer view;
+  if (PyObject_GetBuffer(dataObj, &view, PyBUF_SIMPLE) != 0)
+    return nullptr;
+
+  PyObject *out = PyBytes_FromStringAndSize(nullptr, view.len);
+  if (out) {
+    uint8_t *dst = (uint8_t *)PyBytes_AS_STRING(out);
+    const uint8_t *src = (const uint8_t *)view.buf;
+    size_t len = (size_t)view.len;
+    if (len >= kParallelThreshold) {
+      Py_BEGIN_ALLOW_THREADS;
+      crypt(key, src, dst, len, decrypt);
+      Py_END_ALLOW_THREADS;
+    } else {
+      crypt(key, src, dst, len, decrypt);
+    }
+  }
+  PyBuffer_Release(&view);
+  return out;
+}
+
+PyObject *py_encrypt_bytes(PyObject *, PyObject *args) {
+  return crypt_one(args, false);
+}
+
+PyObject *py_decrypt_bytes(PyObject *, PyObject *args) {
+  return crypt_one(args, true);
+}
+
+struct Job {
+  Py_buffer view{};
+  uint8_t key[32];
+  uint8_t *out = nullptr;
+};
+
+PyObject *py_encrypt_many(PyObject *, PyObject *args, PyObject *kwargs) {
+  static const char *kwlist[] = {"items", "threads", nullptr};
+  PyObject *itemsObj;
+  int threads = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", (char **)kwlist,
+                                   &itemsObj, &threads))
+    return nullptr;
+
+  PyObject *seq = PySequence_Fast(itemsObj, "items must be a sequence");
+  if (!seq)
+    return nullptr;
+  Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+
+  std::vector<Job> jobs((size_t)n);
+  PyObject *result = PyList_New(n);
+  Py_ssize_t acquired = 0;
+  size_t totalBytes = 0;
+  bool ok = result != nullptr;
+
+  for (Py_ssize_t i = 0; ok && i < n; i++) {
+    PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+    PyObject *dataObj, *keyObj;
+    if (!PyTuple_Check(item) ||
+        !PyArg_ParseTuple(item, "OO", &dataObj, &keyObj)) {
+      PyErr_SetString(PyExc_TypeError, "items must be (data, key) tuples");
+      ok = false;
+      break;
+    }
+    Job &job = jobs[(size_t)i];
+    if (!get_key(keyObj, job.key) ||
+        PyObject_GetBuffer(dataObj, &job.view, PyBUF_SIMPLE) != 0) {
+      ok = false;
+      break;
+    }
+    acquired++;
+
+    PyObject *out = PyBytes_FromStringAndSize(nullptr, job.view.len);
+    if (!out) {
+      ok = false;
+      break;
+    }
+    job.out = (uint8_t *)PyBytes_AS_STRING(out);
+    PyList_SET_ITEM(result, i, out);
+    totalBytes += (size_t)job.view.len;
+  }
+
+  if (ok) {
+    auto run = [&](const Job &job) {
+      mcbe_cfb8::encrypt(job.key, (const uint8_t *)job.view.buf, job.out,
+                         (size_t)job.view.len);
+    };
+
+    unsigned workers = threads > 0 ? (unsigned)threads
+                                   : std::max(1u, std::thread::hardware_concurrency());
+    workers = (unsigned)std::min<size_t>(workers, jobs.size());
+
+    if (workers <= 1 || totalBytes < kParallelThreshold) {
+      for (auto const &job : jobs)
+        run(job);
+    } else {
+      // Largest items first so one big file doesn't end up last
+      std::vector<size_t> order(jobs.size());
+      for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+      std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return jobs[a].view.len > jobs[b].view.len;
+      });
+
+      Py_BEGIN_ALLOW_THREADS;
+      std::atomic<size_t> next(0);
+      std::vector<std::thread> pool;
+      pool.reserve(workers);
+      for (unsigned w = 0; w < workers; w++) {
+        pool.emplace_back([&]() {
+          size_t i;
+          while ((i = next.fetch_add(1)) < order.size())
+            run(jobs[order[i]]);
+        });
+      }
+      for (auto &t : pool)
+        t.join();
+      Py_END_ALLOW_THREADS;
+    }
+  }
+
+  for (Py_ssize_t i = 0; i < acquired; i++)
+    PyBuffer_Release(&jobs[(size_t)i].view);
+  Py_DECREF(seq);
+
+  if (!ok) {
+    Py_XDECREF(result);
+    return nullptr;
+  }
+  return result;
+}
+
+// Calls fn(buf, len) for each src.read(chunk) until it returns b"".
+// Returns false with a Python error set on failure.
+template <class Fn>
+bool for_each_chunk(PyObject *src, Py_ssize_t chunk, Fn &&fn) {
+  for (;;) {
+    PyObject *data = PyObject_CallMethod(src, "read", "n", chunk);
+    if (!data)
+      return false;
+    Py_buffer view;
+    if (PyObject_GetBuffer(data, &view, PyBUF_SIMPLE) != 0) {
+      Py_DECREF(data);
+      return false;
+    }
+    bool ok = view.len == 0 || fn((const uint8_t *)view.buf, (size_t)view.len);
+    bool end = view.len == 0;
+    PyBuffer_Release(&view);
+    Py_DECREF(data);
+    if (!ok || end)
+      return ok;
+  }
+}
+
+PyObject *py_encrypt_stream(PyObject *, PyObject *args, PyObject *kwargs) {
+  static const char *kwlist[] = {"src", "dst", "key", "chunk_size", nullptr};
+  PyObject *src, *dst, *keyObj;
+  Py_ssize_t chunk = kStreamChunk;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|n", (char **)kwlist,
+                                   &src, &dst, &keyObj, &chunk))
+    return nullptr;
+  if (chunk <= 0) {
+    PyErr_SetString(PyExc_ValueError, "chunk_size must be positive");
+    return nullptr;
+  }
+
+  uint8_t key[32];
+  if (!get_key(keyObj, key))
+    return nullptr;
+
+  mcbe_cfb8::Stream cfb(key, false);
+  unsigned long long total = 0;
+  bool ok = for_each_chunk(src, chunk, [&](const uint8_t *in, size_t len) {
+    PyObject *out = PyBytes_FromStringAndSize(nullptr, (Py_ssize_t)len);
+    if (!out)
+      return false;
+    uint8_t *o = (uint8_t *)PyBytes_AS_STRING(out);
+    Py_BEGIN_ALLOW_THREADS;
+    cfb.update(in, o, len);
+    Py_END_ALLOW_THREADS;
+    PyObject *r = PyObject_CallMethod(dst, "write", "O", out);
+    Py_DECREF(out);
+    if (!r)
+      return false;
+    Py_DECREF(r);
+    total += len;
+    return true;
+  });
+  if (!ok)
+    return nullptr;
+  return PyLong_FromUnsignedLongLong(total);
+}
+
+PyObject *py_derive_entry_key(PyObject *, PyObject *args) {
+  PyObject *masterObj, *dataObj;
+  const char *path;
+  Py_ssize_t pathLen;
+  if (!PyArg_ParseTuple(args, "Os#O", &masterObj, &path, &pathLen, &dataObj))
+    return nullptr;
+
+  uint8_t master[32];
+  if (!get_key(masterObj, master))
+    return nullptr;
+
+  mcbe_cfb8::Cmac cmac(master);
+  if (PyObject_HasAttrString(dataObj, "read")) {
+    bool ok = for_each_chunk(dataObj, kStreamChunk,
+                             [&](const uint8_t *in, size_t len) {
+                               Py_BEGIN_ALLOW_THREADS;
+                               cmac.update(in, len);
+                               Py_END_ALLOW_THREADS;
+                               return true;
+                             });
+    if (!ok)
+      return nullptr;
+  } else {
+    Py_buffer view;
+    if (PyObject_GetBuffer(dataObj, &view, PyBUF_SIMPLE) != 0)
+      return nullptr;
+    Py_BEGIN_ALLOW_THREADS;
+    cmac.update((const uint8_t *)view.buf, (size_t)view.len);
+    Py_END_ALLOW_THREADS;
+    PyBuffer_Release(&view);
+  }
+
+  uint8_t mac[16];
+  cmac.final(mac);
+  std::string key = mcbe_pack::derive_entry_key(
+      std::string((const char *)master, 32), std::string(path, (size_t)pathLen),
+      mac);
+  return PyUnicode_FromStringAndSize(key.data(), (Py_ssize_t)key.size());
+}
+
+PyObject *py_backend(PyObject *, PyObject *) {
+  return PyUnicode_FromString(mcbe_cfb8::backend_name());
+}
+
+// ============================================
+// plan_pack
+// ============================================
+
+// General-purpose bit 11: the name is UTF-8 (cp437 otherwise)
+constexpr uint16_t kUtf8NameFlag = 0x800;
+
+// zipfile cuts names at NUL and turns '\\' into '/' on Windows, so such a
+// name would not match what encrypt.py reads back. Sorted plans also need
+// byte order to be code point order, which cp437 names above 0x7F break.
+bool differs_from_zipfile(const mcbe_zip::ZipEntry &e, bool sorted) {
+  const std::string &n = e.name;
+#ifdef _WIN32
+  if (n.find('\\') != std::string::npos)
+    return true;
+#endif
+  if (n.find('\0') != std::string::npos)
+    return true;
+  return sorted && !(e.flags & kUtf8NameFlag) &&
+         std::any_of(n.begin(), n.end(), [](char c) { return c & 0x80; });
+}
+
+// Entry names as str, decoded once each and owned by the cache
+class NameCache {
+public:
+  explicit NameCache(const mcbe_zip::ZipReader &z)
+      : base_(z.entries().data()), names_(z.entries().size(), nullptr) {}
+  ~NameCache() {
+    for (PyObject *o : names_)
+      Py_XDECREF(o);
+  }
+  NameCache(const NameCache &) = delete;
+  NameCache &operator=(const NameCache &) = delete;
+
+  // Borrowed reference, nullptr with an exception set on a bad name
+  PyObject *get(const mcbe_zip::ZipEntry *e) {
+    PyObject *&o = names_[(size_t)(e - base_)];
+    if (!o) {
+      const std::string &n = e->name;
+      o = (e->flags & kUtf8NameFlag)
+              ? PyUnicode_DecodeUTF8(n.data(), (Py_ssize_t)n.size(), "strict")
+              : PyUnicode_Decode(n.data(), (Py_ssize_t)n.size(), "cp437",
+                                 "strict");
+    }
+    return o;
+  }
+
+private:
+  const mcbe_zip::ZipEntry *base_;
+  std::vector<PyObject *> names_;
+};
+
+PyObject *plan_to_dict(const mcbe_zip::ZipReader &z,
+                       const mcbe_pack::PackPlan &plan, PyObject *excluded) {
+  NameCache names(z);
+  PyObject *dirs = nullptr, *roots = nullptr, *subs = nullptr,
+           *copied = nullptr, *uuid = nullptr;
+
+  dirs = PyTuple_New((Py_ssize_t)plan.directories.size());
+  roots = PyTuple_New((Py_ssize_t)plan.rootFiles.size());
+  subs = PyTuple_New((Py_ssize_t)plan.subpacks.size());
+  copied = PyList_New(0);
+  uuid = PyUnicode_DecodeUTF8(plan.uuid.data(), (Py_ssize_t)plan.uuid.size(),
+                              "replace");
+  if (!dirs || !roots || !subs || !copied || !uuid)
+    goto fail;
+
+  for (size_t i = 0; i < plan.directories.size(); i++) {
+    PyObject *n = names.get(plan.directories[i]);
+    if (!n)
+      goto fail;
+    Py_INCREF(n);
+    PyTuple_SET_ITEM(dirs, (Py_ssize_t)i, n);
+  }
+
+  // Exclusion is decided on the decoded names, as encrypt.py compares them
+  for (size_t i = 0; i < plan.rootFiles.size(); i++) {
+    const mcbe_zip::ZipEntry *e = plan.rootFiles[i].entry;
+    PyObject *n = names.get(e);
+    int copy = n ? PySet_Contains(excluded, n) : -1;
+    if (copy < 0)
+      goto fail;
+    if (copy && PyList_Append(copied, n) < 0)
+      goto fail;
+    PyObject *item = Py_BuildValue("(OKO)", n,
+                                   (unsigned long long)e->uncompressedSize,
+                                   copy ? Py_True : Py_False);
+    if (!item)
+      goto fail;
+    PyTuple_SET_ITEM(roots, (Py_ssize_t)i, item);
+  }
+
+  for (size_t i = 0; i < plan.subpacks.size(); i++) {
+    const mcbe_pack::SubpackPlan &sp = plan.subpacks[i];
+    PyObject *root = names.get(sp.entry);
+    if (!root)
+      goto fail;
+    PyObject *files = PyTuple_New((Py_ssize_t)sp.files.size());
+    if (!files)
+      goto fail;
+    for (size_t j = 0; j < sp.files.size(); j++) {
+      PyObject *n = names.get(sp.files[j]);
+      PyObject *item =
+          n ? Py_BuildValue("(OK)", n,
+                            (unsigned long long)sp.files[j]->uncompressedSize)
+            : nullptr;
+      if (!item) {
+        Py_DECREF(files);
+        goto fail;
+      }
+      PyTuple_SET_ITEM(files, (Py_ssize_t)j, item);
+    }
+    PyObject *item = Py_BuildValue("(ON)", root, files);
+    if (!item)
+      goto fail;
+    PyTuple_SET_ITEM(subs, (Py_ssize_t)i, item);
+  }
+
+  {
+    PyObject *copiedTuple = PyList_AsTuple(copied);
+    Py_DECREF(copied);
+    if (!copiedTuple) {
+      copied = nullptr;
+      goto fail;
+    }
+    return Py_BuildValue(
+        "{s:N,s:O,s:N,s:N,s:N,s:N,s:n,s:n,s:K}", "uuid", uuid, "sorted",
+        plan.sorted ? Py_True : Py_False, "directories", dirs, "root_files",
+        roots, "subpacks", subs, "excluded", copiedTuple, "files",
+        (Py_ssize_t)plan.files, "total", (Py_ssize_t)plan.total, "bytes",
+        (unsigned long long)plan.bytes);
+  }
+
+fail:
+  Py_XDECREF(dirs);
+  Py_XDECREF(roots);
+  Py_XDECREF(subs);
+  Py_XDECREF(copied);
+  Py_XDECREF(uuid);
+  return nullptr;
+}
+
+PyObject *py_plan_pack(PyObject *, PyObject *args, PyObject *kwargs) {
+  static const char *kwlist[] = {"path", "excluded", "sorted", "threads",
+                                 nullptr};
+  PyObject *pathObj = nullptr, *excludedObj = nullptr;
+  int sorted = 0;
+  unsigned int threads = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&|OpI", (char **)kwlist,
+                                   PyUnicode_FSConverter, &pathObj,
+                                   &excludedObj, &sorted, &threads))
+    return nullptr;
+  // Filesystem encoding: raw bytes on POSIX, UTF-8 on Windows
+  std::filesystem::path path =
+      std::filesystem::u8path(std::string(PyBytes_AS_STRING(pathObj),
+                                          (size_t)PyBytes_GET_SIZE(pathObj)));
+  Py_DECREF(pathObj);
+
+  PyObject *excluded = PyFrozenSet_New(excludedObj);
+  if (!excluded)
+    return nullptr;
+
+  mcbe_zip::ZipReader z;
+  mcbe_pack::PackPlan plan;
+  std::string error;
+  bool differs = false;
+  Py_BEGIN_ALLOW_THREADS;
+  try {
+    z.open(path);
+    plan = mcbe_pack::plan_pack(z, {}, sorted != 0, threads);
+    for (auto const &e : z.entries())
+      differs = differs || differs_from_zipfile(e, sorted != 0);
+  } catch (const std::exception &e) {
+    error = e.what();
+    if (error.empty())
+      error = "plan_pack failed";
+  }
+  Py_END_ALLOW_THREADS;
+
+  PyObject *result = nullptr;
+  if (!error.empty())
+    PyErr_SetString(PyExc_RuntimeError, error.c_str());
+  else if (differs)
+    PyErr_SetString(PyExc_ValueError,
+                    "archive has entry names that zipfile reads differently");
+  else
+    result = plan_to_dict(z, plan, excluded);
+  Py_DECREF(excluded);
+  return result;
+}
+
+// ============================================
+// ProgressChannel
+// ============================================
+
+struct ChannelObject {
+  PyObject_HEAD
+  mcbe_progress::Channel *ch;
+};
+
+PyObject *channel_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+  static const char *kwlist[] = {"capacity", nullptr};
+  Py_ssize_t capacity = (Py_ssize_t)mcbe_progress::DEFAULT_CAPACITY;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|n", (char **)kwlist,
+                                   &capacity))
+    return nullptr;
+  if (capacity <= 0 || capacity > (1 << 20)) {
+    PyErr_SetString(PyExc_ValueError, "capacity must be in 1..1048576");
+    return nullptr;
+  }
+  ChannelObject *self = (ChannelObject *)type->tp_alloc(type, 0);
+  if (!self)
+    return nullptr;
+  self->ch = new (std::nothrow) mcbe_progress::Channel((size_t)capacity);
+  if (!self->ch) {
+    Py_DECREF(self);
+    return PyErr_NoMemory();
+  }
+  return (PyObject *)self;
+}
+
+void channel_dealloc(PyObject *obj) {
+  delete ((ChannelObject *)obj)->ch;
+  Py_TYPE(obj)->tp_free(obj);
+}
+
+mcbe_progress::Channel &channel_of(PyObject *obj) {
+  return *((ChannelObject *)obj)->ch;
+}
+
+PyObject *channel_log(PyObject *self, PyObject *args) {
+  const char *line;
+  Py_ssize_t len;
+  if (!PyArg_ParseTuple(args, "s#", &line, &len))
+    return nullptr;
+  channel_of(self).log(std::string(line, (size_t)len));
+  Py_RETURN_NONE;
+}
+
+PyObject *channel_set_phase(PyObject *self, PyObject *args) {
+  const char *phase;
+  Py_ssize_t len;
+  if (!PyArg_ParseTuple(args, "s#", &phase, &len))
+    return nullptr;
+  channel_of(self).set_phase(std::string(phase, (size_t)len));
+  Py_RETURN_NONE;
+}
+
+PyObject *channel_add_total(PyObject *self, PyObject *args) {
+  unsigned long long n;
+  if (!PyArg_ParseTuple(args, "K", &n))
+    return nullptr;
+  channel_of(self).add_total(n);
+  Py_RETURN_NONE;
+}
+
+PyObject *channel_advance(PyObject *self, PyObject *args, PyObject *kwargs) {
+  static const char *kwlist[] = {"files", "bytes", nullptr};
+  unsigned long long files = 1, bytes = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|KK", (char **)kwlist,
+                                   &files, &bytes))
+    return nullptr;
+  channel_of(self).advance(files, bytes);
+  Py_RETURN_NONE;
+}
+
+PyObject *channel_finish(PyObject *self, PyObject *) {
+  channel_of(self).finish();
+  Py_RETURN_NONE;
+}
+
+PyObject *channel_snapshot(PyObject *self, PyObject *) {
+  mcbe_progress::Snapshot s = channel_of(self).snapshot();
+  return Py_BuildValue(
+      "{s:K,s:K,s:K,s:N,s:K,s:K,s:O}", "done", (unsigned long long)s.done,
+      "total", (unsigned long long)s.total, "bytes",
+      (unsigned long long)s.bytes, "phase",
+      PyUnicode_DecodeUTF8(s.phase.data(), (Py_ssize_t)s.phase.size(),
+                           "replace"),
+      "pending", (unsigned long long)s.pending, "dropped",
+      (unsigned long long)s.dropped, "finished",
+      s.finished ? Py_True : Py_False);
+}
+
+PyObject *channel_drain(PyObject *self, PyObject *args, PyObject *kwargs) {
+  static const char *kwlist[] = {"max", nullptr};
+  Py_ssize_t max = -1;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|n", (char **)kwlist, &max))
+    return nullptr;
+  std::vector<std::string> lines;
+  channel_of(self).drain(lines, max < 0 ? SIZE_MAX : (size_t)max);
+  PyObject *list = PyList_New((Py_ssize_t)lines.size());
+  if (!list)
+    return nullptr;
+  for (size_t i = 0; i < lines.size(); i++) {
+    PyObject *line = PyUnicode_DecodeUTF8(
+        lines[i].data(), (Py_ssize_t)lines[i].size(), "replace");
+    if (!line) {
+      Py_DECREF(list);
+      return nullptr;
+    }
+    PyList_SET_ITEM(list, (Py_ssize_t)i, line);
+  }
+  return list;
+}
+
+PyObject *channel_get_file_log(PyObject *self, void *) {
+  return PyBool_FromLong(channel_of(self).file_log());
+}
+
+int channel_set_file_log(PyObject *self, PyObject *value, void *) {
+  int on = value ? PyObject_IsTrue(value) : 0;
+  if (on < 0)
+    return -1;
+  channel_of(self).set_file_log(on != 0);
+  return 0;
+}
+
+PyMethodDef kChannelMethods[] = {
+    {"log", channel_log, METH_VARARGS,
+     "log(line)\n\nQueues a log line; dropped (and counted) if the ring is "
+     "full."},
+    {"set_phase", channel_set_phase, METH_VARARGS, "set_phase(name)"},
+    {"add_total", channel_add_total, METH_VARARGS,
+     "add_total(n)\n\nAdds n to the expected number of files."},
+    {"advance", (PyCFunction)(void (*)(void))channel_advance,
+     METH_VARARGS | METH_KEYWORDS, "advance(files=1, bytes=0)"},
+    {"finish", channel_finish, METH_NOARGS, "finish()"},
+    {"snapshot", channel_snapshot, METH_NOARGS,
+     "snapshot() -> dict\n\n"
+     "done, total, bytes, phase, pending, dropped, finished."},
+    {"drain", (PyCFunction)(void (*)(void))channel_drain,
+     METH_VARARGS | METH_KEYWORDS,
+     "drain(max=-1) -> list[str]\n\nTakes up to max queued log lines."},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyGetSetDef kChannelGetSet[] = {
+    {"file_log", channel_get_file_log, channel_set_file_log,
+     "Whether per-file log lines are wanted", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+PyTypeObject kChannelType = [] {
+  // Zeroed and filled in by name; PyVarObject_HEAD_INIT in a braced list
+  // leaves the other ~45 slots to -Wmissing-field-initializers
+  PyTypeObject t{};
+  Py_SET_REFCNT(&t, 1);
+  t.tp_name = "mcbe_native.ProgressChannel";
+  t.tp_basicsize = sizeof(ChannelObject);
+  t.tp_flags = Py_TPFLAGS_DEFAULT;
+  t.tp_doc = "ProgressChannel(capacity=4096)\n\n"
+             "Lock-free progress counters and log ring shared between an "
+             "encryption\nthread and a UI that polls it.";
+  t.tp_new = channel_new;
+  t.tp_dealloc = channel_dealloc;
+  t.tp_methods = kChannelMethods;
+  t.tp_getset = kChannelGetSet;
+  return t;
+}();
+
+PyMethodDef kMethods[] = {
+    {"encrypt_bytes", py_encrypt_bytes, METH_VARARGS,
+     "encrypt_bytes(data, key) -> bytes\n\nAES-256-CFB-8, IV = key[:16]."},
+    {"decrypt_bytes", py_decrypt_bytes, METH_VARARGS,
+     "decrypt_bytes(data, key) -> bytes"},
+    {"encrypt_many", (PyCFunction)(void (*)(void))py_encrypt_many,
+     METH_VARARGS | METH_KEYWORDS,
+     "encrypt_many(items, threads=0) -> list[bytes]\n\n"
+     "Encrypts [(data, key), ...] on native threads without the GIL."},
+    {"encrypt_stream", (PyCFunction)(void (*)(void))py_encrypt_stream,
+     METH_VARARGS | METH_KEYWORDS,
+     "encrypt_stream(src, dst, key, chunk_size=1048576) -> int\n\n"
+     "Encrypts src.read() chunks into dst.write(); returns the byte count."},
+    {"derive_entry_key", py_derive_entry_key, METH_VARARGS,
+     "derive_entry_key(master_key, path, data) -> str\n\n"
+     "Deterministic 32-character entry key (AES-CMAC KDF).\n"
+     "data may be bytes-like or a binary file object."},
+    {"backend", py_backend, METH_NOARGS,
+     "backend() -> str\n\nName of the AES implementation in use."},
+    {"plan_pack", (PyCFunction)(void (*)(void))py_plan_pack,
+     METH_VARARGS | METH_KEYWORDS,
+     "plan_pack(path, excluded=(), sorted=False, threads=0) -> dict\n\n"
+     "One pass over the central directory: uuid, directories, root_files\n"
+     "((name, size, copy), ...), subpacks ((root, ((name, size), ...)),\n"
+     "...), excluded, files, total (progress steps) and bytes."},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyModuleDef kModule = {PyModuleDef_HEAD_INIT,
+                       "mcbe_native",
+                       "Native AES-256-CFB-8 engine for MCBE resource packs.",
+                       -1,
+                       kMethods,
+                       nullptr,
+                       nullptr,
+                       nullptr,
+                       nullptr};
+
+} // namespace
+
+PyMODINIT_FUNC PyInit_mcbe_native(void) {
+  if (PyType_Ready(&kChannelType) < 0)
+    return nullptr;
+  PyObject *m = PyModule_Create(&kModule);
+  if (!m)
+    return nullptr;
+  Py_INCREF(&kChannelType);
+  if (PyModule_AddObject(m, "ProgressChannel", (PyObject *)&kChannelType) <
+      0) {
+    Py_DECREF(&kChannelType);
+    Py_DECREF(m);
+    return nullptr;
+  }
+  return m;
+}
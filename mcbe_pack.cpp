@@ -0,0 +1,599 @@
+#include "mcbe_pack.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+#include "mcbe_cfb8.h"
+#include "mcbe_hash.h"
+#include "mcbe_json.h"
+#include "mcbe_perf.h"
+#include "mcbe_pack_hashes.h"
+#include "mcbe_pack_pipeline.h"
+#include "mcbe_pack_plan.h"
+
+namespace mcbe_pack {
+
+using mcbe_zip::ZipEntry;
+using mcbe_zip::ZipReader;
+using mcbe_zip::ZipWriter;
+
+static const char KEY_ALPHABET[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+
+const std::set<std::string> &default_excluded_files() {
+  static const std::set<std::string> files = {"manifest.json", "pack_icon.png",
+                                              "bug_pack_icon.png"};
+  return files;
+}
+
+std::string random_key() {
+  static thread_local std::random_device rd;
+  std::uniform_int_distribution<size_t> dist(0, sizeof(KEY_ALPHABET) - 2);
+  std::string k(KEY_LEN, '\0');
+  for (size_t i = 0; i < KEY_LEN; i++)
+    k[i] = KEY_ALPHABET[dist(rd)];
+  return k;
+}
+
+static void check_master_key(const std::string &masterKey) {
+  if (masterKey.size() != KEY_LEN)
+    throw std::runtime_error("Master key must be exactly " +
+                             std::to_string(KEY_LEN) + " characters.");
+}
+
+std::string derive_entry_key(const std::string &masterKey,
+                             const std::string &path, const uint8_t *data,
+                             size_t len) {
+  check_master_key(masterKey);
+  uint8_t digest[16];
+  mcbe_cfb8::cmac((const uint8_t *)masterKey.data(), data, len, digest);
+  return derive_entry_key(masterKey, path, digest);
+}
+
+std::string derive_entry_key(const std::string &masterKey,
+                             const std::string &path,
+                             const uint8_t digest[16]) {
+  check_master_key(masterKey);
+  const uint8_t *mk = (const uint8_t *)masterKey.data();
+
+  static const char kLabel[] = "MCBE-KDF1";
+  std::vector<uint8_t> info(kLabel, kLabel + sizeof(kLabel)); // keeps the NUL
+  info.insert(info.end(), path.begin(), path.end());
+  info.push_back(0);
+  info.insert(info.end(), digest, digest + 16);
+
+  uint8_t block[17];
+  mcbe_cfb8::cmac(mk, info.data(), info.size(), block);
+
+  std::string key;
+  key.reserve(KEY_LEN);
+  const size_t alphabet = sizeof(KEY_ALPHABET) - 1;
+  for (uint8_t counter = 0; key.size() < KEY_LEN; counter++) {
+    uint8_t out[16];
+    block[16] = counter;
+    mcbe_cfb8::cmac(mk, block, 17, out);
+    for (int i = 0; i < 16 && key.size() < KEY_LEN; i++) {
+      if (out[i] < 248)
+        key.push_back(KEY_ALPHABET[out[i] % alphabet]);
+    }
+  }
+  return key;
+}
+
+std::string read_key_file(const fs::path &p) {
+  std::ifstream f(p, std::ios::binary);
+  if (!f)
+    throw std::runtime_error("Failed to open key file: " + p.u8string());
+  std::string key((std::istreambuf_iterator<char>(f)),
+                  std::istreambuf_iterator<char>());
+  while (!key.empty() && isspace((unsigned char)key.back()))
+    key.pop_back();
+  if (key.size() != KEY_LEN)
+    throw std::runtime_error("Key file does not hold a " +
+                             std::to_string(KEY_LEN) +
+                             "-character master key: " + p.u8string());
+  return key;
+}
+
+static void check_key(const std::string &key) {
+  if (key.size() != KEY_LEN)
+    throw std::runtime_error("Key must be exactly " + std::to_string(KEY_LEN) +
+                             " bytes.");
+}
+
+std::vector<uint8_t> encrypt_bytes(const uint8_t *data, size_t len,
+                                   const std::string &key) {
+  check_key(key);
+  std::vector<uint8_t> out(len);
+  mcbe_cfb8::encrypt((const uint8_t *)key.data(), data, out.data(), len);
+  return out;
+}
+
+std::vector<uint8_t> decrypt_bytes(const uint8_t *data, size_t len,
+                                   const std::string &key) {
+  check_key(key);
+  std::vector<uint8_t> out(len);
+  mcbe_cfb8::decrypt((const uint8_t *)key.data(), data, out.data(), len);
+  return out;
+}
+
+// Same layout as json.dumps({"content": entries}, ensure_ascii=False)
+static std::string contents_document(const std::vector<ContentEntry> &entries) {
+  std::string doc = "{\"content\": [";
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (i)
+      doc += ", ";
+    doc += "{\"path\": ";
+    mcbe_json::append_quoted(doc, entries[i].path);
+    doc += ", \"key\": ";
+    if (entries[i].key.empty())
+      doc += "null";
+    else
+      mcbe_json::append_quoted(doc, entries[i].key);
+    doc += "}";
+  }
+  doc += "]}";
+  return doc;
+}
+
+std::vector<uint8_t> build_contents_json(const std::string &contentId,
+                                         const std::string &masterKey,
+                                         const std::vector<ContentEntry> &entries) {
+  // Length byte at 0x10, the id itself from 0x11 to the end of the header
+  if (contentId.size() > HEADER_SIZE - 0x11)
+    throw std::runtime_error("ContentId too long (>" +
+                             std::to_string(HEADER_SIZE - 0x11) + " bytes).");
+
+  std::vector<uint8_t> meta(HEADER_SIZE, 0);
+  memcpy(meta.data(), VERSION, 4);
+  memcpy(meta.data() + 4, MAGIC, 4);
+  meta[0x10] = (uint8_t)contentId.size();
+  memcpy(meta.data() + 0x11, contentId.data(), contentId.size());
+
+  std::string doc = contents_document(entries);
+  std::vector<uint8_t> enc =
+      encrypt_bytes((const uint8_t *)doc.data(), doc.size(), masterKey);
+  meta.insert(meta.end(), enc.begin(), enc.end());
+  return meta;
+}
+
+bool is_contents_json_header(const uint8_t *data, size_t len) {
+  if (len < HEADER_SIZE)
+    return false;
+  return memcmp(data + 4, MAGIC, 4) == 0;
+}
+
+ContentsJson parse_contents_json(const uint8_t *data, size_t len,
+                                 const std::string &masterKey) {
+  if (!is_contents_json_header(data, len))
+    throw std::runtime_error("Not an encrypted contents.json (MAGIC mismatch).");
+
+  ContentsJson out;
+  size_t idLen = data[0x10];
+  if (0x11 + idLen > HEADER_SIZE)
+    throw std::runtime_error("Corrupt contents.json header.");
+  out.contentId.assign((const char *)data + 0x11, idLen);
+
+  std::vector<uint8_t> doc =
+      decrypt_bytes(data + HEADER_SIZE, len - HEADER_SIZE, masterKey);
+  mcbe_json::Value root;
+  try {
+    root = mcbe_json::parse((const char *)doc.data(),
+                            (const char *)doc.data() + doc.size());
+  } catch (const std::exception &) {
+    throw std::runtime_error("contents.json does not decrypt (wrong master key?).");
+  }
+
+  const mcbe_json::Value *content = root.get("content");
+  if (!content || !content->is_array())
+    throw std::runtime_error("contents.json has no \"content\" array.");
+  out.entries.reserve(content->items.size());
+  for (auto const &item : content->items) {
+    const mcbe_json::Value *path = item.get("path");
+    const mcbe_json::Value *key = item.get("key");
+    if (!path || !path->is_string())
+      continue;
+    ContentEntry ce{path->str, ""};
+    if (key && key->is_string())
+      ce.key = key->str;
+    // An empty key marks a file copied as is; anything else is an AES key
+    if (!ce.key.empty() && ce.key.size() != KEY_LEN)
+      throw std::runtime_error("contents.json key for " + ce.path + " is " +
+                               std::to_string(ce.key.size()) +
+                               " bytes, expected " + std::to_string(KEY_LEN));
+    out.entries.push_back(std::move(ce));
+  }
+  return out;
+}
+
+const ZipEntry *find_manifest_member(const ZipReader &z) {
+  const ZipEntry *best = nullptr;
+  auto depth = [](const std::string &n) {
+    return std::count(n.begin(), n.end(), '/');
+  };
+  const std::string suffix = "manifest.json";
+  for (auto const &e : z.entries()) {
+    const std::string &n = e.name;
+    if (n.size() < suffix.size() ||
+        n.compare(n.size() - suffix.size(), suffix.size(), suffix) != 0)
+      continue;
+    if (!best || std::make_pair(depth(n), n.size()) <
+                     std::make_pair(depth(best->name), best->name.size()))
+      best = &e;
+  }
+  return best;
+}
+
+std::string get_manifest_uuid(const ZipReader &z) {
+  return read_manifest_uuid(z, find_manifest_member(z));
+}
+
+std::string read_manifest_uuid(const ZipReader &z, const ZipEntry *m) {
+  if (!m)
+    return NULL_UUID;
+  try {
+    std::vector<uint8_t> data = z.read(*m);
+    mcbe_json::Value doc =
+        mcbe_json::parse((const char *)data.data(),
+                         (const char *)data.data() + data.size());
+    const mcbe_json::Value *header = doc.get("header");
+    const mcbe_json::Value *uuid = header ? header->get("uuid") : nullptr;
+    if (uuid && uuid->is_string())
+      return uuid->str;
+  } catch (const std::exception &) {
+  }
+  return NULL_UUID;
+}
+
+bool is_subpack_root(const std::string &name) {
+  return is_subpack_file(name) && is_dir(name) &&
+         std::count(name.begin(), name.end(), '/') == 2;
+}
+
+bool is_contents_json_path(const std::string &name) {
+  static const std::string kContents = "contents.json";
+  if (name == kContents)
+    return true;
+  if (name.size() <= kContents.size() ||
+      name.compare(name.size() - kContents.size(), kContents.size(),
+                   kContents) != 0)
+    return false;
+  return is_subpack_root(name.substr(0, name.size() - kContents.size()));
+}
+
+static void throw_if_cancelled(const std::atomic<bool> *cancel) {
+  if (cancel && cancel->load())
+    throw std::runtime_error("Cancelled.");
+}
+
+void write_key_files(const fs::path &keyFile, const std::string &masterKey,
+                     const std::string &uuid, const fs::path &outputZip) {
+  {
+    std::ofstream kf(keyFile, std::ios::binary | std::ios::trunc);
+    if (!kf)
+      throw std::runtime_error("Failed to write key file: " +
+                               keyFile.u8string());
+    kf.write(masterKey.data(), (std::streamsize)masterKey.size());
+  }
+
+  fs::path infoPath = keyFile;
+  infoPath += ".info.txt";
+  std::ofstream inf(infoPath, std::ios::binary | std::ios::trunc);
+  if (!inf)
+    throw std::runtime_error("Failed to write info file: " +
+                             infoPath.u8string());
+  inf << "UUID: " << uuid << "\nEncrypted file: "
+      << outputZip.filename().u8string() << "\n";
+}
+
+std::string encrypt_archive(const ZipReader &zin, ZipWriter &zout,
+                            const EncryptOptions &opts, const LogFn &logFn,
+                            const ProgressFn &progressFn,
+                            const std::atomic<bool> *cancel,
+                            EncryptStats *stats, HashSidecar *hashes) {
+  mcbe_progress::Channel *ch = opts.channel;
+  auto log = [&](const std::string &msg) {
+    if (logFn)
+      logFn(msg);
+    else if (ch)
+      ch->log(msg);
+  };
+  // "Encrypted: x" for every file floods a slow consumer; with a channel
+  // they are only built while it asks for them
+  auto log_file = [&](const char *what, const std::string &name) {
+    if (!ch || ch->file_log())
+      log(what + name);
+  };
+  auto check_cancel = [&]() { throw_if_cancelled(cancel); };
+
+  check_master_key(opts.masterKey);
+
+  PackPlan plan = plan_pack(zin, opts.excludedFiles, opts.deterministic,
+                            opts.threads);
+  const std::string &uuid = plan.uuid;
+  log("Manifest UUID: " + uuid);
+  log("Plan: " + std::to_string(plan.files) + " files (" +
+      std::to_string(plan.excluded.size()) + " copied as is), " +
+      std::to_string(plan.subpacks.size()) + " subpack(s), " +
+      std::to_string(plan.bytes / 1024) + " KiB");
+  if (hashes)
+    hashes->contentId = uuid;
+
+  log(std::string("Output I/O: ") + zout.io_backend());
+  if (opts.deterministic) {
+    // Archive order and timestamps of the input must not leak into the
+    // output; the plan lists every group by name
+    zout.set_fixed_timestamp(true);
+    log("Deterministic mode: derived entry keys, fixed timestamps");
+  }
+
+  // Set up below, once the processing order is known
+  std::unique_ptr<EncryptPipeline> pipe;
+  size_t nextSlot = 0;
+  std::vector<double> latencies;
+  EncryptStats local;
+  EncryptStats &st = stats ? *stats : local;
+
+  // Writes one entry, encrypted unless `copy`, and returns its key. Entries
+  // must come in pipeline order.
+  auto put_entry = [&](const ZipEntry &e, bool copy) -> std::string {
+    PipelineOutput r = pipe->take(nextSlot++);
+    if (r.spool) {
+      // Streamed: the worker left a one-entry ZIP, copied over page by page
+      ZipReader spool(r.spool->path);
+      mcbe_perf::Scope perf("write", spool.entries()[0].compressedSize);
+      zout.add_raw(spool, spool.entries()[0]);
+    } else {
+      mcbe_perf::Scope perf("write", r.packed.size());
+      zout.add_deflated(e.name, r.packed.data(), r.packed.size(), r.crc32,
+                        r.size);
+    }
+    latencies.push_back(r.latency);
+    if (hashes) {
+      EntryHash h;
+      h.path = e.name;
+      h.size = r.size;
+      memcpy(h.digest, r.digest, sizeof(h.digest));
+      hashes->entries.push_back(std::move(h));
+    }
+    if (r.spool)
+      log_file(copy ? "Copied (streamed): " : "Encrypted (streamed): ", e.name);
+    else
+      log_file(copy ? "Copied: " : "Encrypted: ", e.name);
+    return r.key;
+  };
+
+  // Copy directory entries
+  for (const ZipEntry *item : plan.directories) {
+    check_cancel();
+    zout.add_directory(item->name);
+  }
+  size_t total = plan.total;
+
+  size_t done = 0;
+  const char *lastPhase = nullptr;
+  auto prog = [&](const char *phase) {
+    if (ch && phase != lastPhase)
+      ch->set_phase(phase);
+    lastPhase = phase;
+    if (progressFn)
+      progressFn(done, total, phase);
+  };
+  if (ch)
+    ch->add_total(total);
+
+  // Every file entry goes through the worker pool in the order it is
+  // written below; the large ones are streamed into spool files next to
+  // the output
+  std::vector<PipelineEntry> work;
+  for (const PlanFile &f : plan.rootFiles)
+    work.push_back({f.entry, f.copy});
+  for (const SubpackPlan &sp : plan.subpacks) {
+    for (const ZipEntry *e : sp.files)
+      work.push_back({e, false});
+  }
+  PipelineOptions po;
+  po.streamThreshold = opts.streamThreshold;
+  if (!opts.outputZip.empty())
+    po.spoolDir = fs::absolute(opts.outputZip).parent_path();
+  po.cancel = cancel;
+  po.masterKey = opts.masterKey;
+  po.deterministic = opts.deterministic;
+  po.threads = opts.threads;
+  po.hash = hashes != nullptr;
+  po.channel = ch;
+  pipe.reset(new EncryptPipeline(zin, std::move(work), po));
+
+  std::vector<ContentEntry> contentEntries;
+  log("Processing " + std::to_string(plan.rootFiles.size()) + " root files.");
+  for (const PlanFile &f : plan.rootFiles) {
+    check_cancel();
+    contentEntries.push_back({f.entry->name, put_entry(*f.entry, f.copy)});
+    done++;
+    prog("Processing root files");
+  }
+
+  check_cancel();
+  std::vector<uint8_t> contents =
+      build_contents_json(uuid, opts.masterKey, contentEntries);
+  zout.add_file("contents.json", contents.data(), contents.size());
+  log("Wrote contents.json");
+  done++;
+  if (ch)
+    ch->advance(1);
+  prog("Writing metadata");
+
+  for (const SubpackPlan &sp : plan.subpacks) {
+    check_cancel();
+    const std::string &root = sp.root;
+    const auto &files = sp.files;
+    log("Subpack: " + root + " (" + std::to_string(files.size()) + " files)");
+
+    std::vector<ContentEntry> subEntries;
+    for (const ZipEntry *e : files) {
+      check_cancel();
+      std::string key = put_entry(*e, false);
+      subEntries.push_back({e->name.substr(root.size()), key});
+      done++;
+      prog("Processing subpacks");
+    }
+
+    check_cancel();
+    std::vector<uint8_t> sub =
+        build_contents_json(uuid, opts.masterKey, subEntries);
+    zout.add_file(root + "contents.json", sub.data(), sub.size());
+    log("Wrote " + root + "contents.json");
+    done++;
+    if (ch)
+      ch->advance(1);
+    prog("Writing subpack metadata");
+  }
+
+  pipe->add_stats(st);
+  pipe.reset();
+  if (!latencies.empty()) {
+    // Nearest-rank percentiles
+    std::sort(latencies.begin(), latencies.end());
+    auto pct = [&](double p) {
+      size_t rank = (size_t)std::ceil(p * latencies.size());
+      return latencies[std::max<size_t>(rank, 1) - 1];
+    };
+    st.entries = latencies.size();
+    st.p50 = pct(0.50);
+    st.p99 = pct(0.99);
+    st.maxLatency = latencies.back();
+    st.tailRatio = st.p50 > 0 ? st.p99 / st.p50 : 0;
+  }
+
+  zout.finish();
+  return uuid;
+}
+
+void encrypt_pack(const EncryptOptions &opts, const LogFn &logFn,
+                  const ProgressFn &progressFn,
+                  const std::atomic<bool> *cancel, EncryptStats *stats) {
+  auto log = [&](const std::string &msg) {
+    if (logFn)
+      logFn(msg);
+    else if (opts.channel)
+      opts.channel->log(msg);
+  };
+
+  check_master_key(opts.masterKey);
+  ZipReader zin(opts.inputZip);
+  ZipWriter zout(opts.outputZip);
+  HashSidecar hashes;
+  std::string uuid =
+      encrypt_archive(zin, zout, opts, logFn, progressFn, cancel, stats,
+                      opts.plainHashes ? &hashes : nullptr);
+  write_key_files(opts.keyFile, opts.masterKey, uuid, opts.outputZip);
+  if (opts.plainHashes)
+    write_hash_sidecar(hash_sidecar_path(opts.keyFile), hashes);
+
+  log("Done.");
+  log("Output ZIP: " + opts.outputZip.filename().u8string());
+  log("Key file: " + opts.keyFile.filename().u8string());
+  log("Info file: " + opts.keyFile.filename().u8string() + ".info.txt");
+  if (opts.plainHashes)
+    log("Hash file: " +
+        hash_sidecar_path(opts.keyFile).filename().u8string());
+  if (opts.channel)
+    opts.channel->finish();
+}
+
+void rotate_master_key(const RotateOptions &opts, const LogFn &logFn,
+                       const ProgressFn &progressFn,
+                       const std::atomic<bool> *cancel) {
+  auto log = [&](const std::string &msg) {
+    if (logFn)
+      logFn(msg);
+  };
+
+  check_master_key(opts.oldMasterKey);
+  check_master_key(opts.newMasterKey);
+
+  fs::path tmpPath = opts.outputZip;
+  tmpPath += ".tmp";
+  std::string contentId;
+  try {
+    ZipReader zin(opts.inputZip);
+    if (!zin.find("contents.json"))
+      throw std::runtime_error("No contents.json in " +
+                               opts.inputZip.filename().u8string() +
+                               " (not an encrypted pack?).");
+
+    ZipWriter zout(tmpPath);
+    size_t total = zin.entries().size();
+    size_t done = 0;
+    size_t rekeyed = 0;
+    for (auto const &e : zin.entries()) {
+      throw_if_cancelled(cancel);
+      if (is_contents_json_path(e.name)) {
+        std::vector<uint8_t> data = zin.read(e);
+        ContentsJson doc =
+            parse_contents_json(data.data(), data.size(), opts.oldMasterKey);
+        if (e.name == "contents.json")
+          contentId = doc.contentId;
+        std::vector<uint8_t> out =
+            build_contents_json(doc.contentId, opts.newMasterKey, doc.entries);
+        zout.add_file(e.name, out.data(), out.size());
+        log("Re-keyed: " + e.name);
+        rekeyed++;
+      } else {
+        zout.add_raw(zin, e);
+      }
+      done++;
+      if (progressFn)
+        progressFn(done, total, "Rotating master key");
+    }
+    zout.finish();
+    log("Copied " + std::to_string(total - rekeyed) + " entries unchanged.");
+  } catch (...) {
+    std::error_code ec;
+    fs::remove(tmpPath, ec);
+    throw;
+  }
+
+  // The new key goes to disk before the pack that needs it replaces the old
+  // one: if that write fails the old pack and key are left as they were,
+  // and once the pack is renamed the key is already there to be moved in
+  fs::path tmpKey = opts.keyFile;
+  tmpKey += ".tmp";
+  fs::path tmpInfo = tmpKey;
+  tmpInfo += ".info.txt";
+  fs::path infoPath = opts.keyFile;
+  infoPath += ".info.txt";
+  try {
+    write_key_files(tmpKey, opts.newMasterKey, contentId, opts.outputZip);
+    // The input mapping is closed by now, so this also works in place
+    fs::rename(tmpPath, opts.outputZip);
+  } catch (...) {
+    std::error_code ec;
+    fs::remove(tmpPath, ec);
+    fs::remove(tmpKey, ec);
+    fs::remove(tmpInfo, ec);
+    throw;
+  }
+  std::error_code ec;
+  fs::rename(tmpKey, opts.keyFile, ec);
+  if (ec)
+    throw std::runtime_error("Pack re-keyed, but the new key could not be "
+                             "moved into place; it is in " +
+                             tmpKey.u8string() + " (" + ec.message() + ")");
+  fs::rename(tmpInfo, infoPath, ec);
+  if (ec)
+    fs::remove(tmpInfo, ec);
+
+  log("Done.");
+  log("Output ZIP: " + opts.outputZip.filename().u8string());
+  log("Key file: " + opts.keyFile.filename().u8string());
+}
+
+} // namespace mcbe_pack
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "mcbe_progress.h"
+#include "mcbe_zip.h"
+
+// Native implementation of the resource pack encryption format
+// (same output as encrypt.py's encrypt_pack()).
+
+namespace mcbe_pack {
+
+namespace fs = std::filesystem;
+
+struct HashSidecar; // mcbe_pack_hashes.h
+
+static constexpr size_t KEY_LEN = 32;
+static constexpr size_t HEADER_SIZE = 256;
+static constexpr uint8_t VERSION[4] = {0x00, 0x00, 0x00, 0x00};
+static constexpr uint8_t MAGIC[4] = {0xFC, 0xB9, 0xCF, 0x9B};
+
+// Entries at least this large (uncompressed) are streamed through a
+// STREAM_WINDOW-sized buffer instead of being read whole
+static constexpr uint64_t STREAM_THRESHOLD = 64ull * 1024 * 1024;
+static constexpr size_t STREAM_WINDOW = 1024 * 1024;
+
+static const char *const NULL_UUID = "00000000-0000-0000-0000-000000000000";
+
+const std::set<std::string> &default_excluded_files();
+
+// 32 characters from A-Z a-z 0-9, like random_key() in encrypt.py
+std::string random_key();
+
+// Deterministic per-entry key for the reproducible mode:
+//   T    = CMAC(master, content)
+//   seed = CMAC(master, "MCBE-KDF1\0" || path || "\0" || T)
+//   out  = CMAC(master, seed || i) for i = 0, 1, ...
+// Output bytes below 248 map to alphabet[b % 62] until 32 characters are
+// collected (no modulo bias). Same result as derive_entry_key() in
+// encrypt.py.
+std::string derive_entry_key(const std::string &masterKey,
+                             const std::string &path, const uint8_t *data,
+                             size_t len);
+
+// Same, with T already computed (mcbe_cfb8::Cmac over a streamed entry)
+std::string derive_entry_key(const std::string &masterKey,
+                             const std::string &path,
+                             const uint8_t contentMac[16]);
+
+// Master key stored in a <name>.zip.key file (trailing whitespace is
+// ignored). Throws std::runtime_error if it is not a 32-character key.
+std::string read_key_file(const fs::path &p);
+
+// AES-256-CFB-8, IV = first 16 bytes of the key
+std::vector<uint8_t> encrypt_bytes(const uint8_t *data, size_t len,
+                                   const std::string &key);
+std::vector<uint8_t> decrypt_bytes(const uint8_t *data, size_t len,
+                                   const std::string &key);
+
+// Entry of a contents.json; an empty key is written as null
+struct ContentEntry {
+  std::string path;
+  std::string key;
+};
+
+// Header (VERSION, MAGIC, content id) followed by the encrypted
+// {"content": [...]} document
+std::vector<uint8_t> build_contents_json(const std::string &contentId,
+                                         const std::string &masterKey,
+                                         const std::vector<ContentEntry> &entries);
+
+bool is_contents_json_header(const uint8_t *data, size_t len);
+
+struct ContentsJson {
+  std::string contentId;
+  std::vector<ContentEntry> entries;
+};
+
+// Inverse of build_contents_json(). Throws std::runtime_error on a bad
+// header, a wrong master key, a malformed document or an entry key that is
+// neither empty nor KEY_LEN bytes.
+ContentsJson parse_contents_json(const uint8_t *data, size_t len,
+                                 const std::string &masterKey);
+
+// Shallowest manifest.json in the archive, nullptr if there is none
+const mcbe_zip::ZipEntry *find_manifest_member(const mcbe_zip::ZipReader &z);
+
+// header.uuid of the manifest, NULL_UUID if missing or unreadable
+std::string get_manifest_uuid(const mcbe_zip::ZipReader &z);
+// Same for a manifest entry found beforehand (nullptr gives NULL_UUID)
+std::string read_manifest_uuid(const mcbe_zip::ZipReader &z,
+                               const mcbe_zip::ZipEntry *manifest);
+
+inline bool is_dir(const std::string &name) {
+  return !name.empty() && name.back() == '/';
+}
+
+inline bool is_subpack_file(const std::string &name) {
+  return name.rfind("subpacks/", 0) == 0;
+}
+
+bool is_subpack_root(const std::string &name);
+
+// "contents.json" or "subpacks/<x>/contents.json": the entries encrypted
+// with the master key
+bool is_contents_json_path(const std::string &name);
+
+struct EncryptOptions {
+  fs::path inputZip;
+  fs::path outputZip;
+  fs::path keyFile;
+  std::string masterKey;
+  std::set<std::string> excludedFiles;
+  // Derive entry keys with derive_entry_key(), sort entries by name and
+  // write fixed timestamps: same input and master key, same output bytes
+  bool deterministic = false;
+  uint64_t streamThreshold = STREAM_THRESHOLD;
+  // Worker threads (inflate, AES, deflate), 0 = one per core. Entries from
+  // streamThreshold up are encrypted into spool files next to outputZip.
+  unsigned threads = 0;
+  // Hash every plaintext entry on the way and write the digests to
+  // hash_sidecar_path(keyFile)
+  bool plainHashes = false;
+  // Counters, phase and log lines for a front end polling at its own rate.
+  // Lines go here unless a LogFn is passed; per-file lines are only
+  // produced while channel->file_log().
+  mcbe_progress::Channel *channel = nullptr;
+};
+
+// Where encrypt_pack() spent its time
+struct EncryptStats {
+  // Inflate (+ CRC check) of deflated input entries, summed over the
+  // workers and the streamed entries: bytes / seconds is the per-thread rate
+  uint64_t inflatedBytes = 0;
+  double inflateSeconds = 0;
+  unsigned threads = 0;
+  // AES-256-CFB-8 of all encrypted entries, in memory or streamed
+  uint64_t encryptedBytes = 0;
+  double encryptSeconds = 0;
+  // Per-entry latency (pickup to done, seconds) over all file entries
+  size_t entries = 0;
+  double p50 = 0;
+  double p99 = 0;
+  double maxLatency = 0;
+  double tailRatio = 0; // p99 / p50
+  // From the first worker running out of entries to the last one finishing
+  double tailSeconds = 0;
+};
+
+using LogFn = std::function<void(const std::string &)>;
+using ProgressFn =
+    std::function<void(size_t done, size_t total, const std::string &phase)>;
+
+// Core of encrypt_pack() on archives that are already open: everything but
+// the paths and key files. Finishes `zout` and returns the manifest UUID.
+// With `hashes`, the plaintext digest of every file entry is added to it
+// (opts.plainHashes is not looked at).
+std::string encrypt_archive(const mcbe_zip::ZipReader &zin,
+                            mcbe_zip::ZipWriter &zout,
+                            const EncryptOptions &opts, const LogFn &log = {},
+                            const ProgressFn &progress = {},
+                            const std::atomic<bool> *cancel = nullptr,
+                            EncryptStats *stats = nullptr,
+                            HashSidecar *hashes = nullptr);
+
+// <name>.zip.key and <name>.zip.key.info.txt for `outputZip`
+void write_key_files(const fs::path &keyFile, const std::string &masterKey,
+                     const std::string &uuid, const fs::path &outputZip);
+
+// Throws std::runtime_error on failure or when *cancel becomes true
+void encrypt_pack(const EncryptOptions &opts, const LogFn &log = {},
+                  const ProgressFn &progress = {},
+                  const std::atomic<bool> *cancel = nullptr,
+                  EncryptStats *stats = nullptr);
+
+struct RotateOptions {
+  fs::path inputZip;  // encrypted pack
+  fs::path outputZip; // may be the same as inputZip
+  fs::path keyFile;
+  std::string oldMasterKey;
+  std::string newMasterKey;
+};
+
+// Re-keys every contents.json from oldMasterKey to newMasterKey (content id
+// kept) and copies all other entries compressed and encrypted as they are.
+// Entry keys don't change, so the cost is one sequential copy of the
+// archive. Output is written next to outputZip and renamed into place;
+// the new key file is written first, so a failed key write leaves the old
+// pack and key untouched.
+// Throws std::runtime_error on failure or when *cancel becomes true.
+void rotate_master_key(const RotateOptions &opts, const LogFn &log = {},
+                       const ProgressFn &progress = {},
+                       const std::atomic<bool> *cancel = nullptr);
+
+} // namespace mcbe_pack
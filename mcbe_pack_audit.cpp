@@ -0,0 +1,387 @@
+#include "mcbe_pack_audit.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "mcbe_pack.h"
+
+namespace mcbe_pack {
+
+using mcbe_zip::ZipEntry;
+using mcbe_zip::ZipReader;
+
+// Enough to see what's wrong without one broken pack bloating the index
+static constexpr size_t MAX_ISSUES = 20;
+
+static const char INDEX_MAGIC[8] = {'M', 'C', 'B', 'E', 'A', 'U', 'D', '1'};
+
+fs::path find_key_file(const fs::path &zip) {
+  std::string stem = zip.stem().u8string();
+  const std::string suffix = "_encrypted";
+  std::error_code ec;
+  if (stem.size() > suffix.size() &&
+      stem.compare(stem.size() - suffix.size(), suffix.size(), suffix) == 0) {
+    fs::path p = zip.parent_path() /
+                 fs::u8path(stem.substr(0, stem.size() - suffix.size()) +
+                            ".zip.key");
+    if (fs::exists(p, ec))
+      return p;
+  }
+  fs::path p = zip.parent_path() / fs::u8path(stem + ".zip.key");
+  return fs::exists(p, ec) ? p : fs::path();
+}
+
+// Header fields of one contents.json; issues are reported, not thrown
+static std::string check_header(const std::vector<uint8_t> &data,
+                                const std::string &name,
+                                std::vector<std::string> &issues) {
+  if (data.size() < HEADER_SIZE) {
+    issues.push_back(name + ": shorter than the 256-byte header");
+    return {};
+  }
+  if (memcmp(data.data(), VERSION, 4) != 0)
+    issues.push_back(name + ": unknown header version");
+  if (memcmp(data.data() + 4, MAGIC, 4) != 0)
+    issues.push_back(name + ": bad MAGIC");
+
+  size_t idLen = data[0x10];
+  if (0x11 + idLen > HEADER_SIZE) {
+    issues.push_back(name + ": content id overruns the header");
+    return {};
+  }
+  std::string id((const char *)data.data() + 0x11, idLen);
+  for (unsigned char c : id) {
+    if (c < 0x20 || c > 0x7E) {
+      issues.push_back(name + ": content id is not printable ASCII");
+      break;
+    }
+  }
+  for (size_t i = 8; i < HEADER_SIZE; i++) {
+    if ((i < 0x10 || i >= 0x11 + idLen) && data[i] != 0) {
+      issues.push_back(name + ": non-zero header padding");
+      break;
+    }
+  }
+  return id;
+}
+
+// "UUID: ..." and "Encrypted file: ..." lines of the .info.txt sidecar
+static void check_info_file(const fs::path &keyFile, const std::string &uuid,
+                            const fs::path &zip,
+                            std::vector<std::string> &issues) {
+  fs::path infoPath = keyFile;
+  infoPath += ".info.txt";
+  std::ifstream f(infoPath, std::ios::binary);
+  if (!f) {
+    issues.push_back("missing sidecar " + infoPath.filename().u8string());
+    return;
+  }
+
+  std::string line, infoUuid, infoFile;
+  while (std::getline(f, line)) {
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if (line.rfind("UUID: ", 0) == 0)
+      infoUuid = line.substr(6);
+    else if (line.rfind("Encrypted file: ", 0) == 0)
+      infoFile = line.substr(16);
+  }
+  if (infoUuid != uuid)
+    issues.push_back("info.txt UUID " + infoUuid + " does not match " + uuid);
+  if (infoFile != zip.filename().u8string())
+    issues.push_back("info.txt names " + infoFile + ", not " +
+                     zip.filename().u8string());
+}
+
+AuditResult audit_pack(const fs::path &zip, const fs::path &keyFile) {
+  AuditResult r;
+  std::vector<std::string> &issues = r.issues;
+  try {
+    ZipReader z(zip);
+    r.entries = (uint32_t)z.entries().size();
+
+    std::string masterKey;
+    if (keyFile.empty()) {
+      issues.push_back("no .zip.key sidecar");
+    } else {
+      try {
+        masterKey = read_key_file(keyFile);
+      } catch (const std::exception &e) {
+        issues.push_back(e.what());
+      }
+    }
+
+    std::unordered_set<std::string> files;
+    for (auto const &e : z.entries()) {
+      if (!e.is_dir())
+        files.insert(e.name);
+    }
+
+    bool haveRoot = false;
+    bool decrypted = !masterKey.empty();
+    std::vector<std::pair<std::string, std::string>> subpackIds;
+    std::unordered_set<std::string> listed;
+    for (auto const &e : z.entries()) {
+      if (!is_contents_json_path(e.name))
+        continue;
+      std::string prefix =
+          e.name.substr(0, e.name.size() - std::strlen("contents.json"));
+
+      std::vector<uint8_t> data;
+      try {
+        data = z.read(e);
+      } catch (const std::exception &ex) {
+        issues.push_back(e.name + ": " + ex.what());
+        decrypted = false;
+        continue;
+      }
+      std::string id = check_header(data, e.name, issues);
+      if (prefix.empty()) {
+        haveRoot = true;
+        r.contentId = id;
+      } else {
+        subpackIds.emplace_back(e.name, id);
+      }
+
+      if (masterKey.empty())
+        continue;
+      try {
+        ContentsJson doc =
+            parse_contents_json(data.data(), data.size(), masterKey);
+        for (auto const &ce : doc.entries) {
+          std::string full = prefix + ce.path;
+          r.listed++;
+          if (!files.count(full))
+            issues.push_back(e.name + " lists missing file " + full);
+          listed.insert(std::move(full));
+        }
+      } catch (const std::exception &ex) {
+        issues.push_back(e.name + ": " + ex.what());
+        decrypted = false;
+      }
+    }
+
+    if (!haveRoot) {
+      issues.push_back("no contents.json (not an encrypted pack?)");
+    } else {
+      std::string uuid = get_manifest_uuid(z);
+      if (r.contentId != uuid)
+        issues.push_back("content id " + r.contentId +
+                         " does not match manifest UUID " + uuid);
+      for (auto const &s : subpackIds) {
+        if (s.second != r.contentId)
+          issues.push_back(s.first + ": content id " + s.second +
+                           " differs from the root");
+      }
+    }
+
+    if (decrypted) {
+      for (auto const &e : z.entries()) {
+        if (!e.is_dir() && !is_contents_json_path(e.name) &&
+            !listed.count(e.name))
+          issues.push_back("not listed in any contents.json: " + e.name);
+      }
+    }
+    r.keyChecked = decrypted;
+
+    if (!keyFile.empty() && haveRoot)
+      check_info_file(keyFile, r.contentId, zip, issues);
+  } catch (const std::exception &e) {
+    issues.push_back(e.what());
+  }
+
+  if (issues.size() > MAX_ISSUES) {
+    size_t more = issues.size() - (MAX_ISSUES - 1);
+    issues.resize(MAX_ISSUES - 1);
+    issues.push_back("... and " + std::to_string(more) + " more");
+  }
+  r.ok = issues.empty();
+  return r;
+}
+
+static int64_t mtime_of(const fs::path &p, std::error_code &ec) {
+  auto t = fs::last_write_time(p, ec);
+  return ec ? 0 : (int64_t)t.time_since_epoch().count();
+}
+
+AuditStamp audit_stamp(const fs::path &zip, const fs::path &keyFile) {
+  std::error_code ec;
+  AuditStamp s;
+  s.size = (uint64_t)fs::file_size(zip, ec);
+  if (ec)
+    throw std::runtime_error("Failed to open file: " + zip.u8string());
+  s.mtime = mtime_of(zip, ec);
+
+  // FNV-1a over (size, mtime) of each sidecar; 0 when there is no key file
+  if (!keyFile.empty()) {
+    fs::path info = keyFile;
+    info += ".info.txt";
+    uint64_t h = 0xcbf29ce484222325ull;
+    const fs::path *paths[] = {&keyFile, &info};
+    for (const fs::path *p : paths) {
+      std::error_code pec;
+      uint64_t size = (uint64_t)fs::file_size(*p, pec);
+      uint64_t mtime = pec ? 0 : (uint64_t)mtime_of(*p, pec);
+      for (uint64_t v : {pec ? 0 : size, mtime}) {
+        h ^= v;
+        h *= 0x100000001b3ull;
+      }
+    }
+    s.sidecars = h;
+  }
+  return s;
+}
+
+// ============================================
+// AuditIndex
+// ============================================
+
+namespace {
+
+struct Writer {
+  std::string buf;
+  void u8(uint8_t v) { buf.push_back((char)v); }
+  void u16(uint16_t v) {
+    for (int i = 0; i < 2; i++)
+      buf.push_back((char)(v >> (8 * i)));
+  }
+  void u32(uint32_t v) {
+    for (int i = 0; i < 4; i++)
+      buf.push_back((char)(v >> (8 * i)));
+  }
+  void u64(uint64_t v) {
+    for (int i = 0; i < 8; i++)
+      buf.push_back((char)(v >> (8 * i)));
+  }
+  void str(const std::string &s) {
+    size_t n = s.size() > 0xFFFF ? 0xFFFF : s.size();
+    u16((uint16_t)n);
+    buf.append(s, 0, n);
+  }
+};
+
+struct Reader {
+  const uint8_t *p;
+  const uint8_t *end;
+  void need(size_t n) {
+    if ((size_t)(end - p) < n)
+      throw std::runtime_error("truncated index");
+  }
+  uint64_t le(int bytes) {
+    need((size_t)bytes);
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++)
+      v |= (uint64_t)p[i] << (8 * i);
+    p += bytes;
+    return v;
+  }
+  std::string str() {
+    size_t n = (size_t)le(2);
+    need(n);
+    std::string s((const char *)p, n);
+    p += n;
+    return s;
+  }
+};
+
+} // namespace
+
+void AuditIndex::load(const fs::path &p) {
+  records_.clear();
+  std::ifstream f(p, std::ios::binary);
+  if (!f)
+    return;
+  std::string data((std::istreambuf_iterator<char>(f)),
+                   std::istreambuf_iterator<char>());
+  if (data.size() < sizeof(INDEX_MAGIC) + 4 ||
+      memcmp(data.data(), INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0)
+    return;
+
+  Reader rd{(const uint8_t *)data.data() + sizeof(INDEX_MAGIC),
+            (const uint8_t *)data.data() + data.size()};
+  try {
+    uint32_t count = (uint32_t)rd.le(4);
+    records_.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+      std::string path = rd.str();
+      Record rec;
+      rec.stamp.size = rd.le(8);
+      rec.stamp.mtime = (int64_t)rd.le(8);
+      rec.stamp.sidecars = rd.le(8);
+      uint8_t flags = (uint8_t)rd.le(1);
+      rec.result.ok = flags & 1;
+      rec.result.keyChecked = (flags & 2) != 0;
+      rec.result.entries = (uint32_t)rd.le(4);
+      rec.result.listed = (uint32_t)rd.le(4);
+      rec.result.contentId = rd.str();
+      uint16_t n = (uint16_t)rd.le(2);
+      for (uint16_t j = 0; j < n; j++)
+        rec.result.issues.push_back(rd.str());
+      records_[std::move(path)] = std::move(rec);
+    }
+  } catch (const std::exception &) {
+    // A damaged index only costs a full re-scan
+    records_.clear();
+  }
+}
+
+void AuditIndex::save(const fs::path &p) const {
+  Writer w;
+  w.buf.append(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  w.u32((uint32_t)records_.size());
+  for (auto const &kv : records_) {
+    const Record &rec = kv.second;
+    w.str(kv.first);
+    w.u64(rec.stamp.size);
+    w.u64((uint64_t)rec.stamp.mtime);
+    w.u64(rec.stamp.sidecars);
+    w.u8((uint8_t)((rec.result.ok ? 1 : 0) | (rec.result.keyChecked ? 2 : 0)));
+    w.u32(rec.result.entries);
+    w.u32(rec.result.listed);
+    w.str(rec.result.contentId);
+    w.u16((uint16_t)rec.result.issues.size());
+    for (auto const &s : rec.result.issues)
+      w.str(s);
+  }
+
+  fs::path tmp = p;
+  tmp += ".tmp";
+  {
+    std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+    if (!f)
+      throw std::runtime_error("Failed to write index: " + tmp.u8string());
+    f.write(w.buf.data(), (std::streamsize)w.buf.size());
+    if (!f)
+      throw std::runtime_error("Failed to write index: " + tmp.u8string());
+  }
+  fs::rename(tmp, p);
+}
+
+const AuditResult *AuditIndex::find(const std::string &path,
+                                    const AuditStamp &stamp) const {
+  auto it = records_.find(path);
+  if (it == records_.end() || !(it->second.stamp == stamp))
+    return nullptr;
+  return &it->second.result;
+}
+
+void AuditIndex::put(const std::string &path, const AuditStamp &stamp,
+                     const AuditResult &result) {
+  records_[path] = Record{stamp, result};
+}
+
+size_t AuditIndex::prune(const std::unordered_set<std::string> &seen) {
+  size_t dropped = 0;
+  for (auto it = records_.begin(); it != records_.end();) {
+    if (seen.count(it->first)) {
+      ++it;
+    } else {
+      it = records_.erase(it);
+      dropped++;
+    }
+  }
+  return dropped;
+}
+
+} // namespace mcbe_pack
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Integrity checks for encrypted packs as written by encrypt_pack(), and
+// the on-disk index mcbe_audit uses to skip packs that did not change
+// since the last scan.
+
+namespace mcbe_pack {
+
+namespace fs = std::filesystem;
+
+struct AuditResult {
+  bool ok = false;
+  std::string contentId;
+  uint32_t entries = 0;            // archive entries
+  uint32_t listed = 0;             // paths listed across all contents.json
+  bool keyChecked = false;         // a key was found and contents.json decrypted
+  std::vector<std::string> issues; // empty when ok
+};
+
+// <name>.zip.key next to <name>_encrypted.zip (or <name>.zip), empty path if
+// neither exists
+fs::path find_key_file(const fs::path &zip);
+
+// Checks one pack:
+//   - the central directory parses
+//   - every contents.json header has VERSION, MAGIC, a sane content id and
+//     zero padding, and the root content id matches the manifest UUID
+//   - the .zip.key.info.txt sidecar names the same UUID and archive
+//   - with a key file: every contents.json decrypts, every listed path
+//     exists in the archive and every file is listed somewhere
+// Never throws; problems end up in AuditResult::issues.
+AuditResult audit_pack(const fs::path &zip, const fs::path &keyFile);
+
+// Size and mtime of the pack and its sidecars. A pack is re-audited when
+// any of them changes.
+struct AuditStamp {
+  uint64_t size = 0;
+  int64_t mtime = 0;
+  uint64_t sidecars = 0; // combined size/mtime of .zip.key and .info.txt
+  bool operator==(const AuditStamp &o) const {
+    return size == o.size && mtime == o.mtime && sidecars == o.sidecars;
+  }
+};
+
+AuditStamp audit_stamp(const fs::path &zip, const fs::path &keyFile);
+
+// Binary index: magic, record count, then per record the path, stamp,
+// status and issues. Loaded whole and rewritten atomically after a scan.
+class AuditIndex {
+public:
+  struct Record {
+    AuditStamp stamp;
+    AuditResult result;
+  };
+
+  // A missing or unreadable index is treated as empty
+  void load(const fs::path &p);
+  void save(const fs::path &p) const;
+
+  // Cached result if `stamp` still matches, nullptr otherwise
+  const AuditResult *find(const std::string &path,
+                          const AuditStamp &stamp) const;
+  void put(const std::string &path, const AuditStamp &stamp,
+           const AuditResult &result);
+
+  // Drops every record whose path is not in `seen`
+  size_t prune(const std::unordered_set<std::string> &seen);
+
+  size_t size() const { return records_.size(); }
+
+private:
+  std::unordered_map<std::string, Record> records_;
+};
+
+} // namespace mcbe_pack
@@ -0,0 +1,317 @@
+#include "mcbe_pack_bundle.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+#include "mcbe_pack_hashes.h"
+#include "mcbe_pack_pipeline.h"
+
+namespace mcbe_pack {
+
+using mcbe_zip::ZipEntry;
+using mcbe_zip::ZipReader;
+using mcbe_zip::ZipWriter;
+
+static std::string lower(std::string s) {
+  for (auto &c : s)
+    c = (char)std::tolower((unsigned char)c);
+  return s;
+}
+
+static bool ends_with(const std::string &s, const std::string &suffix) {
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool is_bundle_path(const fs::path &p) {
+  std::string ext = lower(p.extension().u8string());
+  return ext == ".mcaddon" || ext == ".mcworld";
+}
+
+static bool is_inner_archive_name(const std::string &name) {
+  std::string n = lower(name);
+  return !is_dir(n) && (ends_with(n, ".mcpack") || ends_with(n, ".zip"));
+}
+
+// "resource_packs/rp/" -> "resource_packs_rp", "Addon RP.mcpack" -> "Addon RP"
+static std::string pack_label(const std::string &source, bool archive) {
+  std::string s = source;
+  if (archive)
+    s = s.substr(0, s.rfind('.'));
+  while (!s.empty() && s.back() == '/')
+    s.pop_back();
+  std::replace(s.begin(), s.end(), '/', '_');
+  return s.empty() ? "pack" : s;
+}
+
+// Packs encrypted at once: the one being written goes straight into the
+// output, the ones after it into spool files next to the output
+static constexpr size_t PACKS_IN_FLIGHT = 4;
+
+// One inner pack
+struct BundleJob {
+  BundlePack pack;
+  ZipReader zin;
+  uint64_t sizeHint = 0; // inner archive size, for ZIP64 headers
+  HashSidecar hashes;
+  // Started ahead of the writer, on its own thread
+  std::unique_ptr<SpoolFile> spool;
+  std::future<void> done;
+};
+
+static void write_bundle_key_file(const fs::path &keyFile,
+                                  const std::string &masterKey,
+                                  const fs::path &outputZip,
+                                  const std::vector<BundlePack> &packs) {
+  {
+    std::ofstream kf(keyFile, std::ios::binary | std::ios::trunc);
+    if (!kf)
+      throw std::runtime_error("Failed to write key file: " +
+                               keyFile.u8string());
+    kf.write(masterKey.data(), (std::streamsize)masterKey.size());
+  }
+
+  fs::path infoPath = keyFile;
+  infoPath += ".info.txt";
+  std::ofstream inf(infoPath, std::ios::binary | std::ios::trunc);
+  if (!inf)
+    throw std::runtime_error("Failed to write info file: " +
+                             infoPath.u8string());
+  inf << "Encrypted file: " << outputZip.filename().u8string() << "\n";
+  for (auto const &p : packs)
+    inf << "Pack: " << p.source << "\nUUID: " << p.uuid
+        << "\nKey file: " << p.keyFile.filename().u8string() << "\n";
+}
+
+std::vector<BundlePack> encrypt_bundle(const EncryptOptions &opts,
+                                       const LogFn &logFn,
+                                       const ProgressFn &progressFn,
+                                       const std::atomic<bool> *cancel) {
+  std::mutex logMu;
+  auto log = [&](const std::string &msg) {
+    if (logFn) {
+      std::lock_guard<std::mutex> lk(logMu);
+      logFn(msg);
+    } else if (opts.channel) {
+      opts.channel->log(msg);
+    }
+  };
+
+  ZipReader outer(opts.inputZip);
+  const std::vector<ZipEntry> &entries = outer.entries();
+  fs::path outDir = opts.outputZip.parent_path();
+
+  // Pack directories: shallowest prefixes holding a manifest.json
+  std::vector<std::string> dirs;
+  for (auto const &e : entries) {
+    if (e.name != "manifest.json" && !ends_with(e.name, "/manifest.json"))
+      continue;
+    std::string prefix = e.name.substr(0, e.name.size() - 13);
+    if (prefix.empty())
+      throw std::runtime_error("Input is a single pack, not an add-on or "
+                               "world: " + opts.inputZip.u8string());
+    dirs.push_back(prefix);
+  }
+  std::sort(dirs.begin(), dirs.end());
+  std::vector<std::string> packDirs;
+  for (auto const &d : dirs) {
+    if (packDirs.empty() || d.rfind(packDirs.back(), 0) != 0)
+      packDirs.push_back(d);
+  }
+  auto dir_of = [&](const std::string &name) -> const std::string * {
+    for (auto const &d : packDirs) {
+      if (name.rfind(d, 0) == 0)
+        return &d;
+    }
+    return nullptr;
+  };
+
+  // Jobs in archive order; inner archives without a manifest are copied
+  std::vector<std::unique_ptr<BundleJob>> jobs;
+  std::map<std::string, BundleJob *> bySource;
+  std::set<std::string> labels;
+  auto add_job = [&](const std::string &source, bool archive, ZipReader zin,
+                     uint64_t sizeHint) {
+    std::unique_ptr<BundleJob> job(new BundleJob());
+    job->pack.source = source;
+    job->pack.archive = archive;
+    job->sizeHint = sizeHint;
+    std::string label = pack_label(source, archive);
+    std::string name = label;
+    for (int n = 2; labels.count(name); n++)
+      name = label + "_" + std::to_string(n);
+    labels.insert(name);
+    job->pack.name = name;
+    job->pack.keyFile = outDir / fs::u8path(name + ".zip.key");
+    job->zin = std::move(zin);
+    bySource[source] = job.get();
+    jobs.push_back(std::move(job));
+  };
+  for (auto const &e : entries) {
+    const std::string *d = dir_of(e.name);
+    if (d) {
+      if (!bySource.count(*d))
+        add_job(*d, false, outer.subtree(*d), 0);
+      continue;
+    }
+    if (!is_inner_archive_name(e.name))
+      continue;
+    ZipReader zin;
+    try {
+      zin = ZipReader::open_nested(outer, e);
+    } catch (const std::exception &ex) {
+      log("Not a pack, copied: " + e.name + " (" + ex.what() + ")");
+      continue;
+    }
+    if (!find_manifest_member(zin)) {
+      log("No manifest.json, copied: " + e.name);
+      continue;
+    }
+    add_job(e.name, true, std::move(zin), e.uncompressedSize);
+  }
+  if (jobs.empty())
+    throw std::runtime_error("No packs found in " + opts.inputZip.u8string());
+
+  unsigned threads = opts.threads;
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  size_t inFlight = std::min<size_t>(
+      jobs.size(), std::min<size_t>(threads, PACKS_IN_FLIGHT));
+  EncryptOptions jobOpts = opts;
+  jobOpts.threads = std::max(1u, threads / (unsigned)inFlight);
+  log("Packs: " + std::to_string(jobs.size()) + ", " +
+      std::to_string(inFlight) + " at a time, " +
+      std::to_string(jobOpts.threads) + " worker thread(s) each");
+
+  auto run = [&](BundleJob &job, ZipWriter &w,
+                 const std::atomic<bool> *stop) {
+    std::string tag = "[" + job.pack.name + "] ";
+    job.pack.uuid = encrypt_archive(
+        job.zin, w, jobOpts, [&](const std::string &msg) { log(tag + msg); },
+        {}, stop, nullptr, opts.plainHashes ? &job.hashes : nullptr);
+    // The input view (and an inflated inner archive) isn't needed anymore
+    job.zin = ZipReader();
+  };
+
+  // Set when the caller cancels or anything fails, so every job stops
+  std::atomic<bool> abort(false);
+  size_t started = 0; // jobs [0, started) were started ahead or written
+  auto start_ahead = [&](BundleJob *job) {
+    job->spool.reset(new SpoolFile(
+        outDir / fs::u8path("mcbe_spool_" + random_key() + ".zip")));
+    job->done = std::async(std::launch::async, [&, job]() {
+      ZipWriter w(job->spool->path);
+      run(*job, w, &abort);
+    });
+  };
+
+  // Output in input order; each pack is written once its job is done
+  auto wait = [&](BundleJob &job) {
+    while (job.done.wait_for(std::chrono::milliseconds(100)) !=
+           std::future_status::ready) {
+      if (cancel && cancel->load())
+        abort = true;
+    }
+    job.done.get();
+  };
+
+  std::vector<BundlePack> packs;
+  try {
+    ZipWriter zout(opts.outputZip);
+    zout.set_fixed_timestamp(opts.deterministic);
+    std::set<std::string> written;
+    size_t done = 0;
+    for (auto const &e : entries) {
+      if (cancel && cancel->load())
+        throw std::runtime_error("Cancelled.");
+      const std::string *d = dir_of(e.name);
+      const std::string &source = d ? *d : e.name;
+      auto it = bySource.find(source);
+      if (it == bySource.end()) {
+        zout.add_raw(outer, e);
+        continue;
+      }
+      if (!written.insert(source).second)
+        continue;
+
+      // Jobs are in output order; keep the next ones busy meanwhile
+      BundleJob &job = *it->second;
+      bool ahead = job.done.valid();
+      if (!ahead)
+        started++;
+      while (started < jobs.size() && started < done + inFlight)
+        start_ahead(jobs[started++].get());
+
+      if (!ahead) {
+        // Straight into the output, nothing held or spooled
+        ZipWriter w;
+        if (job.pack.archive) {
+          zout.begin_file(e.name, false, job.sizeHint);
+          w.open_nested(&zout);
+          run(job, w, cancel);
+          zout.end_file();
+        } else {
+          w.open_subtree(&zout, source);
+          run(job, w, cancel);
+        }
+      } else {
+        wait(job);
+        if (job.pack.archive) {
+          std::ifstream in(job.spool->path, std::ios::binary);
+          if (!in)
+            throw std::runtime_error("Failed to open file: " +
+                                     job.spool->path.u8string());
+          zout.begin_file(e.name, false, fs::file_size(job.spool->path));
+          std::vector<uint8_t> buf(STREAM_WINDOW);
+          while (in.read((char *)buf.data(), buf.size()) || in.gcount() > 0)
+            zout.write(buf.data(), (size_t)in.gcount());
+          zout.end_file();
+        } else {
+          ZipReader r(job.spool->path);
+          for (ZipEntry inner : r.entries()) {
+            ZipEntry renamed = inner;
+            renamed.name = source + inner.name;
+            zout.add_raw(r, renamed);
+          }
+        }
+        job.spool.reset();
+      }
+      write_key_files(job.pack.keyFile, opts.masterKey, job.pack.uuid,
+                      fs::u8path(job.pack.name));
+      if (opts.plainHashes)
+        write_hash_sidecar(hash_sidecar_path(job.pack.keyFile), job.hashes);
+      log("Wrote " + source + " (UUID " + job.pack.uuid + ")");
+      packs.push_back(job.pack);
+      if (progressFn)
+        progressFn(++done, jobs.size(), "Encrypting packs");
+    }
+    zout.finish();
+  } catch (...) {
+    abort = true;
+    for (auto &jp : jobs) {
+      if (jp->done.valid())
+        jp->done.wait();
+    }
+    throw;
+  }
+
+  if (!opts.keyFile.empty())
+    write_bundle_key_file(opts.keyFile, opts.masterKey, opts.outputZip, packs);
+  log("Done.");
+  log("Output: " + opts.outputZip.filename().u8string());
+  if (opts.channel)
+    opts.channel->finish();
+  return packs;
+}
+
+} // namespace mcbe_pack
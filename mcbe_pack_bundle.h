@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "mcbe_pack.h"
+
+// Add-ons (.mcaddon) and worlds (.mcworld) carry several packs in one
+// archive: as inner .mcpack/.zip archives, or as directories with their own
+// manifest.json (resource_packs/<x>/, behavior_packs/<x>/ of a world).
+// encrypt_bundle() encrypts them straight from the outer archive -- inner
+// archives are opened as in-memory views, nothing is unpacked to disk --
+// and writes the archive again with the same layout. A few packs run at
+// once: the one being written goes directly into the output, the ones
+// after it into spool files next to the output, so no encrypted pack is
+// held in memory.
+
+namespace mcbe_pack {
+
+namespace fs = std::filesystem;
+
+// .mcaddon / .mcworld (case-insensitive)
+bool is_bundle_path(const fs::path &p);
+
+struct BundlePack {
+  std::string source; // inner archive entry, or directory prefix ("x/y/")
+  bool archive = false;
+  std::string name;   // unique label, used for the key file name
+  std::string uuid;   // manifest UUID = content id
+  fs::path keyFile;   // <output dir>/<name>.zip.key
+};
+
+// Encrypts every inner pack of opts.inputZip with opts.masterKey and writes
+// the result to opts.outputZip in the input's entry order: inner archives
+// as stored entries, pack directories in place, everything else copied as
+// is. Each pack gets <name>.zip.key(.info.txt), and <name>.zip.hashes with
+// opts.plainHashes, next to the output; the master key also goes to
+// opts.keyFile with a list of the packs. opts.threads is shared among the
+// packs that run at once; opts.channel counts the files of all of them.
+// Throws std::runtime_error on failure, when the input holds no packs, or
+// when *cancel becomes true.
+std::vector<BundlePack> encrypt_bundle(const EncryptOptions &opts,
+                                       const LogFn &log = {},
+                                       const ProgressFn &progress = {},
+                                       const std::atomic<bool> *cancel = nullptr);
+
+} // namespace mcbe_pack
@@ -0,0 +1,332 @@
+#include "mcbe_pack_hashes.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+#include "mcbe_pack.h"
+#include "mcbe_pack_reader.h"
+
+namespace mcbe_pack {
+
+using mcbe_zip::ZipEntry;
+using mcbe_zip::ZipReader;
+
+static const char SIDECAR_MAGIC[8] = {'M', 'C', 'B', 'E', 'H', 'S', 'H', '1'};
+static constexpr uint8_t ALGO_BLAKE3 = 1;
+
+fs::path hash_sidecar_path(const fs::path &keyFile) {
+  fs::path p = keyFile;
+  return p.replace_extension(".hashes");
+}
+
+// fn(i) for i in [0, n) over `threads` threads; the first error is rethrown
+template <typename Fn>
+static void parallel_for(size_t n, unsigned threads, Fn fn) {
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = (unsigned)std::max<size_t>(1, std::min<size_t>(threads, n));
+
+  std::atomic<size_t> next(0);
+  std::mutex mu;
+  std::exception_ptr error;
+  auto work = [&]() {
+    for (size_t i; (i = next++) < n;) {
+      try {
+        fn(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lk(mu);
+        if (!error)
+          error = std::current_exception();
+        next = n;
+      }
+    }
+  };
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; t++)
+    pool.emplace_back(work);
+  work();
+  for (auto &t : pool)
+    t.join();
+  if (error)
+    std::rethrow_exception(error);
+}
+
+// ============================================
+// Sidecar file
+// ============================================
+
+namespace {
+
+struct Writer {
+  std::string buf;
+  void u8(uint8_t v) { buf.push_back((char)v); }
+  void u16(uint16_t v) {
+    for (int i = 0; i < 2; i++)
+      buf.push_back((char)(v >> (8 * i)));
+  }
+  void u32(uint32_t v) {
+    for (int i = 0; i < 4; i++)
+      buf.push_back((char)(v >> (8 * i)));
+  }
+  void u64(uint64_t v) {
+    for (int i = 0; i < 8; i++)
+      buf.push_back((char)(v >> (8 * i)));
+  }
+  void str(const std::string &s) {
+    if (s.size() > 0xFFFF)
+      throw std::runtime_error("Path too long for the hash file: " + s);
+    u16((uint16_t)s.size());
+    buf.append(s);
+  }
+  void bytes(const uint8_t *p, size_t n) { buf.append((const char *)p, n); }
+};
+
+struct Reader {
+  const uint8_t *p;
+  const uint8_t *end;
+  void need(size_t n) {
+    if ((size_t)(end - p) < n)
+      throw std::runtime_error("truncated");
+  }
+  uint64_t le(int bytes) {
+    need((size_t)bytes);
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++)
+      v |= (uint64_t)p[i] << (8 * i);
+    p += bytes;
+    return v;
+  }
+  std::string str() {
+    size_t n = (size_t)le(2);
+    need(n);
+    std::string s((const char *)p, n);
+    p += n;
+    return s;
+  }
+  void bytes(uint8_t *out, size_t n) {
+    need(n);
+    memcpy(out, p, n);
+    p += n;
+  }
+};
+
+} // namespace
+
+void write_hash_sidecar(const fs::path &p, HashSidecar sidecar) {
+  std::sort(sidecar.entries.begin(), sidecar.entries.end(),
+            [](const EntryHash &a, const EntryHash &b) { return a.path < b.path; });
+
+  Writer w;
+  w.buf.append(SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC));
+  w.u8(ALGO_BLAKE3);
+  w.str(sidecar.contentId);
+  w.u32((uint32_t)sidecar.entries.size());
+  for (auto const &e : sidecar.entries) {
+    w.str(e.path);
+    w.u64(e.size);
+    w.bytes(e.digest, sizeof(e.digest));
+  }
+  uint8_t check[mcbe_hash::OUT_LEN];
+  mcbe_hash::hash((const uint8_t *)w.buf.data(), w.buf.size(), check);
+  w.bytes(check, sizeof(check));
+
+  std::ofstream f(p, std::ios::binary | std::ios::trunc);
+  if (!f)
+    throw std::runtime_error("Failed to write hash file: " + p.u8string());
+  f.write(w.buf.data(), (std::streamsize)w.buf.size());
+  if (!f)
+    throw std::runtime_error("Failed to write hash file: " + p.u8string());
+}
+
+HashSidecar read_hash_sidecar(const fs::path &p) {
+  std::ifstream f(p, std::ios::binary);
+  if (!f)
+    throw std::runtime_error("Failed to open hash file: " + p.u8string());
+  std::string data((std::istreambuf_iterator<char>(f)),
+                   std::istreambuf_iterator<char>());
+  auto bad = [&](const std::string &why) {
+    return std::runtime_error("Bad hash file " + p.u8string() + ": " + why);
+  };
+  if (data.size() < sizeof(SIDECAR_MAGIC) + mcbe_hash::OUT_LEN ||
+      memcmp(data.data(), SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC)) != 0)
+    throw bad("not a hash file");
+
+  const uint8_t *begin = (const uint8_t *)data.data();
+  size_t bodyLen = data.size() - mcbe_hash::OUT_LEN;
+  uint8_t check[mcbe_hash::OUT_LEN];
+  mcbe_hash::hash(begin, bodyLen, check);
+  if (memcmp(check, begin + bodyLen, sizeof(check)) != 0)
+    throw bad("checksum mismatch");
+
+  HashSidecar sc;
+  Reader rd{begin + sizeof(SIDECAR_MAGIC), begin + bodyLen};
+  try {
+    if (rd.le(1) != ALGO_BLAKE3)
+      throw std::runtime_error("unknown algorithm");
+    sc.contentId = rd.str();
+    uint32_t count = (uint32_t)rd.le(4);
+    sc.entries.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+      EntryHash e;
+      e.path = rd.str();
+      e.size = rd.le(8);
+      rd.bytes(e.digest, sizeof(e.digest));
+      sc.entries.push_back(std::move(e));
+    }
+  } catch (const std::exception &ex) {
+    throw bad(ex.what());
+  }
+  return sc;
+}
+
+// ============================================
+// Source packs
+// ============================================
+
+HashSidecar hash_source(const fs::path &src, unsigned threads) {
+  HashSidecar sc;
+  if (fs::is_directory(src)) {
+    std::vector<fs::path> files;
+    for (auto const &de : fs::recursive_directory_iterator(src)) {
+      if (de.is_regular_file())
+        files.push_back(de.path());
+    }
+    std::sort(files.begin(), files.end());
+    sc.entries.resize(files.size());
+    parallel_for(files.size(), threads, [&](size_t i) {
+      EntryHash &e = sc.entries[i];
+      e.path = files[i].lexically_relative(src).generic_u8string();
+      std::ifstream f(files[i], std::ios::binary);
+      if (!f)
+        throw std::runtime_error("Failed to open " + files[i].u8string());
+      std::vector<uint8_t> win(STREAM_WINDOW);
+      mcbe_hash::Hasher h;
+      while (f) {
+        f.read((char *)win.data(), (std::streamsize)win.size());
+        size_t n = (size_t)f.gcount();
+        h.update(win.data(), n);
+        e.size += n;
+      }
+      h.final(e.digest);
+    });
+    return sc;
+  }
+
+  ZipReader zin(src);
+  std::vector<const ZipEntry *> files;
+  for (auto const &e : zin.entries()) {
+    if (!is_dir(e.name))
+      files.push_back(&e);
+  }
+  sc.entries.resize(files.size());
+  parallel_for(files.size(), threads, [&](size_t i) {
+    const ZipEntry &ze = *files[i];
+    EntryHash &e = sc.entries[i];
+    e.path = ze.name;
+    e.size = ze.uncompressedSize;
+    if (ze.uncompressedSize < STREAM_THRESHOLD) {
+      std::vector<uint8_t> data = zin.read(ze);
+      mcbe_hash::hash(data.data(), data.size(), e.digest);
+      return;
+    }
+    std::vector<uint8_t> win(STREAM_WINDOW);
+    mcbe_zip::EntryReader reader(zin, ze);
+    mcbe_hash::Hasher h;
+    size_t n;
+    while ((n = reader.read(win.data(), win.size())) > 0)
+      h.update(win.data(), n);
+    h.final(e.digest);
+  });
+  return sc;
+}
+
+HashDiff diff_hashes(const HashSidecar &from, const HashSidecar &to) {
+  std::map<std::string, const EntryHash *> a, b;
+  for (auto const &e : from.entries)
+    a[e.path] = &e;
+  for (auto const &e : to.entries)
+    b[e.path] = &e;
+
+  HashDiff d;
+  for (auto const &kv : a) {
+    auto it = b.find(kv.first);
+    if (it == b.end())
+      d.removed.push_back(kv.first);
+    else if (kv.second->size != it->second->size ||
+             memcmp(kv.second->digest, it->second->digest,
+                    mcbe_hash::OUT_LEN) != 0)
+      d.changed.push_back(kv.first);
+  }
+  for (auto const &kv : b) {
+    if (!a.count(kv.first))
+      d.added.push_back(kv.first);
+  }
+  return d;
+}
+
+// ============================================
+// Encrypted packs
+// ============================================
+
+VerifyResult verify_pack(const fs::path &zip, const std::string &masterKey,
+                         const HashSidecar &expected, unsigned threads) {
+  PackReader pack(zip, masterKey);
+  if (!expected.contentId.empty() && pack.content_id() != expected.contentId)
+    throw std::runtime_error("Content id " + pack.content_id() +
+                             " does not match the hash file (" +
+                             expected.contentId + ")");
+
+  VerifyResult r;
+  std::vector<const EntryHash *> present;
+  std::set<std::string> listed;
+  for (auto const &e : expected.entries) {
+    listed.insert(e.path);
+    if (pack.contains(e.path))
+      present.push_back(&e);
+    else
+      r.missing.push_back(e.path);
+  }
+  for (auto const &e : pack.zip().entries()) {
+    if (!is_dir(e.name) && !is_contents_json_path(e.name) &&
+        !listed.count(e.name))
+      r.extra.push_back(e.name);
+  }
+
+  // Large entries are hashed window by window, so memory stays at one
+  // window per thread for them as in encrypt_pack()
+  std::vector<char> bad(present.size(), 0);
+  parallel_for(present.size(), threads, [&](size_t i) {
+    const EntryHash &e = *present[i];
+    uint8_t digest[mcbe_hash::OUT_LEN];
+    uint64_t size = 0;
+    if (pack.asset_size(e.path) >= STREAM_THRESHOLD) {
+      mcbe_hash::Hasher h;
+      pack.read_to(e.path, [&](const uint8_t *p, size_t n) {
+        h.update(p, n);
+        size += n;
+      });
+      h.final(digest);
+    } else {
+      std::vector<uint8_t> data = pack.read(e.path);
+      mcbe_hash::hash(data.data(), data.size(), digest);
+      size = data.size();
+    }
+    bad[i] = size != e.size || memcmp(digest, e.digest, sizeof(digest)) != 0;
+  });
+  for (size_t i = 0; i < present.size(); i++) {
+    if (bad[i])
+      r.mismatched.push_back(present[i]->path);
+  }
+  r.checked = present.size();
+  return r;
+}
+
+} // namespace mcbe_pack
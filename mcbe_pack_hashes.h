@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "mcbe_hash.h"
+
+// Plaintext integrity sidecar. encrypt_pack() hashes every entry (BLAKE3)
+// on its way to the cipher and writes the digests to <name>.zip.hashes next
+// to <name>.zip.key. Entry keys are random, so two encryptions of the same
+// pack never compare equal; their sidecars do. The sidecar lets
+// verify_pack() check an encrypted pack against what went in, and
+// diff_hashes() compare builds or a source tree without decrypting.
+
+namespace mcbe_pack {
+
+namespace fs = std::filesystem;
+
+struct EntryHash {
+  std::string path; // archive path in the source pack
+  uint64_t size = 0;
+  uint8_t digest[mcbe_hash::OUT_LEN] = {};
+};
+
+struct HashSidecar {
+  std::string contentId; // manifest UUID, empty for a source tree
+  std::vector<EntryHash> entries;
+};
+
+// <name>.zip.key -> <name>.zip.hashes
+fs::path hash_sidecar_path(const fs::path &keyFile);
+
+// Binary file: magic, algorithm, content id, entry count, then per entry
+// (sorted by path) the path, size and digest, followed by a digest of
+// everything before it. Throws std::runtime_error on I/O errors.
+void write_hash_sidecar(const fs::path &p, HashSidecar sidecar);
+
+// Throws std::runtime_error if the file is missing, truncated or damaged
+HashSidecar read_hash_sidecar(const fs::path &p);
+
+// Digests of an unencrypted pack, a .zip/.mcpack or a directory, over
+// `threads` worker threads (0 = one per core)
+HashSidecar hash_source(const fs::path &src, unsigned threads = 0);
+
+struct HashDiff {
+  std::vector<std::string> added;   // only in `to`
+  std::vector<std::string> removed; // only in `from`
+  std::vector<std::string> changed; // size or digest differs
+  bool empty() const {
+    return added.empty() && removed.empty() && changed.empty();
+  }
+};
+
+HashDiff diff_hashes(const HashSidecar &from, const HashSidecar &to);
+
+struct VerifyResult {
+  size_t checked = 0;
+  std::vector<std::string> mismatched; // decrypts to different content
+  std::vector<std::string> missing;    // in the sidecar, not in the pack
+  std::vector<std::string> extra;      // in the pack, not in the sidecar
+  bool ok() const {
+    return mismatched.empty() && missing.empty() && extra.empty();
+  }
+};
+
+// Decrypts every entry of an encrypted pack with `masterKey` and compares it
+// with the sidecar. Throws std::runtime_error if the pack can't be opened
+// or its contents.json doesn't decrypt.
+VerifyResult verify_pack(const fs::path &zip, const std::string &masterKey,
+                         const HashSidecar &expected, unsigned threads = 0);
+
+} // namespace mcbe_pack
@@ -0,0 +1,461 @@
+#include "mcbe_pack_pipeline.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "mcbe_cfb8.h"
+#include "mcbe_perf.h"
+
+namespace mcbe_pack {
+
+using mcbe_zip::ZipEntry;
+using mcbe_zip::ZipReader;
+using mcbe_zip::ZipWriter;
+
+static double seconds_since(std::chrono::steady_clock::time_point t) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t)
+      .count();
+}
+
+static void throw_if_cancelled(const std::atomic<bool> *cancel) {
+  if (cancel && cancel->load())
+    throw std::runtime_error("Cancelled.");
+}
+
+// ============================================
+// Streamed entries
+// ============================================
+
+// CMAC(master, content) of an entry too large to read in one piece
+static void stream_content_mac(const ZipReader &zin, const ZipEntry &e,
+                               const std::string &masterKey, uint8_t mac[16],
+                               const std::atomic<bool> *cancel) {
+  std::vector<uint8_t> buf(STREAM_WINDOW);
+  mcbe_zip::EntryReader reader(zin, e);
+  mcbe_cfb8::Cmac cmac((const uint8_t *)masterKey.data());
+  size_t n;
+  while ((n = reader.read(buf.data(), buf.size())) > 0) {
+    throw_if_cancelled(cancel);
+    cmac.update(buf.data(), n);
+  }
+  cmac.final(mac);
+}
+
+// Hashes the windows stream_entry() hands it on one thread that lives as
+// long as the entry. post() returns at once; the window must stay untouched
+// until the next wait().
+class WindowHasher {
+public:
+  explicit WindowHasher(mcbe_hash::Hasher &h)
+      : thread_([this, &h]() { run(h); }) {}
+
+  ~WindowHasher() {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      done_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+
+  WindowHasher(const WindowHasher &) = delete;
+  WindowHasher &operator=(const WindowHasher &) = delete;
+
+  void post(const uint8_t *p, size_t n) {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      p_ = p;
+      n_ = n;
+    }
+    cv_.notify_all();
+  }
+
+  void wait() {
+    std::unique_lock<std::mutex> lk(mu_);
+    cv_.wait(lk, [&] { return p_ == nullptr; });
+  }
+
+private:
+  void run(mcbe_hash::Hasher &h) {
+    std::unique_lock<std::mutex> lk(mu_);
+    for (;;) {
+      cv_.wait(lk, [&] { return done_ || p_ != nullptr; });
+      if (p_ == nullptr)
+        return;
+      const uint8_t *p = p_;
+      size_t n = n_;
+      lk.unlock();
+      {
+        mcbe_perf::Scope perf("hash", n);
+        h.update(p, n);
+      }
+      lk.lock();
+      p_ = nullptr;
+      cv_.notify_all();
+    }
+  }
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  const uint8_t *p_ = nullptr;
+  size_t n_ = 0;
+  bool done_ = false;
+  std::thread thread_;
+};
+
+// inflate -> CFB-8 (unless key is empty) -> deflate, one window at a time.
+// With a hasher, each plaintext window is also hashed; with `overlap` on a
+// WindowHasher thread while the window is encrypted and compressed and the
+// next one is inflated into a second buffer. Inflate and AES time go into
+// `st` like the pipeline's.
+static void stream_entry(const ZipReader &zin, const ZipEntry &e,
+                         ZipWriter &zout, const std::string &key,
+                         const std::atomic<bool> *cancel, EncryptStats &st,
+                         mcbe_hash::Hasher *hasher = nullptr,
+                         bool overlap = false) {
+  // Declared before the hashing thread, which is joined first on unwinding
+  std::vector<uint8_t> bufs[2];
+  std::unique_ptr<WindowHasher> hashThread;
+  if (hasher && overlap)
+    hashThread.reset(new WindowHasher(*hasher));
+  bufs[0].resize(STREAM_WINDOW);
+  if (hashThread)
+    bufs[1].resize(STREAM_WINDOW);
+  mcbe_zip::EntryReader reader(zin, e);
+  std::unique_ptr<mcbe_cfb8::Stream> cfb;
+  if (!key.empty())
+    cfb.reset(new mcbe_cfb8::Stream((const uint8_t *)key.data(), false));
+  // The hashing thread still reads the window, so encrypt out of place
+  std::vector<uint8_t> enc;
+  if (cfb && hashThread)
+    enc.resize(STREAM_WINDOW);
+
+  zout.begin_file(e.name, true, e.uncompressedSize);
+  const bool deflated = e.method == mcbe_zip::METHOD_DEFLATED;
+  for (int cur = 0;; cur = hashThread ? cur ^ 1 : 0) {
+    uint8_t *buf = bufs[cur].data();
+    auto t = std::chrono::steady_clock::now();
+    size_t n = reader.read(buf, STREAM_WINDOW);
+    if (n == 0)
+      break;
+    if (deflated) {
+      st.inflateSeconds += seconds_since(t);
+      st.inflatedBytes += n;
+    }
+    throw_if_cancelled(cancel);
+    if (hashThread) {
+      // The previous window (the other buffer) is hashed by now, mostly
+      hashThread->wait();
+      hashThread->post(buf, n);
+    } else if (hasher) {
+      mcbe_perf::Scope perf("hash", n);
+      hasher->update(buf, n);
+    }
+
+    uint8_t *out = buf;
+    if (cfb) {
+      if (!enc.empty())
+        out = enc.data();
+      auto t = std::chrono::steady_clock::now();
+      cfb->update(buf, out, n);
+      st.encryptSeconds += seconds_since(t);
+      st.encryptedBytes += n;
+    }
+    zout.write(out, n);
+  }
+  if (hashThread)
+    hashThread->wait();
+  zout.end_file();
+}
+
+SpoolFile::~SpoolFile() {
+  std::error_code ec;
+  fs::remove(path, ec);
+}
+
+// ============================================
+// EncryptPipeline
+// ============================================
+
+EncryptPipeline::EncryptPipeline(const mcbe_zip::ZipReader &zin,
+                                 std::vector<PipelineEntry> entries,
+                                 const PipelineOptions &opts)
+    : zin_(zin), entries_(std::move(entries)), opts_(opts),
+      slots_(entries_.size()), start_(std::chrono::steady_clock::now()) {
+  unsigned threads = opts_.threads;
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = (unsigned)std::min<size_t>(threads, entries_.size());
+  opts_.threads = threads;
+
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    // Streamed entries are up for pickup at once, largest first; admit()
+    // skips them when it gets there
+    auto cmp = [this](size_t a, size_t b) { return before(a, b); };
+    for (size_t i = 0; i < entries_.size(); i++) {
+      if (streamed(i)) {
+        heap_.push_back(i);
+        std::push_heap(heap_.begin(), heap_.end(), cmp);
+      }
+    }
+    admit();
+  }
+  for (unsigned t = 0; t < threads; t++)
+    threads_.emplace_back([this]() { worker(); });
+}
+
+EncryptPipeline::~EncryptPipeline() {
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    stop_ = true;
+  }
+  workCv_.notify_all();
+  for (auto &t : threads_)
+    t.join();
+}
+
+bool EncryptPipeline::before(size_t a, size_t b) const {
+  // Largest first; among equal sizes, archive order
+  uint64_t sa = size_of(a), sb = size_of(b);
+  return sa != sb ? sa < sb : a > b;
+}
+
+// Moves entries into the heap while they fit in the window behind the
+// oldest entry the writer still has to take (always at least one)
+void EncryptPipeline::admit() {
+  auto cmp = [this](size_t a, size_t b) { return before(a, b); };
+  bool any = false;
+  while (admitted_ < entries_.size() &&
+         (admitted_ == taken_ ||
+          windowBytes_ + cost_of(admitted_) <= opts_.window)) {
+    size_t i = admitted_++;
+    if (streamed(i))
+      continue;
+    windowBytes_ += cost_of(i);
+    zin_.prefetch(*entries_[i].entry);
+    heap_.push_back(i);
+    std::push_heap(heap_.begin(), heap_.end(), cmp);
+    any = true;
+  }
+  if (any)
+    workCv_.notify_all();
+}
+
+void EncryptPipeline::worker() {
+  auto cmp = [this](size_t a, size_t b) { return before(a, b); };
+  for (;;) {
+    std::vector<size_t> batch;
+    {
+      std::unique_lock<std::mutex> lk(mu_);
+      workCv_.wait(lk, [this]() {
+        return stop_ || !heap_.empty() || admitted_ == entries_.size();
+      });
+      if (stop_ || heap_.empty()) {
+        // Nothing left to start: the time until the last worker gets
+        // here is the tail of the pack
+        double now = seconds_since(start_);
+        if (firstIdle_ < 0)
+          firstIdle_ = now;
+        lastDone_ = now;
+        return;
+      }
+
+      std::pop_heap(heap_.begin(), heap_.end(), cmp);
+      batch.push_back(heap_.back());
+      heap_.pop_back();
+
+      // The heap is largest-first, so once a small entry comes up only
+      // small ones are left: take a batch for the multi-lane kernel
+      uint64_t bytes = size_of(batch[0]);
+      while (bytes < SMALL_ENTRY && !streamed(batch[0]) && !heap_.empty() &&
+             !streamed(heap_.front()) &&
+             batch.size() < BATCH_FILES &&
+             bytes + size_of(heap_.front()) <= BATCH_BYTES) {
+        std::pop_heap(heap_.begin(), heap_.end(), cmp);
+        bytes += size_of(heap_.back());
+        batch.push_back(heap_.back());
+        heap_.pop_back();
+      }
+    }
+    if (streamed(batch[0]))
+      process_streamed(batch[0]);
+    else
+      process(batch);
+  }
+}
+
+void EncryptPipeline::process_streamed(size_t i) {
+  auto pickup = std::chrono::steady_clock::now();
+  const PipelineEntry &pe = entries_[i];
+  const ZipEntry &e = *pe.entry;
+  Slot done;
+  EncryptStats st;
+  try {
+    mcbe_perf::Scope perf("stream", e.uncompressedSize);
+    PipelineOutput &out = done.out;
+    if (!pe.copy && opts_.deterministic) {
+      uint8_t mac[16];
+      stream_content_mac(zin_, e, opts_.masterKey, mac, opts_.cancel);
+      out.key = derive_entry_key(opts_.masterKey, e.name, mac);
+    } else if (!pe.copy) {
+      out.key = random_key();
+    }
+
+    fs::path dir =
+        opts_.spoolDir.empty() ? fs::temp_directory_path() : opts_.spoolDir;
+    out.spool.reset(
+        new SpoolFile(dir / ("mcbe_spool_" + random_key() + ".zip")));
+    ZipWriter spool(out.spool->path);
+    spool.set_fixed_timestamp(opts_.deterministic);
+    if (opts_.hash) {
+      mcbe_hash::Hasher hasher;
+      stream_entry(zin_, e, spool, out.key, opts_.cancel, st, &hasher,
+                   opts_.threads != 1);
+      hasher.final(out.digest);
+    } else {
+      stream_entry(zin_, e, spool, out.key, opts_.cancel, st);
+    }
+    spool.finish();
+    out.size = e.uncompressedSize;
+  } catch (...) {
+    done.error = std::current_exception();
+  }
+
+  if (opts_.channel && !done.error)
+    opts_.channel->advance(1, done.out.size);
+
+  done.out.latency = seconds_since(pickup);
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    done.ready = true;
+    slots_[i] = std::move(done);
+    inflatedBytes_ += st.inflatedBytes;
+    inflateSeconds_ += st.inflateSeconds;
+    encryptedBytes_ += st.encryptedBytes;
+    encryptSeconds_ += st.encryptSeconds;
+  }
+  readyCv_.notify_all();
+}
+
+void EncryptPipeline::process(const std::vector<size_t> &batch) {
+  auto pickup = std::chrono::steady_clock::now();
+  std::vector<Slot> done(batch.size());
+  std::vector<std::vector<uint8_t>> data(batch.size());
+  double inflateSeconds = 0;
+  uint64_t inflatedBytes = 0;
+
+  for (size_t b = 0; b < batch.size(); b++) {
+    const PipelineEntry &pe = entries_[batch[b]];
+    try {
+      mcbe_perf::Scope perf("inflate", pe.entry->uncompressedSize);
+      auto t = std::chrono::steady_clock::now();
+      data[b] = zin_.read(*pe.entry);
+      if (pe.entry->method == mcbe_zip::METHOD_DEFLATED) {
+        inflateSeconds += seconds_since(t);
+        inflatedBytes += data[b].size();
+      }
+      if (opts_.hash) {
+        // Still plaintext here; large entries get the other cores too
+        size_t n = data[b].size();
+        mcbe_perf::Scope hashPerf("hash", n);
+        mcbe_hash::hash(data[b].data(), n, done[b].out.digest,
+                        n >= mcbe_hash::PARALLEL_MIN ? opts_.threads : 1);
+      }
+      if (!pe.copy) {
+        done[b].out.key = opts_.deterministic
+                              ? derive_entry_key(opts_.masterKey,
+                                                 pe.entry->name, data[b].data(),
+                                                 data[b].size())
+                              : random_key();
+      }
+    } catch (...) {
+      done[b].error = std::current_exception();
+    }
+  }
+
+  // Encrypt in place: one stream on its own, a batch interleaved
+  std::vector<mcbe_cfb8::Job> jobs;
+  uint64_t encryptedBytes = 0;
+  for (size_t b = 0; b < batch.size(); b++) {
+    if (done[b].error || entries_[batch[b]].copy)
+      continue;
+    jobs.push_back({(const uint8_t *)done[b].out.key.data(), data[b].data(),
+                    data[b].data(), data[b].size()});
+    encryptedBytes += data[b].size();
+  }
+  auto t = std::chrono::steady_clock::now();
+  {
+    mcbe_perf::Scope perf("aes", encryptedBytes);
+    if (jobs.size() == 1)
+      mcbe_cfb8::encrypt(jobs[0].key, jobs[0].in, jobs[0].out, jobs[0].len);
+    else if (!jobs.empty())
+      mcbe_cfb8::encrypt_many(jobs.data(), jobs.size());
+  }
+  double encryptSeconds = seconds_since(t);
+
+  for (size_t b = 0; b < batch.size(); b++) {
+    if (done[b].error)
+      continue;
+    try {
+      mcbe_perf::Scope perf("deflate", data[b].size());
+      PipelineOutput &out = done[b].out;
+      out.size = data[b].size();
+      out.crc32 = mcbe_zip::crc32(data[b].data(), data[b].size());
+      out.packed = mcbe_zip::deflate_raw(data[b].data(), data[b].size());
+    } catch (...) {
+      done[b].error = std::current_exception();
+    }
+    std::vector<uint8_t>().swap(data[b]);
+  }
+
+  if (opts_.channel) {
+    uint64_t bytes = 0;
+    for (size_t b = 0; b < batch.size(); b++)
+      bytes += done[b].out.size;
+    opts_.channel->advance(batch.size(), bytes);
+  }
+
+  double latency = seconds_since(pickup);
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    for (size_t b = 0; b < batch.size(); b++) {
+      done[b].out.latency = latency;
+      done[b].ready = true;
+      slots_[batch[b]] = std::move(done[b]);
+    }
+    inflatedBytes_ += inflatedBytes;
+    inflateSeconds_ += inflateSeconds;
+    encryptedBytes_ += encryptedBytes;
+    encryptSeconds_ += encryptSeconds;
+  }
+  readyCv_.notify_all();
+}
+
+PipelineOutput EncryptPipeline::take(size_t i) {
+  Slot slot;
+  {
+    std::unique_lock<std::mutex> lk(mu_);
+    readyCv_.wait(lk, [&]() { return slots_[i].ready; });
+    slot = std::move(slots_[i]);
+    windowBytes_ -= cost_of(i);
+    taken_ = i + 1;
+    admit();
+  }
+  if (slot.error)
+    std::rethrow_exception(slot.error);
+  return std::move(slot.out);
+}
+
+void EncryptPipeline::add_stats(EncryptStats &st) const {
+  std::lock_guard<std::mutex> lk(mu_);
+  st.inflatedBytes += inflatedBytes_;
+  st.inflateSeconds += inflateSeconds_;
+  st.encryptedBytes += encryptedBytes_;
+  st.encryptSeconds += encryptSeconds_;
+  st.threads = opts_.threads;
+  if (firstIdle_ >= 0)
+    st.tailSeconds = lastDone_ - firstIdle_;
+}
+
+} // namespace mcbe_pack
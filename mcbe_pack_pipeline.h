@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mcbe_hash.h"
+#include "mcbe_pack.h"
+#include "mcbe_progress.h"
+
+// Parallel part of encrypt_pack(): inflate, entry key, plaintext hash,
+// AES-256-CFB-8 and deflate of every entry. Entries from streamThreshold up
+// never exist in memory as a whole: a worker streams them window by window
+// into a one-entry spool ZIP on disk, which the writer copies over with
+// ZipWriter::add_raw().
+//
+// Packs are skewed (thousands of 1 KB JSON files next to a few huge
+// atlases), so workers don't take entries in archive order. Within a window
+// ahead of the writer they always pick the largest entry left, using the
+// central-directory sizes, so a big file never starts last and holds up the
+// whole pack. Streamed entries only cost a window of memory, so they are
+// all up for pickup from the start and start before anything else. Once
+// only small entries are left, a worker takes a batch of
+// them at a time and encrypts it through the multi-lane kernel
+// (mcbe_cfb8::encrypt_many). The writer still takes finished entries in
+// archive order, so the output doesn't depend on timing.
+
+namespace mcbe_pack {
+
+// Entries below this size (uncompressed) are encrypted in batches
+static constexpr uint64_t SMALL_ENTRY = 64 * 1024;
+static constexpr size_t BATCH_FILES = 64;
+static constexpr uint64_t BATCH_BYTES = 1024 * 1024;
+
+// Uncompressed bytes a worker may run ahead of the writer. This bounds
+// memory and is also the horizon of the longest-first order.
+static constexpr uint64_t SCHEDULE_WINDOW = 128ull * 1024 * 1024;
+
+struct PipelineEntry {
+  const mcbe_zip::ZipEntry *entry;
+  bool copy; // written as is (excluded root files)
+};
+
+// One-entry ZIP holding a streamed entry, encrypted and deflated; the file
+// is removed with this
+struct SpoolFile {
+  explicit SpoolFile(fs::path p) : path(std::move(p)) {}
+  ~SpoolFile();
+  SpoolFile(const SpoolFile &) = delete;
+  SpoolFile &operator=(const SpoolFile &) = delete;
+
+  fs::path path;
+};
+
+// A finished entry, ready for ZipWriter::add_deflated(), or for add_raw()
+// from the spool file if it was streamed
+struct PipelineOutput {
+  std::string key; // empty for copies
+  std::vector<uint8_t> packed;
+  std::unique_ptr<SpoolFile> spool; // streamed: packed is empty
+  uint32_t crc32 = 0;
+  uint64_t size = 0;
+  double latency = 0; // seconds from pickup to done
+  uint8_t digest[mcbe_hash::OUT_LEN] = {}; // plaintext, if hashing
+};
+
+struct PipelineOptions {
+  std::string masterKey;
+  bool deterministic = false;
+  unsigned threads = 0; // 0 = one per core
+  uint64_t window = SCHEDULE_WINDOW;
+  // Entries from here up are streamed into spool files under spoolDir
+  // (empty: the system temp directory)
+  uint64_t streamThreshold = STREAM_THRESHOLD;
+  fs::path spoolDir;
+  // Checked between windows of streamed entries
+  const std::atomic<bool> *cancel = nullptr;
+  // BLAKE3 of the plaintext into PipelineOutput::digest
+  bool hash = false;
+  // Counts entries as workers finish them, not as the writer takes them:
+  // with longest-first order the writer may wait on one entry for most of
+  // the pack
+  mcbe_progress::Channel *channel = nullptr;
+};
+
+class EncryptPipeline {
+public:
+  EncryptPipeline(const mcbe_zip::ZipReader &zin,
+                  std::vector<PipelineEntry> entries,
+                  const PipelineOptions &opts);
+  ~EncryptPipeline();
+
+  EncryptPipeline(const EncryptPipeline &) = delete;
+  EncryptPipeline &operator=(const EncryptPipeline &) = delete;
+
+  // Result for entries[i]; calls must come in order i = 0, 1, ... Blocks
+  // until the entry is done and rethrows its error.
+  PipelineOutput take(size_t i);
+
+  // Adds inflate/AES totals, thread count and tail time to `st`
+  void add_stats(EncryptStats &st) const;
+
+private:
+  struct Slot {
+    bool ready = false;
+    PipelineOutput out;
+    std::exception_ptr error;
+  };
+
+  uint64_t size_of(size_t i) const {
+    return entries_[i].entry->uncompressedSize;
+  }
+  bool streamed(size_t i) const { return size_of(i) >= opts_.streamThreshold; }
+  // What entry i holds in memory while it is admitted
+  uint64_t cost_of(size_t i) const { return streamed(i) ? 0 : size_of(i); }
+  bool before(size_t a, size_t b) const; // heap order: a is picked after b
+  void admit();
+  void worker();
+  void process(const std::vector<size_t> &batch);
+  void process_streamed(size_t i);
+
+  const mcbe_zip::ZipReader &zin_;
+  std::vector<PipelineEntry> entries_;
+  PipelineOptions opts_;
+  std::vector<Slot> slots_;
+
+  mutable std::mutex mu_;
+  std::condition_variable workCv_;  // workers: entries admitted / stop
+  std::condition_variable readyCv_; // writer: a slot became ready
+  std::vector<size_t> heap_;        // admitted, not yet picked up
+  size_t admitted_ = 0;             // entries [0, admitted_) were admitted
+  size_t taken_ = 0;                // entries [0, taken_) were taken
+  uint64_t windowBytes_ = 0;        // costs of [taken_, admitted_)
+  bool stop_ = false;
+
+  // Stats, under mu_
+  uint64_t inflatedBytes_ = 0;
+  double inflateSeconds_ = 0;
+  uint64_t encryptedBytes_ = 0;
+  double encryptSeconds_ = 0;
+  double firstIdle_ = -1; // seconds since start, when a worker ran dry
+  double lastDone_ = 0;   // same, when the last worker finished
+
+  std::chrono::steady_clock::time_point start_;
+  std::vector<std::thread> threads_;
+};
+
+} // namespace mcbe_pack
@@ -0,0 +1,165 @@
+#include "mcbe_pack_plan.h"
+
+#include <algorithm>
+#include <map>
+#include <thread>
+
+#include "mcbe_pack.h"
+
+namespace mcbe_pack {
+
+using mcbe_zip::ZipEntry;
+using mcbe_zip::ZipReader;
+
+// ============================================
+// Classification of one run of entries
+// ============================================
+
+namespace {
+
+struct Chunk {
+  std::vector<const ZipEntry *> dirs;
+  std::vector<const ZipEntry *> roots;    // subpack roots
+  std::vector<const ZipEntry *> files;    // root files
+  std::vector<const ZipEntry *> subFiles; // files under subpacks/
+  const ZipEntry *manifest = nullptr;
+};
+
+size_t depth(const std::string &n) {
+  return std::count(n.begin(), n.end(), '/');
+}
+
+// find_manifest_member()'s order: shallowest, then shortest, then first
+bool better_manifest(const ZipEntry *a, const ZipEntry *b) {
+  if (!b)
+    return true;
+  return std::make_pair(depth(a->name), a->name.size()) <
+         std::make_pair(depth(b->name), b->name.size());
+}
+
+void classify(const ZipEntry *first, const ZipEntry *last, Chunk &c) {
+  static const std::string kManifest = "manifest.json";
+  for (const ZipEntry *e = first; e != last; e++) {
+    const std::string &n = e->name;
+    if (n.size() >= kManifest.size() &&
+        n.compare(n.size() - kManifest.size(), kManifest.size(), kManifest) ==
+            0 &&
+        better_manifest(e, c.manifest))
+      c.manifest = e;
+
+    if (is_dir(n)) {
+      c.dirs.push_back(e);
+      if (is_subpack_root(n))
+        c.roots.push_back(e);
+    } else if (is_subpack_file(n)) {
+      c.subFiles.push_back(e);
+    } else {
+      c.files.push_back(e);
+    }
+  }
+}
+
+template <class T> void append(std::vector<T> &to, const std::vector<T> &from) {
+  to.insert(to.end(), from.begin(), from.end());
+}
+
+void sort_by_name(std::vector<const ZipEntry *> &v) {
+  std::stable_sort(v.begin(), v.end(),
+                   [](const ZipEntry *a, const ZipEntry *b) {
+                     return a->name < b->name;
+                   });
+}
+
+} // namespace
+
+// ============================================
+// plan_pack
+// ============================================
+
+PackPlan plan_pack(const ZipReader &z, const std::set<std::string> &excluded,
+                   bool sorted, unsigned threads) {
+  const std::vector<ZipEntry> &entries = z.entries();
+  const ZipEntry *base = entries.data();
+  size_t n = entries.size();
+
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  size_t chunks = n < PLAN_PARALLEL_MIN
+                      ? 1
+                      : std::min<size_t>(threads, n / (PLAN_PARALLEL_MIN / 2));
+  chunks = std::max<size_t>(chunks, 1);
+
+  std::vector<Chunk> parts(chunks);
+  auto range = [&](size_t i) { return base + n * i / chunks; };
+  if (chunks == 1) {
+    classify(base, base + n, parts[0]);
+  } else {
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < chunks; i++)
+      pool.emplace_back(
+          [&, i] { classify(range(i), range(i + 1), parts[i]); });
+    classify(range(0), range(1), parts[0]);
+    for (auto &t : pool)
+      t.join();
+  }
+
+  // Chunks are consecutive runs, so concatenating them keeps archive order
+  Chunk all;
+  for (const Chunk &c : parts) {
+    append(all.dirs, c.dirs);
+    append(all.roots, c.roots);
+    append(all.files, c.files);
+    append(all.subFiles, c.subFiles);
+    if (c.manifest && better_manifest(c.manifest, all.manifest))
+      all.manifest = c.manifest;
+  }
+  parts.clear();
+
+  PackPlan plan;
+  plan.sorted = sorted;
+  if (sorted) {
+    sort_by_name(all.dirs);
+    sort_by_name(all.roots);
+    sort_by_name(all.files);
+    sort_by_name(all.subFiles);
+  }
+
+  plan.directories = std::move(all.dirs);
+  for (const ZipEntry *e : all.files) {
+    bool copy = excluded.count(e->name) != 0;
+    plan.rootFiles.push_back({e, copy});
+    if (copy)
+      plan.excluded.push_back(e->name);
+    plan.bytes += e->uncompressedSize;
+  }
+
+  // A subpack file belongs to the root made of its first two components.
+  // A root listed twice gets its files twice, as the old per-root scan did.
+  std::map<std::string, std::vector<size_t>> byRoot;
+  for (const ZipEntry *e : all.roots) {
+    byRoot[e->name].push_back(plan.subpacks.size());
+    plan.subpacks.push_back({e, e->name, {}});
+  }
+  static const size_t kPrefix = std::string("subpacks/").size();
+  for (const ZipEntry *e : all.subFiles) {
+    size_t slash = e->name.find('/', kPrefix);
+    if (slash == std::string::npos)
+      continue;
+    auto it = byRoot.find(e->name.substr(0, slash + 1));
+    if (it == byRoot.end())
+      continue;
+    for (size_t i : it->second) {
+      plan.subpacks[i].files.push_back(e);
+      plan.bytes += e->uncompressedSize;
+    }
+  }
+
+  plan.files = plan.rootFiles.size();
+  for (const SubpackPlan &s : plan.subpacks)
+    plan.files += s.files.size();
+  plan.total = plan.files + 1 + plan.subpacks.size();
+  plan.uuid = read_manifest_uuid(z, all.manifest);
+  return plan;
+}
+
+} // namespace mcbe_pack
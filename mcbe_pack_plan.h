@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "mcbe_zip.h"
+
+// Everything encrypt_archive() (and encrypt.py through mcbe_native) needs to
+// know about a pack before touching any data, from one pass over the central
+// directory: directory entries, root files with their excluded flag,
+// subpack roots with their files, sizes and the manifest UUID. The pass is
+// split over threads for very large archives; chunks are merged in archive
+// order, so the plan is the same for any thread count.
+//
+// A plan is a plain value and isn't changed after plan_pack() returns. Its
+// entry pointers point into the ZipReader, which must outlive it.
+
+namespace mcbe_pack {
+
+// Archives with fewer entries are planned on the calling thread
+static constexpr size_t PLAN_PARALLEL_MIN = 32768;
+
+struct PlanFile {
+  const mcbe_zip::ZipEntry *entry;
+  bool copy; // excluded root file, written as is
+};
+
+struct SubpackPlan {
+  const mcbe_zip::ZipEntry *entry; // the root directory entry
+  std::string root;                // its name, "subpacks/<name>/"
+  std::vector<const mcbe_zip::ZipEntry *> files;
+};
+
+struct PackPlan {
+  std::string uuid; // header.uuid of the manifest, NULL_UUID if none
+  bool sorted = false;
+  std::vector<const mcbe_zip::ZipEntry *> directories;
+  std::vector<PlanFile> rootFiles;
+  std::vector<SubpackPlan> subpacks;
+  std::vector<std::string> excluded; // root files that are copied
+  size_t files = 0;  // root + subpack files
+  size_t total = 0;  // progress steps: files + one per contents.json
+  uint64_t bytes = 0; // uncompressed size of those files
+};
+
+// Groups keep archive order, or name order with `sorted` (deterministic
+// mode). Subpack roots are directory entries "subpacks/<name>/"; files
+// under subpacks/ outside any of them are left out, as before. The
+// manifest is picked like find_manifest_member() and read once; a missing
+// or unreadable one gives NULL_UUID. `threads` 0 means one per core.
+PackPlan plan_pack(const mcbe_zip::ZipReader &z,
+                   const std::set<std::string> &excluded, bool sorted = false,
+                   unsigned threads = 0);
+
+} // namespace mcbe_pack
@@ -0,0 +1,130 @@
+#include "mcbe_pack_reader.h"
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include "mcbe_cfb8.h"
+#include "mcbe_pack.h"
+
+namespace mcbe_pack {
+
+using mcbe_zip::ZipEntry;
+
+static const std::string kContents = "contents.json";
+
+void PackReader::open(const fs::path &zip, const std::string &masterKey) {
+  if (masterKey.size() != KEY_LEN)
+    throw std::runtime_error("Master key must be exactly " +
+                             std::to_string(KEY_LEN) + " characters.");
+  zip_.open(zip);
+  masterKey_ = masterKey;
+  index_.clear();
+  contentId_.clear();
+  // A re-opened reader indexes the new archive on first use
+  indexed_.reset(new std::once_flag());
+}
+
+void PackReader::build_index() const {
+  std::unordered_map<std::string, Asset> index;
+  index.reserve(zip_.entries().size());
+  for (auto const &e : zip_.entries()) {
+    if (!e.is_dir())
+      index[e.name].entry = &e;
+  }
+
+  // "contents.json" lists root files, "subpacks/<x>/contents.json" lists
+  // the files of that subpack relative to "subpacks/<x>/"
+  for (auto const &e : zip_.entries()) {
+    if (!is_contents_json_path(e.name))
+      continue;
+    std::string prefix = e.name.substr(0, e.name.size() - kContents.size());
+
+    std::vector<uint8_t> data = zip_.read(e);
+    ContentsJson doc = parse_contents_json(data.data(), data.size(), masterKey_);
+    if (prefix.empty())
+      contentId_ = doc.contentId;
+    for (auto &ce : doc.entries) {
+      auto it = index.find(prefix + ce.path);
+      if (it != index.end())
+        it->second.key = std::move(ce.key);
+    }
+  }
+
+  index_ = std::move(index);
+}
+
+void PackReader::ensure_index() const {
+  std::call_once(*indexed_, [this]() { build_index(); });
+}
+
+const PackReader::Asset &PackReader::find(const std::string &path) const {
+  ensure_index();
+  auto it = index_.find(path);
+  if (it == index_.end())
+    throw std::runtime_error("Asset not found in pack: " + path);
+  return it->second;
+}
+
+bool PackReader::contains(const std::string &path) const {
+  ensure_index();
+  return index_.count(path) != 0;
+}
+
+uint64_t PackReader::asset_size(const std::string &path) const {
+  return find(path).entry->uncompressedSize;
+}
+
+std::vector<uint8_t> PackReader::read(const std::string &path) const {
+  const Asset &a = find(path);
+  const ZipEntry &e = *a.entry;
+  if (a.key.empty())
+    return zip_.read(e);
+
+  const uint8_t *key = (const uint8_t *)a.key.data();
+  if (e.method == mcbe_zip::METHOD_STORED && !(e.flags & 1)) {
+    // Decrypt straight out of the mapping, no intermediate copy
+    const uint8_t *src = zip_.raw_data(e);
+    if (e.compressedSize != e.uncompressedSize)
+      throw std::runtime_error("Corrupt stored ZIP entry: " + e.name);
+    if (mcbe_zip::crc32(src, (size_t)e.compressedSize) != e.crc32)
+      throw std::runtime_error("Bad CRC-32 for ZIP entry: " + e.name);
+    std::vector<uint8_t> out((size_t)e.uncompressedSize);
+    mcbe_cfb8::decrypt(key, src, out.data(), out.size());
+    return out;
+  }
+
+  std::vector<uint8_t> out = zip_.read(e);
+  mcbe_cfb8::decrypt(key, out.data(), out.data(), out.size());
+  return out;
+}
+
+void PackReader::read_to(
+    const std::string &path,
+    const std::function<void(const uint8_t *, size_t)> &sink) const {
+  const Asset &a = find(path);
+  mcbe_zip::EntryReader reader(zip_, *a.entry);
+  std::unique_ptr<mcbe_cfb8::Stream> cfb;
+  if (!a.key.empty())
+    cfb.reset(new mcbe_cfb8::Stream((const uint8_t *)a.key.data(), true));
+
+  std::vector<uint8_t> buf(STREAM_WINDOW);
+  size_t n;
+  while ((n = reader.read(buf.data(), buf.size())) > 0) {
+    if (cfb)
+      cfb->update(buf.data(), buf.data(), n);
+    sink(buf.data(), n);
+  }
+}
+
+const std::string &PackReader::content_id() const {
+  ensure_index();
+  return contentId_;
+}
+
+size_t PackReader::size() const {
+  ensure_index();
+  return index_.size();
+}
+
+} // namespace mcbe_pack
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mcbe_zip.h"
+
+// Random access to single assets of an encrypted pack we hold the master
+// key for. The archive stays memory-mapped; contents.json (root and every
+// subpacks/<x>/contents.json) is decrypted once, on first use, into a hash
+// index of archive path -> (entry key, ZIP entry). A read() then inflates
+// and decrypts only the requested entry, so its cost depends on the asset,
+// not on the size of the pack.
+
+namespace mcbe_pack {
+
+namespace fs = std::filesystem;
+
+class PackReader {
+public:
+  PackReader() = default;
+  PackReader(const fs::path &zip, const std::string &masterKey) {
+    open(zip, masterKey);
+  }
+
+  PackReader(const PackReader &) = delete;
+  PackReader &operator=(const PackReader &) = delete;
+
+  // Maps the archive; contents.json is not touched yet
+  void open(const fs::path &zip, const std::string &masterKey);
+
+  // Archive paths ("textures/a.png", "subpacks/hi/textures/a.png")
+  bool contains(const std::string &path) const;
+
+  // Plaintext size of one asset, from the ZIP directory (CFB-8 keeps the
+  // length). Throws std::runtime_error if the path is not in the archive.
+  uint64_t asset_size(const std::string &path) const;
+
+  // Plaintext of one asset. Entries without a key (excluded files) and
+  // entries not listed in any contents.json are returned as stored.
+  // Throws std::runtime_error if the path is not in the archive.
+  std::vector<uint8_t> read(const std::string &path) const;
+
+  // read() in STREAM_WINDOW pieces, handed to `sink` in order, so memory
+  // stays bounded whatever the size of the asset. The CRC is checked after
+  // the last piece: on a mismatch sink has already seen the data and the
+  // call throws.
+  void read_to(const std::string &path,
+               const std::function<void(const uint8_t *, size_t)> &sink) const;
+
+  // Content id from the root contents.json header
+  const std::string &content_id() const;
+
+  // Number of indexed archive entries
+  size_t size() const;
+
+  const mcbe_zip::ZipReader &zip() const { return zip_; }
+
+private:
+  struct Asset {
+    const mcbe_zip::ZipEntry *entry = nullptr;
+    std::string key; // empty: not encrypted
+  };
+
+  void build_index() const;
+  void ensure_index() const;
+  const Asset &find(const std::string &path) const;
+
+  mcbe_zip::ZipReader zip_;
+  std::string masterKey_;
+
+  // Built lazily under call_once, so concurrent readers are fine
+  std::unique_ptr<std::once_flag> indexed_{new std::once_flag()};
+  mutable std::unordered_map<std::string, Asset> index_;
+  mutable std::string contentId_;
+};
+
+} // namespace mcbe_pack
@@ -0,0 +1,344 @@
+#include "mcbe_perf.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace mcbe_perf {
+
+static const char *const kNames[COUNTER_COUNT] = {
+    "cycles", "instructions", "LLC misses", "context switches"};
+
+const char *counter_name(Counter c) { return kNames[c]; }
+
+Counts &Counts::operator+=(const Counts &o) {
+  for (int c = 0; c < COUNTER_COUNT; c++)
+    value[c] += o.value[c];
+  seconds += o.seconds;
+  bytes += o.bytes;
+  return *this;
+}
+
+static std::atomic<bool> g_enabled(false);
+static bool g_available[COUNTER_COUNT];
+
+static std::mutex g_mu;
+static std::vector<std::string> g_stages; // order of first use
+static std::map<std::pair<std::string, unsigned>, Counts> g_rows;
+static unsigned g_nextThread = 1;
+
+static double now_seconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// ============================================
+// perf_event_open
+// ============================================
+
+#ifdef __linux__
+
+// Opens counter c for the calling thread, -1 with errno set on failure.
+// With group, it joins the group led by groupFd (starts one when that is
+// -1), read all at once through the leader.
+static int open_counter(Counter c, bool group = false, int groupFd = -1) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  switch (c) {
+  case CYCLES:
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    break;
+  case INSTRUCTIONS:
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    break;
+  case LLC_MISSES:
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    break;
+  default:
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+    break;
+  }
+  // Enabled time vs running time, to scale when the PMU is multiplexed
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  if (group)
+    attr.read_format |= PERF_FORMAT_GROUP;
+  attr.exclude_hv = 1;
+
+  // Kernel time counts too where allowed (context switches happen there);
+  // perf_event_paranoid >= 2 only permits user space
+  int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+  if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+    attr.exclude_kernel = 1;
+    fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+  }
+  return fd;
+}
+
+static uint64_t scaled(uint64_t value, uint64_t enabled, uint64_t running) {
+  if (running == 0)
+    return 0;
+  if (running < enabled)
+    return (uint64_t)((double)value * enabled / running);
+  return value;
+}
+
+static uint64_t read_counter(int fd) {
+  uint64_t buf[3];
+  if (read(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf))
+    return 0;
+  return scaled(buf[0], buf[1], buf[2]);
+}
+
+// Reads the n counters of the group led by fd, in the order they joined
+static void read_group(int fd, int n, uint64_t *out) {
+  // nr, time enabled, time running, then one value per counter
+  uint64_t buf[3 + COUNTER_COUNT];
+  ssize_t want = (ssize_t)((3 + n) * sizeof(uint64_t));
+  if (read(fd, buf, sizeof(buf)) != want || buf[0] != (uint64_t)n) {
+    memset(out, 0, n * sizeof(uint64_t));
+    return;
+  }
+  for (int i = 0; i < n; i++)
+    out[i] = scaled(buf[3 + i], buf[1], buf[2]);
+}
+
+static void close_counter(int fd) { close(fd); }
+
+#else
+
+static int open_counter(Counter, bool = false, int = -1) {
+  errno = ENOSYS;
+  return -1;
+}
+static uint64_t read_counter(int) { return 0; }
+static void read_group(int, int n, uint64_t *out) {
+  memset(out, 0, n * sizeof(uint64_t));
+}
+static void close_counter(int) {}
+
+#endif
+
+// Counters of one thread, opened on its first Scope. They form one group,
+// so the PMU schedules them together and every Scope reads cycles,
+// instructions and misses over the same intervals; a counter that can't
+// join the group is counted on its own.
+struct ThreadCounters {
+  int fd[COUNTER_COUNT];
+  int slot[COUNTER_COUNT]; // position in the group read, -1 when on its own
+  int leader = -1;
+  int members = 0;
+  unsigned id = 0;
+
+  ThreadCounters() {
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+      fd[c] = -1;
+      slot[c] = -1;
+      if (!g_available[c])
+        continue;
+      fd[c] = open_counter((Counter)c, true, leader);
+      if (fd[c] >= 0) {
+        if (leader < 0)
+          leader = fd[c];
+        slot[c] = members++;
+      } else if (leader >= 0) {
+        fd[c] = open_counter((Counter)c);
+      }
+    }
+    std::lock_guard<std::mutex> lk(g_mu);
+    id = g_nextThread++;
+  }
+  ~ThreadCounters() {
+    // Members before the leader
+    for (int c = COUNTER_COUNT - 1; c >= 0; c--)
+      if (fd[c] >= 0)
+        close_counter(fd[c]);
+  }
+
+  void read(uint64_t out[COUNTER_COUNT]) const {
+    uint64_t group[COUNTER_COUNT];
+    if (leader >= 0)
+      read_group(leader, members, group);
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+      if (slot[c] >= 0)
+        out[c] = group[slot[c]];
+      else
+        out[c] = fd[c] >= 0 ? read_counter(fd[c]) : 0;
+    }
+  }
+};
+
+static ThreadCounters &thread_counters() {
+  thread_local ThreadCounters tc;
+  return tc;
+}
+
+bool enable(std::string *why) {
+  std::string reasons, missing;
+  bool any = false;
+  for (int c = 0; c < COUNTER_COUNT; c++) {
+    int fd = open_counter((Counter)c);
+    g_available[c] = fd >= 0;
+    if (fd >= 0) {
+      close_counter(fd);
+      any = true;
+      continue;
+    }
+    if (reasons.empty())
+      reasons = std::string("perf_event_open: ") + strerror(errno);
+    missing += (missing.empty() ? "" : ", ") + std::string(kNames[c]);
+  }
+  if (why)
+    why->clear();
+  if (any && !missing.empty() && why)
+    *why = "no " + missing + " (" + reasons + ")";
+  if (!any) {
+#ifdef __linux__
+    if (why)
+      *why = reasons + " (no PMU, or kernel.perf_event_paranoid too high)";
+#else
+    if (why)
+      *why = "perf_event_open is only available on Linux";
+#endif
+    return false;
+  }
+  g_enabled = true;
+  return true;
+}
+
+bool enabled() { return g_enabled; }
+
+bool available(Counter c) { return g_available[c]; }
+
+// ============================================
+// Scope
+// ============================================
+
+Scope::Scope(const char *stage, uint64_t bytes)
+    : stage_(stage), bytes_(bytes), active_(g_enabled), startTime_(0) {
+  if (!active_)
+    return;
+  thread_counters().read(start_);
+  startTime_ = now_seconds();
+}
+
+Scope::~Scope() {
+  if (!active_)
+    return;
+  ThreadCounters &tc = thread_counters();
+  uint64_t end[COUNTER_COUNT];
+  tc.read(end);
+  double seconds = now_seconds() - startTime_;
+
+  std::lock_guard<std::mutex> lk(g_mu);
+  auto key = std::make_pair(std::string(stage_), tc.id);
+  auto it = g_rows.find(key);
+  if (it == g_rows.end()) {
+    bool seen = false;
+    for (auto const &s : g_stages)
+      seen = seen || s == key.first;
+    if (!seen)
+      g_stages.push_back(key.first);
+    it = g_rows.emplace(key, Counts()).first;
+  }
+  Counts &row = it->second;
+  for (int c = 0; c < COUNTER_COUNT; c++)
+    row.value[c] += end[c] >= start_[c] ? end[c] - start_[c] : 0;
+  row.seconds += seconds;
+  row.bytes += bytes_;
+}
+
+// ============================================
+// Report
+// ============================================
+
+std::vector<Row> report() {
+  std::lock_guard<std::mutex> lk(g_mu);
+  std::vector<Row> rows;
+  for (auto const &stage : g_stages) {
+    for (auto const &kv : g_rows) {
+      if (kv.first.first == stage)
+        rows.push_back({stage, kv.first.second, kv.second});
+    }
+  }
+  return rows;
+}
+
+static std::string format_count(Counter c, uint64_t v) {
+  if (!g_available[c])
+    return "n/a";
+  std::ostringstream s;
+  if (v >= 10000000000ull)
+    s << std::fixed << std::setprecision(1) << v / 1e9 << "G";
+  else if (v >= 10000000ull)
+    s << std::fixed << std::setprecision(1) << v / 1e6 << "M";
+  else
+    s << v;
+  return s.str();
+}
+
+static void print_row(std::ostream &os, const std::string &stage,
+                      const std::string &thread, const Counts &c) {
+  std::ostringstream mbs, ipc;
+  if (c.bytes && c.seconds > 0)
+    mbs << std::fixed << std::setprecision(1) << c.bytes / c.seconds / 1e6;
+  else
+    mbs << "-";
+  if (g_available[CYCLES] && g_available[INSTRUCTIONS])
+    ipc << std::fixed << std::setprecision(2) << c.ipc();
+  else
+    ipc << "n/a";
+
+  std::ostringstream secs;
+  secs << std::fixed << std::setprecision(3) << c.seconds << "s";
+  os << "    " << std::left << std::setw(10) << stage << std::right
+     << std::setw(7) << thread << std::setw(10) << secs.str() << std::setw(9)
+     << mbs.str() << std::setw(10) << format_count(CYCLES, c.value[CYCLES])
+     << std::setw(10) << format_count(INSTRUCTIONS, c.value[INSTRUCTIONS])
+     << std::setw(6) << ipc.str() << std::setw(10)
+     << format_count(LLC_MISSES, c.value[LLC_MISSES]) << std::setw(8)
+     << format_count(CONTEXT_SWITCHES, c.value[CONTEXT_SWITCHES]) << "\n";
+}
+
+void print_report(std::ostream &os) {
+  std::vector<Row> rows = report();
+  os << "    " << std::left << std::setw(10) << "stage" << std::right
+     << std::setw(7) << "thread" << std::setw(10) << "time" << std::setw(9)
+     << "MB/s" << std::setw(10) << "cycles" << std::setw(10) << "instr"
+     << std::setw(6) << "IPC" << std::setw(10) << "LLC miss" << std::setw(8)
+     << "ctx sw"
+     << "\n";
+
+  for (size_t i = 0; i < rows.size();) {
+    size_t j = i;
+    Counts total;
+    for (; j < rows.size() && rows[j].stage == rows[i].stage; j++) {
+      print_row(os, rows[j].stage, std::to_string(rows[j].thread),
+                rows[j].counts);
+      total += rows[j].counts;
+    }
+    if (j - i > 1)
+      print_row(os, rows[i].stage, "all", total);
+    i = j;
+  }
+  os << std::flush;
+}
+
+} // namespace mcbe_perf
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Hardware performance counters for the native tools (--perf-counters).
+//
+// Code marks stages with Scope; while counting is enabled, each thread
+// counts cycles, instructions, last-level cache misses and context switches
+// of its own work through perf_event_open (Linux), as one counter group read
+// in a single call, and adds them to the (stage, thread) row of the report. Counters the kernel or CPU doesn't
+// provide (no PMU in a VM, perf_event_paranoid, other OSes) are reported as
+// n/a; with none at all enable() fails and Scope stays a no-op.
+
+namespace mcbe_perf {
+
+enum Counter {
+  CYCLES,
+  INSTRUCTIONS,
+  LLC_MISSES,
+  CONTEXT_SWITCHES,
+  COUNTER_COUNT
+};
+
+const char *counter_name(Counter c);
+
+struct Counts {
+  uint64_t value[COUNTER_COUNT] = {};
+  double seconds = 0; // wall time inside the scopes
+  uint64_t bytes = 0; // payload, for MB/s
+
+  double ipc() const {
+    return value[CYCLES] ? (double)value[INSTRUCTIONS] / value[CYCLES] : 0;
+  }
+  Counts &operator+=(const Counts &o);
+};
+
+// Starts counting for Scopes entered from now on. Returns false, with the
+// reason in *why, when no counter can be opened; when only some can, returns
+// true and lists the missing ones in *why.
+bool enable(std::string *why = nullptr);
+bool enabled();
+
+// Whether counter c could be opened (meaningful after enable())
+bool available(Counter c);
+
+// Counts the calling thread from construction to destruction
+class Scope {
+public:
+  explicit Scope(const char *stage, uint64_t bytes = 0);
+  ~Scope();
+
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+  void add_bytes(uint64_t n) { bytes_ += n; }
+
+private:
+  const char *stage_;
+  uint64_t bytes_;
+  bool active_;
+  uint64_t start_[COUNTER_COUNT];
+  double startTime_;
+};
+
+struct Row {
+  std::string stage;
+  unsigned thread; // 1, 2, ... in order of first use
+  Counts counts;
+};
+
+// Totals so far, by stage (in order of first use) and thread
+std::vector<Row> report();
+
+// Table of report() with a per-stage total row when several threads
+// worked on a stage
+void print_report(std::ostream &os);
+
+} // namespace mcbe_perf
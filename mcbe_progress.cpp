@@ -0,0 +1,140 @@
+#include "mcbe_progress.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace mcbe_progress {
+
+Channel::Channel(size_t capacity) {
+  size_t n = 1;
+  while (n < std::max<size_t>(capacity, 2))
+    n <<= 1;
+  ring_.reset(new Slot[n]);
+  for (size_t i = 0; i < n; i++)
+    ring_[i].seq.store(i, std::memory_order_relaxed);
+  mask_ = n - 1;
+}
+
+// ============================================
+// Log ring (bounded MPMC queue after Vyukov, one consumer here)
+// ============================================
+//
+// Slot i of lap L has seq == i + L * size when free for that lap's producer
+// and i + L * size + 1 once its line is in. A producer claims a ticket with
+// a CAS on head_; a slot still holding last lap's line means the ring is
+// full and the line is dropped.
+
+void Channel::log(const std::string &line) {
+  uint64_t pos = head_.load(std::memory_order_relaxed);
+  for (;;) {
+    Slot &s = ring_[pos & mask_];
+    uint64_t seq = s.seq.load(std::memory_order_acquire);
+    int64_t dif = (int64_t)(seq - pos);
+    if (dif == 0) {
+      if (head_.compare_exchange_weak(pos, pos + 1,
+                                      std::memory_order_relaxed)) {
+        size_t n = std::min(line.size(), LINE_BYTES);
+        while (n < line.size() && n > 0 && (line[n] & 0xC0) == 0x80)
+          n--; // don't cut a UTF-8 sequence
+        memcpy(s.text, line.data(), n);
+        s.len = (uint32_t)n;
+        s.seq.store(pos + 1, std::memory_order_release);
+        return;
+      }
+    } else if (dif < 0) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      pos = head_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+size_t Channel::drain(std::vector<std::string> &out, size_t max) {
+  size_t n = 0;
+  uint64_t pos = tail_.load(std::memory_order_relaxed);
+  while (n < max) {
+    Slot &s = ring_[pos & mask_];
+    if (s.seq.load(std::memory_order_acquire) != pos + 1)
+      break;
+    out.emplace_back(s.text, s.len);
+    s.seq.store(pos + mask_ + 1, std::memory_order_release);
+    pos++;
+    n++;
+  }
+  tail_.store(pos, std::memory_order_relaxed);
+  return n;
+}
+
+// ============================================
+// Phase and snapshot
+// ============================================
+
+void Channel::set_phase(const std::string &phase) {
+  char buf[PHASE_BYTES] = {};
+  size_t n = std::min(phase.size(), PHASE_BYTES);
+  while (n < phase.size() && n > 0 && (phase[n] & 0xC0) == 0x80)
+    n--;
+  memcpy(buf, phase.data(), n);
+
+  // Calls are ordered by ticket; one that finds a later call's phase
+  // already written has nothing left to do
+  uint64_t ticket = phaseTicket_.fetch_add(1, std::memory_order_relaxed) + 1;
+  uint64_t seq;
+  for (;;) {
+    seq = phaseSeq_.load(std::memory_order_relaxed);
+    // Another writer is copying its 64 bytes
+    if (seq & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (phaseSeq_.compare_exchange_weak(seq, seq + 1,
+                                        std::memory_order_acquire))
+      break;
+  }
+  if (phaseVersion_ > ticket) {
+    // Nothing was written: readers that saw `seq` are still right
+    phaseSeq_.store(seq, std::memory_order_release);
+    return;
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+
+  for (size_t i = 0; i < PHASE_WORDS; i++) {
+    uint64_t w;
+    memcpy(&w, buf + 8 * i, 8);
+    phase_[i].store(w, std::memory_order_relaxed);
+  }
+  phaseVersion_ = ticket;
+  phaseSeq_.store(seq + 2, std::memory_order_release);
+}
+
+Snapshot Channel::snapshot() const {
+  Snapshot s;
+  char buf[PHASE_BYTES];
+  for (;;) {
+    uint64_t before = phaseSeq_.load(std::memory_order_acquire);
+    if (before & 1)
+      continue;
+    for (size_t i = 0; i < PHASE_WORDS; i++) {
+      uint64_t w = phase_[i].load(std::memory_order_relaxed);
+      memcpy(buf + 8 * i, &w, 8);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (phaseSeq_.load(std::memory_order_relaxed) == before)
+      break;
+  }
+  s.phase.assign(buf, strnlen(buf, PHASE_BYTES));
+
+  s.finished = finished_.load(std::memory_order_acquire);
+  s.done = done_.load(std::memory_order_relaxed);
+  s.total = total_.load(std::memory_order_relaxed);
+  s.bytes = bytes_.load(std::memory_order_relaxed);
+  s.dropped = dropped_.load(std::memory_order_relaxed);
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  uint64_t tail = tail_.load(std::memory_order_relaxed);
+  s.pending = head > tail ? head - tail : 0;
+  return s;
+}
+
+} // namespace mcbe_progress
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Progress and log channel between an encryption run and whatever shows it.
+//
+// The engine only bumps atomic counters and pushes lines into a bounded
+// lock-free ring; nothing it does waits on a consumer. Front ends (the Tk
+// GUI through mcbe_native, the web UI through app.py, mcbe_encrypt's status
+// line) call snapshot() and drain() on a timer, so a 50k-entry pack costs
+// them the same few updates per second as a small one. Per-file lines are
+// only pushed while file logging is on. A full ring drops new lines and
+// counts them instead of blocking.
+
+namespace mcbe_progress {
+
+// Longer log lines are cut to this many bytes
+static constexpr size_t LINE_BYTES = 240;
+static constexpr size_t PHASE_BYTES = 64;
+static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+struct Snapshot {
+  uint64_t done = 0;  // files (and metadata entries) written
+  uint64_t total = 0; // 0 until known
+  uint64_t bytes = 0; // uncompressed bytes written
+  std::string phase;
+  uint64_t pending = 0; // lines waiting in the ring
+  uint64_t dropped = 0; // lines lost to a full ring so far
+  bool finished = false;
+};
+
+class Channel {
+public:
+  // `capacity` is rounded up to a power of two
+  explicit Channel(size_t capacity = DEFAULT_CAPACITY);
+
+  Channel(const Channel &) = delete;
+  Channel &operator=(const Channel &) = delete;
+
+  // Producers: any thread, never wait for the consumer
+
+  void log(const std::string &line);
+
+  // Whether per-file lines are wanted; checked by the engine before it
+  // formats one. The consumer may switch it at any time.
+  bool file_log() const { return fileLog_.load(std::memory_order_relaxed); }
+  void set_file_log(bool on) {
+    fileLog_.store(on, std::memory_order_relaxed);
+  }
+
+  // The phase of the last call wins; calls that race wait for each other's
+  // 64-byte copy
+  void set_phase(const std::string &phase);
+  // Totals add up, so several packs can report into one channel
+  void add_total(uint64_t n) {
+    total_.fetch_add(n, std::memory_order_relaxed);
+  }
+  void advance(uint64_t files, uint64_t bytes = 0) {
+    done_.fetch_add(files, std::memory_order_relaxed);
+    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+  void finish() { finished_.store(true, std::memory_order_release); }
+
+  // Consumer: one thread at a time
+
+  Snapshot snapshot() const;
+
+  // Moves up to `max` queued lines to `out`; returns how many
+  size_t drain(std::vector<std::string> &out, size_t max = SIZE_MAX);
+
+private:
+  struct Slot {
+    std::atomic<uint64_t> seq;
+    uint32_t len;
+    char text[LINE_BYTES];
+  };
+  static constexpr size_t PHASE_WORDS = PHASE_BYTES / 8;
+
+  std::unique_ptr<Slot[]> ring_;
+  uint64_t mask_;
+  alignas(64) std::atomic<uint64_t> head_{0}; // next ticket for a producer
+  alignas(64) std::atomic<uint64_t> tail_{0}; // next slot for the consumer
+  alignas(64) std::atomic<uint64_t> done_{0};
+  std::atomic<uint64_t> total_{0};
+  std::atomic<uint64_t> bytes_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<bool> fileLog_{false};
+  std::atomic<bool> finished_{false};
+
+  // Seqlock over the phase name, odd while a write is in progress
+  std::atomic<uint64_t> phaseSeq_{0};
+  std::atomic<uint64_t> phaseTicket_{0}; // set_phase() calls so far
+  uint64_t phaseVersion_ = 0; // ticket of the phase in phase_ (under the lock)
+  std::atomic<uint64_t> phase_[PHASE_WORDS] = {};
+};
+
+} // namespace mcbe_progress
@@ -0,0 +1,119 @@
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "mcbe_pack.h"
+
+namespace fs = std::filesystem;
+
+static std::atomic<bool> g_stop(false);
+
+static void print_usage() {
+    std::cout
+        << "Usage:\n"
+        << "  mcbe_rotate <pack_encrypted.zip> <old key|keyfile> [output_dir] [options]\n\n"
+        << "Options:\n"
+        << "  --new-key <32 chars>   New master key (default: random)\n"
+        << "  --quiet                Only print the summary\n\n"
+        << "Re-encrypts every contents.json with the new master key and copies all\n"
+        << "other entries as they are; assets are neither inflated nor decrypted.\n"
+        << "Without output_dir the pack and its <name>.zip.key are replaced in place.\n";
+}
+
+static void on_signal(int) {
+    g_stop = true;
+}
+
+// 32-character master key, or the path of a .zip.key file holding one
+static std::string load_master_key(const std::string& arg) {
+    if (arg.size() == mcbe_pack::KEY_LEN && !fs::exists(fs::u8path(arg))) return arg;
+    return mcbe_pack::read_key_file(fs::u8path(arg));
+}
+
+int main(int argc, char** argv) {
+    try {
+        std::cout << "[*] MCBE Resource Pack Master Key Rotation (C++)" << std::endl;
+
+        fs::path inputPath;
+        std::string oldKeyArg;
+        fs::path outputDir;
+        std::string newKey;
+        bool quiet = false;
+
+        for (int i = 1; i < argc; i++) {
+            std::string a = argv[i];
+            if (a == "--new-key" && i + 1 < argc) {
+                newKey = argv[++i];
+            } else if (a == "--quiet") {
+                quiet = true;
+            } else if (a == "-h" || a == "--help") {
+                print_usage();
+                return 0;
+            } else if (!a.empty() && a[0] == '-') {
+                std::cerr << "[ERROR] Unknown option: " << a << std::endl;
+                print_usage();
+                return 2;
+            } else if (inputPath.empty()) {
+                inputPath = fs::u8path(a);
+            } else if (oldKeyArg.empty()) {
+                oldKeyArg = a;
+            } else if (outputDir.empty()) {
+                outputDir = fs::u8path(a);
+            } else {
+                print_usage();
+                return 2;
+            }
+        }
+
+        if (inputPath.empty() || oldKeyArg.empty()) {
+            print_usage();
+            return 2;
+        }
+        if (outputDir.empty()) outputDir = inputPath.parent_path();
+        if (outputDir.empty()) outputDir = ".";
+        if (newKey.empty()) newKey = mcbe_pack::random_key();
+        fs::create_directories(outputDir);
+
+        // <name>_encrypted.zip pairs with <name>.zip.key
+        std::string stem = inputPath.stem().u8string();
+        const std::string suffix = "_encrypted";
+        if (stem.size() > suffix.size() && stem.compare(stem.size() - suffix.size(), suffix.size(), suffix) == 0)
+            stem.resize(stem.size() - suffix.size());
+
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
+
+        mcbe_pack::RotateOptions opts;
+        opts.inputZip = inputPath;
+        opts.outputZip = outputDir / inputPath.filename();
+        opts.keyFile = outputDir / fs::u8path(stem + ".zip.key");
+        opts.oldMasterKey = load_master_key(oldKeyArg);
+        opts.newMasterKey = newKey;
+
+        std::cout << "[*] Input: " << inputPath.u8string() << std::endl;
+        std::cout << "[*] Output: " << opts.outputZip.u8string() << std::endl;
+
+        auto start = std::chrono::steady_clock::now();
+        mcbe_pack::rotate_master_key(
+            opts,
+            [&](const std::string& msg) {
+                if (!quiet) std::cout << "  " << msg << "\n";
+            },
+            {},
+            &g_stop);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::uintmax_t outBytes = fs::file_size(opts.outputZip);
+        std::cout << "[OK] Rotated in " << std::fixed << std::setprecision(3) << elapsed << "s"
+                  << " (" << std::setprecision(1) << (elapsed > 0 ? outBytes / elapsed / 1e6 : 0.0)
+                  << " MB/s copied)" << std::endl;
+        std::cout << "[*] New key file: " << opts.keyFile.u8string() << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "\n[ERROR] " << e.what() << std::endl;
+        return 3;
+    }
+}
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "mcbe_pack.h"
+#include "mcbe_pack_audit.h"
+#include "mcbe_pack_hashes.h"
+
+namespace fs = std::filesystem;
+
+static void print_usage() {
+    std::cout
+        << "Usage:\n"
+        << "  mcbe_verify <pack_encrypted.zip> <key|keyfile> [hashes] [--threads <n>]\n"
+        << "  mcbe_verify --diff <from> <to> [--threads <n>]\n\n"
+        << "The first form decrypts every entry and compares it with the plaintext\n"
+        << "digests mcbe_encrypt wrote to <name>.zip.hashes (default: next to the\n"
+        << "key file).\n\n"
+        << "--diff compares two builds without decrypting anything. <from> and <to>\n"
+        << "are .hashes files or unencrypted packs (.zip/.mcpack or a directory),\n"
+        << "which are hashed on the fly.\n\n"
+        << "Exit code 0 if everything matches, 1 if not.\n";
+}
+
+// 32-character master key, or the path of a .zip.key file holding one
+static std::string load_master_key(const std::string& arg) {
+    if (arg.size() == mcbe_pack::KEY_LEN && !fs::exists(fs::u8path(arg))) return arg;
+    return mcbe_pack::read_key_file(fs::u8path(arg));
+}
+
+static mcbe_pack::HashSidecar load_side(const fs::path& p, unsigned threads) {
+    if (p.extension() == ".hashes") return mcbe_pack::read_hash_sidecar(p);
+    std::cout << "[*] Hashing " << p.u8string() << std::endl;
+    return mcbe_pack::hash_source(p, threads);
+}
+
+static void print_list(const char* tag, const std::vector<std::string>& paths) {
+    for (auto const& p : paths) std::cout << "  " << tag << " " << p << "\n";
+}
+
+int main(int argc, char** argv) {
+    try {
+        std::vector<std::string> args;
+        bool diff = false;
+        unsigned threads = 0;
+        for (int i = 1; i < argc; i++) {
+            std::string a = argv[i];
+            if (a == "--diff") {
+                diff = true;
+            } else if (a == "--threads" && i + 1 < argc) {
+                threads = (unsigned)std::max(1, std::stoi(argv[++i]));
+            } else if (a == "-h" || a == "--help") {
+                print_usage();
+                return 0;
+            } else if (!a.empty() && a[0] == '-') {
+                std::cerr << "[ERROR] Unknown option: " << a << std::endl;
+                print_usage();
+                return 2;
+            } else {
+                args.push_back(a);
+            }
+        }
+
+        if (diff) {
+            if (args.size() != 2) {
+                print_usage();
+                return 2;
+            }
+            mcbe_pack::HashSidecar from = load_side(fs::u8path(args[0]), threads);
+            mcbe_pack::HashSidecar to = load_side(fs::u8path(args[1]), threads);
+            mcbe_pack::HashDiff d = mcbe_pack::diff_hashes(from, to);
+            print_list("+", d.added);
+            print_list("-", d.removed);
+            print_list("M", d.changed);
+            if (d.empty()) {
+                std::cout << "[OK] Identical (" << to.entries.size() << " entries)" << std::endl;
+                return 0;
+            }
+            std::cout << "[*] " << d.added.size() << " added, " << d.removed.size() << " removed, "
+                      << d.changed.size() << " changed" << std::endl;
+            return 1;
+        }
+
+        if (args.size() < 2 || args.size() > 3) {
+            print_usage();
+            return 2;
+        }
+        fs::path zip = fs::u8path(args[0]);
+        fs::path hashFile;
+        if (args.size() == 3) {
+            hashFile = fs::u8path(args[2]);
+        } else {
+            fs::path keyFile = fs::u8path(args[1]);
+            if (args[1].size() == mcbe_pack::KEY_LEN && !fs::exists(keyFile))
+                keyFile = mcbe_pack::find_key_file(zip);
+            if (keyFile.empty()) throw std::runtime_error("No hash file given and no .zip.key next to the pack.");
+            hashFile = mcbe_pack::hash_sidecar_path(keyFile);
+        }
+
+        mcbe_pack::HashSidecar expected = mcbe_pack::read_hash_sidecar(hashFile);
+        std::cout << "[*] Pack: " << zip.u8string() << std::endl;
+        std::cout << "[*] Hash file: " << hashFile.u8string() << " (" << expected.entries.size()
+                  << " entries)" << std::endl;
+        mcbe_pack::VerifyResult r = mcbe_pack::verify_pack(zip, load_master_key(args[1]), expected, threads);
+        print_list("M", r.mismatched);
+        print_list("-", r.missing);
+        print_list("+", r.extra);
+        if (r.ok()) {
+            std::cout << "[OK] " << r.checked << " entries match" << std::endl;
+            return 0;
+        }
+        std::cout << "[*] " << r.mismatched.size() << " mismatched, " << r.missing.size() << " missing, "
+                  << r.extra.size() << " not in the hash file" << std::endl;
+        return 1;
+    } catch (const std::exception& e) {
+        std::cerr << "\n[ERROR] " << e.what() << std::endl;
+        return 3;
+    }
+}
@@ -0,0 +1,55 @@
+// WebAssembly exports of the CFB-8 engine for static/mcbe_wasm.js.
+// Built twice by the EMSCRIPTEN branch of CMakeLists.txt: mcbe_wasm.wasm
+// (SoftBackend) and mcbe_wasm_simd.wasm (Simd128Backend, -msimd128).
+// Plain C ABI on pointers into linear memory, no Emscripten JS glue.
+
+#include <cstdlib>
+#include <new>
+
+#include "mcbe_cfb8.h"
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/emscripten.h>
+#define MCBE_WASM_EXPORT extern "C" EMSCRIPTEN_KEEPALIVE
+#else
+#define MCBE_WASM_EXPORT extern "C"
+#endif
+
+// JS writes crypt_many() jobs as 4 pointer-sized words each
+static_assert(sizeof(mcbe_cfb8::Job) == 4 * sizeof(void *),
+              "Job layout assumed by mcbe_wasm.js");
+
+MCBE_WASM_EXPORT const char *mcbe_wasm_backend() {
+  return mcbe_cfb8::backend_name();
+}
+
+MCBE_WASM_EXPORT void *mcbe_wasm_alloc(size_t n) { return malloc(n); }
+
+MCBE_WASM_EXPORT void mcbe_wasm_free(void *p) { free(p); }
+
+// Incremental CFB-8 with IV = key[:16]; returns nullptr when out of memory
+MCBE_WASM_EXPORT mcbe_cfb8::Stream *mcbe_wasm_stream_new(const uint8_t *key,
+                                                         int decrypt) {
+  void *p = malloc(sizeof(mcbe_cfb8::Stream));
+  return p ? new (p) mcbe_cfb8::Stream(key, decrypt != 0) : nullptr;
+}
+
+// in == out is allowed
+MCBE_WASM_EXPORT void mcbe_wasm_stream_update(mcbe_cfb8::Stream *s,
+                                              const uint8_t *in, uint8_t *out,
+                                              size_t len) {
+  s->update(in, out, len);
+}
+
+MCBE_WASM_EXPORT void mcbe_wasm_stream_free(mcbe_cfb8::Stream *s) {
+  if (s) {
+    s->~Stream();
+    free(s);
+  }
+}
+
+// Independent messages interleaved in the multi-lane kernel
+MCBE_WASM_EXPORT void mcbe_wasm_crypt_many(const mcbe_cfb8::Job *jobs,
+                                           size_t n, int decrypt) {
+  mcbe_cfb8::select().crypt_many(jobs, n, decrypt != 0);
+}
@@ -0,0 +1,1080 @@
+#include "mcbe_zip.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+#include "mcbe_inflate.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mcbe_zip {
+
+static constexpr uint32_t SIG_LOCAL = 0x04034b50;
+static constexpr uint32_t SIG_CENTRAL = 0x02014b50;
+static constexpr uint32_t SIG_EOCD = 0x06054b50;
+static constexpr uint32_t SIG_DESCRIPTOR = 0x08074b50;
+static constexpr uint32_t SIG_ZIP64_EOCD = 0x06064b50;
+static constexpr uint32_t SIG_ZIP64_LOCATOR = 0x07064b50;
+
+// Header ID of the ZIP64 extended information extra field
+static constexpr uint16_t EXTRA_ZIP64 = 0x0001;
+
+// 32-bit size/offset and 16-bit count fields saturate at these values;
+// the real number then lives in a ZIP64 record
+static constexpr uint64_t MAX32 = 0xFFFFFFFFull;
+static constexpr uint64_t MAX16 = 0xFFFF;
+
+// "Version needed to extract": 2.0 for deflate, 4.5 for ZIP64
+static constexpr uint16_t VERSION_DEFAULT = 20;
+static constexpr uint16_t VERSION_ZIP64 = 45;
+
+// General purpose flag bit 3: CRC and sizes follow the data
+static constexpr uint16_t FLAG_DATA_DESCRIPTOR = 0x08;
+
+// General purpose flag bit 11: name and comment are UTF-8 rather than cp437
+static constexpr uint16_t FLAG_UTF8 = 0x800;
+
+// Output buffer of the streaming deflater
+static constexpr size_t STREAM_ZBUF = 256 * 1024;
+
+// EntryReader and add_raw() hand consumed input back to the OS in steps of
+// this size
+static constexpr uint64_t RELEASE_STEP = 4 * 1024 * 1024;
+
+// zlib counts in uInt; larger buffers are fed in slices
+static constexpr size_t ZLIB_SLICE = 0x40000000u;
+
+static inline uint16_t rd16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t rd32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t rd64(const uint8_t *p) {
+  return (uint64_t)rd32(p) | ((uint64_t)rd32(p + 4) << 32);
+}
+
+static inline void wr16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void wr32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static inline void wr64(uint8_t *p, uint64_t v) {
+  wr32(p, (uint32_t)v);
+  wr32(p + 4, (uint32_t)(v >> 32));
+}
+
+// ============================================
+// MappedFile
+// ============================================
+
+MappedFile &MappedFile::operator=(MappedFile &&o) noexcept {
+  if (this != &o) {
+    close();
+    data_ = o.data_;
+    size_ = o.size_;
+    borrowed_ = o.borrowed_;
+    fileBacked_ = o.fileBacked_;
+    owner_ = std::move(o.owner_);
+    o.data_ = nullptr;
+    o.size_ = 0;
+    o.borrowed_ = false;
+    o.fileBacked_ = true;
+#ifdef _WIN32
+    file_ = o.file_;
+    mapping_ = o.mapping_;
+    o.file_ = nullptr;
+    o.mapping_ = nullptr;
+#endif
+  }
+  return *this;
+}
+
+#ifdef _WIN32
+
+void MappedFile::open(const fs::path &p) {
+  close();
+  HANDLE f = CreateFileW(p.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ,
+                         nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                         nullptr);
+  if (f == INVALID_HANDLE_VALUE)
+    throw std::runtime_error("Failed to open file: " + p.u8string());
+  LARGE_INTEGER sz;
+  if (!GetFileSizeEx(f, &sz)) {
+    CloseHandle(f);
+    throw std::runtime_error("Failed to read file size: " + p.u8string());
+  }
+  file_ = f;
+  size_ = (size_t)sz.QuadPart;
+  if (size_ == 0)
+    return;
+  HANDLE m = CreateFileMappingW(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!m) {
+    close();
+    throw std::runtime_error("Failed to map file: " + p.u8string());
+  }
+  mapping_ = m;
+  data_ = (const uint8_t *)MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+  if (!data_) {
+    close();
+    throw std::runtime_error("Failed to map file: " + p.u8string());
+  }
+}
+
+void MappedFile::release(const uint8_t *, size_t) const {
+  // Mapped views are trimmed by the memory manager on its own
+}
+
+static void unmap_view(const uint8_t *data, void *mapping, void *file) {
+  if (data)
+    UnmapViewOfFile(data);
+  if (mapping)
+    CloseHandle((HANDLE)mapping);
+  if (file)
+    CloseHandle((HANDLE)file);
+}
+
+void MappedFile::prefetch(const uint8_t *, size_t) const {}
+
+void MappedFile::close() {
+  if (!borrowed_)
+    unmap_view(data_, mapping_, file_);
+  borrowed_ = false;
+  fileBacked_ = true;
+  owner_.reset();
+  data_ = nullptr;
+  mapping_ = nullptr;
+  file_ = nullptr;
+  size_ = 0;
+}
+
+#else
+
+void MappedFile::open(const fs::path &p) {
+  close();
+  int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw std::runtime_error("Failed to open file: " + p.u8string());
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Failed to read file size: " + p.u8string());
+  }
+  size_ = (size_t)st.st_size;
+  if (size_ > 0) {
+    void *m = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m == MAP_FAILED) {
+      ::close(fd);
+      size_ = 0;
+      throw std::runtime_error("Failed to map file: " + p.u8string());
+    }
+    data_ = (const uint8_t *)m;
+  }
+  ::close(fd);
+}
+
+void MappedFile::release(const uint8_t *p, size_t len) const {
+  // On heap memory MADV_DONTNEED would zero the pages
+  if (!fileBacked_)
+    return;
+  static const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+  uintptr_t begin = ((uintptr_t)p + page - 1) & ~(page - 1);
+  uintptr_t end = ((uintptr_t)p + len) & ~(page - 1);
+  // Read-only private mapping: dropped pages are simply re-read on access
+  if (end > begin)
+    madvise((void *)begin, end - begin, MADV_DONTNEED);
+}
+
+void MappedFile::prefetch(const uint8_t *p, size_t len) const {
+  if (!fileBacked_)
+    return;
+  static const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+  uintptr_t begin = (uintptr_t)p & ~(page - 1);
+  uintptr_t end = (uintptr_t)p + len;
+  // Starts readahead and returns; the pages arrive while we encrypt
+  if (end > begin)
+    madvise((void *)begin, end - begin, MADV_WILLNEED);
+}
+
+void MappedFile::close() {
+  if (data_ && !borrowed_)
+    munmap((void *)data_, size_);
+  borrowed_ = false;
+  fileBacked_ = true;
+  owner_.reset();
+  data_ = nullptr;
+  size_ = 0;
+}
+
+#endif
+
+void MappedFile::view(const uint8_t *data, size_t size,
+                      std::shared_ptr<const void> owner, bool fileBacked) {
+  close();
+  data_ = data;
+  size_ = size;
+  borrowed_ = true;
+  fileBacked_ = fileBacked;
+  owner_ = std::move(owner);
+}
+
+void MappedFile::share(const MappedFile &other) {
+  view(other.data_, other.size_, other.owner_, other.fileBacked_);
+}
+
+// ============================================
+// ZipReader
+// ============================================
+
+// Replaces saturated 32-bit fields of a central directory record with the
+// values from its ZIP64 extra field (present only for those fields, in
+// this order)
+static void read_zip64_extra(ZipEntry &e, const uint8_t *extra,
+                             size_t extraLen) {
+  const uint8_t *end = extra + extraLen;
+  while (end - extra >= 4) {
+    uint16_t id = rd16(extra);
+    uint16_t len = rd16(extra + 2);
+    const uint8_t *p = extra + 4;
+    if ((size_t)(end - p) < len)
+      break;
+    if (id == EXTRA_ZIP64) {
+      const uint8_t *q = p;
+      auto take = [&](uint64_t &field) {
+        if (field != MAX32)
+          return;
+        if (p + len - q < 8)
+          throw std::runtime_error("Corrupt ZIP64 extra field: " + e.name);
+        field = rd64(q);
+        q += 8;
+      };
+      take(e.uncompressedSize);
+      take(e.compressedSize);
+      take(e.localHeaderOffset);
+      return;
+    }
+    extra = p + len;
+  }
+  if (e.uncompressedSize == MAX32 || e.compressedSize == MAX32 ||
+      e.localHeaderOffset == MAX32)
+    throw std::runtime_error("ZIP64 extra field missing: " + e.name);
+}
+
+void ZipReader::open(const fs::path &p) {
+  file_.open(p);
+  parse();
+}
+
+void ZipReader::open_view(const uint8_t *data, size_t size,
+                          std::shared_ptr<const void> owner, bool fileBacked) {
+  file_.view(data, size, std::move(owner), fileBacked);
+  parse();
+}
+
+ZipReader ZipReader::open_nested(const ZipReader &outer, const ZipEntry &e) {
+  ZipReader z;
+  if (e.method == METHOD_STORED && !(e.flags & 1)) {
+    const uint8_t *src = outer.raw_data(e);
+    if (e.compressedSize != e.uncompressedSize)
+      throw std::runtime_error("Corrupt stored ZIP entry: " + e.name);
+    // Checked a window at a time, so a large inner archive isn't left
+    // resident until its entries are read
+    uint32_t crc = 0;
+    for (uint64_t off = 0; off < e.uncompressedSize;) {
+      size_t n = (size_t)std::min<uint64_t>(e.uncompressedSize - off,
+                                            RELEASE_STEP);
+      crc = crc32(src + off, n, crc);
+      outer.file_.release(src + off, n);
+      off += n;
+    }
+    if (crc != e.crc32)
+      throw std::runtime_error("Bad CRC-32 for ZIP entry: " + e.name);
+    z.file_.view(src, (size_t)e.uncompressedSize, outer.file_.owner(),
+                 outer.file_.file_backed());
+  } else {
+    auto data = std::make_shared<std::vector<uint8_t>>(outer.read(e));
+    const uint8_t *p = data->data();
+    size_t n = data->size();
+    z.file_.view(p, n, std::move(data), false);
+  }
+  z.parse();
+  return z;
+}
+
+ZipReader ZipReader::subtree(const std::string &prefix) const {
+  ZipReader z;
+  z.file_.share(file_);
+  for (auto const &e : entries_) {
+    if (e.name.size() <= prefix.size() || e.name.compare(0, prefix.size(),
+                                                         prefix) != 0)
+      continue;
+    ZipEntry s = e;
+    s.name.erase(0, prefix.size());
+    z.entries_.push_back(std::move(s));
+  }
+  return z;
+}
+
+void ZipReader::parse() {
+  entries_.clear();
+
+  const uint8_t *base = file_.data();
+  size_t size = file_.size();
+  if (size < 22)
+    throw std::runtime_error("Not a ZIP archive (too small).");
+
+  // End of central directory: scan back over a possible archive comment
+  size_t scanFloor = size > 22 + 0xFFFF ? size - 22 - 0xFFFF : 0;
+  size_t eocd = (size_t)-1;
+  for (size_t i = size - 22 + 1; i-- > scanFloor;) {
+    if (rd32(base + i) == SIG_EOCD) {
+      eocd = i;
+      break;
+    }
+  }
+  if (eocd == (size_t)-1)
+    throw std::runtime_error("Not a ZIP archive (no end of central directory).");
+
+  uint64_t count = rd16(base + eocd + 10);
+  uint64_t cdSize = rd32(base + eocd + 12);
+  uint64_t cdOffset = rd32(base + eocd + 16);
+
+  // ZIP64: the locator sits right before the EOCD and points at the ZIP64
+  // end of central directory record holding the 64-bit values
+  if (eocd >= 20 && rd32(base + eocd - 20) == SIG_ZIP64_LOCATOR) {
+    uint64_t z64 = rd64(base + eocd - 20 + 8);
+    if (z64 > eocd - 20 || eocd - 20 - z64 < 56 ||
+        rd32(base + z64) != SIG_ZIP64_EOCD)
+      throw std::runtime_error("Corrupt ZIP64 end of central directory.");
+    count = rd64(base + z64 + 32);
+    cdSize = rd64(base + z64 + 40);
+    cdOffset = rd64(base + z64 + 48);
+  } else if (cdSize == MAX32 || cdOffset == MAX32) {
+    throw std::runtime_error("Corrupt ZIP archive (ZIP64 locator missing).");
+  }
+  if (cdOffset > eocd || cdSize > eocd - cdOffset)
+    throw std::runtime_error("Corrupt ZIP central directory.");
+
+  // Every record is at least 46 bytes, so a corrupt count can't make us
+  // reserve more than the directory could hold
+  entries_.reserve((size_t)std::min<uint64_t>(count, cdSize / 46));
+  const uint8_t *rec = base + cdOffset;
+  const uint8_t *cdEnd = rec + cdSize;
+  for (uint64_t i = 0; i < count; i++) {
+    if (cdEnd - rec < 46 || rd32(rec) != SIG_CENTRAL)
+      throw std::runtime_error("Corrupt ZIP central directory entry.");
+    uint16_t nameLen = rd16(rec + 28);
+    uint16_t extraLen = rd16(rec + 30);
+    uint16_t commentLen = rd16(rec + 32);
+    if ((size_t)(cdEnd - rec) < 46u + nameLen + extraLen + commentLen)
+      throw std::runtime_error("Corrupt ZIP central directory entry.");
+
+    ZipEntry e;
+    e.flags = rd16(rec + 8);
+    e.method = rd16(rec + 10);
+    e.dosTime = rd16(rec + 12);
+    e.dosDate = rd16(rec + 14);
+    e.crc32 = rd32(rec + 16);
+    e.compressedSize = rd32(rec + 20);
+    e.uncompressedSize = rd32(rec + 24);
+    e.externalAttr = rd32(rec + 38);
+    e.localHeaderOffset = rd32(rec + 42);
+    e.name.assign((const char *)rec + 46, nameLen);
+    read_zip64_extra(e, rec + 46 + nameLen, extraLen);
+    // ZIP64 values are 64-bit, so check by subtraction to avoid wrapping
+    if (e.localHeaderOffset > size || size - e.localHeaderOffset < 30 ||
+        e.compressedSize > size - e.localHeaderOffset - 30)
+      throw std::runtime_error("Corrupt ZIP central directory entry: " +
+                               e.name);
+    entries_.push_back(std::move(e));
+
+    rec += 46 + nameLen + extraLen + commentLen;
+  }
+}
+
+const ZipEntry *ZipReader::find(const std::string &name) const {
+  for (auto const &e : entries_) {
+    if (e.name == name)
+      return &e;
+  }
+  return nullptr;
+}
+
+const uint8_t *ZipReader::raw_data(const ZipEntry &e) const {
+  const uint8_t *base = file_.data();
+  size_t size = file_.size();
+  if (e.localHeaderOffset > size || size - e.localHeaderOffset < 30 ||
+      rd32(base + e.localHeaderOffset) != SIG_LOCAL)
+    throw std::runtime_error("Corrupt ZIP local header: " + e.name);
+  const uint8_t *lh = base + e.localHeaderOffset;
+  uint64_t dataOffset = e.localHeaderOffset + 30 + rd16(lh + 26) + rd16(lh + 28);
+  if (dataOffset > size || e.compressedSize > size - dataOffset)
+    throw std::runtime_error("Truncated ZIP entry: " + e.name);
+  return base + dataOffset;
+}
+
+void ZipReader::prefetch(const ZipEntry &e) const {
+  // Local header + name + a typical extra field + data, without touching
+  // the header (that would be the synchronous fault we want to avoid)
+  uint64_t begin = e.localHeaderOffset;
+  uint64_t size = file_.size();
+  if (begin >= size)
+    return;
+  // Clamped to the mapping without adding 64-bit sizes that could wrap
+  uint64_t avail = size - begin;
+  uint64_t header = 30 + e.name.size() + 64;
+  uint64_t end = header >= avail || e.compressedSize > avail - header
+                     ? size
+                     : begin + header + e.compressedSize;
+  file_.prefetch(file_.data() + begin, (size_t)(end - begin));
+}
+
+std::vector<uint8_t> ZipReader::read(const ZipEntry &e) const {
+  if (e.flags & 1)
+    throw std::runtime_error("Encrypted ZIP entries are not supported: " +
+                             e.name);
+  const uint8_t *src = raw_data(e);
+  std::vector<uint8_t> out((size_t)e.uncompressedSize);
+
+  if (e.method == METHOD_STORED) {
+    if (e.compressedSize != e.uncompressedSize)
+      throw std::runtime_error("Corrupt stored ZIP entry: " + e.name);
+    if (!out.empty())
+      memcpy(out.data(), src, out.size());
+  } else if (e.method == METHOD_DEFLATED) {
+    inflate_raw(src, (size_t)e.compressedSize, out.data(), out.size());
+  } else {
+    throw std::runtime_error("Unsupported ZIP compression method " +
+                             std::to_string(e.method) + ": " + e.name);
+  }
+
+  if (crc32(out.data(), out.size()) != e.crc32)
+    throw std::runtime_error("Bad CRC-32 for ZIP entry: " + e.name);
+  return out;
+}
+
+// ============================================
+// EntryReader
+// ============================================
+
+void ZStreamFree::operator()(z_stream_s *zs) const { delete zs; }
+
+EntryReader::EntryReader(const ZipReader &zip, const ZipEntry &e)
+    : file_(zip.file()), entry_(e), src_(zip.raw_data(e)) {
+  if (e.flags & 1)
+    throw std::runtime_error("Encrypted ZIP entries are not supported: " +
+                             e.name);
+  if (e.method == METHOD_DEFLATED) {
+    zs_.reset(new z_stream{});
+    if (inflateInit2(zs_.get(), -15) != Z_OK) {
+      zs_.reset();
+      throw std::runtime_error("inflateInit2 failed.");
+    }
+  } else if (e.method != METHOD_STORED) {
+    throw std::runtime_error("Unsupported ZIP compression method " +
+                             std::to_string(e.method) + ": " + e.name);
+  } else if (e.compressedSize != e.uncompressedSize) {
+    throw std::runtime_error("Corrupt stored ZIP entry: " + e.name);
+  }
+}
+
+EntryReader::~EntryReader() {
+  if (zs_)
+    inflateEnd(zs_.get());
+}
+
+size_t EntryReader::read(uint8_t *out, size_t cap) {
+  if (done_ || cap == 0)
+    return 0;
+
+  size_t n = 0;
+  bool ended = false;
+  if (!zs_) {
+    n = (size_t)std::min<uint64_t>(entry_.compressedSize - consumed_, cap);
+    memcpy(out, src_ + consumed_, n);
+    consumed_ += n;
+    ended = consumed_ == entry_.compressedSize;
+  } else {
+    z_stream &zs = *zs_;
+    while (n < cap) {
+      const uint8_t *in = src_ + consumed_;
+      zs.next_in = (Bytef *)in;
+      zs.avail_in = (uInt)std::min<uint64_t>(entry_.compressedSize - consumed_,
+                                             ZLIB_SLICE);
+      zs.next_out = out + n;
+      zs.avail_out = (uInt)std::min(cap - n, ZLIB_SLICE);
+      int rc = inflate(&zs, Z_NO_FLUSH);
+      consumed_ += (uint64_t)(zs.next_in - in);
+      n = (size_t)(zs.next_out - out);
+      if (rc == Z_STREAM_END) {
+        ended = true;
+        break;
+      }
+      // Z_BUF_ERROR here means the input ran out before the end marker
+      if (rc != Z_OK)
+        throw std::runtime_error("Corrupt DEFLATE stream: " + entry_.name);
+    }
+  }
+
+  produced_ += n;
+  if (produced_ > entry_.uncompressedSize)
+    throw std::runtime_error("ZIP entry larger than recorded: " + entry_.name);
+  crc_ = crc32(out, n, crc_);
+  release_consumed(ended);
+
+  if (ended) {
+    done_ = true;
+    if (produced_ != entry_.uncompressedSize)
+      throw std::runtime_error("Truncated ZIP entry: " + entry_.name);
+    if (crc_ != entry_.crc32)
+      throw std::runtime_error("Bad CRC-32 for ZIP entry: " + entry_.name);
+  }
+  return n;
+}
+
+void EntryReader::release_consumed(bool all) {
+  if (consumed_ - released_ < RELEASE_STEP && !all)
+    return;
+  file_.release(src_ + released_, (size_t)(consumed_ - released_));
+  released_ = consumed_;
+}
+
+// ============================================
+// ZipWriter
+// ============================================
+
+static void dos_now(uint16_t &dosTime, uint16_t &dosDate) {
+  std::time_t t = std::time(nullptr);
+  std::tm tmv{};
+#ifdef _WIN32
+  localtime_s(&tmv, &t);
+#else
+  localtime_r(&t, &tmv);
+#endif
+  int year = tmv.tm_year + 1900;
+  if (year < 1980)
+    year = 1980;
+  dosTime = (uint16_t)((tmv.tm_hour << 11) | (tmv.tm_min << 5) |
+                       (tmv.tm_sec / 2));
+  dosDate = (uint16_t)(((year - 1980) << 9) | ((tmv.tm_mon + 1) << 5) |
+                       tmv.tm_mday);
+}
+
+ZipWriter::~ZipWriter() {
+  if ((out_.is_open() || memOut_ || parent_) && !finished_ && !inFile_) {
+    try {
+      finish();
+    } catch (...) {
+    }
+  }
+  if (zs_)
+    deflateEnd(zs_.get());
+}
+
+void ZipWriter::reset(std::vector<uint8_t> *sink, ZipWriter *parent,
+                      bool subtree, const std::string &prefix) {
+  memOut_ = sink;
+  parent_ = parent;
+  subtree_ = subtree;
+  prefix_ = prefix;
+  offset_ = 0;
+  entries_.clear();
+  finished_ = false;
+  inFile_ = false;
+}
+
+void ZipWriter::open(const fs::path &p) {
+  out_.open(p);
+  reset(nullptr, nullptr, false, "");
+}
+
+void ZipWriter::open(std::vector<uint8_t> *sink) {
+  reset(sink, nullptr, false, "");
+}
+
+void ZipWriter::open_nested(ZipWriter *parent) {
+  if (!parent->inFile_)
+    throw std::runtime_error("Nested ZIP needs an open entry to write to.");
+  reset(nullptr, parent, false, "");
+}
+
+void ZipWriter::open_subtree(ZipWriter *parent, const std::string &prefix) {
+  if (parent->inFile_)
+    throw std::runtime_error("ZIP entry still open: " + parent->cur_.name);
+  reset(nullptr, parent, true, prefix);
+  // Offsets are the parent's, so the entries can join its directory as is
+  offset_ = parent->offset_;
+}
+
+void ZipWriter::put(const void *p, size_t n) {
+  if (parent_ && subtree_)
+    parent_->put(p, n);
+  else if (parent_)
+    parent_->write((const uint8_t *)p, n);
+  else if (memOut_)
+    memOut_->insert(memOut_->end(), (const uint8_t *)p, (const uint8_t *)p + n);
+  else
+    out_.write(p, n);
+  offset_ += n;
+}
+
+// Names are written as given. Non-ASCII names that are valid UTF-8 get the
+// UTF-8 flag, otherwise readers fall back to cp437 and show mojibake; other
+// byte strings (cp437 names copied from an old archive) stay unflagged.
+static uint16_t name_flags(const std::string &name) {
+  bool ascii = true;
+  for (size_t i = 0; i < name.size();) {
+    uint8_t c = (uint8_t)name[i];
+    if (c < 0x80) {
+      ++i;
+      continue;
+    }
+    ascii = false;
+    // Lead byte: 110xxxxx, 1110xxxx or 11110xxx (no overlong C0/C1, <= F4)
+    size_t n = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC2 ? 1 : 0;
+    if (n == 0 || c > 0xF4 || name.size() - i <= n)
+      return 0;
+    for (size_t k = 1; k <= n; ++k)
+      if (((uint8_t)name[i + k] & 0xC0) != 0x80)
+        return 0;
+    i += n + 1;
+  }
+  return ascii ? 0 : FLAG_UTF8;
+}
+
+void ZipWriter::stamp(ZipEntry &e) const {
+  if (fixedTimestamp_) {
+    e.dosTime = 0;
+    e.dosDate = (1 << 5) | 1; // 1980-01-01
+  } else {
+    dos_now(e.dosTime, e.dosDate);
+  }
+}
+
+void ZipWriter::write_local_header(ZipEntry &e, bool zip64) {
+  if (!prefix_.empty()) {
+    e.name = prefix_ + e.name;
+    e.flags |= name_flags(e.name);
+  }
+  if (e.name.size() > 0xFFFF)
+    throw std::runtime_error("ZIP entry name too long: " + e.name);
+
+  e.localHeaderOffset = offset_;
+
+  uint8_t h[30];
+  wr32(h, SIG_LOCAL);
+  wr16(h + 4, zip64 ? VERSION_ZIP64 : VERSION_DEFAULT);
+  wr16(h + 6, e.flags);
+  wr16(h + 8, e.method);
+  wr16(h + 10, e.dosTime);
+  wr16(h + 12, e.dosDate);
+  wr32(h + 14, e.crc32);
+  wr32(h + 18, zip64 ? (uint32_t)MAX32 : (uint32_t)e.compressedSize);
+  wr32(h + 22, zip64 ? (uint32_t)MAX32 : (uint32_t)e.uncompressedSize);
+  wr16(h + 26, (uint16_t)e.name.size());
+  wr16(h + 28, zip64 ? 20 : 0);
+  put(h, sizeof(h));
+  put(e.name.data(), e.name.size());
+
+  // The local ZIP64 field always carries both sizes (zero while streaming;
+  // the data descriptor has the real ones)
+  if (zip64) {
+    uint8_t x[20];
+    wr16(x, EXTRA_ZIP64);
+    wr16(x + 2, 16);
+    wr64(x + 4, e.uncompressedSize);
+    wr64(x + 12, e.compressedSize);
+    put(x, sizeof(x));
+  }
+}
+
+void ZipWriter::write_entry(ZipEntry e, const uint8_t *payload) {
+  if (inFile_)
+    throw std::runtime_error("ZIP entry still open: " + cur_.name);
+
+  write_local_header(e, e.compressedSize >= MAX32 ||
+                            e.uncompressedSize >= MAX32);
+  if (e.compressedSize)
+    put(payload, (size_t)e.compressedSize);
+
+  entries_.push_back(std::move(e));
+}
+
+void ZipWriter::add_directory(const std::string &name) {
+  ZipEntry e;
+  e.name = name;
+  // drwxrwxr-x plus the MS-DOS directory bit, as Python's zipfile writes it
+  e.externalAttr = (040775u << 16) | 0x10;
+  e.flags = name_flags(name);
+  stamp(e);
+  write_entry(std::move(e), nullptr);
+}
+
+void ZipWriter::add_file(const std::string &name, const uint8_t *data,
+                         size_t len, bool deflate) {
+  ZipEntry e;
+  e.name = name;
+  e.flags = name_flags(name);
+  e.externalAttr = 0600u << 16;
+  stamp(e);
+  e.crc32 = crc32(data, len);
+  e.uncompressedSize = len;
+  if (deflate) {
+    std::vector<uint8_t> packed = deflate_raw(data, len);
+    e.method = METHOD_DEFLATED;
+    e.compressedSize = packed.size();
+    write_entry(std::move(e), packed.data());
+  } else {
+    e.compressedSize = len;
+    write_entry(std::move(e), data);
+  }
+}
+
+void ZipWriter::add_deflated(const std::string &name, const uint8_t *packed,
+                             size_t packedLen, uint32_t crc, uint64_t size) {
+  ZipEntry e;
+  e.name = name;
+  e.flags = name_flags(name);
+  e.externalAttr = 0600u << 16;
+  stamp(e);
+  e.method = METHOD_DEFLATED;
+  e.crc32 = crc;
+  e.uncompressedSize = size;
+  e.compressedSize = packedLen;
+  write_entry(std::move(e), packed);
+}
+
+void ZipWriter::add_raw(const ZipReader &from, const ZipEntry &src) {
+  if (inFile_)
+    throw std::runtime_error("ZIP entry still open: " + cur_.name);
+
+  ZipEntry e;
+  e.name = src.name;
+  // Sizes and CRC are known now and go into the local header, so the copy
+  // needs no data descriptor; the UTF-8 bit stays as the source had it
+  e.flags = src.flags & ~FLAG_DATA_DESCRIPTOR;
+  e.method = src.method;
+  e.dosTime = src.dosTime;
+  e.dosDate = src.dosDate;
+  e.crc32 = src.crc32;
+  e.compressedSize = src.compressedSize;
+  e.uncompressedSize = src.uncompressedSize;
+  e.externalAttr = src.externalAttr;
+  write_local_header(e, e.compressedSize >= MAX32 ||
+                            e.uncompressedSize >= MAX32);
+
+  const uint8_t *p = from.raw_data(src);
+  uint64_t left = src.compressedSize;
+  while (left > 0) {
+    size_t n = (size_t)std::min<uint64_t>(left, RELEASE_STEP);
+    put(p, n);
+    from.file().release(p, n);
+    p += n;
+    left -= n;
+  }
+  entries_.push_back(std::move(e));
+}
+
+void ZipWriter::begin_file(const std::string &name, bool deflate,
+                           uint64_t sizeHint) {
+  if (inFile_)
+    throw std::runtime_error("ZIP entry still open: " + cur_.name);
+
+  cur_ = ZipEntry();
+  cur_.name = name;
+  cur_.flags = FLAG_DATA_DESCRIPTOR | name_flags(name);
+  cur_.method = deflate ? METHOD_DEFLATED : METHOD_STORED;
+  cur_.externalAttr = 0600u << 16;
+
+  if (deflate) {
+    if (!zs_) {
+      zs_.reset(new z_stream{});
+      if (deflateInit2(zs_.get(), Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                       Z_DEFAULT_STRATEGY) != Z_OK) {
+        zs_.reset();
+        throw std::runtime_error("deflateInit2 failed.");
+      }
+      zbuf_.resize(STREAM_ZBUF);
+    } else {
+      deflateReset(zs_.get());
+    }
+  }
+
+  // The header can't be patched later, so decide on ZIP64 now. The margin
+  // covers deflate output of incompressible data (stored blocks add 5
+  // bytes per 64 KB) and a hint that is slightly off.
+  curZip64_ = sizeHint + (sizeHint >> 10) + 4096 >= MAX32;
+
+  stamp(cur_);
+  write_local_header(cur_, curZip64_);
+  inFile_ = true;
+}
+
+void ZipWriter::deflate_pending(int flush) {
+  z_stream &zs = *zs_;
+  for (;;) {
+    zs.next_out = zbuf_.data();
+    zs.avail_out = (uInt)zbuf_.size();
+    int rc = deflate(&zs, flush);
+    if (rc == Z_STREAM_ERROR)
+      throw std::runtime_error("deflate failed.");
+    size_t produced = zbuf_.size() - zs.avail_out;
+    put(zbuf_.data(), produced);
+    cur_.compressedSize += produced;
+    if (flush == Z_FINISH ? rc == Z_STREAM_END
+                          : zs.avail_in == 0 && zs.avail_out != 0)
+      break;
+  }
+}
+
+void ZipWriter::write(const uint8_t *data, size_t len) {
+  if (!inFile_)
+    throw std::runtime_error("ZipWriter::write() without begin_file().");
+
+  cur_.crc32 = crc32(data, len, cur_.crc32);
+  cur_.uncompressedSize += len;
+  if (cur_.method == METHOD_STORED) {
+    put(data, len);
+    cur_.compressedSize += len;
+    return;
+  }
+  while (len > 0) {
+    size_t n = std::min(len, ZLIB_SLICE);
+    zs_->next_in = (Bytef *)data;
+    zs_->avail_in = (uInt)n;
+    deflate_pending(Z_NO_FLUSH);
+    data += n;
+    len -= n;
+  }
+}
+
+void ZipWriter::end_file() {
+  if (!inFile_)
+    throw std::runtime_error("ZipWriter::end_file() without begin_file().");
+  if (cur_.method == METHOD_DEFLATED) {
+    zs_->next_in = nullptr;
+    zs_->avail_in = 0;
+    deflate_pending(Z_FINISH);
+  }
+  inFile_ = false;
+
+  if (!curZip64_ &&
+      (cur_.compressedSize >= MAX32 || cur_.uncompressedSize >= MAX32))
+    throw std::runtime_error("ZIP entry passed 4 GiB without a ZIP64 header "
+                             "(give begin_file() a size hint): " +
+                             cur_.name);
+
+  // ZIP64 entries get 8-byte sizes in the descriptor
+  uint8_t d[24];
+  wr32(d, SIG_DESCRIPTOR);
+  wr32(d + 4, cur_.crc32);
+  if (curZip64_) {
+    wr64(d + 8, cur_.compressedSize);
+    wr64(d + 16, cur_.uncompressedSize);
+    put(d, 24);
+  } else {
+    wr32(d + 8, (uint32_t)cur_.compressedSize);
+    wr32(d + 12, (uint32_t)cur_.uncompressedSize);
+    put(d, 16);
+  }
+
+  entries_.push_back(std::move(cur_));
+}
+
+void ZipWriter::finish() {
+  if (finished_)
+    return;
+  finished_ = true;
+  if (inFile_)
+    throw std::runtime_error("ZIP entry still open: " + cur_.name);
+
+  if (subtree_) {
+    if (parent_->offset_ != offset_)
+      throw std::runtime_error("ZIP subtree " + prefix_ +
+                               " interleaved with other output.");
+    for (auto &e : entries_)
+      parent_->entries_.push_back(std::move(e));
+    entries_.clear();
+    return;
+  }
+
+  uint64_t cdStart = offset_;
+  for (auto const &e : entries_) {
+    // Saturated fields move into a ZIP64 extra field, in spec order
+    uint8_t x[28];
+    size_t xLen = 4;
+    bool bigU = e.uncompressedSize >= MAX32;
+    bool bigC = e.compressedSize >= MAX32;
+    bool bigO = e.localHeaderOffset >= MAX32;
+    if (bigU) {
+      wr64(x + xLen, e.uncompressedSize);
+      xLen += 8;
+    }
+    if (bigC) {
+      wr64(x + xLen, e.compressedSize);
+      xLen += 8;
+    }
+    if (bigO) {
+      wr64(x + xLen, e.localHeaderOffset);
+      xLen += 8;
+    }
+    bool zip64 = xLen > 4;
+    wr16(x, EXTRA_ZIP64);
+    wr16(x + 2, (uint16_t)(xLen - 4));
+
+    uint8_t h[46];
+    wr32(h, SIG_CENTRAL);
+    // made by: Unix, spec 2.0 (4.5 for ZIP64)
+    wr16(h + 4, (3 << 8) | (zip64 ? VERSION_ZIP64 : VERSION_DEFAULT));
+    wr16(h + 6, zip64 ? VERSION_ZIP64 : VERSION_DEFAULT);
+    wr16(h + 8, e.flags);
+    wr16(h + 10, e.method);
+    wr16(h + 12, e.dosTime);
+    wr16(h + 14, e.dosDate);
+    wr32(h + 16, e.crc32);
+    wr32(h + 20, bigC ? (uint32_t)MAX32 : (uint32_t)e.compressedSize);
+    wr32(h + 24, bigU ? (uint32_t)MAX32 : (uint32_t)e.uncompressedSize);
+    wr16(h + 28, (uint16_t)e.name.size());
+    wr16(h + 30, zip64 ? (uint16_t)xLen : 0);
+    wr16(h + 32, 0);
+    wr16(h + 34, 0);
+    wr16(h + 36, 0);
+    wr32(h + 38, e.externalAttr);
+    wr32(h + 42, bigO ? (uint32_t)MAX32 : (uint32_t)e.localHeaderOffset);
+    put(h, sizeof(h));
+    put(e.name.data(), e.name.size());
+    if (zip64)
+      put(x, xLen);
+  }
+  uint64_t cdSize = offset_ - cdStart;
+  uint64_t count = entries_.size();
+
+  if (count >= MAX16 || cdStart >= MAX32 || cdSize >= MAX32) {
+    uint64_t z64 = offset_;
+    uint8_t r[56];
+    wr32(r, SIG_ZIP64_EOCD);
+    wr64(r + 4, sizeof(r) - 12); // size of the rest of the record
+    wr16(r + 12, (3 << 8) | VERSION_ZIP64);
+    wr16(r + 14, VERSION_ZIP64);
+    wr32(r + 16, 0);
+    wr32(r + 20, 0);
+    wr64(r + 24, count);
+    wr64(r + 32, count);
+    wr64(r + 40, cdSize);
+    wr64(r + 48, cdStart);
+    put(r, sizeof(r));
+
+    uint8_t loc[20];
+    wr32(loc, SIG_ZIP64_LOCATOR);
+    wr32(loc + 4, 0);
+    wr64(loc + 8, z64);
+    wr32(loc + 16, 1);
+    put(loc, sizeof(loc));
+  }
+
+  uint8_t eocd[22];
+  wr32(eocd, SIG_EOCD);
+  wr16(eocd + 4, 0);
+  wr16(eocd + 6, 0);
+  wr16(eocd + 8, (uint16_t)std::min(count, MAX16));
+  wr16(eocd + 10, (uint16_t)std::min(count, MAX16));
+  wr32(eocd + 12, (uint32_t)std::min(cdSize, MAX32));
+  wr32(eocd + 16, (uint32_t)std::min(cdStart, MAX32));
+  wr16(eocd + 20, 0);
+  put(eocd, sizeof(eocd));
+
+  if (!memOut_ && !parent_)
+    out_.close();
+}
+
+// ============================================
+// zlib helpers
+// ============================================
+
+uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc) {
+  // zlib takes uInt lengths; feed large buffers in slices
+  while (len > 0) {
+    uInt n = len > 0x40000000u ? 0x40000000u : (uInt)len;
+    crc = (uint32_t)::crc32(crc, data, n);
+    data += n;
+    len -= n;
+  }
+  return crc;
+}
+
+// Keeps next_in/next_out topped up from [in, inEnd) / [out, outEnd) in
+// ZLIB_SLICE pieces, since avail_in/avail_out are only 32 bits wide
+static void refill(z_stream &zs, const uint8_t *&in, const uint8_t *inEnd,
+                   uint8_t *&out, uint8_t *outEnd) {
+  if (zs.avail_in == 0 && in < inEnd) {
+    size_t n = std::min((size_t)(inEnd - in), ZLIB_SLICE);
+    zs.next_in = (Bytef *)in;
+    zs.avail_in = (uInt)n;
+    in += n;
+  }
+  if (zs.avail_out == 0 && out < outEnd) {
+    size_t n = std::min((size_t)(outEnd - out), ZLIB_SLICE);
+    zs.next_out = out;
+    zs.avail_out = (uInt)n;
+    out += n;
+  }
+}
+
+std::vector<uint8_t> deflate_raw(const uint8_t *data, size_t len, int level) {
+  z_stream zs{};
+  if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    throw std::runtime_error("deflateInit2 failed.");
+
+  // deflateBound() takes a uLong, which is 32 bits on Windows; past that
+  // use zlib's conservative bound for any parameters
+  size_t bound = len <= 0xFFFFFFFFu
+                     ? (size_t)deflateBound(&zs, (uLong)len)
+                     : len + ((len + 7) >> 3) + ((len + 63) >> 6) + 5;
+  std::vector<uint8_t> out(bound);
+  const uint8_t *in = data;
+  uint8_t *o = out.data();
+  int rc;
+  do {
+    refill(zs, in, data + len, o, out.data() + out.size());
+    rc = deflate(&zs, in == data + len ? Z_FINISH : Z_NO_FLUSH);
+  } while (rc == Z_OK);
+  size_t produced = (size_t)(zs.next_out - out.data());
+  deflateEnd(&zs);
+  if (rc != Z_STREAM_END)
+    throw std::runtime_error("deflate failed.");
+  out.resize(produced);
+  return out;
+}
+
+void inflate_raw(const uint8_t *in, size_t inLen, uint8_t *out,
+                 size_t outLen) {
+  // The whole output buffer is known up front, so this doesn't need zlib's
+  // streaming machinery
+  mcbe_inflate::inflate(in, inLen, out, outLen);
+}
+
+} // namespace mcbe_zip
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mcbe_aio.h"
+
+// Portable ZIP reading/writing for resource packs, including ZIP64 (entries
+// and archives past 4 GiB, more than 65535 entries).
+// Reading works on a memory-mapped archive or on a view of one held in
+// memory (an inner pack of an .mcaddon); writing is strictly sequential.
+// Large entries can be streamed both ways (EntryReader, begin_file()) so
+// memory stays bounded by the window size instead of the entry size.
+
+struct z_stream_s;
+
+namespace mcbe_zip {
+
+namespace fs = std::filesystem;
+
+// Owns a zlib stream; the *End() call is made by the owner beforehand
+struct ZStreamFree {
+  void operator()(z_stream_s *zs) const;
+};
+using ZStreamPtr = std::unique_ptr<z_stream_s, ZStreamFree>;
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+  MappedFile() = default;
+  explicit MappedFile(const fs::path &p) { open(p); }
+  ~MappedFile() { close(); }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&o) noexcept { *this = std::move(o); }
+  MappedFile &operator=(MappedFile &&o) noexcept;
+
+  void open(const fs::path &p);
+  void close();
+
+  // Borrows [data, data + size) instead of mapping a file; `owner` is kept
+  // alive as long as the view. `fileBacked` says the range lies inside a
+  // file mapping, where release()/prefetch() are safe to apply.
+  void view(const uint8_t *data, size_t size,
+            std::shared_ptr<const void> owner, bool fileBacked);
+
+  // Borrows the same bytes as `other` (which must outlive this, unless it
+  // is itself a view with an owner)
+  void share(const MappedFile &other);
+
+  const uint8_t *data() const { return data_; }
+  size_t size() const { return size_; }
+  const std::shared_ptr<const void> &owner() const { return owner_; }
+  bool file_backed() const { return fileBacked_; }
+
+  // Hint that [p, p + len) won't be read again soon: drops those pages from
+  // the resident set (they are re-read from the file if touched later)
+  void release(const uint8_t *p, size_t len) const;
+
+  // Hint that [p, p + len) is needed soon: the OS reads it in the
+  // background instead of faulting page by page on first touch
+  void prefetch(const uint8_t *p, size_t len) const;
+
+private:
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+  bool borrowed_ = false;
+  bool fileBacked_ = true;
+  std::shared_ptr<const void> owner_;
+#ifdef _WIN32
+  void *file_ = nullptr;
+  void *mapping_ = nullptr;
+#endif
+};
+
+enum : uint16_t { METHOD_STORED = 0, METHOD_DEFLATED = 8 };
+
+struct ZipEntry {
+  std::string name;
+  uint16_t flags = 0;
+  uint16_t method = METHOD_STORED;
+  uint16_t dosTime = 0;
+  uint16_t dosDate = 0;
+  uint32_t crc32 = 0;
+  uint64_t compressedSize = 0;
+  uint64_t uncompressedSize = 0;
+  uint64_t localHeaderOffset = 0;
+  uint32_t externalAttr = 0;
+
+  bool is_dir() const { return !name.empty() && name.back() == '/'; }
+};
+
+class ZipReader {
+public:
+  ZipReader() = default;
+  explicit ZipReader(const fs::path &p) { open(p); }
+
+  // Maps the archive and parses the central directory
+  void open(const fs::path &p);
+
+  // Parses an archive held in memory; see MappedFile::view()
+  void open_view(const uint8_t *data, size_t size,
+                 std::shared_ptr<const void> owner, bool fileBacked);
+
+  // Entry `e` of `outer` opened as an archive of its own, without going
+  // through disk. A stored entry is read in place from outer's mapping
+  // (so `outer` must outlive the result); a deflated one is inflated into
+  // memory owned by the result. CRC-checked either way.
+  static ZipReader open_nested(const ZipReader &outer, const ZipEntry &e);
+
+  // Entries under `prefix` ("dir/") with the prefix stripped from their
+  // names, on the same mapping (this reader must outlive the result)
+  ZipReader subtree(const std::string &prefix) const;
+
+  const std::vector<ZipEntry> &entries() const { return entries_; }
+
+  // nullptr if no entry has exactly this name
+  const ZipEntry *find(const std::string &name) const;
+
+  // Compressed bytes of an entry, straight from the mapping
+  const uint8_t *raw_data(const ZipEntry &e) const;
+
+  // MappedFile::prefetch() of an entry's compressed bytes
+  void prefetch(const ZipEntry &e) const;
+
+  // Decompressed contents, CRC-checked. Throws std::runtime_error.
+  std::vector<uint8_t> read(const ZipEntry &e) const;
+
+  const MappedFile &file() const { return file_; }
+
+private:
+  void parse();
+
+  MappedFile file_;
+  std::vector<ZipEntry> entries_;
+};
+
+// Streaming decompression of one entry straight from the mapping.
+// Consumed input pages are released as it goes, so reading a multi-GB entry
+// keeps only about one window resident. CRC-checked at the end.
+class EntryReader {
+public:
+  EntryReader(const ZipReader &zip, const ZipEntry &e);
+  ~EntryReader();
+
+  EntryReader(const EntryReader &) = delete;
+  EntryReader &operator=(const EntryReader &) = delete;
+
+  // Fills up to `cap` bytes of `out`; returns 0 once the entry is exhausted.
+  // Throws std::runtime_error on corrupt data.
+  size_t read(uint8_t *out, size_t cap);
+
+private:
+  void release_consumed(bool all);
+
+  const MappedFile &file_;
+  const ZipEntry &entry_;
+  const uint8_t *src_;
+  uint64_t consumed_ = 0;
+  uint64_t released_ = 0;
+  uint64_t produced_ = 0;
+  uint32_t crc_ = 0;
+  bool done_ = false;
+  ZStreamPtr zs_;
+};
+
+// Sequential archive writer. Entries are compressed in memory before their
+// local header is written, so the output stream never seeks. Output goes
+// through mcbe_aio::FileWriter, so writes overlap with compression and
+// encryption of the next entry.
+class ZipWriter {
+public:
+  ZipWriter() = default;
+  explicit ZipWriter(const fs::path &p) { open(p); }
+  ~ZipWriter();
+
+  ZipWriter(const ZipWriter &) = delete;
+  ZipWriter &operator=(const ZipWriter &) = delete;
+
+  void open(const fs::path &p);
+
+  // Builds the archive in `*sink` (appended to) instead of a file, e.g. an
+  // inner pack that is nested into another archive afterwards
+  void open(std::vector<uint8_t> *sink);
+
+  // Builds the archive as the data of the entry `parent` has open
+  // (parent->begin_file() before, end_file() after finish()): an inner
+  // .mcpack of an add-on, written without a copy in memory
+  void open_nested(ZipWriter *parent);
+
+  // Writes every entry straight into `parent` with `prefix` in front of its
+  // name (a pack directory of a world); finish() adds them to parent's
+  // central directory instead of writing one. Nothing else may be written
+  // to `parent` until then.
+  void open_subtree(ZipWriter *parent, const std::string &prefix);
+
+  // Writes a directory entry ("name/")
+  void add_directory(const std::string &name);
+
+  // Writes a file entry, deflated unless `deflate` is false
+  void add_file(const std::string &name, const uint8_t *data, size_t len,
+                bool deflate = true);
+
+  // Writes a file entry whose raw DEFLATE payload was produced elsewhere
+  // (e.g. on a worker thread); `crc` and `size` describe the uncompressed
+  // data
+  void add_deflated(const std::string &name, const uint8_t *packed,
+                    size_t packedLen, uint32_t crc, uint64_t size);
+
+  // Copies entry `e` of `from` as is: compressed bytes, CRC, sizes and
+  // timestamp. The source pages are released as they are written out.
+  void add_raw(const ZipReader &from, const ZipEntry &e);
+
+  // Streaming file entry: begin_file(), any number of write() calls, then
+  // end_file(). CRC and sizes follow the data in a data descriptor
+  // (flag bit 3), so nothing is buffered beyond one deflate window.
+  // `sizeHint` is the expected uncompressed size; entries that may reach
+  // 4 GiB get ZIP64 headers up front, since the output never seeks back.
+  void begin_file(const std::string &name, bool deflate = true,
+                  uint64_t sizeHint = 0);
+  void write(const uint8_t *data, size_t len);
+  void end_file();
+
+  // Stamp every following entry with 1980-01-01 00:00:00 instead of the
+  // current time (reproducible output)
+  void set_fixed_timestamp(bool on) { fixedTimestamp_ = on; }
+
+  // Writes the central directory and closes the file
+  void finish();
+
+  // Output engine in use ("io_uring", "thread", "memory")
+  const char *io_backend() const {
+    if (parent_)
+      return parent_->io_backend();
+    return memOut_ ? "memory" : out_.backend_name();
+  }
+
+private:
+  void reset(std::vector<uint8_t> *sink, ZipWriter *parent, bool subtree,
+             const std::string &prefix);
+  void write_entry(ZipEntry e, const uint8_t *payload);
+  void stamp(ZipEntry &e) const;
+  void write_local_header(ZipEntry &e, bool zip64);
+  void deflate_pending(int flush);
+  void put(const void *p, size_t n);
+
+  mcbe_aio::FileWriter out_;
+  std::vector<uint8_t> *memOut_ = nullptr;
+  ZipWriter *parent_ = nullptr; // open_nested() / open_subtree()
+  bool subtree_ = false;
+  std::string prefix_;
+  uint64_t offset_ = 0;
+  std::vector<ZipEntry> entries_;
+  bool finished_ = false;
+  bool fixedTimestamp_ = false;
+
+  // State of the entry between begin_file() and end_file()
+  bool inFile_ = false;
+  bool curZip64_ = false;
+  ZipEntry cur_;
+  ZStreamPtr zs_;
+  std::vector<uint8_t> zbuf_;
+};
+
+uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc = 0);
+
+// Raw DEFLATE helpers (no zlib header). inflate_raw() needs the exact
+// output size and decodes with mcbe_inflate.
+std::vector<uint8_t> deflate_raw(const uint8_t *data, size_t len,
+                                 int level = -1);
+void inflate_raw(const uint8_t *in, size_t inLen, uint8_t *out,
+                 size_t outLen);
+
+} // namespace mcbe_zip
@@ -1,7 +1,8 @@
-#include <windows.h>
-
+#include <algorithm>
 #include <atomic>
+#include <cctype>
 #include <chrono>
+#include <csignal>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
@@ -13,12 +14,14 @@
 #include <vector>
 
 #include "aes256_ecb.h"
+#include "mcbe_pack.h"
+#include "mcbe_perf.h"
+#include "mcbe_zip.h"
 
 namespace fs = std::filesystem;
 
-static constexpr uint8_t MAGIC[4] = {0xFC, 0xB9, 0xCF, 0x9B};
-static constexpr size_t HEADER_SIZE = 256;
-static constexpr size_t KEY_LEN = 32;
+using mcbe_pack::HEADER_SIZE;
+using mcbe_pack::KEY_LEN;
 
 static std::atomic<unsigned long long> g_totalTried(0);
 static std::atomic<bool> g_found(false);
@@ -27,70 +30,6 @@ static std::string g_foundKey;
 static std::mutex g_lastKeyMu;
 static std::string g_lastKey;
 
-static std::wstring to_wstring_utf8_lossy(const std::string& s) {
-    if (s.empty()) return L"";
-    int needed = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.size(), nullptr, 0);
-    if (needed <= 0) {
-        std::wstring ws;
-        ws.reserve(s.size());
-        for (unsigned char c : s) ws.push_back((wchar_t)c);
-        return ws;
-    }
-    std::wstring ws(needed, L'\0');
-    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.size(), ws.data(), needed);
-    return ws;
-}
-
-static std::wstring ps_single_quote_escape(const std::wstring& s) {
-    // In PowerShell single-quoted strings, escape ' as ''
-    std::wstring out;
-    out.reserve(s.size() + 8);
-    for (wchar_t ch : s) {
-        if (ch == L'\'') out += L"''";
-        else out.push_back(ch);
-    }
-    return out;
-}
-
-static bool run_powershell_expand_archive(const fs::path& zipPath, const fs::path& destDir) {
-    std::wstring zipW = zipPath.wstring();
-    std::wstring destW = destDir.wstring();
-
-    std::wstring cmd =
-        L"powershell -NoProfile -NonInteractive -ExecutionPolicy Bypass -Command "
-        L"\"$ErrorActionPreference='Stop'; Expand-Archive -Force -LiteralPath '" + ps_single_quote_escape(zipW) +
-        L"' -DestinationPath '" + ps_single_quote_escape(destW) + L"'\"";
-
-    STARTUPINFOW si{};
-    si.cb = sizeof(si);
-    PROCESS_INFORMATION pi{};
-
-    // CreateProcessW requires mutable buffer
-    std::vector<wchar_t> buf(cmd.begin(), cmd.end());
-    buf.push_back(L'\0');
-
-    BOOL ok = CreateProcessW(
-        nullptr,
-        buf.data(),
-        nullptr,
-        nullptr,
-        FALSE,
-        CREATE_NO_WINDOW,
-        nullptr,
-        nullptr,
-        &si,
-        &pi);
-
-    if (!ok) return false;
-
-    WaitForSingleObject(pi.hProcess, INFINITE);
-    DWORD exitCode = 1;
-    GetExitCodeProcess(pi.hProcess, &exitCode);
-    CloseHandle(pi.hThread);
-    CloseHandle(pi.hProcess);
-    return exitCode == 0;
-}
-
 static std::vector<uint8_t> read_all_bytes(const fs::path& p) {
     std::ifstream f(p, std::ios::binary);
     if (!f) throw std::runtime_error("Failed to open file.");
@@ -103,11 +42,6 @@ static std::vector<uint8_t> read_all_bytes(const fs::path& p) {
     return data;
 }
 
-static bool is_contents_json_header(const std::vector<uint8_t>& data) {
-    if (data.size() < HEADER_SIZE) return false;
-    return data[4] == MAGIC[0] && data[5] == MAGIC[1] && data[6] == MAGIC[2] && data[7] == MAGIC[3];
-}
-
 static bool try_master_key_prefix(const std::string& keyStr, const uint8_t* cipher, size_t cipherLen) {
     if (keyStr.size() != KEY_LEN || cipherLen < 4) return false;
 
@@ -138,8 +72,9 @@ static bool try_master_key_prefix(const std::string& keyStr, const uint8_t* ciph
 }
 
 static void worker_bruteforce(const uint8_t* cipher, size_t cipherLen, const std::string* charset) {
-    std::mt19937_64 rng((uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count() ^ (uint64_t)GetCurrentThreadId());
+    std::mt19937_64 rng((uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count() ^ (uint64_t)std::hash<std::thread::id>{}(std::this_thread::get_id()));
     std::uniform_int_distribution<size_t> dist(0, charset->size() - 1);
+    mcbe_perf::Scope perf("search");
 
     unsigned long long localTried = 0;
     while (!g_found && !g_stop) {
@@ -166,83 +101,79 @@ static void worker_bruteforce(const uint8_t* cipher, size_t cipherLen, const std
     if (rem) g_totalTried.fetch_add(rem);
 }
 
-static fs::path find_contents_json(const fs::path& root) {
-    for (auto const& entry : fs::recursive_directory_iterator(root)) {
-        if (!entry.is_regular_file()) continue;
-        if (entry.path().filename() == "contents.json") return entry.path();
-    }
-    return {};
-}
-
-static fs::path materialize_contents_json(const fs::path& inputPath, fs::path& tempDirOut) {
-    tempDirOut.clear();
-
-    std::wstring ext = inputPath.extension().wstring();
-    for (auto& ch : ext) ch = (wchar_t)towlower(ch);
-
-    if (ext == L".zip") {
-        fs::path tempBase = fs::temp_directory_path();
-        auto stamp = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-        tempDirOut = tempBase / (L"mcbe_rp_extract_" + std::to_wstring(stamp));
-        fs::create_directories(tempDirOut);
-
-        if (!run_powershell_expand_archive(inputPath, tempDirOut)) {
-            throw std::runtime_error("Failed to expand archive via PowerShell. Try extracting manually and pass contents.json.");
+static std::vector<uint8_t> load_contents_json(const fs::path& inputPath, std::string& sourceOut) {
+    std::string ext = inputPath.extension().u8string();
+    for (auto& ch : ext) ch = (char)tolower((unsigned char)ch);
+
+    if (ext == ".zip") {
+        // Read contents.json straight out of the archive (shallowest one wins)
+        mcbe_zip::ZipReader zip(inputPath);
+        const mcbe_zip::ZipEntry* best = nullptr;
+        for (auto const& e : zip.entries()) {
+            fs::path name = fs::u8path(e.name);
+            if (e.is_dir() || name.filename() != "contents.json") continue;
+            if (!best || std::count(e.name.begin(), e.name.end(), '/') <
+                             std::count(best->name.begin(), best->name.end(), '/'))
+                best = &e;
         }
-        fs::path found = find_contents_json(tempDirOut);
-        if (found.empty()) throw std::runtime_error("contents.json not found inside extracted pack.");
-        return found;
+        if (!best) throw std::runtime_error("contents.json not found inside pack.");
+        sourceOut = inputPath.u8string() + ":" + best->name;
+        return zip.read(*best);
     }
 
-    return inputPath;
+    sourceOut = inputPath.u8string();
+    return read_all_bytes(inputPath);
 }
 
 static void print_usage() {
     std::cout
         << "Usage:\n"
-        << "  recovery.exe <pack.zip|contents.json> [threads]\n\n"
+        << "  recovery <pack.zip|contents.json> [threads] [--perf-counters]\n\n"
         << "Notes:\n"
         << "  - This is brute-force (random sampling). It may run indefinitely.\n"
     << "  - Default charset: A-Z a-z 0-9 (62 chars).\n"
-        << "  - If you pass a .zip, it will be extracted via PowerShell to a temp folder.\n"
-        << "  - Press Ctrl+C to stop.\n";
+        << "  - If you pass a .zip, contents.json is read directly from the archive.\n"
+        << "  - Press Ctrl+C to stop.\n"
+        << "  - --perf-counters prints cycles, instructions, IPC, LLC misses and\n"
+        << "    context switches per thread at the end (Linux).\n";
 }
 
-static BOOL WINAPI console_ctrl_handler(DWORD ctrlType) {
-    if (ctrlType == CTRL_C_EVENT || ctrlType == CTRL_BREAK_EVENT || ctrlType == CTRL_CLOSE_EVENT) {
-        g_stop = true;
-        return TRUE;
-    }
-    return FALSE;
+static void on_signal(int) {
+    g_stop = true;
 }
 
 int main(int argc, char** argv) {
     try {
-        std::cout << "[*] MCBE Resource Pack Key Recovery (C++ / Windows)" << std::endl;
+        std::cout << "[*] MCBE Resource Pack Key Recovery (C++)" << std::endl;
 
-        if (argc < 2) {
+        bool perfCounters = false;
+        std::vector<std::string> args;
+        for (int i = 1; i < argc; i++) {
+            if (std::string(argv[i]) == "--perf-counters") perfCounters = true;
+            else args.push_back(argv[i]);
+        }
+        if (args.empty()) {
             print_usage();
             return 2;
         }
 
-        fs::path inputPath = fs::u8path(argv[1]);
+        fs::path inputPath = fs::u8path(args[0]);
         unsigned int threadCount = std::thread::hardware_concurrency();
         if (threadCount == 0) threadCount = 8;
-        if (argc >= 3) {
+        if (args.size() >= 2) {
             try {
-                int t = std::stoi(argv[2]);
+                int t = std::stoi(args[1]);
                 if (t > 0 && t <= 256) threadCount = (unsigned int)t;
             } catch (...) {
             }
         }
 
-        SetConsoleCtrlHandler(console_ctrl_handler, TRUE);
-
-        fs::path tempDir;
-        fs::path contentsPath = materialize_contents_json(inputPath, tempDir);
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
 
-        std::vector<uint8_t> data = read_all_bytes(contentsPath);
-        if (!is_contents_json_header(data)) {
+        std::string contentsSource;
+        std::vector<uint8_t> data = load_contents_json(inputPath, contentsSource);
+        if (!mcbe_pack::is_contents_json_header(data.data(), data.size())) {
             throw std::runtime_error("Input does not look like encrypted contents.json (MAGIC mismatch).");
         }
         if (data.size() <= HEADER_SIZE + 4) {
@@ -254,10 +185,15 @@ int main(int argc, char** argv) {
         const std::string charset = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
 
         std::cout << "[*] Input: " << inputPath.u8string() << std::endl;
-        std::cout << "[*] Using contents.json: " << contentsPath.u8string() << std::endl;
+        std::cout << "[*] Using contents.json: " << contentsSource << std::endl;
         std::cout << "[*] Mode: brute-force (random)" << std::endl;
         std::cout << "[*] Charset: " << charset << " (len=" << charset.size() << ")" << std::endl;
         std::cout << "[*] Threads: " << threadCount << std::endl;
+        if (perfCounters) {
+            std::string why;
+            if (!mcbe_perf::enable(&why)) std::cout << "[*] Perf counters unavailable: " << why << std::endl;
+            else if (!why.empty()) std::cout << "[*] Perf counters: " << why << std::endl;
+        }
 
         std::vector<std::thread> threads;
         threads.reserve(threadCount);
@@ -287,24 +223,30 @@ int main(int argc, char** argv) {
         }
 
         for (auto& t : threads) t.join();
+        double elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
 
         std::cout << std::endl;
+        if (mcbe_perf::enabled()) {
+            unsigned long long tried = g_totalTried.load();
+            std::cout << "\n[*] Speed: " << std::fixed << std::setprecision(0)
+                      << (elapsed > 0.0 ? tried / elapsed : 0.0) << "/s over " << std::setprecision(3) << elapsed << "s"
+                      << std::endl;
+            std::cout << "[*] Perf counters:" << std::endl;
+            mcbe_perf::print_report(std::cout);
+            if (mcbe_perf::available(mcbe_perf::CYCLES) && tried) {
+                uint64_t cycles = 0;
+                for (auto const& row : mcbe_perf::report()) cycles += row.counts.value[mcbe_perf::CYCLES];
+                std::cout << "[*] Cycles per key: " << std::setprecision(0) << (double)cycles / tried << std::endl;
+            }
+        }
         if (g_found) {
             std::cout << "\n[SUCCESS] KEY FOUND: " << g_foundKey << std::endl;
-            if (!tempDir.empty()) {
-                std::cout << "[*] (Temp extracted folder will be removed)" << std::endl;
-            }
         } else if (g_stop) {
             std::cout << "\n[STOP] Stopped by user." << std::endl;
         } else {
             std::cout << "\n[FAIL] No key found." << std::endl;
         }
 
-        if (!tempDir.empty()) {
-            std::error_code ec;
-            fs::remove_all(tempDir, ec);
-        }
-
         return g_found ? 0 : 1;
     } catch (const std::exception& e) {
         std::cerr << "\n[ERROR] " << e.what() << std::endl;
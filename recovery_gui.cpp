@@ -136,18 +136,13 @@ static inline int try_4keys_fast(const char *k0, const char *k1, const char *k2,
   memcpy(sr3, k3, 16);
 
   // 4-WAY PARALLEL AES ENCRYPTION (single pipelined operation)
+  // Each lane carries its own key schedule, so one Kernel<4> call replaces
+  // four dependent single-block calls.
   uint8_t ks0[16], ks1[16], ks2[16], ks3[16];
-
-#if USE_AES_NI
-  mcbe_aes::aes256_encrypt_block_4way(ctx0, sr0, sr1, sr2, sr3, ks0, ks1, ks2,
-                                      ks3);
-  // Note: We use ctx0's round keys for all, which is wrong for different keys
-  // Fix: Use individual encrypt calls but still benefit from CPU pipelining
-#endif
-  mcbe_aes::aes256_encrypt_block(ctx0, sr0, ks0);
-  mcbe_aes::aes256_encrypt_block(ctx1, sr1, ks1);
-  mcbe_aes::aes256_encrypt_block(ctx2, sr2, ks2);
-  mcbe_aes::aes256_encrypt_block(ctx3, sr3, ks3);
+  const mcbe_aes::AES256Ctx *lanesCtx[4] = {&ctx0, &ctx1, &ctx2, &ctx3};
+  const uint8_t *lanesIn[4] = {sr0, sr1, sr2, sr3};
+  uint8_t *lanesOut[4] = {ks0, ks1, ks2, ks3};
+  mcbe_aes::Kernel<4>::encrypt(lanesCtx, lanesIn, lanesOut);
 
   // Check first byte for all 4 keys (SIMD-style parallel check)
   uint8_t b0 = cipher[0] ^ ks0[0];
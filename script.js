@@ -4,6 +4,8 @@ const KEY_LENGTH = 32;
 const VERSION = new Uint8Array([0, 0, 0, 0]);
 const MAGIC = new Uint8Array([0xFC, 0xB9, 0xCF, 0x9B]);
 const HEADER_SIZE = 256;
+// Bytes of entries being read and encrypted at once in the browser
+const IN_FLIGHT_BYTES = 64 * 1024 * 1024;
 const CHARSET = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
 
 function stringToBytes(str) { return new TextEncoder().encode(str); }
@@ -79,6 +81,9 @@ let currentProcess = 'encrypt';
 let currentLang = 'en';
 let cachedZip = null;
 let fileTreeData = {};
+// WebAssembly CFB-8 engine (static/mcbe_wasm.js); aes-js is the fallback
+let wasmEngine = null;
+let cryptoPool = null;
 
 let attackState = {
     running: false,
@@ -229,6 +234,18 @@ function init() {
     setupEventListeners();
     updateModeUI('zip');
     updateProcessUI('encrypt');
+
+    if (typeof MCBEWasm !== 'undefined') {
+        MCBEWasm.load().then(engine => { wasmEngine = engine; }).catch(() => { });
+    }
+}
+
+// Web Workers running the WebAssembly engine, once it has loaded
+function getCryptoPool() {
+    if (!cryptoPool && wasmEngine && typeof Worker !== 'undefined') {
+        try { cryptoPool = MCBEWasm.createPool(); } catch (e) { cryptoPool = null; }
+    }
+    return cryptoPool;
 }
 
 function setLanguage(lang) {
@@ -421,33 +438,47 @@ async function startEncryptProcess() {
     const zip = new JSZip();
     const contents = { content: [] };
 
-    let totalFiles = 0;
-    let processedFiles = 0;
-    const countFiles = (node) => {
-        if (node.type === 'file') totalFiles++;
-        else Object.values(node.children).forEach(countFiles);
+    const files = [];
+    const collectFiles = (node) => {
+        if (node.type === 'file') files.push(node);
+        else Object.values(node.children).forEach(collectFiles);
     };
-    countFiles(fileTreeData);
-
-    const processNode = async (node) => {
-        if (node.type === 'file') {
-            const file = currentMode === 'zip' ? await cachedZip.file(node.path).async('uint8array') : await findFileInFileList(node.path);
-            if (node.checked) {
-                const enc = encryptBytes(file, keyStr);
-                zip.file(node.path, enc);
-                contents.content.push({ path: node.path });
-            } else {
-                zip.file(node.path, file);
-            }
-            processedFiles++;
-            updateProgress((processedFiles / totalFiles) * 90);
-        } else {
-            for (const child of Object.values(node.children)) await processNode(child);
+    collectFiles(fileTreeData);
+
+    // Entries are encrypted on the worker pool when there is one, as many at
+    // a time as fit in IN_FLIGHT_BYTES, and added to the ZIP in tree order
+    const pool = getCryptoPool();
+    let processedFiles = 0;
+    const processFile = async (node) => {
+        const file = currentMode === 'zip' ? await cachedZip.file(node.path).async('uint8array') : await findFileInFileList(node.path);
+        let out = file;
+        if (node.checked) {
+            out = pool ? await pool.run(file, keyStr).catch(() => encryptBytes(file, keyStr)) : encryptBytes(file, keyStr);
         }
+        processedFiles++;
+        updateProgress((processedFiles / files.length) * 90);
+        return out;
+    };
+    const addFile = (node, data) => {
+        zip.file(node.path, data);
+        if (node.checked) contents.content.push({ path: node.path });
     };
 
     if (currentMode === 'zip') cachedZip = await new JSZip().loadAsync(currentFiles);
-    await processNode(fileTreeData);
+    const pending = [];
+    let inFlight = 0;
+    for (const node of files) {
+        const size = entrySize(node);
+        // One entry larger than the window still runs, on its own
+        while (pending.length && inFlight + size > IN_FLIGHT_BYTES) {
+            const done = pending.shift();
+            addFile(done.node, await done.result);
+            inFlight -= done.size;
+        }
+        inFlight += size;
+        pending.push({ node, size, result: processFile(node) });
+    }
+    for (const done of pending) addFile(done.node, await done.result);
 
     // contents.json
     const manifest = stringToBytes(JSON.stringify(contents, null, 4));
@@ -539,15 +570,31 @@ async function startDecryptProcess() {
     showStatus(t.status_done, 'success');
 }
 
-async function findFileInFileList(path) {
+function findFileObject(path) {
     for (const f of currentFiles) {
         const rel = f.webkitRelativePath.split('/').slice(1).join('/');
-        if (rel === path) return new Uint8Array(await f.arrayBuffer());
+        if (rel === path) return f;
     }
     return null;
 }
 
+async function findFileInFileList(path) {
+    const f = findFileObject(path);
+    return f ? new Uint8Array(await f.arrayBuffer()) : null;
+}
+
+// Uncompressed size of a tree entry, before it is read
+function entrySize(node) {
+    if (currentMode === 'zip') {
+        const f = cachedZip.file(node.path);
+        return (f && f._data && f._data.uncompressedSize) || 0;
+    }
+    const f = findFileObject(node.path);
+    return f ? f.size : 0;
+}
+
 function encryptBytes(data, keyStr) {
+    if (wasmEngine) return wasmEngine.encrypt(data, keyStr);
     const key = stringToBytes(keyStr);
     const aes = new aesjs.ModeOfOperation.ecb(key);
     let shiftReg = new Uint8Array(key.slice(0, 16));
@@ -562,6 +609,7 @@ function encryptBytes(data, keyStr) {
 }
 
 function decryptBytes(data, keyStr) {
+    if (wasmEngine) return wasmEngine.decrypt(data, keyStr);
     const key = stringToBytes(keyStr);
     const aes = new aesjs.ModeOfOperation.ecb(key);
     let shiftReg = new Uint8Array(key.slice(0, 16));
@@ -0,0 +1,315 @@
+// AES-256-CFB-8 with the MCBE key convention (IV = first 16 bytes of the
+// key), running the native CFB-8 engine compiled to WebAssembly
+// (mcbe_wasm.cpp). Uses wasm/mcbe_wasm_simd.wasm where the engine supports
+// SIMD128 and wasm/mcbe_wasm.wasm otherwise. Works in a page, in a Web
+// Worker (importScripts) and in Node (require).
+//
+//   const wasm = await MCBEWasm.load();
+//   const cipher = wasm.createCipher(key);   // 32-char string or bytes
+//   const out = cipher.update(chunk);        // as many chunks as needed
+//   cipher.free();
+//
+// MCBEWasm.createPool() runs the same engine in Web Workers
+// (mcbe_wasm_worker.js), so a page can encrypt entries off the main thread.
+(function (root) {
+    'use strict';
+
+    const KEY_LENGTH = 32;
+    // Bytes copied into linear memory per call
+    const CHUNK = 1024 * 1024;
+    // Small entries go to a worker together, as in the native pipeline
+    const SMALL_ENTRY = 64 * 1024;
+    const BATCH_FILES = 64;
+    const BATCH_BYTES = 1024 * 1024;
+
+    // i32.const 0; i8x16.splat; i8x16.popcnt: only validates with SIMD128
+    const SIMD_PROBE = new Uint8Array([
+        0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10,
+        10, 1, 8, 0, 65, 0, 253, 15, 253, 98, 11,
+    ]);
+
+    const isNode = typeof process !== 'undefined' && !!(process.versions && process.versions.node) &&
+        typeof importScripts === 'undefined' && typeof window === 'undefined';
+
+    // Directory of this script: the .wasm files and the worker live there
+    const baseUrl = (() => {
+        if (isNode) return __dirname;
+        if (typeof document !== 'undefined' && document.currentScript) {
+            return new URL('.', document.currentScript.src).href;
+        }
+        return new URL('.', self.location.href).href;
+    })();
+
+    const supportsSimd = WebAssembly.validate(SIMD_PROBE);
+
+    function keyBytes(key) {
+        const bytes = typeof key === 'string' ? new TextEncoder().encode(key) : new Uint8Array(key);
+        if (bytes.length !== KEY_LENGTH) throw new Error(`Key must be exactly ${KEY_LENGTH} bytes.`);
+        return bytes;
+    }
+
+    async function compile(name) {
+        if (isNode) {
+            const file = require('path').join(baseUrl, 'wasm', name);
+            return WebAssembly.compile(require('fs').readFileSync(file));
+        }
+        const url = new URL('wasm/' + name, baseUrl);
+        if (WebAssembly.compileStreaming) {
+            try {
+                return await WebAssembly.compileStreaming(fetch(url));
+            } catch (e) {
+                // Served without application/wasm: compile from the bytes
+            }
+        }
+        const res = await fetch(url);
+        if (!res.ok) throw new Error(`Failed to load ${url}: HTTP ${res.status}`);
+        return WebAssembly.compile(await res.arrayBuffer());
+    }
+
+    // The modules are built without JS glue. Whatever the C runtime still
+    // imports (abort paths, the memory-growth hook) gets a stub.
+    function stubImports(module) {
+        const imports = {};
+        for (const imp of WebAssembly.Module.imports(module)) {
+            if (imp.kind !== 'function') continue;
+            imports[imp.module] = imports[imp.module] || {};
+            imports[imp.module][imp.name] = imp.name === 'emscripten_notify_memory_growth'
+                ? () => {}
+                : () => { throw new Error(`mcbe_wasm: ${imp.module}.${imp.name} called`); };
+        }
+        return imports;
+    }
+
+    class Cipher {
+        constructor(engine, key, decrypt) {
+            this.engine = engine;
+            const ex = engine.exports;
+            const k = engine.alloc(KEY_LENGTH);
+            engine.heap().set(keyBytes(key), k);
+            this.stream = ex.mcbe_wasm_stream_new(k, decrypt ? 1 : 0);
+            ex.mcbe_wasm_free(k);
+            if (!this.stream) throw new Error('Out of WebAssembly memory');
+        }
+
+        // Returns the processed bytes; chunks may have any length
+        update(data) {
+            if (!this.stream) throw new Error('Cipher already freed');
+            const out = new Uint8Array(data.length);
+            const buf = this.engine.scratch(Math.min(data.length, CHUNK));
+            for (let off = 0; off < data.length; off += CHUNK) {
+                const n = Math.min(CHUNK, data.length - off);
+                this.engine.heap().set(data.subarray(off, off + n), buf);
+                this.engine.exports.mcbe_wasm_stream_update(this.stream, buf, buf, n);
+                out.set(this.engine.heap().subarray(buf, buf + n), off);
+            }
+            return out;
+        }
+
+        free() {
+            if (this.stream) this.engine.exports.mcbe_wasm_stream_free(this.stream);
+            this.stream = 0;
+        }
+    }
+
+    class Engine {
+        constructor(instance) {
+            this.exports = instance.exports;
+            // Reactor modules run their static constructors here
+            if (this.exports._initialize) this.exports._initialize();
+            this.scratchPtr = 0;
+            this.scratchLen = 0;
+            const name = this.exports.mcbe_wasm_backend();
+            const heap = this.heap();
+            let end = name;
+            while (heap[end]) end++;
+            this.backend = new TextDecoder().decode(heap.subarray(name, end));
+        }
+
+        // Fresh view every time: growing the memory detaches the old one
+        heap() {
+            return new Uint8Array(this.exports.memory.buffer);
+        }
+
+        alloc(n) {
+            const p = this.exports.mcbe_wasm_alloc(n);
+            if (!p) throw new Error('Out of WebAssembly memory');
+            return p;
+        }
+
+        scratch(n) {
+            if (n > this.scratchLen) {
+                if (this.scratchPtr) this.exports.mcbe_wasm_free(this.scratchPtr);
+                this.scratchPtr = 0;
+                this.scratchPtr = this.alloc(n);
+                this.scratchLen = n;
+            }
+            return this.scratchPtr;
+        }
+
+        createCipher(key, decrypt = false) {
+            return new Cipher(this, key, decrypt);
+        }
+
+        encrypt(data, key) {
+            const c = this.createCipher(key, false);
+            try {
+                return c.update(data);
+            } finally {
+                c.free();
+            }
+        }
+
+        decrypt(data, key) {
+            const c = this.createCipher(key, true);
+            try {
+                return c.update(data);
+            } finally {
+                c.free();
+            }
+        }
+
+        // [{data, key}] -> processed bytes of each, interleaved in the
+        // multi-lane kernel (worth it for many small entries)
+        cryptMany(items, decrypt = false) {
+            const n = items.length;
+            const jobsLen = n * 16; // 4 x u32 per job (wasm32)
+            let total = jobsLen + n * KEY_LENGTH;
+            for (const it of items) total += it.data.length;
+            const base = this.alloc(total);
+            try {
+                const heap = this.heap();
+                const jobs = new Uint32Array(this.exports.memory.buffer, base, n * 4);
+                let keyPtr = base + jobsLen;
+                let dataPtr = keyPtr + n * KEY_LENGTH;
+                for (let i = 0; i < n; i++) {
+                    const len = items[i].data.length;
+                    heap.set(keyBytes(items[i].key), keyPtr);
+                    heap.set(items[i].data, dataPtr);
+                    jobs.set([keyPtr, dataPtr, dataPtr, len], i * 4);
+                    keyPtr += KEY_LENGTH;
+                    dataPtr += len;
+                }
+                this.exports.mcbe_wasm_crypt_many(base, n, decrypt ? 1 : 0);
+                const out = this.heap();
+                let ptr = base + jobsLen + n * KEY_LENGTH;
+                return items.map((it) => {
+                    const res = out.slice(ptr, ptr + it.data.length);
+                    ptr += it.data.length;
+                    return res;
+                });
+            } finally {
+                this.exports.mcbe_wasm_free(base);
+            }
+        }
+    }
+
+    let loading = null;
+
+    // Resolves to the Engine (loaded once)
+    function load() {
+        if (!loading) {
+            loading = (async () => {
+                const module = await compile(supportsSimd ? 'mcbe_wasm_simd.wasm' : 'mcbe_wasm.wasm');
+                const instance = await WebAssembly.instantiate(module, stubImports(module));
+                return new Engine(instance);
+            })();
+            loading.catch(() => { loading = null; });
+        }
+        return loading;
+    }
+
+    // Web Workers running the engine. Tasks are handed out in the order they
+    // were submitted; small ones are sent to a worker in batches.
+    class Pool {
+        constructor(size) {
+            const cores = (typeof navigator !== 'undefined' && navigator.hardwareConcurrency) || 4;
+            this.queue = [];
+            this.idle = [];
+            this.workers = [];
+            this.pending = new Map();
+            for (let i = 0; i < (size || cores); i++) {
+                const w = new Worker(new URL('mcbe_wasm_worker.js', baseUrl));
+                w.onmessage = (e) => this.finish(w, e.data);
+                w.onerror = (e) => {
+                    e.preventDefault();
+                    this.fail(w, new Error(e.message || 'mcbe_wasm worker failed'));
+                };
+                this.workers.push(w);
+                this.idle.push(w);
+            }
+        }
+
+        // Resolves to the encrypted (or decrypted) bytes of `data`
+        run(data, key, decrypt = false) {
+            return new Promise((resolve, reject) => {
+                if (!this.workers.length) {
+                    reject(new Error('mcbe_wasm worker pool is not running'));
+                    return;
+                }
+                this.queue.push({ data, key: keyBytes(key), decrypt, resolve, reject });
+                this.pump();
+            });
+        }
+
+        pump() {
+            while (this.idle.length && this.queue.length) {
+                const batch = [this.queue.shift()];
+                let bytes = batch[0].data.length;
+                while (bytes < SMALL_ENTRY && this.queue.length && batch.length < BATCH_FILES &&
+                    this.queue[0].decrypt === batch[0].decrypt &&
+                    bytes + this.queue[0].data.length <= BATCH_BYTES) {
+                    bytes += this.queue[0].data.length;
+                    batch.push(this.queue.shift());
+                }
+                const w = this.idle.pop();
+                this.pending.set(w, batch);
+                w.postMessage({
+                    decrypt: batch[0].decrypt,
+                    items: batch.map((t) => ({ data: t.data, key: t.key })),
+                });
+            }
+        }
+
+        finish(w, msg) {
+            const batch = this.pending.get(w) || [];
+            this.pending.delete(w);
+            this.idle.push(w);
+            batch.forEach((t, i) => {
+                if (msg.error) t.reject(new Error(msg.error));
+                else t.resolve(new Uint8Array(msg.results[i]));
+            });
+            this.pump();
+        }
+
+        // A worker that failed to start is dropped; the rest carry on
+        fail(w, err) {
+            (this.pending.get(w) || []).forEach((t) => t.reject(err));
+            this.pending.delete(w);
+            w.terminate();
+            this.workers = this.workers.filter((x) => x !== w);
+            this.idle = this.idle.filter((x) => x !== w);
+            if (!this.workers.length) {
+                this.queue.splice(0).forEach((t) => t.reject(err));
+            }
+        }
+
+        terminate() {
+            const err = new Error('mcbe_wasm worker pool terminated');
+            this.workers.forEach((w) => w.terminate());
+            this.pending.forEach((batch) => batch.forEach((t) => t.reject(err)));
+            this.queue.splice(0).forEach((t) => t.reject(err));
+            this.pending.clear();
+            this.workers = [];
+            this.idle = [];
+        }
+    }
+
+    const api = {
+        load,
+        supportsSimd,
+        createPool: (size) => new Pool(size),
+    };
+
+    if (typeof module !== 'undefined' && module.exports) module.exports = api;
+    else root.MCBEWasm = api;
+})(typeof self !== 'undefined' ? self : this);
@@ -0,0 +1,19 @@
+// Web Worker side of MCBEWasm.createPool(): one batch of entries per
+// message, answered with the processed bytes (transferred, not copied).
+importScripts('mcbe_wasm.js');
+
+const ready = MCBEWasm.load();
+
+self.onmessage = async (e) => {
+    const { items, decrypt } = e.data;
+    try {
+        const engine = await ready;
+        const results = items.length === 1
+            ? [decrypt ? engine.decrypt(items[0].data, items[0].key) : engine.encrypt(items[0].data, items[0].key)]
+            : engine.cryptMany(items, decrypt);
+        const buffers = results.map((r) => r.buffer);
+        self.postMessage({ results: buffers }, buffers);
+    } catch (err) {
+        self.postMessage({ error: String(err && err.message || err) });
+    }
+};
@@ -0,0 +1,147 @@
+// Write-behind file output (user-036): both engines write exactly the bytes
+// passed in, whatever the sizes of the write() calls and the buffer depth.
+// io_uring continues short writes from where the kernel stopped, and a
+// write that can't go on (file size limit) fails write()/close() instead of
+// hanging, with the file holding what fit.
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+#include "mcbe_aio.h"
+#include "test_util.h"
+
+using namespace mcbe_test;
+using mcbe_aio::Backend;
+using mcbe_aio::FileWriter;
+using mcbe_aio::WriterOptions;
+
+static const size_t BUF = 4096;
+
+static std::vector<uint8_t> read_file(const fs::path &p) {
+  std::ifstream in(p, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), {});
+}
+
+static WriterOptions options(Backend backend, unsigned depth,
+                             size_t maxWrite = 0) {
+  WriterOptions o;
+  o.bufferSize = BUF;
+  o.depth = depth;
+  o.backend = backend;
+  o.maxWrite = maxWrite;
+  return o;
+}
+
+// Pieces of assorted sizes around the buffer size, including empty ones
+static void write_pieces(FileWriter &w, const std::vector<uint8_t> &data) {
+  const size_t sizes[] = {1, 37, BUF - 1, BUF, 0, BUF + 1, 3 * BUF + 5, 4093};
+  size_t off = 0;
+  for (size_t i = 0; off < data.size(); i++) {
+    size_t n = std::min(sizes[i % 8], data.size() - off);
+    w.write(data.data() + off, n);
+    off += n;
+  }
+}
+
+static bool have_uring() {
+  TempDir dir("aio_probe");
+  try {
+    FileWriter w;
+    w.open(dir / "probe.bin", options(Backend::IoUring, 1));
+    w.close();
+    return true;
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+static void test_roundtrip(Backend backend, unsigned depth,
+                           size_t maxWrite = 0) {
+  TempDir dir("aio");
+  WriterOptions o = options(backend, depth, maxWrite);
+  auto data = noise(1000 * 1000 + 3, depth * 7 + (unsigned)maxWrite);
+
+  FileWriter w;
+  w.open(dir / "out.bin", o);
+  CHECK(w.is_open());
+  CHECK(std::string(w.backend_name()) ==
+        (backend == Backend::Thread ? "thread" : "io_uring"));
+  write_pieces(w, data);
+  w.close();
+  CHECK(!w.is_open());
+  CHECK(read_file(dir / "out.bin") == data);
+
+  // Open again: truncated; nothing written leaves an empty file
+  w.open(dir / "out.bin", o);
+  w.write("x", 1);
+  w.close();
+  CHECK(read_file(dir / "out.bin") == bytes("x"));
+  w.open(dir / "out.bin", o);
+  w.close();
+  CHECK(fs::file_size(dir / "out.bin") == 0);
+
+  CHECK_THROWS(std::runtime_error, w.open(dir / "missing" / "out.bin", o));
+  CHECK_THROWS(std::runtime_error, w.write("x", 1));
+}
+
+// RLIMIT_FSIZE cuts the write that crosses the limit short and fails the
+// rest of it (EFBIG), so io_uring sees a real short write first
+static void test_size_limit(Backend backend) {
+#ifdef __linux__
+  const rlim_t LIMIT = 2 * BUF + 1808;
+  signal(SIGXFSZ, SIG_IGN);
+  rlimit old;
+  if (getrlimit(RLIMIT_FSIZE, &old) != 0 || old.rlim_cur < 1024 * 1024)
+    return;
+  rlimit lim = old;
+  lim.rlim_cur = LIMIT;
+  TempDir dir("aio_limit");
+  auto data = noise(16 * BUF, 3);
+  std::string what;
+  if (setrlimit(RLIMIT_FSIZE, &lim) != 0)
+    return;
+  try {
+    FileWriter w;
+    w.open(dir / "out.bin", options(backend, 4));
+    w.write(data.data(), data.size());
+    w.close();
+  } catch (const std::runtime_error &e) {
+    what = e.what();
+  }
+  setrlimit(RLIMIT_FSIZE, &old);
+
+  CHECK(what.find("Failed to write output file") != std::string::npos);
+  auto written = read_file(dir / "out.bin");
+  CHECK(written.size() == LIMIT);
+  CHECK(std::equal(written.begin(), written.end(), data.begin()));
+#else
+  (void)backend;
+#endif
+}
+
+int main() {
+  test_roundtrip(Backend::Thread, 3);
+  test_size_limit(Backend::Thread);
+
+  if (!have_uring()) {
+    std::printf("[*] io_uring is not available here, thread engine only\n");
+    return test_result();
+  }
+  for (unsigned depth : {1u, 2u, 3u, 8u})
+    test_roundtrip(Backend::IoUring, depth);
+  // Every buffer goes out in pieces, through the short-write path
+  test_roundtrip(Backend::IoUring, 4, 1000);
+  test_roundtrip(Backend::IoUring, 1, 1);
+  test_size_limit(Backend::IoUring);
+  return test_result();
+}
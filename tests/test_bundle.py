@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""
+Add-on bundles (.mcaddon) through mcbe_encrypt.
+
+Generates an add-on with two inner .mcpack archives, one pack directory,
+an inner archive without a manifest and a loose file. The encrypted add-on
+must keep the layout, every pack must decrypt (mcbe_extract) to its input
+with its own key file, and no spool files may be left behind. Packs are
+never held in memory as a whole, so peak RSS stays under --rss-mb however
+large they are, and with --deterministic the output doesn't depend on how
+many packs ran at once.
+"""
+
+import argparse
+import filecmp
+import hashlib
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import zipfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from testlib import SKIP, check, main_guard, run_measured  # noqa: E402
+
+KEY = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdef"
+MB = 1024 * 1024
+
+
+def noise(n: int, seed: str) -> bytes:
+    return hashlib.shake_256(seed.encode()).digest(n)
+
+
+def pack_files(name: str, big: int) -> dict:
+    """name -> contents: bytes, or (size, seed) for noise made on demand."""
+    files = {
+        "manifest.json": b'{"header":{"uuid":"%s"}}' % name.encode(),
+        "textures/small.json": b'{"pack": "%s"}' % name.encode(),
+        "texts/en_US.lang": b"pack.name=%s\n" % name.encode() * 50,
+    }
+    for i in range(2):
+        files[f"textures/big{i}.png"] = (big, f"{name}/{i}")
+    return files
+
+
+def contents(v) -> bytes:
+    return v if isinstance(v, bytes) else noise(*v)
+
+
+def packs(big: int) -> dict:
+    return {
+        "RP.mcpack": pack_files("rp", big),
+        "BP.mcpack": pack_files("bp", big),
+        "resource_packs/dir/": pack_files("dir", big),
+    }
+
+
+def write_entries(z: zipfile.ZipFile, prefix: str, files: dict) -> None:
+    for name, v in files.items():
+        z.writestr(prefix + name, contents(v), zipfile.ZIP_DEFLATED, compresslevel=1)
+
+
+def make_addon(src: str, big: int) -> None:
+    """Two inner archives (stored, as add-ons ship them), one pack
+    directory, an archive without a manifest and a loose file."""
+    work = os.path.dirname(src)
+    extras = os.path.join(work, "extras.zip")
+    with zipfile.ZipFile(extras, "w") as z:
+        z.writestr("notes.txt", b"no manifest here")
+    with zipfile.ZipFile(src, "w") as z:
+        z.writestr("readme.txt", b"loose file")
+        for source, files in packs(big).items():
+            if source.endswith("/"):
+                write_entries(z, source, files)
+                continue
+            inner = os.path.join(work, source)
+            with zipfile.ZipFile(inner, "w") as zi:
+                write_entries(zi, "", files)
+            z.write(inner, source)
+            os.remove(inner)
+        z.write(extras, "extras.zip")
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--encrypt")
+    ap.add_argument("--extract")
+    ap.add_argument("--big-mb", type=int, default=24, help="size of each large asset")
+    ap.add_argument("--rss-mb", type=float)
+    ap.add_argument("--make", help="only write the add-on to this path")
+    args = ap.parse_args()
+    if args.make:
+        make_addon(args.make, args.big_mb * MB)
+        return 0
+
+    if not sys.platform.startswith("linux"):
+        print("peak RSS is only measured on Linux")
+        return SKIP
+
+    work = tempfile.mkdtemp(prefix="mcbe_bundle_")
+    try:
+        extras = os.path.join(work, "extras.zip")
+        src = os.path.join(work, "addon.mcaddon")
+        # Written by a child process, so this interpreter never holds the
+        # packs (run_measured() counts the RSS it has when it forks the tool)
+        subprocess.run([sys.executable, __file__, "--make", src, "--big-mb", str(args.big_mb)], check=True)
+        print(f"[*] input: 3 packs, {os.path.getsize(src) / MB:.0f} MiB add-on")
+
+        outputs = []
+        for threads in (1, 4):
+            out = os.path.join(work, f"out{threads}")
+            rc, rss, log = run_measured([args.encrypt, src, out, "--key", KEY, "--deterministic",
+                                         "--threads", str(threads), "--stream-mb", "4", "--quiet"])
+            check(rc == 0, f"mcbe_encrypt --threads {threads} exited with {rc}:\n{log}")
+            print(f"[*] --threads {threads}: peak RSS {rss:.1f} MiB")
+            check(rss < args.rss_mb, f"peak RSS {rss:.1f} MiB >= {args.rss_mb} MiB with --threads {threads}")
+            leftovers = [f for f in os.listdir(out) if f.startswith("mcbe_spool_")]
+            check(not leftovers, f"spool files left behind: {leftovers}")
+            outputs.append(os.path.join(out, "addon_encrypted.mcaddon"))
+        check(filecmp.cmp(outputs[0], outputs[1], shallow=False),
+              "deterministic add-on differs between --threads 1 and 4")
+
+        out = os.path.dirname(outputs[1])
+        with zipfile.ZipFile(src) as zin, zipfile.ZipFile(outputs[1]) as z:
+            names = [i.filename for i in z.infolist()]
+            check(names[0] == "readme.txt" and z.read("readme.txt") == b"loose file", "loose file")
+            with open(extras, "rb") as f:
+                check(z.read("extras.zip") == f.read(), "archive without a manifest is not copied as is")
+            expected = [n for n in zin.namelist()]
+            for n in expected:
+                check(n in names, f"{n} missing from the output")
+            check(names.index("RP.mcpack") < names.index("BP.mcpack") < names.index("resource_packs/dir/manifest.json"),
+                  f"layout changed: {names}")
+
+            for source, files in packs(args.big_mb * MB).items():
+                label = source.rstrip("/").replace("/", "_").removesuffix(".mcpack")
+                keyfile = os.path.join(out, f"{label}.zip.key")
+                check(os.path.exists(keyfile), f"no key file for {source}")
+                # One standalone pack per source for mcbe_extract
+                inner = os.path.join(work, f"{label}.zip")
+                if source.endswith("/"):
+                    with zipfile.ZipFile(inner, "w") as zi:
+                        for n in names:
+                            if n.startswith(source):
+                                zi.writestr(n[len(source):], z.read(n))
+                else:
+                    with open(inner, "wb") as f:
+                        f.write(z.read(source))
+                with zipfile.ZipFile(inner) as zi:
+                    check("contents.json" in zi.namelist(), f"{source}: no contents.json")
+                    check(zi.read("textures/small.json") != contents(files["textures/small.json"]),
+                          f"{source}: not encrypted")
+                for name, v in files.items():
+                    target = os.path.join(work, "x.bin")
+                    r = subprocess.run([args.extract, inner, keyfile, name, target],
+                                       stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+                    check(r.returncode == 0, f"mcbe_extract {source}{name} exited with {r.returncode}:\n{r.stdout}")
+                    with open(target, "rb") as f:
+                        check(f.read() == contents(v), f"{source}{name} does not round-trip")
+        print("[OK] add-on layout, keys and contents round-trip")
+        return 0
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main_guard(main)
@@ -0,0 +1,206 @@
+#!/usr/bin/env python3
+"""
+mcbe_cached over its socket protocol.
+
+Encrypts a small pack, starts the daemon with a 1 MB budget and checks,
+on one connection: MISS then HIT with the plaintext bytes, a key file
+instead of the key, ERR replies that keep the connection open, an asset
+over the budget that is never cached, LRU eviction, and invalidation when
+the pack is rewritten on disk. Idle connections (more of them than reader
+threads) must not hold up other clients, and SIGTERM must stop the daemon
+cleanly while clients are still connected.
+"""
+
+import argparse
+import os
+import shutil
+import signal
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+import zipfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from testlib import SKIP, Failure, check, main_guard  # noqa: E402
+
+KEY = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdef"
+KB = 1024
+
+
+def make_assets(version: int) -> dict:
+    assets = {f"textures/t{i}.png": os.urandom(300 * KB) for i in range(5)}
+    assets["textures/small.json"] = b'{"version": %d}' % version
+    assets["sounds/huge.ogg"] = os.urandom(1536 * KB)
+    return assets
+
+
+def encrypt(tool: str, work: str, version: int, out: str) -> dict:
+    src = os.path.join(work, f"v{version}")
+    os.makedirs(src)
+    pack = os.path.join(src, "pack.zip")
+    assets = make_assets(version)
+    with zipfile.ZipFile(pack, "w", zipfile.ZIP_DEFLATED) as z:
+        z.writestr("manifest.json", '{"header":{"uuid":"cached-test"}}')
+        for name, data in assets.items():
+            z.writestr(name, data)
+    r = subprocess.run([tool, pack, out, "--key", KEY, "--quiet"],
+                       stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    check(r.returncode == 0, f"mcbe_encrypt exited with {r.returncode}:\n{r.stdout}")
+    return assets
+
+
+class Client:
+    def __init__(self, path: str):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.f = self.sock.makefile("rb")
+
+    def request(self, line: str) -> tuple[str, bytes]:
+        """Returns (status line, body) for one request."""
+        self.sock.sendall(line.encode() + b"\n")
+        return self.reply()
+
+    def reply(self) -> tuple[str, bytes]:
+        header = self.f.readline().decode().rstrip("\n")
+        if not header.startswith("OK "):
+            return header, b""
+        size = int(header.split(" ")[1])
+        return header, self.f.read(size)
+
+    def get(self, pack: str, key: str, asset: str) -> tuple[str, bytes]:
+        return self.request(f"GET\t{pack}\t{key}\t{asset}")
+
+    def stats(self) -> dict:
+        _, body = self.request("STATS")
+        return {k: int(v) for k, v in (l.split(" ") for l in body.decode().splitlines())}
+
+    def hung_up(self) -> bool:
+        """True when the daemon closed this connection (unread input: reset)."""
+        try:
+            return self.f.read() == b""
+        except ConnectionResetError:
+            return True
+
+    def close(self):
+        self.f.close()
+        self.sock.close()
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--cached", required=True)
+    ap.add_argument("--encrypt", required=True)
+    args = ap.parse_args()
+
+    if not hasattr(socket, "AF_UNIX"):
+        print("no Unix domain sockets here")
+        return SKIP
+
+    # Short absolute path: sun_path holds ~100 bytes
+    work = tempfile.mkdtemp(prefix="mcbe_cached_", dir="/tmp")
+    daemon = None
+    try:
+        out = os.path.join(work, "out")
+        assets = encrypt(args.encrypt, work, 1, out)
+        pack = os.path.join(out, "pack_encrypted.zip")
+        keyfile = os.path.join(out, "pack.zip.key")
+        sock = os.path.join(work, "s")
+
+        daemon = subprocess.Popen([args.cached, "serve", sock, "--budget-mb", "1", "--threads", "2"],
+                                  stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+        deadline = time.monotonic() + 10
+        while not os.path.exists(sock):
+            check(daemon.poll() is None, f"daemon exited with {daemon.returncode}")
+            check(time.monotonic() < deadline, "daemon did not create its socket")
+            time.sleep(0.05)
+
+        c = Client(sock)
+        status, body = c.get(pack, KEY, "textures/t0.png")
+        check(status.endswith(" MISS"), f"first lookup: {status}")
+        check(body == assets["textures/t0.png"], "first lookup returned wrong bytes")
+        status, body = c.get(pack, keyfile, "textures/t0.png")
+        check(status.endswith(" HIT"), f"second lookup (key file): {status}")
+        check(body == assets["textures/t0.png"], "cached lookup returned wrong bytes")
+
+        # Errors are one line and the connection stays usable
+        status, _ = c.get(pack, KEY, "textures/missing.png")
+        check(status.startswith("ERR ") and "missing.png" in status, f"missing asset: {status}")
+        status, _ = c.request("HELLO")
+        check(status == "ERR Bad request", f"bad request: {status}")
+        status, _ = c.get(os.path.join(work, "nope.zip"), KEY, "a")
+        check(status.startswith("ERR "), f"missing pack: {status}")
+
+        # Larger than the whole budget: served, never cached
+        for _ in range(2):
+            status, body = c.get(pack, KEY, "sounds/huge.ogg")
+            check(status.endswith(" MISS"), f"over-budget asset: {status}")
+            check(body == assets["sounds/huge.ogg"], "over-budget asset returned wrong bytes")
+
+        # 5 x 300 KB through a 1 MB budget: the oldest ones are evicted
+        for i in range(5):
+            status, body = c.get(pack, KEY, f"textures/t{i}.png")
+            check(body == assets[f"textures/t{i}.png"], f"t{i}.png returned wrong bytes")
+        s = c.stats()
+        check(s["evictions"] > 0, f"no evictions: {s}")
+        check(s["bytes"] <= s["budget"] == 1024 * KB, f"over budget: {s}")
+        status, _ = c.get(pack, KEY, "textures/t4.png")
+        check(status.endswith(" HIT"), f"most recent asset: {status}")
+        status, _ = c.get(pack, KEY, "textures/t0.png")
+        check(status.endswith(" MISS"), f"evicted asset: {status}")
+
+        # Rewriting the pack drops what was cached from the old version
+        time.sleep(0.01)
+        assets = encrypt(args.encrypt, work, 2, out)
+        status, body = c.get(pack, KEY, "textures/small.json")
+        check(status.endswith(" MISS"), f"after rewrite: {status}")
+        check(body == b'{"version": 2}', f"after rewrite: stale bytes {body!r}")
+        status, body = c.get(pack, KEY, "textures/t4.png")
+        check(status.endswith(" MISS") and body == assets["textures/t4.png"], f"after rewrite: {status}")
+        s = c.stats()
+        check(s["invalidations"] == 1 and s["packs"] == 1, f"after rewrite: {s}")
+
+        # Two reader threads, three idle clients (one halfway through a
+        # request line): a fourth client is still answered right away
+        idle = [Client(sock) for _ in range(3)]
+        idle[0].sock.sendall(b"STATS")
+        fresh = Client(sock)
+        fresh.sock.settimeout(5)
+        try:
+            s = fresh.stats()
+        except socket.timeout:
+            raise Failure("STATS blocked behind idle connections")
+        check(s["packs"] == 1, f"stats next to idle clients: {s}")
+        # Two requests in one write get two replies; the half line completes
+        fresh.sock.sendall(b"STATS\nSTATS\n")
+        for _ in range(2):
+            status, body = fresh.reply()
+            check(status.startswith("OK ") and b"packs 1" in body, f"pipelined STATS: {status}")
+        idle[0].sock.settimeout(5)
+        idle[0].sock.sendall(b"\n")
+        status, _ = idle[0].reply()
+        check(status.startswith("OK "), f"request split across two writes: {status}")
+        fresh.close()
+
+        # Stopping with clients still connected, one of them mid-line
+        idle[1].sock.sendall(b"GET\t")
+        daemon.send_signal(signal.SIGTERM)
+        log, _ = daemon.communicate(timeout=10)
+        check(daemon.returncode == 0, f"daemon exited with {daemon.returncode}:\n{log}")
+        for client in [c] + idle:
+            client.sock.settimeout(5)
+            check(client.hung_up(), "connection left open after SIGTERM")
+            client.close()
+        check(not os.path.exists(sock), "socket left behind")
+        print("[OK] mcbe_cached protocol, budget and invalidation")
+        return 0
+    finally:
+        if daemon and daemon.poll() is None:
+            daemon.kill()
+            daemon.wait()
+        shutil.rmtree(work, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main_guard(main)
@@ -0,0 +1,54 @@
+// contents.json header (user-027): content ids up to the 239 bytes that fit
+// after the length byte at 0x10 round-trip, longer ones are rejected before
+// anything is written, also when they come from a manifest.
+
+#include <stdexcept>
+#include <string>
+
+#include "mcbe_pack.h"
+#include "test_util.h"
+
+using namespace mcbe_test;
+
+static const std::string KEY = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdef";
+static const size_t MAX_ID = mcbe_pack::HEADER_SIZE - 0x11;
+
+static void test_id_lengths() {
+  for (size_t len : {size_t(0), size_t(1), size_t(36), MAX_ID}) {
+    std::string id(len, 'u');
+    auto doc = mcbe_pack::build_contents_json(id, KEY, {{"a.png", ""}});
+    CHECK(doc.size() > mcbe_pack::HEADER_SIZE);
+    CHECK(doc[0x10] == len);
+    auto back = mcbe_pack::parse_contents_json(doc.data(), doc.size(), KEY);
+    CHECK(back.contentId == id);
+  }
+  for (size_t len : {MAX_ID + 1, size_t(250), size_t(255), size_t(256)})
+    CHECK_THROWS(std::runtime_error,
+                 mcbe_pack::build_contents_json(std::string(len, 'u'), KEY,
+                                                {}));
+}
+
+static void test_long_manifest_uuid() {
+  TempDir dir("contents_json");
+  std::string manifest =
+      "{\"header\":{\"uuid\":\"" + std::string(250, 'u') + "\"}}";
+  {
+    mcbe_zip::ZipWriter z(dir / "long.zip");
+    z.add_file("manifest.json", (const uint8_t *)manifest.data(),
+               manifest.size());
+    z.add_file("a.txt", (const uint8_t *)"a", 1);
+    z.finish();
+  }
+  mcbe_pack::EncryptOptions opts;
+  opts.inputZip = dir / "long.zip";
+  opts.outputZip = dir / "long_encrypted.zip";
+  opts.keyFile = dir / "long.zip.key";
+  opts.masterKey = KEY;
+  CHECK_THROWS(std::runtime_error, mcbe_pack::encrypt_pack(opts));
+}
+
+int main() {
+  test_id_lengths();
+  test_long_manifest_uuid();
+  return test_result();
+}
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""
+Deterministic mode (--deterministic / EncryptOptions.deterministic).
+
+The same input and master key must give byte-identical packs and key files:
+from mcbe_encrypt run twice (with different thread counts, a few seconds
+apart), from an input holding the same entries in another order with other
+timestamps, and from encrypt.py's encrypt_pack() run twice. Entries above
+the stream threshold are included, so the streamed paths are covered too.
+Without the flag two runs must differ.
+"""
+
+import argparse
+import filecmp
+import hashlib
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+import zipfile
+from pathlib import Path
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, HERE)
+sys.path.insert(0, os.path.dirname(HERE))
+from testlib import check, main_guard  # noqa: E402
+
+KEY = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdef"
+MB = 1024 * 1024
+
+
+def noise(n: int, seed: str) -> bytes:
+    return hashlib.shake_256(seed.encode()).digest(n)
+
+
+FILES = [
+    ("manifest.json", b'{"header":{"uuid":"deterministic-test"}}'),
+    ("pack_icon.png", noise(3000, "icon")),
+    ("textures/b.png", noise(70000, "b")),
+    ("textures/a.png", noise(5000, "a")),
+    ("sounds/big.ogg", noise(3 * MB, "big")),
+    ("texts/en_US.lang", b"pack.name=Deterministic\n" * 40),
+    ("subpacks/hi/textures/c.png", noise(9000, "c")),
+    ("subpacks/hi/big.png", noise(2 * MB, "big2")),
+]
+
+
+def write_pack(path: str, files: list, date_time: tuple) -> None:
+    with zipfile.ZipFile(path, "w") as z:
+        for name, data in files:
+            info = zipfile.ZipInfo(name, date_time)
+            info.compress_type = zipfile.ZIP_DEFLATED
+            z.writestr(info, data)
+
+
+def run_cli(tool: str, src: str, out: str, *extra: str) -> str:
+    r = subprocess.run([tool, src, out, "--key", KEY, "--stream-mb", "1", "--quiet", *extra],
+                       stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    check(r.returncode == 0, f"mcbe_encrypt {' '.join(extra)} exited with {r.returncode}:\n{r.stdout}")
+    return out
+
+
+def same_outputs(a: str, b: str, names: list, what: str) -> None:
+    for name in names:
+        check(filecmp.cmp(os.path.join(a, name), os.path.join(b, name), shallow=False),
+              f"{what}: {name} differs")
+
+
+def check_cli(tool: str, work: str) -> None:
+    src = os.path.join(work, "cli", "pack.zip")
+    os.makedirs(os.path.dirname(src))
+    write_pack(src, FILES, (2021, 5, 6, 7, 8, 10))
+    names = ["pack_encrypted.zip", "pack.zip.key"]
+
+    a = run_cli(tool, src, os.path.join(work, "cli_a"), "--deterministic", "--threads", "1")
+    # Anything taken from the clock would show up two seconds later
+    time.sleep(2.1)
+    b = run_cli(tool, src, os.path.join(work, "cli_b"), "--deterministic", "--threads", "4")
+    same_outputs(a, b, names, "mcbe_encrypt --deterministic twice")
+
+    # Input order and timestamps don't matter
+    shuffled = os.path.join(work, "cli_shuffled", "pack.zip")
+    os.makedirs(os.path.dirname(shuffled))
+    write_pack(shuffled, list(reversed(FILES)), (2023, 1, 2, 3, 4, 6))
+    c = run_cli(tool, shuffled, os.path.join(work, "cli_c"), "--deterministic")
+    same_outputs(a, c, names, "reordered input")
+
+    d = run_cli(tool, src, os.path.join(work, "cli_d"))
+    e = run_cli(tool, src, os.path.join(work, "cli_e"))
+    check(not filecmp.cmp(os.path.join(d, names[0]), os.path.join(e, names[0]), shallow=False),
+          "two runs without --deterministic are identical")
+    print("[OK] mcbe_encrypt --deterministic is reproducible")
+
+
+def check_python(work: str) -> None:
+    try:
+        import encrypt
+    except ImportError as e:
+        check(False, f"encrypt.py can't be imported here: {e}")
+    if encrypt.mcbe_native is None:
+        try:
+            import Crypto  # noqa: F401
+        except ImportError:
+            print("[*] encrypt_pack(): neither mcbe_native nor pycryptodome, not checked")
+            return
+
+    src = Path(work) / "py" / "pack.zip"
+    src.parent.mkdir()
+    write_pack(str(src), FILES, (2021, 5, 6, 7, 8, 10))
+    # Take the streamed path for the large entries as well
+    encrypt.STREAM_BYTES = 1 * MB
+
+    def run(tag: str) -> Path:
+        out = Path(work) / tag
+        out.mkdir()
+        opts = encrypt.EncryptOptions(input_zip=src, output_dir=out, output_zip=out / "pack_encrypted.zip",
+                                      key_file=out / "pack.zip.key", master_key=KEY,
+                                      excluded_files={"manifest.json", "pack_icon.png"}, deterministic=True)
+        encrypt.encrypt_pack(opts)
+        return out
+
+    a = run("py_a")
+    time.sleep(2.1)
+    b = run("py_b")
+    same_outputs(str(a), str(b), ["pack_encrypted.zip", "pack.zip.key"], "encrypt_pack(deterministic=True) twice")
+    print("[OK] encrypt_pack(deterministic=True) is reproducible")
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--encrypt", required=True)
+    args = ap.parse_args()
+
+    work = tempfile.mkdtemp(prefix="mcbe_det_")
+    try:
+        check_cli(args.encrypt, work)
+        check_python(work)
+        return 0
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main_guard(main)
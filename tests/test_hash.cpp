@@ -0,0 +1,223 @@
+// BLAKE3 (user-042): mcbe_hash::hash() and Hasher against a plain scalar
+// implementation of the spec written out below, on the official test
+// vector input (i % 251) at every length the vectors use plus lengths
+// around the SIMD group and thread split points, with arbitrary update()
+// splits. The reference itself is pinned by published digests.
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "mcbe_hash.h"
+#include "test_util.h"
+
+using namespace mcbe_test;
+
+// ============================================
+// Reference BLAKE3 (one compression at a time, recursive tree)
+// ============================================
+
+namespace ref {
+
+using mcbe_hash::BLOCK_LEN;
+using mcbe_hash::CHUNK_LEN;
+using mcbe_hash::IV;
+
+static uint32_t rotr(uint32_t x, int n) { return x >> n | x << (32 - n); }
+
+static void g(uint32_t s[16], int a, int b, int c, int d, uint32_t mx,
+              uint32_t my) {
+  s[a] = s[a] + s[b] + mx;
+  s[d] = rotr(s[d] ^ s[a], 16);
+  s[c] = s[c] + s[d];
+  s[b] = rotr(s[b] ^ s[c], 12);
+  s[a] = s[a] + s[b] + my;
+  s[d] = rotr(s[d] ^ s[a], 8);
+  s[c] = s[c] + s[d];
+  s[b] = rotr(s[b] ^ s[c], 7);
+}
+
+// Node output before its flags are final: the root gets ROOT on top
+struct Output {
+  uint32_t cv[8];
+  uint8_t block[BLOCK_LEN];
+  uint8_t blockLen;
+  uint64_t counter;
+  uint8_t flags;
+};
+
+static void compress(const uint32_t cv[8], const uint8_t block[BLOCK_LEN],
+                     uint8_t blockLen, uint64_t counter, uint8_t flags,
+                     uint32_t out[8]) {
+  static const int perm[16] = {2, 6, 3, 10, 7, 0, 4, 13,
+                               1, 11, 12, 5, 9, 14, 15, 8};
+  uint32_t m[16], s[16];
+  for (int i = 0; i < 16; i++)
+    m[i] = (uint32_t)block[4 * i] | (uint32_t)block[4 * i + 1] << 8 |
+           (uint32_t)block[4 * i + 2] << 16 | (uint32_t)block[4 * i + 3] << 24;
+  uint32_t init[16] = {cv[0],  cv[1],  cv[2],  cv[3],
+                       cv[4],  cv[5],  cv[6],  cv[7],
+                       IV[0],  IV[1],  IV[2],  IV[3],
+                       (uint32_t)counter, (uint32_t)(counter >> 32),
+                       blockLen, flags};
+  std::memcpy(s, init, sizeof(s));
+  for (int round = 0; round < 7; round++) {
+    g(s, 0, 4, 8, 12, m[0], m[1]);
+    g(s, 1, 5, 9, 13, m[2], m[3]);
+    g(s, 2, 6, 10, 14, m[4], m[5]);
+    g(s, 3, 7, 11, 15, m[6], m[7]);
+    g(s, 0, 5, 10, 15, m[8], m[9]);
+    g(s, 1, 6, 11, 12, m[10], m[11]);
+    g(s, 2, 7, 8, 13, m[12], m[13]);
+    g(s, 3, 4, 9, 14, m[14], m[15]);
+    uint32_t p[16];
+    for (int i = 0; i < 16; i++)
+      p[i] = m[perm[i]];
+    std::memcpy(m, p, sizeof(m));
+  }
+  for (int i = 0; i < 8; i++)
+    out[i] = s[i] ^ s[i + 8];
+}
+
+static void chaining_value(const Output &o, uint32_t cv[8]) {
+  compress(o.cv, o.block, o.blockLen, o.counter, o.flags, cv);
+}
+
+static Output chunk(const uint8_t *data, size_t len, uint64_t index) {
+  Output o{};
+  std::memcpy(o.cv, IV, sizeof(o.cv));
+  uint8_t start = mcbe_hash::CHUNK_START;
+  while (len > BLOCK_LEN) {
+    std::memset(o.block, 0, BLOCK_LEN);
+    std::memcpy(o.block, data, BLOCK_LEN);
+    compress(o.cv, o.block, BLOCK_LEN, index, start, o.cv);
+    data += BLOCK_LEN;
+    len -= BLOCK_LEN;
+    start = 0;
+  }
+  std::memset(o.block, 0, BLOCK_LEN);
+  if (len)
+    std::memcpy(o.block, data, len);
+  o.blockLen = (uint8_t)len;
+  o.counter = index;
+  o.flags = start | mcbe_hash::CHUNK_END;
+  return o;
+}
+
+static Output node(const uint8_t *data, size_t len, uint64_t firstChunk) {
+  if (len <= CHUNK_LEN)
+    return chunk(data, len, firstChunk);
+  // Left subtree: the largest power of two of full chunks leaving input
+  // for the right
+  size_t chunks = (len + CHUNK_LEN - 1) / CHUNK_LEN;
+  size_t left = 1;
+  while (left * 2 < chunks)
+    left *= 2;
+  uint32_t l[8], r[8];
+  chaining_value(node(data, left * CHUNK_LEN, firstChunk), l);
+  chaining_value(node(data + left * CHUNK_LEN, len - left * CHUNK_LEN,
+                      firstChunk + left),
+                 r);
+  Output o{};
+  std::memcpy(o.cv, IV, sizeof(o.cv));
+  for (int i = 0; i < 8; i++) {
+    for (int b = 0; b < 4; b++) {
+      o.block[4 * i + b] = (uint8_t)(l[i] >> (8 * b));
+      o.block[32 + 4 * i + b] = (uint8_t)(r[i] >> (8 * b));
+    }
+  }
+  o.blockLen = BLOCK_LEN;
+  o.flags = mcbe_hash::PARENT;
+  return o;
+}
+
+static std::string hex(const uint8_t *data, size_t len) {
+  Output o = node(data, len, 0);
+  o.flags |= mcbe_hash::ROOT;
+  uint32_t w[8];
+  chaining_value(o, w);
+  uint8_t out[32];
+  for (int i = 0; i < 32; i++)
+    out[i] = (uint8_t)(w[i / 4] >> (8 * (i % 4)));
+  return mcbe_hash::to_hex(out);
+}
+
+} // namespace ref
+
+// ============================================
+// Tests
+// ============================================
+
+static std::vector<uint8_t> vector_input(size_t n) {
+  std::vector<uint8_t> v(n);
+  for (size_t i = 0; i < n; i++)
+    v[i] = (uint8_t)(i % 251);
+  return v;
+}
+
+static std::string digest(const std::vector<uint8_t> &v, unsigned threads) {
+  uint8_t out[mcbe_hash::OUT_LEN];
+  mcbe_hash::hash(v.data(), v.size(), out, threads);
+  return mcbe_hash::to_hex(out);
+}
+
+static void test_reference() {
+  // Published BLAKE3-256 digests
+  CHECK(ref::hex(nullptr, 0) ==
+        "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262");
+  std::vector<uint8_t> abc = bytes("abc");
+  CHECK(ref::hex(abc.data(), abc.size()) ==
+        "6437b3ac38465133ffb63b75273a8db548c558465d79db03fd359c6cd5bd9d85");
+  std::vector<uint8_t> one = vector_input(1);
+  CHECK(ref::hex(one.data(), one.size()) ==
+        "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213");
+}
+
+static void test_lengths() {
+  // Lengths of the official test vectors, then group and lane boundaries
+  std::vector<size_t> lengths = {0,    1,     1023,  1024,  1025,   2048,
+                                 2049, 3072,  3073,  4096,  4097,   5120,
+                                 5121, 6144,  6145,  7168,  7169,   8192,
+                                 8193, 16384, 31744, 102400};
+  for (size_t chunks : {3, 4, 5, 7, 8, 9, 15, 16, 17, 63, 64, 65, 129})
+    for (long d : {-1, 0, 1})
+      lengths.push_back(chunks * mcbe_hash::CHUNK_LEN + d);
+
+  for (size_t len : lengths) {
+    std::vector<uint8_t> v = vector_input(len);
+    std::string expected = ref::hex(v.data(), v.size());
+    if (digest(v, 1) != expected)
+      std::printf("length %zu:\n", len);
+    CHECK(digest(v, 1) == expected);
+  }
+}
+
+static void test_threads_and_splits() {
+  // Past PARALLEL_MIN so hash() splits the tree across threads
+  std::vector<uint8_t> big = noise(mcbe_hash::PARALLEL_MIN * 2 + 12345, 7);
+  std::string expected = ref::hex(big.data(), big.size());
+  for (unsigned threads : {1u, 2u, 3u, 8u})
+    CHECK(digest(big, threads) == expected);
+
+  // Any sequence of update() sizes gives the one-shot digest
+  for (size_t step : {size_t(1), size_t(63), size_t(64), size_t(1000),
+                      size_t(1024), size_t(4097), size_t(65536 + 3),
+                      big.size()}) {
+    mcbe_hash::Hasher h;
+    size_t len = step == 1 ? 20000 : big.size();
+    for (size_t off = 0; off < len; off += step)
+      h.update(big.data() + off, std::min(step, len - off), 2);
+    uint8_t out[mcbe_hash::OUT_LEN];
+    h.final(out);
+    CHECK(mcbe_hash::to_hex(out) == ref::hex(big.data(), len));
+  }
+}
+
+int main() {
+  std::printf("[*] BLAKE3 backend: %s\n", mcbe_hash::backend_name());
+  test_reference();
+  test_lengths();
+  test_threads_and_splits();
+  return test_result();
+}
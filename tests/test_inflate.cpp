@@ -0,0 +1,154 @@
+// mcbe_inflate (user-037) against zlib: every stream zlib's deflater
+// produces (all levels and strategies, stored/fixed/dynamic blocks,
+// overlapping matches, long inputs) decodes to the original bytes, and
+// malformed or mis-sized streams throw instead of reading or writing out
+// of bounds.
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "mcbe_inflate.h"
+#include "mcbe_zip.h"
+#include "test_util.h"
+
+using namespace mcbe_test;
+
+static std::vector<uint8_t> zlib_deflate(const std::vector<uint8_t> &in,
+                                         int level, int strategy,
+                                         const std::string &dict = "") {
+  z_stream zs{};
+  if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, strategy) != Z_OK)
+    throw std::runtime_error("deflateInit2 failed.");
+  if (!dict.empty())
+    deflateSetDictionary(&zs, (const Bytef *)dict.data(), (uInt)dict.size());
+  std::vector<uint8_t> out(deflateBound(&zs, (uLong)in.size()) + 16);
+  zs.next_in = (Bytef *)in.data();
+  zs.avail_in = (uInt)in.size();
+  zs.next_out = out.data();
+  zs.avail_out = (uInt)out.size();
+  int rc = deflate(&zs, Z_FINISH);
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+  if (rc != Z_STREAM_END)
+    throw std::runtime_error("deflate failed.");
+  return out;
+}
+
+static std::vector<uint8_t> decode(const std::vector<uint8_t> &in,
+                                   size_t outLen) {
+  std::vector<uint8_t> out(outLen);
+  mcbe_inflate::inflate(in.data(), in.size(), out.data(), out.size());
+  return out;
+}
+
+static std::vector<std::vector<uint8_t>> inputs() {
+  std::vector<std::vector<uint8_t>> v;
+  v.push_back({});
+  v.push_back({'x'});
+  v.push_back(std::vector<uint8_t>(100000, 'a')); // distance-1 matches
+  std::string text;
+  for (int i = 0; i < 5000; i++)
+    text += "{\"format_version\": " + std::to_string(i % 13) +
+            ", \"texture\": \"textures/blocks/stone_" + std::to_string(i) +
+            "\"}\n";
+  v.push_back(bytes(text));
+  v.push_back(noise(300000, 1)); // incompressible: stored blocks
+  // Short repeating periods: overlapping copies of every small distance
+  std::vector<uint8_t> periodic;
+  for (size_t period = 2; period <= 17; period++)
+    for (size_t i = 0; i < 4000; i++)
+      periodic.push_back((uint8_t)(i % period * 37));
+  v.push_back(periodic);
+  // Mostly noise with long-distance repeats near the 32 KiB window limit
+  std::vector<uint8_t> far = noise(200000, 2);
+  for (size_t i = 40000; i + 300 < far.size(); i += 7919)
+    std::copy(far.begin() + (long)(i - 32700), far.begin() + (long)(i - 32400),
+              far.begin() + (long)i);
+  v.push_back(far);
+  v.push_back(noise(2 * 1024 * 1024, 3)); // bigger than any internal buffer
+  return v;
+}
+
+static void test_matches_zlib() {
+  const int strategies[] = {Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY,
+                            Z_RLE, Z_FIXED};
+  for (auto const &in : inputs()) {
+    for (int level : {0, 1, 6, 9}) {
+      for (int strategy : strategies) {
+        std::vector<uint8_t> packed = zlib_deflate(in, level, strategy);
+        std::vector<uint8_t> out;
+        try {
+          out = decode(packed, in.size());
+        } catch (const std::runtime_error &) {
+        }
+        if (out != in)
+          std::printf("size %zu, level %d, strategy %d:\n", in.size(), level,
+                      strategy);
+        CHECK(out == in);
+      }
+    }
+  }
+
+  // Same decoder behind mcbe_zip::inflate_raw()
+  std::vector<uint8_t> text = inputs()[3];
+  std::vector<uint8_t> packed = mcbe_zip::deflate_raw(text.data(), text.size());
+  std::vector<uint8_t> out(text.size());
+  mcbe_zip::inflate_raw(packed.data(), packed.size(), out.data(), out.size());
+  CHECK(out == text);
+}
+
+static void test_rejects_bad_streams() {
+  std::vector<uint8_t> text = inputs()[3];
+  std::vector<uint8_t> packed = zlib_deflate(text, 6, Z_DEFAULT_STRATEGY);
+
+  // Output size that doesn't match the stream
+  CHECK_THROWS(std::runtime_error, decode(packed, text.size() - 1));
+  CHECK_THROWS(std::runtime_error, decode(packed, text.size() + 1));
+  CHECK_THROWS(std::runtime_error, decode(packed, 0));
+
+  // Truncated input
+  for (size_t cut : {size_t(0), size_t(1), packed.size() / 2,
+                     packed.size() - 1}) {
+    std::vector<uint8_t> head(packed.begin(), packed.begin() + (long)cut);
+    CHECK_THROWS(std::runtime_error, decode(head, text.size()));
+  }
+
+  // Block type 3 (reserved)
+  CHECK_THROWS(std::runtime_error, decode({0x07, 0, 0, 0}, 1));
+
+  // Stored block whose LEN and NLEN don't match
+  CHECK_THROWS(std::runtime_error,
+               decode({0x01, 5, 0, 0, 0, 'h', 'e', 'l', 'l', 'o'}, 5));
+  CHECK(decode({0x01, 5, 0, 0xFA, 0xFF, 'h', 'e', 'l', 'l', 'o'}, 5) ==
+        bytes("hello"));
+
+  // Matches reaching back into a preset dictionary we don't have: the
+  // distance points before the start of the output
+  std::string dict = "textures/blocks/stone_textures/blocks/stone_";
+  std::vector<uint8_t> withDict =
+      zlib_deflate(bytes(dict), 9, Z_DEFAULT_STRATEGY, dict);
+  CHECK_THROWS(std::runtime_error, decode(withDict, dict.size()));
+
+  // Flipped bits anywhere: an error or some output, never a crash
+  std::vector<uint8_t> small(packed.begin(), packed.end());
+  size_t thrown = 0;
+  for (size_t i = 0; i < small.size() * 8; i += 3) {
+    std::vector<uint8_t> bad = small;
+    bad[i / 8] ^= (uint8_t)(1u << (i % 8));
+    try {
+      decode(bad, text.size());
+    } catch (const std::runtime_error &) {
+      thrown++;
+    }
+  }
+  CHECK(thrown > 0);
+}
+
+int main() {
+  test_matches_zlib();
+  test_rejects_bad_streams();
+  return test_result();
+}
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""
+Bounded memory on very large entries (mcbe_encrypt / mcbe_extract /
+mcbe_verify).
+
+Builds a pack with one stored and one deflated entry of --size bytes each,
+encrypts it, checks it against its hash sidecar with mcbe_verify and
+extracts both entries again through mcbe_extract. Peak RSS of each tool
+must stay under --rss-mb, whatever the entry size, and the extracted bytes
+must hash the same as the generated ones.
+"""
+
+import argparse
+import hashlib
+import os
+import shutil
+import sys
+import tempfile
+import zipfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from testlib import SKIP, check, main_guard, run_measured  # noqa: E402
+
+KEY = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdef"
+CHUNK = 1024 * 1024
+
+
+def chunks(size: int):
+    # 16 KiB of noise repeated (cheap to deflate), stamped with the chunk
+    # index so a reordered or repeated window changes the digest
+    base = bytes(random_block(16 * 1024)) * (CHUNK // (16 * 1024))
+    for i in range((size + CHUNK - 1) // CHUNK):
+        n = min(CHUNK, size - i * CHUNK)
+        yield (i.to_bytes(8, "little") + base[8:])[:n]
+
+
+def random_block(n: int) -> bytes:
+    return hashlib.shake_256(b"mcbe large entry").digest(n)
+
+
+def write_pack(path: str, size: int) -> dict:
+    digests = {}
+    with zipfile.ZipFile(path, "w", compresslevel=1) as z:
+        z.writestr("manifest.json", '{"header":{"uuid":"large-entry-test"}}')
+        for name, method in (("big_stored.bin", zipfile.ZIP_STORED),
+                             ("big_deflated.bin", zipfile.ZIP_DEFLATED)):
+            info = zipfile.ZipInfo(name)
+            info.compress_type = method
+            h = hashlib.sha256()
+            with z.open(info, "w", force_zip64=True) as out:
+                for c in chunks(size):
+                    h.update(c)
+                    out.write(c)
+            digests[name] = h.hexdigest()
+    return digests
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--encrypt", required=True)
+    ap.add_argument("--extract", required=True)
+    ap.add_argument("--verify", required=True)
+    ap.add_argument("--size", type=int, required=True, help="bytes per entry")
+    ap.add_argument("--rss-mb", type=float, required=True)
+    ap.add_argument("--workdir", default=None)
+    args = ap.parse_args()
+
+    if not sys.platform.startswith("linux"):
+        print("peak RSS is only measured on Linux")
+        return SKIP
+
+    work = tempfile.mkdtemp(prefix="mcbe_large_", dir=args.workdir)
+    try:
+        pack = os.path.join(work, "large.zip")
+        digests = write_pack(pack, args.size)
+        print(f"[*] input: 2 x {args.size / 2**20:.0f} MiB entries, {os.path.getsize(pack) / 2**20:.0f} MiB zip")
+
+        out = os.path.join(work, "out")
+        rc, rss, stdout = run_measured([args.encrypt, pack, out, "--key", KEY, "--quiet"])
+        print(stdout, end="")
+        check(rc == 0, f"mcbe_encrypt exited with {rc}")
+        print(f"[*] mcbe_encrypt peak RSS {rss:.1f} MiB")
+        check(rss < args.rss_mb, f"mcbe_encrypt peak RSS {rss:.1f} MiB >= {args.rss_mb} MiB")
+
+        encrypted = os.path.join(out, "large_encrypted.zip")
+        rc, rss, stdout = run_measured([args.verify, encrypted, os.path.join(out, "large.zip.key"),
+                                        "--threads", "2"])
+        check(rc == 0, f"mcbe_verify exited with {rc}:\n{stdout}")
+        print(f"[*] mcbe_verify: peak RSS {rss:.1f} MiB")
+        check(rss < args.rss_mb, f"mcbe_verify peak RSS {rss:.1f} MiB >= {args.rss_mb} MiB")
+
+        for name, digest in digests.items():
+            target = os.path.join(work, name)
+            rc, rss, _ = run_measured([args.extract, encrypted, KEY, name, target])
+            check(rc == 0, f"mcbe_extract {name} exited with {rc}")
+            print(f"[*] mcbe_extract {name}: peak RSS {rss:.1f} MiB")
+            check(rss < args.rss_mb, f"mcbe_extract peak RSS {rss:.1f} MiB >= {args.rss_mb} MiB")
+            h = hashlib.sha256()
+            with open(target, "rb") as f:
+                for block in iter(lambda: f.read(CHUNK), b""):
+                    h.update(block)
+            os.remove(target)
+            check(h.hexdigest() == digest, f"{name} does not round-trip")
+        print("[OK] both entries round-trip under the RSS bound")
+        return 0
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main_guard(main)
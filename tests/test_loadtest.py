@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""
+Smoke run of loadtest.py against app.py.
+
+Two server modes, two client counts and a handful of small packs. The run
+must pass, report results for every configuration with no failed
+requests and no leaked temp files, and accept its own output as a
+baseline. A baseline that is far better than reality must be reported as
+a regression.
+"""
+
+import importlib.util
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from testlib import SKIP, check, main_guard  # noqa: E402
+
+LOADTEST = os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), "loadtest.py")
+
+
+def loadtest(work: str, *extra) -> tuple[int, str]:
+    cmd = [sys.executable, LOADTEST, "--server", "threaded,fork:2", "--clients", "1,2",
+           "--requests", "6", "--mix", "small:1", "--warmup", "1",
+           "--corpus", os.path.join(work, "corpus"), *extra]
+    r = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True, timeout=600)
+    return r.returncode, r.stdout
+
+
+def main() -> int:
+    if not sys.platform.startswith("linux"):
+        print("loadtest.py samples /proc")
+        return SKIP
+    if importlib.util.find_spec("flask") is None:
+        print("flask is not installed")
+        return SKIP
+
+    work = tempfile.mkdtemp(prefix="mcbe_loadtest_test_")
+    try:
+        out = os.path.join(work, "run.json")
+        rc, log = loadtest(work, "--json", out)
+        check(rc == 0, f"loadtest.py exited with {rc}:\n{log}")
+        with open(out) as f:
+            doc = json.load(f)
+        keys = sorted(f"{r['server']}/c{r['clients']}" for r in doc["results"])
+        check(keys == ["fork:2/c1", "fork:2/c2", "threaded/c1", "threaded/c2"], f"configurations: {keys}")
+        for r in doc["results"]:
+            where = f"{r['server']}/c{r['clients']}"
+            check(r["requests"] == 6 and r["errors"] == 0, f"{where}: {r['errors']} of {r['requests']} failed")
+            check(r["req_per_s"] > 0 and 0 < r["p50_ms"] <= r["p95_ms"] <= r["p99_ms"],
+                  f"{where}: implausible latency figures {r}")
+            check(r["peak_rss_mb"] > 0, f"{where}: no RSS samples")
+            check(r["leaked_temp_mb"] == 0, f"{where}: {r['leaked_temp_mb']} MB left in the temp dir")
+        print(f"[*] {len(keys)} configurations, no errors, no leaked temp files")
+
+        # Its own numbers with a wide margin: no regression
+        rc, log = loadtest(work, "--baseline", out, "--tolerance", "1000")
+        check(rc == 0 and "REGRESSION" not in log, f"baseline run exited with {rc}:\n{log}")
+
+        # A baseline 100x faster than anything this machine does
+        fast = os.path.join(work, "fast.json")
+        for r in doc["results"]:
+            r["req_per_s"] *= 100
+            r["p95_ms"] /= 100
+            r["p99_ms"] /= 100
+        with open(fast, "w") as f:
+            json.dump(doc, f)
+        rc, log = loadtest(work, "--baseline", fast, "--tolerance", "10")
+        check(rc == 1 and "REGRESSION" in log, f"regression not reported (exit {rc}):\n{log}")
+        print("[OK] loadtest.py runs clean and flags regressions")
+        return 0
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main_guard(main)
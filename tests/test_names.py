@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""
+Non-ASCII entry names through mcbe_encrypt.
+
+ZipWriter has to set general purpose bit 11 (UTF-8) on names that aren't
+pure ASCII, or zipfile and most unzip tools decode them as cp437
+("textures/한글.json" came back as "textures/φò£Ω╕Ç.json"). Names a source
+archive stored as cp437 stay unflagged and must read back unchanged, and
+mcbe_extract must find the entries by their UTF-8 name.
+"""
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import zipfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from testlib import check, main_guard  # noqa: E402
+
+KEY = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdef"
+UTF8_FLAG = 0x800
+
+
+class Cp437Info(zipfile.ZipInfo):
+    """Stores the name as cp437 without the UTF-8 flag, like old archivers."""
+
+    def _encodeFilenameFlags(self):
+        return self.filename.encode("cp437"), self.flag_bits & ~UTF8_FLAG
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--encrypt", required=True)
+    ap.add_argument("--extract", required=True)
+    args = ap.parse_args()
+
+    work = tempfile.mkdtemp(prefix="mcbe_names_")
+    try:
+        utf8 = {
+            "manifest.json": b'{"header":{"uuid":"names-test"}}',
+            "textures/한글.json": b'{"name":"hangul"}' * 50,
+            "texts/日本語/ja_JP.lang": b"pack.name=Names\n" * 100,
+            "textures/emoji_🎨.png": os.urandom(3000),
+            "plain/ascii.txt": b"ascii only",
+        }
+        cp437 = {"textures/café.png": os.urandom(2000)}
+        src = os.path.join(work, "pack.zip")
+        with zipfile.ZipFile(src, "w", zipfile.ZIP_DEFLATED) as z:
+            for name, data in utf8.items():
+                z.writestr(name, data)
+            for name, data in cp437.items():
+                info = Cp437Info(name)
+                info.compress_type = zipfile.ZIP_DEFLATED
+                z.writestr(info, data)
+
+        out = os.path.join(work, "out")
+        r = subprocess.run([args.encrypt, src, out, "--key", KEY, "--quiet"],
+                           stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+        check(r.returncode == 0, f"mcbe_encrypt exited with {r.returncode}:\n{r.stdout}")
+        enc = os.path.join(out, "pack_encrypted.zip")
+
+        with zipfile.ZipFile(enc) as z:
+            infos = {i.filename: i for i in z.infolist()}
+        for name in list(utf8) + list(cp437):
+            check(name in infos, f"{name!r} missing from the output; names: {sorted(infos)}")
+        for name in utf8:
+            ascii_only = name.isascii()
+            flagged = bool(infos[name].flag_bits & UTF8_FLAG)
+            check(flagged != ascii_only, f"{name!r}: UTF-8 flag {'set' if flagged else 'not set'}")
+        for name in cp437:
+            check(not infos[name].flag_bits & UTF8_FLAG, f"{name!r}: cp437 name flagged as UTF-8")
+
+        for name, data in utf8.items():
+            target = os.path.join(work, "x.bin")
+            r = subprocess.run([args.extract, enc, KEY, name, target],
+                               stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+            check(r.returncode == 0, f"mcbe_extract {name!r} exited with {r.returncode}:\n{r.stdout}")
+            with open(target, "rb") as f:
+                check(f.read() == data, f"{name!r}: extracted bytes differ")
+        print(f"[OK] {len(utf8) + len(cp437)} names round-trip")
+        return 0
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main_guard(main)
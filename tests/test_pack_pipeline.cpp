@@ -0,0 +1,181 @@
+// Streamed entries on the worker pool (user-038): they are picked up before
+// anything else, largest first, end up in spool files that decrypt to the
+// input, and count in the latency stats. A whole pack encrypted with a low
+// stream threshold must hold the same plaintext, keys (deterministic mode)
+// and digests as one encrypted entirely in memory.
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mcbe_cfb8.h"
+#include "mcbe_pack.h"
+#include "mcbe_pack_hashes.h"
+#include "mcbe_pack_pipeline.h"
+#include "mcbe_pack_reader.h"
+#include "test_util.h"
+
+using namespace mcbe_test;
+using mcbe_pack::EncryptPipeline;
+using mcbe_pack::PipelineEntry;
+using mcbe_pack::PipelineOutput;
+
+static const std::string KEY = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdef";
+static const uint64_t THRESHOLD = 512 * 1024;
+
+// name -> contents; the two large ones are above THRESHOLD
+static std::vector<std::pair<std::string, std::vector<uint8_t>>> files() {
+  return {{"textures/s0.png", noise(4000, 1)},
+          {"textures/big_a.png", noise(600 * 1024, 2)},
+          {"textures/s1.png", noise(5000, 3)},
+          {"sounds/big_b.ogg", noise(900 * 1024, 4)},
+          {"texts/en_US.lang", bytes("pack.name=Pipeline\n")}};
+}
+
+static void write_pack(const fs::path &path) {
+  mcbe_zip::ZipWriter z(path);
+  std::string manifest = "{\"header\":{\"uuid\":\"pipeline-test\"}}";
+  z.add_file("manifest.json", (const uint8_t *)manifest.data(),
+             manifest.size());
+  z.add_directory("subpacks/");
+  z.add_directory("subpacks/hi/");
+  for (auto const &[name, data] : files())
+    z.add_file(name, data.data(), data.size(), name.size() % 2 == 0);
+  auto big = noise(700 * 1024, 5);
+  z.add_file("subpacks/hi/big_c.png", big.data(), big.size(), true);
+  z.finish();
+}
+
+static void test_pickup_order() {
+  TempDir dir("pipeline_order");
+  write_pack(dir / "pack.zip");
+  mcbe_zip::ZipReader zin(dir / "pack.zip");
+  std::vector<PipelineEntry> work;
+  for (auto const &[name, data] : files())
+    work.push_back({zin.find(name), false});
+
+  mcbe_progress::Channel ch;
+  mcbe_pack::PipelineOptions po;
+  po.masterKey = KEY;
+  po.threads = 1;
+  po.streamThreshold = THRESHOLD;
+  po.spoolDir = dir.path();
+  po.channel = &ch;
+  EncryptPipeline pipe(zin, work, po);
+
+  // One worker, largest first: both streamed entries (and then all the
+  // small ones, as one batch) are done before the first small entry
+  std::vector<PipelineOutput> outs;
+  outs.push_back(pipe.take(0));
+  CHECK(ch.snapshot().done == work.size());
+
+  for (size_t i = 1; i < work.size(); i++)
+    outs.push_back(pipe.take(i));
+  auto expected = files();
+  for (size_t i = 0; i < outs.size(); i++) {
+    const PipelineOutput &out = outs[i];
+    const std::vector<uint8_t> &plain = expected[i].second;
+    bool big = plain.size() >= THRESHOLD;
+    CHECK(bool(out.spool) == big);
+    CHECK(out.packed.empty() == big);
+    CHECK(out.size == plain.size());
+    CHECK(out.key.size() == mcbe_pack::KEY_LEN);
+    CHECK(out.latency > 0);
+    if (!big)
+      continue;
+    // The spool holds the entry under its own name, encrypted
+    mcbe_zip::ZipReader spool(out.spool->path);
+    CHECK(spool.entries().size() == 1);
+    CHECK(spool.entries()[0].name == expected[i].first);
+    std::vector<uint8_t> data = spool.read(spool.entries()[0]);
+    CHECK(data != plain);
+    mcbe_cfb8::decrypt((const uint8_t *)out.key.data(), data.data(),
+                       data.data(), data.size());
+    CHECK(data == plain);
+  }
+
+  fs::path spoolPath = outs[1].spool->path;
+  CHECK(fs::exists(spoolPath));
+  outs.clear();
+  CHECK(!fs::exists(spoolPath));
+}
+
+struct Encrypted {
+  mcbe_pack::EncryptStats stats;
+  std::vector<std::string> names;
+  std::map<std::string, std::string> keys;
+  mcbe_pack::HashSidecar hashes;
+};
+
+static Encrypted encrypt(const TempDir &dir, const std::string &tag,
+                         uint64_t threshold) {
+  fs::create_directories(dir / tag);
+  mcbe_pack::EncryptOptions opts;
+  opts.inputZip = dir / "pack.zip";
+  opts.outputZip = dir / tag / "pack_encrypted.zip";
+  opts.keyFile = dir / tag / "pack.zip.key";
+  opts.masterKey = KEY;
+  opts.deterministic = true;
+  opts.plainHashes = true;
+  opts.threads = 2;
+  opts.streamThreshold = threshold;
+  Encrypted r;
+  mcbe_pack::encrypt_pack(opts, {}, {}, nullptr, &r.stats);
+
+  mcbe_zip::ZipReader z(opts.outputZip);
+  for (auto const &e : z.entries())
+    r.names.push_back(e.name);
+  for (const char *doc : {"contents.json", "subpacks/hi/contents.json"}) {
+    auto data = z.read(*z.find(doc));
+    for (auto const &e :
+         mcbe_pack::parse_contents_json(data.data(), data.size(), KEY)
+             .entries)
+      r.keys[doc + std::string(":") + e.path] = e.key;
+  }
+  r.hashes = mcbe_pack::read_hash_sidecar(
+      mcbe_pack::hash_sidecar_path(opts.keyFile));
+  // Only the pack and its key files are left in the output directory
+  size_t n = 0;
+  for (auto const &f : fs::directory_iterator(dir / tag))
+    n += f.path().filename().u8string().rfind("mcbe_spool_", 0) == 0;
+  CHECK(n == 0);
+  return r;
+}
+
+static void test_streamed_pack() {
+  TempDir dir("pipeline_pack");
+  write_pack(dir / "pack.zip");
+  Encrypted streamed = encrypt(dir, "streamed", THRESHOLD);
+  Encrypted memory = encrypt(dir, "memory", mcbe_pack::STREAM_THRESHOLD);
+
+  CHECK(streamed.names == memory.names);
+  CHECK(streamed.keys == memory.keys);
+  CHECK(streamed.keys.size() == files().size() + 2);
+  CHECK(streamed.hashes.entries.size() == memory.hashes.entries.size());
+  for (size_t i = 0; i < streamed.hashes.entries.size(); i++) {
+    auto const &a = streamed.hashes.entries[i];
+    auto const &b = memory.hashes.entries[i];
+    CHECK(a.path == b.path && a.size == b.size &&
+          memcmp(a.digest, b.digest, sizeof(a.digest)) == 0);
+  }
+
+  mcbe_pack::PackReader pack(dir / "streamed" / "pack_encrypted.zip", KEY);
+  for (auto const &[name, data] : files())
+    CHECK(pack.read(name) == data);
+  CHECK(pack.read("subpacks/hi/big_c.png") == noise(700 * 1024, 5));
+
+  // Streamed entries are in the latency stats like the others
+  const mcbe_pack::EncryptStats &st = streamed.stats;
+  CHECK(st.entries == files().size() + 2);
+  CHECK(st.maxLatency > 0);
+  CHECK(st.p50 <= st.p99 && st.p99 <= st.maxLatency);
+  CHECK(st.encryptedBytes >= 600 * 1024 + 900 * 1024 + 700 * 1024);
+}
+
+int main() {
+  test_pickup_order();
+  test_streamed_pack();
+  return test_result();
+}
@@ -0,0 +1,192 @@
+// plan_pack() (user-045): grouping of directories, root files, excluded
+// files and subpacks, the manifest pick, sorted mode and the totals on a
+// hand-made archive; and the same plan for every thread count on archives
+// big enough to be split.
+
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "mcbe_pack.h"
+#include "mcbe_pack_plan.h"
+#include "test_util.h"
+
+using namespace mcbe_test;
+using mcbe_pack::PackPlan;
+using mcbe_pack::plan_pack;
+
+struct Archive {
+  std::shared_ptr<std::vector<uint8_t>> bytes =
+      std::make_shared<std::vector<uint8_t>>();
+  mcbe_zip::ZipReader reader;
+};
+
+// `names` ending in '/' become directories; file contents are the name
+static std::unique_ptr<Archive>
+build(const std::vector<std::string> &names,
+      const std::vector<std::pair<std::string, std::string>> &files = {}) {
+  auto a = std::make_unique<Archive>();
+  mcbe_zip::ZipWriter z;
+  z.open(a->bytes.get());
+  for (auto const &n : names) {
+    if (mcbe_pack::is_dir(n))
+      z.add_directory(n);
+    else
+      z.add_file(n, (const uint8_t *)n.data(), n.size(), false);
+  }
+  for (auto const &[n, data] : files)
+    z.add_file(n, (const uint8_t *)data.data(), data.size(), false);
+  z.finish();
+  a->reader.open_view(a->bytes->data(), a->bytes->size(), a->bytes, false);
+  return a;
+}
+
+// Everything in a plan, as text, so two plans compare with ==
+static std::string dump(const PackPlan &p) {
+  std::ostringstream o;
+  o << "uuid " << p.uuid << " sorted " << p.sorted << " files " << p.files
+    << " total " << p.total << " bytes " << p.bytes << "\n";
+  for (auto e : p.directories)
+    o << "D " << e->name << "\n";
+  for (auto const &f : p.rootFiles)
+    o << (f.copy ? "C " : "F ") << f.entry->name << "\n";
+  for (auto const &s : p.subpacks) {
+    o << "S " << s.root << " " << s.entry->name << "\n";
+    for (auto e : s.files)
+      o << "  " << e->name << "\n";
+  }
+  for (auto const &n : p.excluded)
+    o << "X " << n << "\n";
+  return o.str();
+}
+
+static std::vector<std::string> names_of(
+    const std::vector<const mcbe_zip::ZipEntry *> &v) {
+  std::vector<std::string> out;
+  for (auto e : v)
+    out.push_back(e->name);
+  return out;
+}
+
+static void test_grouping() {
+  auto a = build(
+      {"textures/", "subpacks/", "subpacks/lo/", "subpacks/hi/",
+       "subpacks/hi/deeper/", "textures/b.png", "pack_icon.png",
+       "subpacks/hi/textures/b.png", "subpacks/lo/textures/b.png",
+       "subpacks/hi/deeper/x.json", "subpacks/orphan/a.png",
+       "subpacks/readme.txt", "textures/a.png", "subpacks/hi/a.png",
+       "nested/manifest.json"},
+      {{"manifest.json", "{\"header\":{\"uuid\":\"root-uuid\"}}"}});
+  std::set<std::string> excluded = {"pack_icon.png", "manifest.json",
+                                    "subpacks/hi/a.png"};
+
+  PackPlan p = plan_pack(a->reader, excluded, false, 1);
+  CHECK(p.uuid == "root-uuid"); // shallowest manifest wins
+  CHECK(!p.sorted);
+  CHECK(names_of(p.directories) ==
+        std::vector<std::string>({"textures/", "subpacks/", "subpacks/lo/",
+                                  "subpacks/hi/", "subpacks/hi/deeper/"}));
+
+  std::vector<std::string> root;
+  for (auto const &f : p.rootFiles)
+    root.push_back(f.entry->name + (f.copy ? " copy" : ""));
+  CHECK(root == std::vector<std::string>({"textures/b.png",
+                                          "pack_icon.png copy",
+                                          "textures/a.png",
+                                          "nested/manifest.json",
+                                          "manifest.json copy"}));
+  CHECK(p.excluded ==
+        std::vector<std::string>({"pack_icon.png", "manifest.json"}));
+
+  // Only subpacks/<x>/ roots; subpacks/hi/deeper/ is a directory inside
+  // one, subpacks/orphan/ has no root entry and subpacks/readme.txt none
+  CHECK(p.subpacks.size() == 2);
+  if (p.subpacks.size() == 2) {
+    CHECK(p.subpacks[0].root == "subpacks/lo/");
+    CHECK(names_of(p.subpacks[0].files) ==
+          std::vector<std::string>({"subpacks/lo/textures/b.png"}));
+    CHECK(p.subpacks[1].root == "subpacks/hi/");
+    CHECK(names_of(p.subpacks[1].files) ==
+          std::vector<std::string>({"subpacks/hi/textures/b.png",
+                                    "subpacks/hi/deeper/x.json",
+                                    "subpacks/hi/a.png"}));
+  }
+  CHECK(p.files == 5 + 1 + 3);
+  CHECK(p.total == p.files + 1 + 2);
+  uint64_t bytes = 0;
+  for (auto const &f : p.rootFiles)
+    bytes += f.entry->uncompressedSize;
+  for (auto const &s : p.subpacks)
+    for (auto e : s.files)
+      bytes += e->uncompressedSize;
+  CHECK(p.bytes == bytes);
+
+  // Sorted: every group in name order, same membership
+  PackPlan s = plan_pack(a->reader, excluded, true, 1);
+  CHECK(s.sorted);
+  CHECK(names_of(s.directories) ==
+        std::vector<std::string>({"subpacks/", "subpacks/hi/",
+                                  "subpacks/hi/deeper/", "subpacks/lo/",
+                                  "textures/"}));
+  CHECK(s.rootFiles.front().entry->name == "manifest.json");
+  CHECK(s.subpacks.size() == 2 && s.subpacks[0].root == "subpacks/hi/");
+  if (s.subpacks.size() == 2)
+    CHECK(names_of(s.subpacks[0].files).front() == "subpacks/hi/a.png");
+  CHECK(s.files == p.files && s.total == p.total && s.bytes == p.bytes);
+
+  // No manifest, or one that doesn't parse
+  auto none = build({"a.txt"});
+  CHECK(plan_pack(none->reader, {}, false, 1).uuid == mcbe_pack::NULL_UUID);
+  auto broken = build({}, {{"manifest.json", "{not json"}});
+  CHECK(plan_pack(broken->reader, {}, false, 1).uuid == mcbe_pack::NULL_UUID);
+}
+
+static void test_threads() {
+  // Past 2 * PLAN_PARALLEL_MIN, with subpack roots and their files spread
+  // over what become different chunks, and a root listed twice
+  std::vector<std::string> names = {"subpacks/"};
+  const size_t n = 2 * mcbe_pack::PLAN_PARALLEL_MIN + 5000;
+  for (size_t i = 0; i < n; i++) {
+    std::string id = std::to_string((i * 7919) % n);
+    switch (i % 6) {
+    case 0:
+      names.push_back("textures/t" + id + ".png");
+      break;
+    case 1:
+      names.push_back("subpacks/s" + std::to_string(i % 5) + "/f" + id);
+      break;
+    case 2:
+      names.push_back("entity/e" + id + ".json");
+      break;
+    case 3:
+      names.push_back(i % 1000 == 3 ? "subpacks/s" + std::to_string(i % 7) + "/"
+                                    : "dir" + id + "/");
+      break;
+    case 4:
+      names.push_back("subpacks/nowhere" + id + "/x");
+      break;
+    default:
+      names.push_back(i == 5 ? "manifest.json" : "lang/l" + id + ".lang");
+    }
+  }
+  names.push_back("subpacks/s1/"); // second entry for an existing root
+  auto a = build(names);
+  std::set<std::string> excluded = {"manifest.json", "textures/t0.png"};
+
+  for (bool sorted : {false, true}) {
+    std::string one = dump(plan_pack(a->reader, excluded, sorted, 1));
+    for (unsigned threads : {2u, 3u, 4u, 7u, 0u})
+      CHECK(dump(plan_pack(a->reader, excluded, sorted, threads)) == one);
+  }
+  PackPlan p = plan_pack(a->reader, excluded, false, 4);
+  CHECK(p.excluded.size() == 2);
+  CHECK(p.subpacks.size() >= 2);
+}
+
+int main() {
+  test_grouping();
+  test_threads();
+  return test_result();
+}
@@ -0,0 +1,114 @@
+// PackReader (user-031): single assets of an encrypted pack come back
+// byte-exact through read() and read_to(), root and subpack entries alike,
+// and contents.json entry keys of the wrong length are rejected.
+
+#include <map>
+#include <stdexcept>
+
+#include "mcbe_pack.h"
+#include "mcbe_pack_reader.h"
+#include "test_util.h"
+
+using namespace mcbe_test;
+
+static const std::string KEY = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdef";
+static const std::string UUID = "0f2d6a58-7a4e-4c43-9d55-3c3b2b5c8f11";
+
+static std::map<std::string, std::vector<uint8_t>> write_plain_pack(
+    const fs::path &path) {
+  std::map<std::string, std::vector<uint8_t>> files;
+  files["manifest.json"] =
+      bytes("{\"format_version\":2,\"header\":{\"uuid\":\"" + UUID + "\"}}");
+  files["pack_icon.png"] = noise(700, 1);
+  files["textures/a.png"] = noise(5000, 2);
+  files["textures/empty.json"] = {};
+  // Several STREAM_WINDOWs plus a tail, streamed by encrypt_pack below
+  files["sounds/long.ogg"] = noise(3 * mcbe_pack::STREAM_WINDOW + 123, 3);
+  files["subpacks/hi/textures/a.png"] = noise(4096, 4);
+
+  mcbe_zip::ZipWriter z(path);
+  // Subpack files are only encrypted under a subpacks/<x>/ directory entry
+  for (auto dirName : {"textures/", "subpacks/", "subpacks/hi/"})
+    z.add_directory(dirName);
+  bool deflate = false;
+  for (auto const &[name, data] : files) {
+    z.add_file(name, data.data(), data.size(), deflate);
+    deflate = !deflate;
+  }
+  z.finish();
+  return files;
+}
+
+static void test_round_trip(const TempDir &dir) {
+  auto files = write_plain_pack(dir / "plain.zip");
+
+  mcbe_pack::EncryptOptions opts;
+  opts.inputZip = dir / "plain.zip";
+  opts.outputZip = dir / "enc.zip";
+  opts.keyFile = dir / "enc.zip.key";
+  opts.masterKey = KEY;
+  opts.excludedFiles = mcbe_pack::default_excluded_files();
+  opts.streamThreshold = 2 * mcbe_pack::STREAM_WINDOW;
+  mcbe_pack::encrypt_pack(opts);
+
+  mcbe_pack::PackReader pack(dir / "enc.zip", KEY);
+  CHECK(pack.content_id() == UUID);
+  CHECK(!pack.contains("textures/missing.png"));
+  CHECK(!pack.contains("textures/"));
+  CHECK_THROWS(std::runtime_error, pack.read("textures/missing.png"));
+
+  for (auto const &[name, data] : files) {
+    CHECK(pack.contains(name));
+    CHECK(pack.read(name) == data);
+
+    std::vector<uint8_t> streamed;
+    size_t pieces = 0;
+    bool bounded = true;
+    pack.read_to(name, [&](const uint8_t *p, size_t n) {
+      bounded = bounded && n <= mcbe_pack::STREAM_WINDOW;
+      streamed.insert(streamed.end(), p, p + n);
+      pieces++;
+    });
+    CHECK(bounded);
+    CHECK(streamed == data);
+    if (data.size() > mcbe_pack::STREAM_WINDOW)
+      CHECK(pieces > 1);
+  }
+
+  // The entries are stored encrypted, not as plaintext
+  const mcbe_zip::ZipEntry *e = pack.zip().find("textures/a.png");
+  CHECK(e && pack.zip().read(*e) != files["textures/a.png"]);
+
+  // Wrong master key: contents.json doesn't decrypt
+  mcbe_pack::PackReader wrong(dir / "enc.zip",
+                              "abcdefghijklmnopqrstuvwxyzABCDEF");
+  CHECK_THROWS(std::runtime_error, wrong.read("textures/a.png"));
+  CHECK_THROWS(std::runtime_error,
+               mcbe_pack::PackReader(dir / "enc.zip", "short"));
+}
+
+static void test_contents_json_keys() {
+  using mcbe_pack::ContentEntry;
+  auto parse = [](const std::vector<ContentEntry> &entries) {
+    auto doc = mcbe_pack::build_contents_json(UUID, KEY, entries);
+    return mcbe_pack::parse_contents_json(doc.data(), doc.size(), KEY);
+  };
+
+  auto ok = parse({{"a.png", std::string(mcbe_pack::KEY_LEN, 'k')},
+                   {"manifest.json", ""}});
+  CHECK(ok.contentId == UUID);
+  CHECK(ok.entries.size() == 2);
+  CHECK(ok.entries[0].key == std::string(mcbe_pack::KEY_LEN, 'k'));
+  CHECK(ok.entries[1].key.empty());
+
+  CHECK_THROWS(std::runtime_error, parse({{"a.png", "0123456789"}}));
+  CHECK_THROWS(std::runtime_error,
+               parse({{"a.png", std::string(mcbe_pack::KEY_LEN + 1, 'k')}}));
+}
+
+int main() {
+  TempDir dir("pack_reader");
+  test_round_trip(dir);
+  test_contents_json_keys();
+  return test_result();
+}
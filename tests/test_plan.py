@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""
+encrypt.plan_pack() through mcbe_native against the pure-Python planner
+(_plan_pack_py). Both must give the same PackPlan, in archive and in name
+order, on archives with subpack edge cases, non-UTF-8 (cp437) and UTF-8
+names, a broken manifest and more entries than the native planner splits
+across threads.
+"""
+
+import os
+import shutil
+import sys
+import tempfile
+import zipfile
+from pathlib import Path
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, HERE)
+sys.path.insert(0, os.path.dirname(HERE))
+from testlib import SKIP, check, main_guard  # noqa: E402
+
+EXCLUDED = {"manifest.json", "pack_icon.png", "bug_pack_icon.png"}
+
+
+def write(path: str, entries: list):
+    """entries: names (directories end in '/') or (name, data) pairs"""
+    with zipfile.ZipFile(path, "w") as z:
+        for e in entries:
+            name, data = (e, e.encode()) if isinstance(e, str) else e
+            if name.endswith("/"):
+                z.writestr(zipfile.ZipInfo(name), b"")
+            else:
+                z.writestr(name, data)
+
+
+def archives(work: str) -> dict:
+    out = {}
+    out["subpacks"] = [
+        "subpacks/", "subpacks/hi/", "subpacks/lo/", "subpacks/hi/deep/",
+        "subpacks/hi/a.png", "subpacks/lo/a.png", "subpacks/hi/deep/b.png",
+        "subpacks/orphan/c.png", "subpacks/readme.txt", "subpacks/hi/",
+        "textures/z.png", "textures/a.png", "pack_icon.png",
+        ("manifest.json", b'{"header": {"uuid": "plan-test"}}'),
+        ("sub/manifest.json", b'{"header": {"uuid": "deeper"}}'),
+    ]
+    out["names"] = [
+        "textures/café.png",  # cp437, no UTF-8 flag
+        "textures/한글.png",  # UTF-8 flag
+        "subpacks/하이/",
+        "subpacks/하이/아.png",
+        ("manifest.json", b"{broken"),
+    ]
+    out["empty"] = []
+    big = ["subpacks/", "subpacks/s0/", "subpacks/s1/", ("manifest.json", b'{"header":{"uuid":"big"}}')]
+    for i in range(70000):
+        kind = i % 4
+        name = (f"textures/t{(i * 7919) % 70000}.png", f"subpacks/s{i % 3}/f{i}.json",
+                f"dir{i}/", f"lang/l{i}.lang")[kind]
+        big.append(name)
+    out["big"] = big
+
+    paths = {}
+    for name, entries in out.items():
+        paths[name] = os.path.join(work, name + ".zip")
+        write(paths[name], entries)
+    return paths
+
+
+def main() -> int:
+    try:
+        import encrypt
+    except ImportError as e:
+        print(f"encrypt.py can't be imported here: {e}")
+        return SKIP
+    if encrypt.mcbe_native is None:
+        print("mcbe_native is not built")
+        return SKIP
+
+    work = tempfile.mkdtemp(prefix="mcbe_plan_")
+    try:
+        for name, path in archives(work).items():
+            for deterministic in (False, True):
+                native = encrypt.PackPlan(**encrypt.mcbe_native.plan_pack(Path(path), tuple(EXCLUDED),
+                                                                          deterministic))
+                with zipfile.ZipFile(path) as z:
+                    python = encrypt._plan_pack_py(z, EXCLUDED, deterministic)
+                check(native == python, f"{name} (deterministic={deterministic}): plans differ\n"
+                                        f"native: {native}\npython: {python}")
+                check(encrypt.plan_pack(Path(path), EXCLUDED, deterministic) == python,
+                      f"{name}: plan_pack() differs from the fallback")
+            print(f"[*] {name}: {python.summary()}")
+        print("[OK] native and Python planners agree")
+        return 0
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main_guard(main)
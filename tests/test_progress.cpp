@@ -0,0 +1,201 @@
+// mcbe_progress::Channel (user-044): the log ring under several producers
+// and a concurrent consumer (nothing lost silently, per-producer order
+// kept, lines intact), the full-ring drop count, UTF-8-safe truncation,
+// untorn phase reads and the counters.
+
+#include <atomic>
+#include <cstdio>
+#include <iterator>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mcbe_progress.h"
+#include "test_util.h"
+
+using namespace mcbe_test;
+using mcbe_progress::Channel;
+
+// Strict UTF-8 check (no overlongs or surrogates needed for these inputs)
+static bool valid_utf8(const std::string &s) {
+  for (size_t i = 0; i < s.size();) {
+    unsigned char c = (unsigned char)s[i];
+    size_t n = c < 0x80 ? 1 : (c >> 5) == 6 ? 2 : (c >> 4) == 14 ? 3
+                            : (c >> 3) == 30 ? 4 : 0;
+    if (!n || i + n > s.size())
+      return false;
+    for (size_t k = 1; k < n; k++)
+      if (((unsigned char)s[i + k] & 0xC0) != 0x80)
+        return false;
+    i += n;
+  }
+  return true;
+}
+
+static void test_full_ring() {
+  Channel ch(5); // rounded up to 8
+  for (int i = 0; i < 10; i++)
+    ch.log("line " + std::to_string(i));
+  mcbe_progress::Snapshot s = ch.snapshot();
+  CHECK(s.pending == 8);
+  CHECK(s.dropped == 2);
+
+  std::vector<std::string> out;
+  CHECK(ch.drain(out, 3) == 3);
+  CHECK(ch.drain(out) == 5);
+  CHECK(out.size() == 8 && out.front() == "line 0" && out.back() == "line 7");
+  CHECK(ch.snapshot().pending == 0);
+
+  // Room again after draining
+  ch.log("again");
+  out.clear();
+  CHECK(ch.drain(out) == 1 && out[0] == "again");
+  CHECK(ch.snapshot().dropped == 2);
+}
+
+static void test_producers() {
+  const int producers = 4;
+  const int lines = 50000;
+  Channel ch(1024);
+  std::atomic<int> running(producers);
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; p++) {
+    threads.emplace_back([&, p]() {
+      for (int i = 0; i < lines; i++) {
+        ch.log("p" + std::to_string(p) + " " + std::to_string(i) + " " +
+               std::string((size_t)(i % 50), 'x'));
+        // Let the consumer keep up some of the time, so both the full
+        // and the flowing ring get exercised
+        if (i % 512 == 0)
+          std::this_thread::yield();
+      }
+      running--;
+    });
+  }
+
+  std::vector<int> last(producers, -1);
+  size_t received = 0;
+  bool intact = true;
+  bool ordered = true;
+  std::vector<std::string> out;
+  for (;;) {
+    bool done = running == 0;
+    out.clear();
+    ch.drain(out, 256);
+    for (auto const &l : out) {
+      int p = -1, i = -1;
+      size_t pos = 0;
+      if (std::sscanf(l.c_str(), "p%d %d %zn", &p, &i, &pos) < 2 || p < 0 ||
+          p >= producers || l.size() - pos != (size_t)(i % 50)) {
+        intact = false;
+        continue;
+      }
+      ordered = ordered && i > last[p];
+      last[p] = i;
+      received++;
+    }
+    if (done && out.empty())
+      break;
+    if (out.empty())
+      std::this_thread::yield();
+  }
+  for (auto &t : threads)
+    t.join();
+
+  mcbe_progress::Snapshot s = ch.snapshot();
+  CHECK(intact);
+  CHECK(ordered);
+  CHECK(received + s.dropped == (size_t)producers * lines);
+  CHECK(received > 0);
+  CHECK(s.pending == 0);
+  std::printf("[*] %zu lines received, %llu dropped\n", received,
+              (unsigned long long)s.dropped);
+}
+
+static void test_truncation() {
+  Channel ch(16);
+  std::string exact(mcbe_progress::LINE_BYTES, 'a');
+  ch.log(exact);
+  ch.log(exact + "b");
+  // "é" would straddle the limit: cut before it
+  ch.log(std::string(mcbe_progress::LINE_BYTES - 1, 'a') + "\xC3\xA9");
+  // 3-byte characters after a 1-byte one: the limit falls inside one
+  std::string hangul = "a";
+  for (int i = 0; i < 100; i++)
+    hangul += "\xED\x95\x9C";
+  ch.log(hangul);
+
+  std::vector<std::string> out;
+  ch.drain(out);
+  CHECK(out.size() == 4);
+  if (out.size() != 4)
+    return;
+  CHECK(out[0] == exact);
+  CHECK(out[1] == exact);
+  CHECK(out[2] == std::string(mcbe_progress::LINE_BYTES - 1, 'a'));
+  CHECK(out[3].size() == 238 && hangul.compare(0, 238, out[3]) == 0);
+  for (auto const &l : out)
+    CHECK(valid_utf8(l));
+
+  ch.set_phase(hangul);
+  std::string phase = ch.snapshot().phase;
+  CHECK(phase.size() <= mcbe_progress::PHASE_BYTES && !phase.empty());
+  CHECK(valid_utf8(phase) && hangul.compare(0, phase.size(), phase) == 0);
+}
+
+static void test_phase_and_counters() {
+  Channel ch;
+  mcbe_progress::Snapshot s = ch.snapshot();
+  CHECK(s.phase.empty() && s.done == 0 && s.total == 0 && !s.finished);
+
+  ch.set_phase("Reading");
+  CHECK(ch.snapshot().phase == "Reading");
+  ch.set_phase("Encrypting");
+  CHECK(ch.snapshot().phase == "Encrypting");
+
+  // Writers racing each other and a reader: every read is one whole phase
+  const std::set<std::string> phases = {
+      "Encrypting", "Writing contents.json and a longer phase name to read",
+      "Zip"};
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> writers;
+  for (int w = 0; w < 2; w++) {
+    writers.emplace_back([&, w]() {
+      for (uint64_t i = 0; !stop; i++) {
+        auto it = phases.begin();
+        std::advance(it, (i + (uint64_t)w) % phases.size());
+        ch.set_phase(*it);
+        ch.advance(1, 10);
+      }
+    });
+  }
+  bool whole = true;
+  for (int i = 0; i < 200000; i++)
+    whole = whole && phases.count(ch.snapshot().phase) == 1;
+  stop = true;
+  for (auto &t : writers)
+    t.join();
+  CHECK(whole);
+
+  s = ch.snapshot();
+  CHECK(s.done > 0 && s.bytes == s.done * 10);
+
+  ch.add_total(5);
+  ch.add_total(7);
+  ch.finish();
+  s = ch.snapshot();
+  CHECK(s.total == 12 && s.finished);
+
+  CHECK(!ch.file_log());
+  ch.set_file_log(true);
+  CHECK(ch.file_log());
+}
+
+int main() {
+  test_full_ring();
+  test_producers();
+  test_truncation();
+  test_phase_and_counters();
+  return test_result();
+}
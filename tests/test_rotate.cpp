@@ -0,0 +1,144 @@
+// Master key rotation (user-033): the rotated pack opens with the new key,
+// assets are copied unchanged, and a failure around the key file never
+// leaves a pack on disk whose key is gone.
+
+#include <stdexcept>
+#include <string>
+
+#include "mcbe_pack.h"
+#include "test_util.h"
+
+using namespace mcbe_test;
+using mcbe_zip::ZipReader;
+
+static const std::string OLD_KEY = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdef";
+static const std::string NEW_KEY = "0123456789abcdefghijklmnopqrstuv";
+
+static void make_pack(const TempDir &dir) {
+  {
+    mcbe_zip::ZipWriter z(dir / "pack.zip");
+    std::string manifest = "{\"header\":{\"uuid\":\"rotate-test\"}}";
+    z.add_file("manifest.json", (const uint8_t *)manifest.data(),
+               manifest.size());
+    auto a = noise(5000, 1);
+    auto b = noise(70000, 2);
+    z.add_file("textures/a.png", a.data(), a.size());
+    z.add_file("textures/b.png", b.data(), b.size(), true);
+    z.finish();
+  }
+  mcbe_pack::EncryptOptions opts;
+  opts.inputZip = dir / "pack.zip";
+  opts.outputZip = dir / "pack_encrypted.zip";
+  opts.keyFile = dir / "pack.zip.key";
+  opts.masterKey = OLD_KEY;
+  mcbe_pack::encrypt_pack(opts);
+}
+
+// contents.json of `pack` decrypts with `key` to the expected content id
+static bool opens_with(const fs::path &pack, const std::string &key) {
+  ZipReader z(pack);
+  const mcbe_zip::ZipEntry *e = z.find("contents.json");
+  if (!e)
+    return false;
+  auto data = z.read(*e);
+  try {
+    return mcbe_pack::parse_contents_json(data.data(), data.size(), key)
+               .contentId == "rotate-test";
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+static std::vector<uint8_t> entry(const fs::path &pack,
+                                  const std::string &name) {
+  ZipReader z(pack);
+  const mcbe_zip::ZipEntry *e = z.find(name);
+  return e ? z.read(*e) : std::vector<uint8_t>();
+}
+
+static mcbe_pack::RotateOptions in_place(const TempDir &dir) {
+  mcbe_pack::RotateOptions opts;
+  opts.inputZip = dir / "pack_encrypted.zip";
+  opts.outputZip = opts.inputZip;
+  opts.keyFile = dir / "pack.zip.key";
+  opts.oldMasterKey = OLD_KEY;
+  opts.newMasterKey = NEW_KEY;
+  return opts;
+}
+
+static void test_rotate() {
+  TempDir dir("rotate");
+  make_pack(dir);
+  auto before = entry(dir / "pack_encrypted.zip", "textures/b.png");
+
+  // Into another directory: the source pack stays as it was
+  fs::create_directories(dir / "out");
+  mcbe_pack::RotateOptions opts = in_place(dir);
+  opts.outputZip = dir / "out" / "pack_encrypted.zip";
+  opts.keyFile = dir / "out" / "pack.zip.key";
+  mcbe_pack::rotate_master_key(opts);
+  CHECK(opens_with(opts.outputZip, NEW_KEY));
+  CHECK(!opens_with(opts.outputZip, OLD_KEY));
+  CHECK(opens_with(opts.inputZip, OLD_KEY));
+  CHECK(mcbe_pack::read_key_file(opts.keyFile) == NEW_KEY);
+  CHECK(fs::exists(dir / "out" / "pack.zip.key.info.txt"));
+  CHECK(entry(opts.outputZip, "textures/b.png") == before);
+
+  // In place, then back again
+  mcbe_pack::rotate_master_key(in_place(dir));
+  CHECK(opens_with(dir / "pack_encrypted.zip", NEW_KEY));
+  CHECK(mcbe_pack::read_key_file(dir / "pack.zip.key") == NEW_KEY);
+  opts = in_place(dir);
+  std::swap(opts.oldMasterKey, opts.newMasterKey);
+  mcbe_pack::rotate_master_key(opts);
+  CHECK(opens_with(dir / "pack_encrypted.zip", OLD_KEY));
+  CHECK(mcbe_pack::read_key_file(dir / "pack.zip.key") == OLD_KEY);
+  CHECK(entry(dir / "pack_encrypted.zip", "textures/b.png") == before);
+  CHECK(!fs::exists(dir / "pack_encrypted.zip.tmp"));
+  CHECK(!fs::exists(dir / "pack.zip.key.tmp"));
+
+  // Wrong old key
+  opts = in_place(dir);
+  opts.oldMasterKey = NEW_KEY;
+  CHECK_THROWS(std::runtime_error, mcbe_pack::rotate_master_key(opts));
+  CHECK(opens_with(dir / "pack_encrypted.zip", OLD_KEY));
+}
+
+// The key can't be written at all: nothing may change
+static void test_key_write_fails() {
+  TempDir dir("rotate_keyfail");
+  make_pack(dir);
+  mcbe_pack::RotateOptions opts = in_place(dir);
+  opts.keyFile = dir / "missing" / "pack.zip.key";
+  CHECK_THROWS(std::runtime_error, mcbe_pack::rotate_master_key(opts));
+  CHECK(opens_with(dir / "pack_encrypted.zip", OLD_KEY));
+  CHECK(mcbe_pack::read_key_file(dir / "pack.zip.key") == OLD_KEY);
+  CHECK(!fs::exists(dir / "pack_encrypted.zip.tmp"));
+}
+
+// The key is written but can't be moved over the old one: the pack has
+// been replaced, so the new key must still be on disk and named in the error
+static void test_key_rename_fails() {
+  TempDir dir("rotate_keymove");
+  make_pack(dir);
+  mcbe_pack::RotateOptions opts = in_place(dir);
+  opts.keyFile = dir / "blocked.key";
+  fs::create_directories(opts.keyFile / "occupied");
+  std::string what;
+  try {
+    mcbe_pack::rotate_master_key(opts);
+  } catch (const std::runtime_error &e) {
+    what = e.what();
+  }
+  CHECK(what.find("blocked.key.tmp") != std::string::npos);
+  CHECK(opens_with(dir / "pack_encrypted.zip", NEW_KEY));
+  CHECK(fs::exists(dir / "blocked.key.tmp") &&
+        mcbe_pack::read_key_file(dir / "blocked.key.tmp") == NEW_KEY);
+}
+
+int main() {
+  test_rotate();
+  test_key_write_fails();
+  test_key_rename_fails();
+  return test_result();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+// Shared by the C++ tests under tests/. CHECK() reports a failed condition
+// and keeps going; main() ends with `return test_result();`. A test that
+// can't run here returns TEST_SKIP (CTest's SKIP_RETURN_CODE).
+
+namespace mcbe_test {
+
+namespace fs = std::filesystem;
+
+static constexpr int TEST_SKIP = 77;
+
+inline int &failures() {
+  static int n = 0;
+  return n;
+}
+
+inline int test_result() {
+  if (failures())
+    std::printf("[FAIL] %d check(s) failed\n", failures());
+  else
+    std::printf("[OK] all checks passed\n");
+  return failures() ? 1 : 0;
+}
+
+// Deterministic bytes, different for every seed
+inline std::vector<uint8_t> noise(size_t n, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::vector<uint8_t> v(n);
+  for (auto &b : v)
+    b = (uint8_t)rng();
+  return v;
+}
+
+inline std::vector<uint8_t> bytes(const std::string &s) {
+  return std::vector<uint8_t>(s.begin(), s.end());
+}
+
+// Fresh directory under the system temp dir, removed with the object
+class TempDir {
+public:
+  explicit TempDir(const std::string &tag) {
+    std::random_device rd;
+    path_ = fs::temp_directory_path() /
+            ("mcbe_" + tag + "_" + std::to_string(rd()));
+    fs::create_directories(path_);
+  }
+  ~TempDir() {
+    std::error_code ec;
+    fs::remove_all(path_, ec);
+  }
+  TempDir(const TempDir &) = delete;
+  TempDir &operator=(const TempDir &) = delete;
+
+  const fs::path &path() const { return path_; }
+  fs::path operator/(const std::string &name) const { return path_ / name; }
+
+private:
+  fs::path path_;
+};
+
+} // namespace mcbe_test
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);     \
+      ++mcbe_test::failures();                                                 \
+    }                                                                          \
+  } while (0)
+
+// Runs `stmt` and checks that it throws `type`
+#define CHECK_THROWS(type, stmt)                                               \
+  do {                                                                         \
+    bool thrown_ = false;                                                      \
+    try {                                                                      \
+      stmt;                                                                    \
+    } catch (const type &) {                                                   \
+      thrown_ = true;                                                          \
+    }                                                                          \
+    if (!thrown_) {                                                            \
+      std::printf("%s:%d: %s did not throw %s\n", __FILE__, __LINE__, #stmt,   \
+                  #type);                                                      \
+      ++mcbe_test::failures();                                                 \
+    }                                                                          \
+  } while (0)
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""
+Plaintext hash sidecar and mcbe_verify.
+
+mcbe_encrypt writes <name>.zip.hashes; mcbe_verify must accept the pack it
+came from and report (exit 1) an entry that decrypts to something else, an
+entry that went missing and one that wasn't hashed. --diff must find the
+same differences between two source packs without any key.
+"""
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import zipfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from testlib import check, main_guard  # noqa: E402
+
+KEY = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdef"
+
+
+def run(cmd: list[str]) -> tuple[int, str]:
+    r = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    return r.returncode, r.stdout
+
+
+def write_zip(path: str, files: dict):
+    with zipfile.ZipFile(path, "w", zipfile.ZIP_DEFLATED) as z:
+        for name, data in files.items():
+            z.writestr(name, data)
+
+
+def rewrite(src: str, dst: str, change):
+    """Copies src to dst with change(name, data) -> bytes or None (drop)."""
+    with zipfile.ZipFile(src) as zin, zipfile.ZipFile(dst, "w", zipfile.ZIP_DEFLATED) as zout:
+        for info in zin.infolist():
+            data = change(info.filename, zin.read(info))
+            if data is not None:
+                zout.writestr(info.filename, data)
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--encrypt", required=True)
+    ap.add_argument("--verify", required=True)
+    args = ap.parse_args()
+
+    work = tempfile.mkdtemp(prefix="mcbe_verify_")
+    try:
+        files = {
+            "manifest.json": b'{"header":{"uuid":"verify-test"}}',
+            "textures/a.png": os.urandom(5000),
+            "textures/b.png": os.urandom(70000),
+            "texts/en_US.lang": b"pack.name=Verify\n" * 100,
+            "empty.txt": b"",
+        }
+        src = os.path.join(work, "pack.zip")
+        write_zip(src, files)
+        out = os.path.join(work, "out")
+        rc, log = run([args.encrypt, src, out, "--key", KEY, "--quiet"])
+        check(rc == 0, f"mcbe_encrypt exited with {rc}:\n{log}")
+        enc = os.path.join(out, "pack_encrypted.zip")
+        keyfile = os.path.join(out, "pack.zip.key")
+        hashes = os.path.join(out, "pack.zip.hashes")
+        check(os.path.exists(hashes), "no .hashes sidecar next to the key file")
+
+        rc, log = run([args.verify, enc, keyfile])
+        check(rc == 0 and f"[OK] {len(files)} entries match" in log, f"clean pack: exit {rc}\n{log}")
+        rc, log = run([args.verify, enc, KEY, hashes, "--threads", "2"])
+        check(rc == 0, f"clean pack, explicit key and hash file: exit {rc}\n{log}")
+
+        # One ciphertext byte flipped (the ZIP CRC is recomputed, so only
+        # the plaintext digest can notice), one entry dropped, one added
+        def tamper(name, data):
+            if name == "textures/b.png":
+                return data[:100] + bytes([data[100] ^ 1]) + data[101:]
+            if name == "texts/en_US.lang":
+                return None
+            return data
+
+        bad = os.path.join(work, "tampered.zip")
+        rewrite(enc, bad, tamper)
+        with zipfile.ZipFile(bad, "a") as z:
+            z.writestr("textures/new.png", b"not in the sidecar")
+        rc, log = run([args.verify, bad, KEY, hashes])
+        check(rc == 1, f"tampered pack: exit {rc}\n{log}")
+        for line in ("M textures/b.png", "- texts/en_US.lang", "+ textures/new.png"):
+            check(line in log, f"tampered pack: no '{line}' in\n{log}")
+        check("M textures/a.png" not in log, f"untouched entry reported:\n{log}")
+
+        # A damaged sidecar is an error, not a pass
+        damaged = os.path.join(work, "damaged.hashes")
+        with open(hashes, "rb") as f:
+            raw = bytearray(f.read())
+        raw[len(raw) // 2] ^= 0xFF
+        with open(damaged, "wb") as f:
+            f.write(raw)
+        rc, log = run([args.verify, enc, KEY, damaged])
+        check(rc == 3, f"damaged sidecar: exit {rc}\n{log}")
+
+        # --diff: sidecar against the source, then two source packs
+        rc, log = run([args.verify, "--diff", hashes, src])
+        check(rc == 0 and "[OK] Identical" in log, f"--diff against the source: exit {rc}\n{log}")
+        changed = dict(files)
+        changed["textures/a.png"] = files["textures/a.png"][::-1]
+        del changed["empty.txt"]
+        changed["textures/c.png"] = b"c"
+        src2 = os.path.join(work, "pack2.zip")
+        write_zip(src2, changed)
+        rc, log = run([args.verify, "--diff", src, src2])
+        check(rc == 1, f"--diff of changed packs: exit {rc}\n{log}")
+        for line in ("+ textures/c.png", "- empty.txt", "M textures/a.png"):
+            check(line in log, f"--diff: no '{line}' in\n{log}")
+        print("[OK] mcbe_verify catches changed, missing and extra entries")
+        return 0
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main_guard(main)
@@ -0,0 +1,136 @@
+// WebAssembly CFB-8 engine (static/mcbe_wasm.js) under Node, against
+// encrypt.py's encrypt_bytes() -- what the Python tool and the Flask service
+// write -- for several keys and lengths, including 0 and lengths that
+// aren't a multiple of 16 or cross the 1 MiB copy chunk. Needs
+// static/wasm/*.wasm, which a native build makes when Emscripten is
+// installed (or emcmake on its own); exits 77 (skipped) without them or
+// without a Python that can import encrypt.py.
+//
+//   node tests/test_wasm.js <static/mcbe_wasm.js> <python>
+
+'use strict';
+
+const { execFileSync } = require('child_process');
+const fs = require('fs');
+const path = require('path');
+
+const SKIP = 77;
+const LENGTHS = [0, 1, 15, 16, 17, 31, 100, 4096, 65537, 1024 * 1024 + 3];
+
+let failures = 0;
+function check(cond, msg) {
+    if (!cond) {
+        console.log(`[FAIL] ${msg}`);
+        failures++;
+    }
+}
+
+function equal(a, b) {
+    return a.length === b.length && Buffer.compare(Buffer.from(a), Buffer.from(b)) === 0;
+}
+
+// Deterministic bytes (xorshift32)
+function noise(n, seed) {
+    const out = new Uint8Array(n);
+    let x = seed >>> 0 || 1;
+    for (let i = 0; i < n; i++) {
+        x ^= x << 13; x >>>= 0;
+        x ^= x >>> 17;
+        x ^= x << 5; x >>>= 0;
+        out[i] = x & 0xff;
+    }
+    return out;
+}
+
+const REFERENCE = 'import sys; sys.path.insert(0, sys.argv[2]); from encrypt import encrypt_bytes; ' +
+    'sys.stdout.buffer.write(encrypt_bytes(sys.stdin.buffer.read(), sys.argv[1]))';
+
+// AES-256-CFB-8, IV = key[:16], as encrypt.py does it
+function referenceEncrypt(data, key, python) {
+    return new Uint8Array(execFileSync(python, ['-c', REFERENCE, key, path.join(__dirname, '..')], {
+        input: Buffer.from(data), maxBuffer: 64 << 20, stdio: ['pipe', 'pipe', 'ignore'],
+    }));
+}
+
+function haveReference(python) {
+    if (!python) return false;
+    try {
+        referenceEncrypt(new Uint8Array(1), 'ABCDEFGHIJKLMNOPQRSTUVWXYZabcdef', python);
+        return true;
+    } catch (e) {
+        return false;
+    }
+}
+
+async function main() {
+    const script = path.resolve(process.argv[2] || path.join(__dirname, '..', 'static', 'mcbe_wasm.js'));
+    const python = process.argv[3];
+    const wasmDir = path.join(path.dirname(script), 'wasm');
+    if (!fs.existsSync(path.join(wasmDir, 'mcbe_wasm.wasm')) ||
+        !fs.existsSync(path.join(wasmDir, 'mcbe_wasm_simd.wasm'))) {
+        console.log(`no WebAssembly build in ${wasmDir} (needs Emscripten)`);
+        return SKIP;
+    }
+    if (!haveReference(python)) {
+        console.log('encrypt.py\'s encrypt_bytes() is not available (mcbe_native or pycryptodome)');
+        return SKIP;
+    }
+
+    const MCBEWasm = require(script);
+    const engine = await MCBEWasm.load();
+    console.log(`[*] backend: ${engine.backend} (SIMD128 ${MCBEWasm.supportsSimd ? 'yes' : 'no'})`);
+
+    const keys = [
+        'ABCDEFGHIJKLMNOPQRSTUVWXYZabcdef',
+        '0123456789abcdefghijklmnopqrstuv',
+        '!"#$%&\'()*+,-./:;<=>?@[\\]^_`{|}~',
+    ];
+    const items = [];
+    keys.forEach((keyStr, ki) => {
+        // The engine also takes the key as bytes
+        const key = ki === 2 ? new Uint8Array(Buffer.from(keyStr)) : keyStr;
+        for (const len of LENGTHS) {
+            const data = noise(len, 1000 * ki + len + 1);
+            const expected = referenceEncrypt(data, keyStr, python);
+            const what = `key ${ki}, ${len} bytes`;
+
+            const ct = engine.encrypt(data, key);
+            check(equal(ct, expected), `encrypt, ${what}`);
+            check(equal(engine.decrypt(ct, key), data), `decrypt, ${what}`);
+
+            // Same stream fed in uneven pieces
+            const cipher = engine.createCipher(key);
+            const parts = [];
+            for (let off = 0, step = 1; off < len; off += step, step = step * 3 + 1) {
+                parts.push(cipher.update(data.subarray(off, Math.min(len, off + step))));
+            }
+            cipher.free();
+            check(equal(Buffer.concat(parts.map((p) => Buffer.from(p))), expected), `chunked update, ${what}`);
+
+            if (len <= 65537) items.push({ data, key, expected, what });
+        }
+    });
+
+    // Multi-lane path used by the worker pool for batches of small entries
+    const many = engine.cryptMany(items.map((it) => ({ data: it.data, key: it.key })));
+    items.forEach((it, i) => check(equal(many[i], it.expected), `cryptMany, ${it.what}`));
+    const back = engine.cryptMany(items.map((it) => ({ data: it.expected, key: it.key })), true);
+    items.forEach((it, i) => check(equal(back[i], it.data), `cryptMany decrypt, ${it.what}`));
+
+    let threw = false;
+    try {
+        engine.encrypt(new Uint8Array(4), 'short key');
+    } catch (e) {
+        threw = true;
+    }
+    check(threw, 'a key that is not 32 bytes is rejected');
+
+    if (failures) return 1;
+    console.log(`[OK] ${keys.length * LENGTHS.length} key/length pairs match encrypt_bytes()`);
+    return 0;
+}
+
+main().then((rc) => process.exit(rc), (e) => {
+    console.log(`[FAIL] ${e && e.stack || e}`);
+    process.exit(1);
+});
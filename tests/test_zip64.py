@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""
+ZIP64 in the native ZIP reader and writer.
+
+1. zip64_tool writes an archive with ZipWriter: more than 65535 entries, a
+   stored entry over 4 GiB and one whose local header lies past 4 GiB.
+   ZipReader/EntryReader and Python's zipfile must both read it back with
+   the CRCs and sizes the writer saw.
+2. zipfile writes a ZIP64 archive with more than 65535 entries; ZipReader
+   must list the same CRCs.
+3. Central directory records whose ZIP64 size or offset point outside the
+   file must be rejected with an error, not crash mcbe_encrypt.
+"""
+
+import argparse
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import zipfile
+import zlib
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from testlib import check, main_guard  # noqa: E402
+
+KEY = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdef"
+CHUNK = 1024 * 1024
+
+
+def listing(text: str) -> list[tuple[int, int, str]]:
+    out = []
+    for line in text.splitlines():
+        crc, size, name = line.split(" ", 2)
+        out.append((int(crc, 16), int(size), name))
+    return out
+
+
+def run_tool(tool: str, *args) -> list[tuple[int, int, str]]:
+    r = subprocess.run([tool, *args], stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    check(r.returncode == 0, f"zip64_tool {args[0]} exited with {r.returncode}: {r.stderr}")
+    return listing(r.stdout)
+
+
+def read_with_zipfile(path: str) -> list[tuple[int, int, str]]:
+    """(crc, size, name) from zipfile, CRC recomputed over the data read."""
+    out = []
+    with zipfile.ZipFile(path) as z:
+        for info in z.infolist():
+            crc, size = 0, 0
+            if not info.is_dir():
+                with z.open(info) as f:
+                    for block in iter(lambda: f.read(CHUNK), b""):
+                        crc = zlib.crc32(block, crc)
+                        size += len(block)
+            check(crc == info.CRC and size == info.file_size,
+                  f"zipfile: {info.filename} data doesn't match its header")
+            out.append((crc, size, info.filename))
+    return out
+
+
+def has_zip64_end_record(path: str) -> bool:
+    with open(path, "rb") as f:
+        f.seek(-22 - 20, os.SEEK_END)
+        return f.read(4) == b"PK\x06\x07"  # ZIP64 end of central directory locator
+
+
+def test_zipwriter(tool: str, work: str, big: int, entries: int):
+    path = os.path.join(work, "written.zip")
+    written = run_tool(tool, "write", path, str(big), str(entries))
+    check(len(written) == entries + 3, f"writer listed {len(written)} entries")
+    check(has_zip64_end_record(path), "no ZIP64 end of central directory")
+    print(f"[*] ZipWriter: {len(written)} entries, {os.path.getsize(path) / 2**30:.2f} GiB")
+
+    check(run_tool(tool, "list", path) == written, "ZipReader disagrees with ZipWriter")
+    check(read_with_zipfile(path) == written, "zipfile disagrees with ZipWriter")
+    os.remove(path)
+    print("[OK] ZipReader and zipfile read the ZipWriter archive")
+
+
+def test_zipfile(tool: str, work: str, entries: int):
+    path = os.path.join(work, "python.zip")
+    expected = []
+    with zipfile.ZipFile(path, "w") as z:
+        for i in range(entries):
+            data = b"python entry %d\n" % i * (i % 5 + 1)
+            info = zipfile.ZipInfo(f"py/{i:06d}.txt")
+            info.compress_type = zipfile.ZIP_DEFLATED if i % 2 else zipfile.ZIP_STORED
+            z.writestr(info, data)
+            expected.append((zlib.crc32(data), len(data), info.filename))
+        # ZIP64 extra field on a small entry
+        data = os.urandom(100000)
+        with z.open(zipfile.ZipInfo("forced.bin"), "w", force_zip64=True) as f:
+            f.write(data)
+        expected.append((zlib.crc32(data), len(data), "forced.bin"))
+
+    check(run_tool(tool, "list", path) == expected, "ZipReader disagrees with zipfile")
+    print(f"[OK] ZipReader reads zipfile's {len(expected)}-entry ZIP64 archive")
+
+
+def malformed(path: str, size: int, offset: int):
+    """One entry whose ZIP64 extra claims `size` bytes at `offset`."""
+    name, data = b"evil.bin", b"A" * 32
+    z64 = struct.pack("<HHQQ", 1, 16, size, size)
+    if offset >= 0xFFFFFFFF:
+        z64 = struct.pack("<HHQQQ", 1, 24, size, size, offset)
+    crc = zlib.crc32(data)
+    local = struct.pack("<IHHHHHIIIHH", 0x04034B50, 45, 0, 0, 0, 0, crc, 0xFFFFFFFF, 0xFFFFFFFF,
+                        len(name), len(z64)) + name + z64 + data
+    central = struct.pack("<IHHHHHHIIIHHHHHII", 0x02014B50, 45, 45, 0, 0, 0, 0, crc, 0xFFFFFFFF,
+                          0xFFFFFFFF, len(name), len(z64), 0, 0, 0, 0,
+                          min(offset, 0xFFFFFFFF)) + name + z64
+    end = struct.pack("<IHHHHIIH", 0x06054B50, 0, 0, 1, 1, len(central), len(local), 0)
+    with open(path, "wb") as f:
+        f.write(local + central + end)
+
+
+def test_malformed(tool: str, encrypt: str, work: str):
+    cases = {
+        "size near 2^64": (2**64 - 16, 0),
+        "size past the end": (1 << 33, 0),
+        "offset near 2^64": (32, 2**64 - 8),
+        "offset past the end": (32, 1 << 33),
+    }
+    path = os.path.join(work, "evil.zip")
+    for what, (size, offset) in cases.items():
+        malformed(path, size, offset)
+        r = subprocess.run([encrypt, path, os.path.join(work, "evil_out"), "--key", KEY, "--quiet"],
+                           stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+        check(r.returncode == 3 and "Corrupt ZIP" in r.stdout,
+              f"mcbe_encrypt, {what}: exit {r.returncode}\n{r.stdout}")
+        r = subprocess.run([tool, "list", path], stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+        check(r.returncode == 3, f"ZipReader, {what}: exit {r.returncode}")
+    print(f"[OK] {len(cases)} malformed ZIP64 records rejected")
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--tool", required=True)
+    ap.add_argument("--encrypt", required=True)
+    ap.add_argument("--big-size", type=int, default=4 * 2**30 + CHUNK)
+    ap.add_argument("--entries", type=int, default=70000)
+    ap.add_argument("--workdir", default=None)
+    args = ap.parse_args()
+
+    work = tempfile.mkdtemp(prefix="mcbe_zip64_", dir=args.workdir)
+    try:
+        test_malformed(args.tool, args.encrypt, work)
+        test_zipfile(args.tool, work, args.entries)
+        test_zipwriter(args.tool, work, args.big_size, args.entries)
+        return 0
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main_guard(main)
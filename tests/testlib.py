@@ -0,0 +1,41 @@
+"""Helpers shared by the Python test scripts under tests/."""
+
+import os
+import subprocess
+import sys
+
+# CTest's SKIP_RETURN_CODE for every test in tests/CMakeLists.txt
+SKIP = 77
+
+
+class Failure(Exception):
+    pass
+
+
+def check(cond: bool, msg: str):
+    if not cond:
+        raise Failure(msg)
+
+
+def run_measured(cmd: list[str], stdin=None) -> tuple[int, float, str]:
+    """
+    Runs cmd to completion; returns (exit code, peak RSS in MiB, stdout).
+    Linux folds the RSS the child had before exec() (a fork of this
+    interpreter, ~10-20 MiB) into ru_maxrss, so this is an upper bound on
+    the tool's own peak.
+    """
+    proc = subprocess.Popen(cmd, stdin=stdin, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    out = proc.stdout.read()
+    # wait4 gives the rusage of exactly this child (ru_maxrss is KiB on Linux)
+    _, status, usage = os.wait4(proc.pid, 0)
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    return proc.returncode, usage.ru_maxrss / 1024, out
+
+
+def main_guard(main):
+    """Turns Failure into a message and exit code 1."""
+    try:
+        sys.exit(main())
+    except Failure as e:
+        print(f"[FAIL] {e}")
+        sys.exit(1)
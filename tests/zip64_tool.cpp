@@ -0,0 +1,100 @@
+// Helper for test_zip64.py: writes ZIP64 archives with mcbe_zip::ZipWriter
+// and reads any archive back through ZipReader/EntryReader. Both modes print
+// one "<crc32> <size> <name>" line per entry, in central directory order,
+// with the CRC computed over the bytes actually written or read.
+//
+//   zip64_tool write <out.zip> <big entry bytes> <small entries>
+//   zip64_tool list <in.zip>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "mcbe_zip.h"
+
+static void print_entry(uint32_t crc, uint64_t size, const std::string &name) {
+  std::printf("%08" PRIx32 " %" PRIu64 " %s\n", crc, size, name.c_str());
+}
+
+static int write_archive(const char *path, uint64_t bigSize, size_t small) {
+  mcbe_zip::ZipWriter z(path);
+
+  z.add_directory("small/");
+  print_entry(0, 0, "small/");
+  for (size_t i = 0; i < small; i++) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "small/%06zu.txt", i);
+    std::string data;
+    for (size_t k = 0; k <= i % 7; k++)
+      data += "entry " + std::to_string(i) + "\n";
+    z.add_file(name, (const uint8_t *)data.data(), data.size(), i % 2 == 1);
+    print_entry(mcbe_zip::crc32((const uint8_t *)data.data(), data.size()),
+                data.size(), name);
+  }
+
+  // 1 MiB blocks, each stamped with its index so a repeated or dropped
+  // block changes the CRC
+  std::vector<uint8_t> block(1024 * 1024);
+  for (size_t i = 0; i < block.size(); i++)
+    block[i] = (uint8_t)(i * 2654435761u >> 13);
+  uint32_t crc = 0;
+  z.begin_file("big.bin", false, bigSize);
+  for (uint64_t done = 0, index = 0; done < bigSize; index++) {
+    std::memcpy(block.data(), &index, sizeof(index));
+    size_t n = (size_t)std::min<uint64_t>(block.size(), bigSize - done);
+    z.write(block.data(), n);
+    crc = mcbe_zip::crc32(block.data(), n, crc);
+    done += n;
+  }
+  z.end_file();
+  print_entry(crc, bigSize, "big.bin");
+
+  // Local header past 4 GiB: only reachable through the ZIP64 offset
+  static const char tail[] = "written after big.bin\n";
+  z.add_file("tail.txt", (const uint8_t *)tail, sizeof(tail) - 1);
+  print_entry(mcbe_zip::crc32((const uint8_t *)tail, sizeof(tail) - 1),
+              sizeof(tail) - 1, "tail.txt");
+
+  z.finish();
+  return 0;
+}
+
+static int list_archive(const char *path) {
+  mcbe_zip::ZipReader z(path);
+  std::vector<uint8_t> buf(1024 * 1024);
+  for (auto const &e : z.entries()) {
+    uint32_t crc = 0;
+    uint64_t size = 0;
+    if (!e.is_dir()) {
+      mcbe_zip::EntryReader r(z, e);
+      size_t n;
+      while ((n = r.read(buf.data(), buf.size())) > 0) {
+        crc = mcbe_zip::crc32(buf.data(), n, crc);
+        size += n;
+      }
+    }
+    print_entry(crc, size, e.name);
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  try {
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "write" && argc == 5)
+      return write_archive(argv[2], std::stoull(argv[3]),
+                           (size_t)std::stoull(argv[4]));
+    if (mode == "list" && argc == 3)
+      return list_archive(argv[2]);
+    std::fprintf(stderr, "Usage: zip64_tool write <out.zip> <big bytes> "
+                         "<small entries> | list <in.zip>\n");
+    return 2;
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "[ERROR] %s\n", e.what());
+    return 3;
+  }
+}